@@ -12,11 +12,22 @@ BasicModel::BasicModel(ID3D11Device* device, TextureMgr& texMgr, const std::stri
 	ModelMesh.SetIndices(device, &Indices[0], Indices.size());
 	ModelMesh.SetSubsetTable(Subsets);
 
+	XNA::ComputeBoundingAxisAlignedBoxFromPointsParallel(&Bounds, Vertices.size(), 
+		&Vertices[0].Pos, sizeof(Vertex::PosNormalTexTan));
+
+	SubsetBounds.resize(Subsets.size());
+	MeshGeometry::ComputeSubsetBounds(Subsets, &Vertices[0].Pos, sizeof(Vertex::PosNormalTexTan), 
+		&SubsetBounds[0], 0);
+
+	PickBvh.Build(&Vertices[0].Pos, sizeof(Vertex::PosNormalTexTan), &Indices[0], Indices.size()/3);
+
 	SubsetCount = mats.size();
 
 	for(UINT i = 0; i < SubsetCount; ++i)
 	{
 		Mat.push_back(mats[i].Mat);
+		AlphaClip.push_back(mats[i].AlphaClip);
+		Tessellation.push_back(TessellationSettings());
 
 		ID3D11ShaderResourceView* diffuseMapSRV = texMgr.CreateTexture(texturePath + mats[i].DiffuseMapName);
 		textureResourceView.push_back(diffuseMapSRV);
@@ -4,6 +4,9 @@
 #include "MeshGeometry.h"
 #include "TextureMgr.h"
 #include "Vertex.h"
+#include "xnacollision.h"
+#include "TriangleBvh.h"
+#include "TessellationLod.h"
 
 class BasicModel
 {
@@ -17,11 +20,26 @@ public:
 	std::vector<ID3D11ShaderResourceView*> textureResourceView;
 	std::vector<ID3D11ShaderResourceView*> NormalMapSRV;
 
+	// Subsets drawn with the alpha clip techniques.
+	std::vector<bool> AlphaClip;
+
+	// Displacement tessellation of each subset; off unless set after loading.
+	std::vector<TessellationSettings> Tessellation;
+
 	// Keep CPU copies of the mesh data to read from.  
 	std::vector<Vertex::PosNormalTexTan> Vertices;
 	std::vector<USHORT> Indices;
 	std::vector<MeshGeometry::Subset> Subsets;
 
+	// Model space bounds of all the vertices.
+	XNA::AxisAlignedBox Bounds;
+
+	// Model space bounds of each subset.
+	std::vector<XNA::AxisAlignedBox> SubsetBounds;
+
+	// Model space triangle tree for exact picking.
+	TriangleBvh PickBvh;
+
 	MeshGeometry ModelMesh;
 };
 
@@ -1,9 +1,11 @@
 #include "BlenderModel.h"
+#include "ScopeProfiler.h"
 #include <locale>
 #include <codecvt>
 #include <string>
 
 BlenderModel::BlenderModel(Camera* mCamera, ID3D11Device* mDevice, ID3D11DeviceContext* mDeviceContext)
+	: mActiveTech(0), mActivePass(0)
 {
 	mCam = mCamera;
 	md3dDevice = mDevice;
@@ -19,6 +21,8 @@ BlenderModel::~BlenderModel()
 
 void BlenderModel::LoadModel(const std::string & filename,TextureMgr* mTexMgr)
 {
+	PROFILE_SCOPE("BlenderModel::LoadModel");
+
 	Assimp::Importer imp;
 
 	const aiScene* pScene = imp.ReadFile(filename,
@@ -61,6 +65,8 @@ void BlenderModel::LoadModel(const std::string & filename,TextureMgr* mTexMgr)
 
 	mModel.mSubsetCount = subsets.size();
 
+	BuildStateIds();
+
 	mModel.Mesh.SetSubsetTable(subsets);
 	mModel.Mesh.SetIndices(md3dDevice, &indices[0], indices.size());
 	mModel.Mesh.SetVertices(md3dDevice, &vertices[0], vertices.size());
@@ -170,9 +176,66 @@ void BlenderModel::ReadTextures(aiMaterial *material, TextureMgr * mTexMgr)
 	}
 	
 }
+void BlenderModel::BuildStateIds()
+{
+	mTextureIds.resize(mModel.mSubsetCount);
+	mMaterialIds.resize(mModel.mSubsetCount);
+
+	for (UINT i = 0; i < mModel.mSubsetCount; i++)
+	{
+		// Id of the first subset with the same texture or material.
+		mTextureIds[i] = i;
+		mMaterialIds[i] = i;
+
+		for (UINT j = 0; j < i; j++)
+		{
+			if (mTextureIds[i] == i && textureResourceView[j] == textureResourceView[i])
+				mTextureIds[i] = mTextureIds[j];
+
+			if (mMaterialIds[i] == i && memcmp(&Materials[j], &Materials[i], sizeof(Material)) == 0)
+				mMaterialIds[i] = mMaterialIds[j];
+		}
+	}
+}
+
+const RenderQueue::FrameStats& BlenderModel::QueueStats()const
+{
+	return mQueue.Stats();
+}
+
+void BlenderModel::SetState(RenderQueue::StateType type, unsigned int id)
+{
+	switch (type)
+	{
+	case RenderQueue::RasterizerState:
+		md3dImmediateContext->RSSetState(0);
+		break;
+
+	case RenderQueue::TextureState:
+		Effects::BasicFX->SetDiffuseMap(textureResourceView[id]);
+		break;
+
+	case RenderQueue::MaterialState:
+		Effects::BasicFX->SetMaterial(Materials[id]);
+		break;
+
+	default:
+		// One technique, and the blend state is left as bound.
+		break;
+	}
+}
+
+void BlenderModel::Draw(const RenderQueue::Packet& packet)
+{
+	Effects::BasicFX->Apply(mActiveTech->GetPassByIndex(mActivePass), md3dImmediateContext);
+	mModel.Mesh.Draw(md3dImmediateContext, packet.Draw);
+}
+
 void BlenderModel::Render(CXMMATRIX world)
 {
-	ID3DX11EffectTechnique* activeTech = Effects::BasicFX->Light0TexTech;
+	PROFILE_SCOPE("BlenderModel::Render");
+
+	ID3DX11EffectTechnique* activeTech = Effects::BasicFX->Technique(LitFeatures(0, true));
 	md3dImmediateContext->IASetInputLayout(InputLayouts::Basic32);
 
 	UINT Stride = sizeof(Vertex::Basic32);
@@ -189,17 +252,24 @@ void BlenderModel::Render(CXMMATRIX world)
 
 	D3DX11_TECHNIQUE_DESC techDesc;
 	activeTech->GetDesc(&techDesc);
-	md3dImmediateContext->RSSetState(0);
+	mActiveTech = activeTech;
 	for (UINT p = 0; p < techDesc.Passes; ++p)
 	{
 		md3dImmediateContext->IASetVertexBuffers(0, 1, &mModel.VertexBuffer, &Stride, &Offset);
 		md3dImmediateContext->IASetIndexBuffer(mModel.IndexBuffer, DXGI_FORMAT_R32_UINT, 0);
+
+		// Subsets are queued by texture and material so the ones sharing a map
+		// or material are drawn together and it is only set once.
 		for (UINT i = 0; i < mModel.mSubsetCount; i++)
 		{
-			Effects::BasicFX->SetMaterial(Materials[i]);
-			Effects::BasicFX->SetDiffuseMap(textureResourceView[i]);
-			activeTech->GetPassByIndex(p)->Apply(0, md3dImmediateContext);
-			mModel.Mesh.Draw(md3dImmediateContext, i);
+			UINT state[RenderQueue::StateTypeCount] = { 0 };
+			state[RenderQueue::TextureState] = mTextureIds[i];
+			state[RenderQueue::MaterialState] = mMaterialIds[i];
+
+			mQueue.Submit(0, state, 0.0f, i);
 		}
+
+		mActivePass = p;
+		mQueue.Execute(*this);
 	}
 }
@@ -9,8 +9,9 @@
 #include "Camera.h"
 #include "TextureMgr.h"
 #include "MeshGeometry.h"
+#include "RenderQueue.h"
 
-class BlenderModel
+class BlenderModel : private RenderQueue::Target
 {
 public:
 	BlenderModel(Camera* mCam, ID3D11Device* pDevice, ID3D11DeviceContext* pDeviceContext);
@@ -19,6 +20,9 @@ public:
 	void Render(CXMMATRIX world);
 	XMFLOAT4X4 mWorld;
 
+	// State changes of the last Render.
+	const RenderQueue::FrameStats& QueueStats()const;
+
 private:
 	struct ModelData
 	{
@@ -51,6 +55,20 @@ private:
 	void BlenderModel::ReadIndices(aiMesh * mesh, std::vector<USHORT> & indices, MeshGeometry::Subset subset);
 	void BlenderModel::ReadMaterials(aiMaterial * material);
 	void BlenderModel::ReadTextures(aiMaterial *material,TextureMgr* mTexMgr);
+	void BuildStateIds();
+
+	// RenderQueue::Target
+	void SetState(RenderQueue::StateType type, unsigned int id);
+	void Draw(const RenderQueue::Packet& packet);
+
+	// Per subset ids of the diffuse map and material.  Subsets sharing one get
+	// the same id, so the queue can skip setting it again.
+	std::vector<UINT> mTextureIds;
+	std::vector<UINT> mMaterialIds;
+
+	RenderQueue mQueue;
+	ID3DX11EffectTechnique* mActiveTech;
+	UINT mActivePass;
 
 	Camera* mCam;  
 	ID3D11Device* md3dDevice;
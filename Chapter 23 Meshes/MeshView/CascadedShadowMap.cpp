@@ -0,0 +1,137 @@
+//***************************************************************************************
+// CascadedShadowMap.cpp
+//***************************************************************************************
+
+#include "CascadedShadowMap.h"
+#include "Camera.h"
+
+CascadedShadowMap::CascadedShadowMap(ID3D11Device* device, UINT size, int cascadeCount)
+	: mShadowMap(device, size, size, cascadeCount)
+{
+	mCascades.SetCascadeCount(cascadeCount);
+	mCascades.SetShadowMapSize(size);
+
+	XMMATRIX I = XMMatrixIdentity();
+	XMStoreFloat4x4(&mLightView, I);
+
+	for(int i = 0; i < ShadowCascades::MaxCascades; ++i)
+	{
+		XMStoreFloat4x4(&mLightProj[i], I);
+		XMStoreFloat4x4(&mShadowTransform[i], I);
+	}
+}
+
+CascadedShadowMap::~CascadedShadowMap()
+{
+}
+
+int CascadedShadowMap::CascadeCount()const
+{
+	return mCascades.CascadeCount();
+}
+
+void CascadedShadowMap::SetSplitLambda(float lambda)
+{
+	mCascades.SetSplitLambda(lambda);
+}
+
+void CascadedShadowMap::SetSceneBounds(const XMFLOAT3& center, float radius)
+{
+	mCascades.SetSceneBounds(&center.x, radius);
+}
+
+void CascadedShadowMap::Update(const Camera& camera, const XMFLOAT3& lightDir)
+{
+	// The light looks down lightDir from the world origin, so the light view
+	// only changes when the light turns, not when the camera moves.
+	XMVECTOR dir = XMVector3Normalize(XMLoadFloat3(&lightDir));
+	XMVECTOR up = XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
+	if( fabsf(XMVectorGetY(dir)) > 0.99f )
+		up = XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f);
+
+	XMMATRIX V = XMMatrixLookAtLH(-dir, XMVectorZero(), up);
+	XMStoreFloat4x4(&mLightView, V);
+
+	mCascades.SetLightView(mLightView.m);
+
+	ShadowCascades::Frustum frustum;
+	XMFLOAT3 pos = camera.GetPosition();
+	XMFLOAT3 right = camera.GetRight();
+	XMFLOAT3 camUp = camera.GetUp();
+	XMFLOAT3 look = camera.GetLook();
+
+	for(int i = 0; i < 3; ++i)
+	{
+		frustum.Position[i] = (&pos.x)[i];
+		frustum.Right[i] = (&right.x)[i];
+		frustum.Up[i] = (&camUp.x)[i];
+		frustum.Look[i] = (&look.x)[i];
+	}
+
+	frustum.FovY = camera.GetFovY();
+	frustum.Aspect = camera.GetAspect();
+	frustum.NearZ = camera.GetNearZ();
+	frustum.FarZ = camera.GetFarZ();
+
+	mCascades.Fit(frustum);
+
+	// Transform NDC space [-1,+1]^2 to texture space [0,1]^2
+	XMMATRIX T(
+		0.5f, 0.0f, 0.0f, 0.0f,
+		0.0f, -0.5f, 0.0f, 0.0f,
+		0.0f, 0.0f, 1.0f, 0.0f,
+		0.5f, 0.5f, 0.0f, 1.0f);
+
+	for(int i = 0; i < mCascades.CascadeCount(); ++i)
+	{
+		const ShadowCascades::Box& box = mCascades.CascadeBox(i);
+
+		XMMATRIX P = XMMatrixOrthographicOffCenterLH(box.Left, box.Right, box.Bottom, box.Top, box.Near, box.Far);
+
+		XMStoreFloat4x4(&mLightProj[i], P);
+		XMStoreFloat4x4(&mShadowTransform[i], V*P*T);
+	}
+}
+
+XMMATRIX CascadedShadowMap::LightView()const
+{
+	return XMLoadFloat4x4(&mLightView);
+}
+
+XMMATRIX CascadedShadowMap::LightProj(int cascade)const
+{
+	return XMLoadFloat4x4(&mLightProj[cascade]);
+}
+
+const XMFLOAT4X4* CascadedShadowMap::ShadowTransforms()const
+{
+	return mShadowTransform;
+}
+
+XMFLOAT4 CascadedShadowMap::SplitDistances()const
+{
+	float splits[ShadowCascades::MaxCascades];
+	mCascades.CascadeEnds(splits);
+
+	return XMFLOAT4(splits[0], splits[1], splits[2], splits[3]);
+}
+
+UINT CascadedShadowMap::Size()const
+{
+	return mShadowMap.Width();
+}
+
+ID3D11ShaderResourceView* CascadedShadowMap::DepthMapSRV()
+{
+	return mShadowMap.DepthMapSRV();
+}
+
+void CascadedShadowMap::BindDsvAndSetNullRenderTarget(ID3D11DeviceContext* dc, int cascade)
+{
+	mShadowMap.BindDsvAndSetNullRenderTarget(dc, cascade);
+}
+
+const ShadowCascades& CascadedShadowMap::Cascades()const
+{
+	return mCascades;
+}
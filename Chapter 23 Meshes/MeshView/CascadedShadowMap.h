@@ -0,0 +1,70 @@
+//***************************************************************************************
+// CascadedShadowMap.h
+//
+// Shadows from a directional light in several cascades, each covering a depth
+// range of the camera frustum with its own slice of a ShadowMap texture array.
+// ShadowCascades does the fitting; this class turns its boxes into the matrices
+// the shadow and scene passes use.
+//***************************************************************************************
+
+#ifndef CASCADEDSHADOWMAP_H
+#define CASCADEDSHADOWMAP_H
+
+#include "d3dUtil.h"
+#include "ShadowMap.h"
+#include "ShadowCascades.h"
+
+class Camera;
+
+class CascadedShadowMap
+{
+public:
+	CascadedShadowMap(ID3D11Device* device, UINT size, int cascadeCount);
+	~CascadedShadowMap();
+
+	int CascadeCount()const;
+
+	// 0 splits uniformly, 1 logarithmically.  0.75 by default.
+	void SetSplitLambda(float lambda);
+
+	// Sphere around the shadow casters.
+	void SetSceneBounds(const XMFLOAT3& center, float radius);
+
+	// Fits the cascades to the camera.  Call once a frame, before drawing the
+	// cascades.
+	void Update(const Camera& camera, const XMFLOAT3& lightDir);
+
+	// For drawing cascade i into its slice.
+	XMMATRIX LightView()const;
+	XMMATRIX LightProj(int cascade)const;
+
+	// World space to the texture space of each cascade, for the scene pass.
+	const XMFLOAT4X4* ShadowTransforms()const;
+
+	// Distance along the camera's look vector where each cascade ends.  Unused
+	// components are past the far plane.
+	XMFLOAT4 SplitDistances()const;
+
+	// Width and height of each cascade's slice.
+	UINT Size()const;
+
+	ID3D11ShaderResourceView* DepthMapSRV();
+
+	void BindDsvAndSetNullRenderTarget(ID3D11DeviceContext* dc, int cascade);
+
+	const ShadowCascades& Cascades()const;
+
+private:
+	CascadedShadowMap(const CascadedShadowMap& rhs);
+	CascadedShadowMap& operator=(const CascadedShadowMap& rhs);
+
+private:
+	ShadowMap mShadowMap;
+	ShadowCascades mCascades;
+
+	XMFLOAT4X4 mLightView;
+	XMFLOAT4X4 mLightProj[ShadowCascades::MaxCascades];
+	XMFLOAT4X4 mShadowTransform[ShadowCascades::MaxCascades];
+};
+
+#endif // CASCADEDSHADOWMAP_H
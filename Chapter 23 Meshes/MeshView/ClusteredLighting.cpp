@@ -0,0 +1,191 @@
+//***************************************************************************************
+// ClusteredLighting.cpp
+//***************************************************************************************
+
+#include "ClusteredLighting.h"
+#include "Camera.h"
+#include "Effects.h"
+#include "ScopeProfiler.h"
+
+ClusteredLighting::ClusteredLighting(ID3D11Device* device, UINT initialLightCapacity)
+	: md3dDevice(device), mPointLightCount(0), mSpotLightCount(0), mTileScale(0.0f, 0.0f)
+{
+	StructuredBuffer* buffers[] = { &mPointLights, &mSpotLights, &mClusterTable, &mLightIndices };
+	UINT strides[] = { sizeof(PointLight), sizeof(SpotLight), sizeof(LightClusters::Cluster), sizeof(UINT) };
+
+	for(int i = 0; i < 4; ++i)
+	{
+		buffers[i]->Buffer = 0;
+		buffers[i]->SRV = 0;
+		buffers[i]->Stride = strides[i];
+		buffers[i]->Capacity = 0;
+	}
+
+	UINT capacity = initialLightCapacity > 0 ? initialLightCapacity : 1;
+	Reserve(mPointLights, capacity);
+	Reserve(mSpotLights, capacity);
+	Reserve(mClusterTable, mClusters.ClusterCount());
+	Reserve(mLightIndices, capacity);
+}
+
+ClusteredLighting::~ClusteredLighting()
+{
+	StructuredBuffer* buffers[] = { &mPointLights, &mSpotLights, &mClusterTable, &mLightIndices };
+
+	for(int i = 0; i < 4; ++i)
+	{
+		ReleaseCOM(buffers[i]->SRV);
+		ReleaseCOM(buffers[i]->Buffer);
+	}
+}
+
+LightClusters& ClusteredLighting::Clusters()
+{
+	return mClusters;
+}
+
+UINT ClusteredLighting::LightCount()const
+{
+	return mPointLightCount + mSpotLightCount;
+}
+
+UINT ClusteredLighting::LightIndexCount()const
+{
+	return (UINT)mClusters.LightIndices().size();
+}
+
+void ClusteredLighting::Reserve(StructuredBuffer& sb, UINT count)
+{
+	if( count <= sb.Capacity )
+		return;
+
+	UINT capacity = sb.Capacity > 0 ? sb.Capacity : 1;
+	while( capacity < count )
+		capacity *= 2;
+
+	ReleaseCOM(sb.SRV);
+	ReleaseCOM(sb.Buffer);
+
+	D3D11_BUFFER_DESC bd;
+	bd.Usage = D3D11_USAGE_DYNAMIC;
+	bd.ByteWidth = sb.Stride * capacity;
+	bd.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	bd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	bd.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+	bd.StructureByteStride = sb.Stride;
+
+	HR(md3dDevice->CreateBuffer(&bd, 0, &sb.Buffer));
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc;
+	srvDesc.Format = DXGI_FORMAT_UNKNOWN;
+	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+	srvDesc.Buffer.FirstElement = 0;
+	srvDesc.Buffer.NumElements = capacity;
+
+	HR(md3dDevice->CreateShaderResourceView(sb.Buffer, &srvDesc, &sb.SRV));
+
+	sb.Capacity = capacity;
+}
+
+void ClusteredLighting::Upload(ID3D11DeviceContext* dc, StructuredBuffer& sb, const void* data, UINT count)
+{
+	if( count == 0 )
+		return;
+
+	Reserve(sb, count);
+
+	D3D11_MAPPED_SUBRESOURCE mappedData;
+	HR(dc->Map(sb.Buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedData));
+	memcpy(mappedData.pData, data, sb.Stride * count);
+	dc->Unmap(sb.Buffer, 0);
+}
+
+void ClusteredLighting::Update(ID3D11DeviceContext* dc, const Camera& camera, float viewportWidth, float viewportHeight,
+	const std::vector<PointLight>& pointLights, const std::vector<SpotLight>& spotLights)
+{
+	PROFILE_SCOPE("ClusteredLighting::Update");
+
+	mClusters.SetFrustum(camera.GetFovY(), camera.GetAspect(), camera.GetNearZ(), camera.GetFarZ());
+
+	mTileScale.x = mClusters.TilesX() / viewportWidth;
+	mTileScale.y = mClusters.TilesY() / viewportHeight;
+
+	mPointLightCount = (UINT)pointLights.size();
+	mSpotLightCount = (UINT)spotLights.size();
+
+	// View space bounds, the point lights first.
+	XMMATRIX view = camera.View();
+	mBounds.resize(mPointLightCount + mSpotLightCount);
+
+	for(UINT i = 0; i < mPointLightCount; ++i)
+	{
+		const PointLight& L = pointLights[i];
+
+		XMFLOAT3 posV;
+		XMStoreFloat3(&posV, XMVector3TransformCoord(XMLoadFloat3(&L.Position), view));
+
+		mBounds[i] = LightClusters::PointBounds(&posV.x, L.Range);
+	}
+
+	for(UINT i = 0; i < mSpotLightCount; ++i)
+	{
+		const SpotLight& L = spotLights[i];
+
+		XMFLOAT3 posV;
+		XMFLOAT3 dirV;
+		XMStoreFloat3(&posV, XMVector3TransformCoord(XMLoadFloat3(&L.Position), view));
+		XMStoreFloat3(&dirV, XMVector3Normalize(XMVector3TransformNormal(XMLoadFloat3(&L.Direction), view)));
+
+		mBounds[mPointLightCount + i] = LightClusters::SpotBounds(&posV.x, &dirV.x, L.Range, L.Spot);
+	}
+
+	mClusters.Bin(mBounds.empty() ? 0 : &mBounds[0], (UINT)mBounds.size());
+
+	const std::vector<LightClusters::Cluster>& clusters = mClusters.Clusters();
+	const std::vector<UINT>& indices = mClusters.LightIndices();
+
+	if( mPointLightCount > 0 )
+		Upload(dc, mPointLights, &pointLights[0], mPointLightCount);
+	if( mSpotLightCount > 0 )
+		Upload(dc, mSpotLights, &spotLights[0], mSpotLightCount);
+
+	Upload(dc, mClusterTable, &clusters[0], (UINT)clusters.size());
+	if( !indices.empty() )
+		Upload(dc, mLightIndices, &indices[0], (UINT)indices.size());
+}
+
+void ClusteredLighting::Apply(BasicEffect* fx)const
+{
+	ApplyEffect(fx);
+}
+
+void ClusteredLighting::Apply(NormalMapEffect* fx)const
+{
+	ApplyEffect(fx);
+}
+
+void ClusteredLighting::Disable(BasicEffect* fx)
+{
+	fx->SetClusterLightCount(0);
+}
+
+void ClusteredLighting::Disable(NormalMapEffect* fx)
+{
+	fx->SetClusterLightCount(0);
+}
+
+template <typename EffectType>
+void ClusteredLighting::ApplyEffect(EffectType* fx)const
+{
+	fx->SetClusterGrid(mClusters.TilesX(), mClusters.TilesY(), mClusters.Slices());
+	fx->SetClusterTileScale(mTileScale);
+	fx->SetClusterDepthScale(mClusters.DepthScale());
+	fx->SetClusterDepthBias(mClusters.DepthBias());
+	fx->SetClusterPointLightCount(mPointLightCount);
+	fx->SetClusterLightCount(mPointLightCount + mSpotLightCount);
+
+	fx->SetClusterPointLights(mPointLights.SRV);
+	fx->SetClusterSpotLights(mSpotLights.SRV);
+	fx->SetClusters(mClusterTable.SRV);
+	fx->SetClusterLightIndices(mLightIndices.SRV);
+}
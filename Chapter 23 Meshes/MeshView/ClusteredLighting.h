@@ -0,0 +1,95 @@
+//***************************************************************************************
+// ClusteredLighting.h
+//
+// Lights a scene with hundreds of point and spot lights by giving each pixel only
+// the lights that can reach its cluster of the camera frustum (see
+// FX/ClusteredLights.fx).
+//   -Update bins the lights for the camera with LightClusters and writes the
+//    lights, the cluster table and the cluster light lists to dynamic structured
+//    buffers, which grow by doubling.
+//   -Apply hands the buffers and grid constants to BasicEffect or NormalMapEffect;
+//    their lit techniques then add the clustered lights to the directional ones.
+// The lights are in world space, as LightHelper.h defines them.  Spot lights are
+// cut off where their spot factor drops below LightClusters::MinSpotFactor.
+// MeshViewApp does not use it yet: its one lit draw, BlenderModel::Render, uses the
+// Light0Tex permutation, which skips lighting, and the shadow and SSAO maps a lit
+// permutation reads are not built.
+//***************************************************************************************
+
+#ifndef CLUSTEREDLIGHTING_H
+#define CLUSTEREDLIGHTING_H
+
+#include "d3dUtil.h"
+#include "LightHelper.h"
+#include "LightClusters.h"
+#include <vector>
+
+class Camera;
+class BasicEffect;
+class NormalMapEffect;
+
+class ClusteredLighting
+{
+public:
+	// The light buffers start with room for initialLightCapacity lights of each
+	// kind.
+	ClusteredLighting(ID3D11Device* device, UINT initialLightCapacity = 256);
+	~ClusteredLighting();
+
+	// The grid, for LightClusters::SetGrid.  The frustum is set by Update.
+	LightClusters& Clusters();
+
+	// Bins the lights for the camera's current view and uploads them.  The
+	// viewport is the one the lit pass renders to.
+	void Update(ID3D11DeviceContext* dc, const Camera& camera, float viewportWidth, float viewportHeight,
+		const std::vector<PointLight>& pointLights, const std::vector<SpotLight>& spotLights);
+
+	void Apply(BasicEffect* fx)const;
+	void Apply(NormalMapEffect* fx)const;
+
+	// Turns the clustered lights off in an effect.
+	static void Disable(BasicEffect* fx);
+	static void Disable(NormalMapEffect* fx);
+
+	UINT LightCount()const;
+
+	// Entries in the cluster light lists: on average, each light reaches
+	// LightIndexCount()/LightCount() clusters.
+	UINT LightIndexCount()const;
+
+private:
+	ClusteredLighting(const ClusteredLighting& rhs);
+	ClusteredLighting& operator=(const ClusteredLighting& rhs);
+
+	// A dynamic structured buffer and its view over the whole buffer.
+	struct StructuredBuffer
+	{
+		ID3D11Buffer* Buffer;
+		ID3D11ShaderResourceView* SRV;
+		UINT Stride;
+		UINT Capacity;
+	};
+
+	void Reserve(StructuredBuffer& sb, UINT count);
+	void Upload(ID3D11DeviceContext* dc, StructuredBuffer& sb, const void* data, UINT count);
+
+	template <typename EffectType>
+	void ApplyEffect(EffectType* fx)const;
+
+private:
+	ID3D11Device* md3dDevice;
+
+	LightClusters mClusters;
+	std::vector<LightClusters::Sphere> mBounds;
+
+	StructuredBuffer mPointLights;
+	StructuredBuffer mSpotLights;
+	StructuredBuffer mClusterTable;
+	StructuredBuffer mLightIndices;
+
+	UINT mPointLightCount;
+	UINT mSpotLightCount;
+	XMFLOAT2 mTileScale;
+};
+
+#endif // CLUSTEREDLIGHTING_H
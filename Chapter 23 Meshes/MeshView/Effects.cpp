@@ -22,88 +22,200 @@ Effect::Effect(ID3D11Device* device, const std::wstring& filename)
 		0, device, &mFX));
 }
 
+Effect::Effect(ID3DX11Effect* fx)
+	: mFX(fx)
+{
+}
+
 Effect::~Effect()
 {
 	ReleaseCOM(mFX);
 }
+
+void Effect::Apply(ID3DX11EffectPass* pass, ID3D11DeviceContext* dc)
+{
+	mConstants.Upload(dc);
+	pass->Apply(0, dc);
+}
+
+const EffectConstantCache::Stats& Effect::ConstantStats()const
+{
+	return mConstants.GetStats();
+}
+
+void Effect::ResetConstantStats()
+{
+	mConstants.ResetStats();
+}
+
+ID3DX11Effect* Effect::CloneFX()const
+{
+	// FORCE_NONSINGLE: a single-instance effect would share its constant
+	// buffers with the clone.
+	ID3DX11Effect* clone = 0;
+	HR(mFX->CloneEffect(D3DX11_EFFECT_CLONE_FORCE_NONSINGLE, &clone));
+	return clone;
+}
+
+void Effect::SetMapSize(ID3DX11EffectVectorVariable* var, float width, float height)
+{
+	XMFLOAT4 v(width, height, 1.0f/width, 1.0f/height);
+	mConstants.SetRawValue(var, &v, sizeof(XMFLOAT4));
+}
 #pragma endregion
 
-#pragma region BasicEffect
-BasicEffect::BasicEffect(ID3D11Device* device, const std::wstring& filename)
-	: Effect(device, filename)
+#pragma region PermutationEffect
+PermutationEffect::PermutationEffect(ID3D11Device* device, ShaderCache* cache, const std::string& sourcePath,
+	const ShaderDefines& defines, const LitFeatures& features)
+	: Effect(LoadEffect(device, cache, sourcePath, defines, features)),
+	  md3dDevice(device), mCache(cache), mSourcePath(sourcePath), mDefines(defines)
+{
+	Permutation self;
+	self.FX = mFX;
+	self.Tech = mFX->GetTechniqueByName("Lit");
+
+	mPermutations[features.Bits()] = self;
+}
+
+PermutationEffect::~PermutationEffect()
+{
+	// mFX is released by ~Effect.
+	for(std::map<UINT, Permutation>::iterator it = mPermutations.begin(); it != mPermutations.end(); ++it)
+	{
+		if( it->second.FX != mFX )
+			ReleaseCOM(it->second.FX);
+	}
+}
+
+ID3DX11EffectTechnique* PermutationEffect::Technique(const LitFeatures& features)
 {
-	Light1Tech    = mFX->GetTechniqueByName("Light1");
-	Light2Tech    = mFX->GetTechniqueByName("Light2");
-	Light3Tech    = mFX->GetTechniqueByName("Light3");
-
-	Light0TexTech = mFX->GetTechniqueByName("Light0Tex");
-	Light1TexTech = mFX->GetTechniqueByName("Light1Tex");
-	Light2TexTech = mFX->GetTechniqueByName("Light2Tex");
-	Light3TexTech = mFX->GetTechniqueByName("Light3Tex");
-
-	Light0TexAlphaClipTech = mFX->GetTechniqueByName("Light0TexAlphaClip");
-	Light1TexAlphaClipTech = mFX->GetTechniqueByName("Light1TexAlphaClip");
-	Light2TexAlphaClipTech = mFX->GetTechniqueByName("Light2TexAlphaClip");
-	Light3TexAlphaClipTech = mFX->GetTechniqueByName("Light3TexAlphaClip");
-
-	Light1FogTech    = mFX->GetTechniqueByName("Light1Fog");
-	Light2FogTech    = mFX->GetTechniqueByName("Light2Fog");
-	Light3FogTech    = mFX->GetTechniqueByName("Light3Fog");
-
-	Light0TexFogTech = mFX->GetTechniqueByName("Light0TexFog");
-	Light1TexFogTech = mFX->GetTechniqueByName("Light1TexFog");
-	Light2TexFogTech = mFX->GetTechniqueByName("Light2TexFog");
-	Light3TexFogTech = mFX->GetTechniqueByName("Light3TexFog");
-
-	Light0TexAlphaClipFogTech = mFX->GetTechniqueByName("Light0TexAlphaClipFog");
-	Light1TexAlphaClipFogTech = mFX->GetTechniqueByName("Light1TexAlphaClipFog");
-	Light2TexAlphaClipFogTech = mFX->GetTechniqueByName("Light2TexAlphaClipFog");
-	Light3TexAlphaClipFogTech = mFX->GetTechniqueByName("Light3TexAlphaClipFog");
-
-	Light1ReflectTech    = mFX->GetTechniqueByName("Light1Reflect");
-	Light2ReflectTech    = mFX->GetTechniqueByName("Light2Reflect");
-	Light3ReflectTech    = mFX->GetTechniqueByName("Light3Reflect");
-
-	Light0TexReflectTech = mFX->GetTechniqueByName("Light0TexReflect");
-	Light1TexReflectTech = mFX->GetTechniqueByName("Light1TexReflect");
-	Light2TexReflectTech = mFX->GetTechniqueByName("Light2TexReflect");
-	Light3TexReflectTech = mFX->GetTechniqueByName("Light3TexReflect");
-
-	Light0TexAlphaClipReflectTech = mFX->GetTechniqueByName("Light0TexAlphaClipReflect");
-	Light1TexAlphaClipReflectTech = mFX->GetTechniqueByName("Light1TexAlphaClipReflect");
-	Light2TexAlphaClipReflectTech = mFX->GetTechniqueByName("Light2TexAlphaClipReflect");
-	Light3TexAlphaClipReflectTech = mFX->GetTechniqueByName("Light3TexAlphaClipReflect");
-
-	Light1FogReflectTech    = mFX->GetTechniqueByName("Light1FogReflect");
-	Light2FogReflectTech    = mFX->GetTechniqueByName("Light2FogReflect");
-	Light3FogReflectTech    = mFX->GetTechniqueByName("Light3FogReflect");
-
-	Light0TexFogReflectTech = mFX->GetTechniqueByName("Light0TexFogReflect");
-	Light1TexFogReflectTech = mFX->GetTechniqueByName("Light1TexFogReflect");
-	Light2TexFogReflectTech = mFX->GetTechniqueByName("Light2TexFogReflect");
-	Light3TexFogReflectTech = mFX->GetTechniqueByName("Light3TexFogReflect");
-
-	Light0TexAlphaClipFogReflectTech = mFX->GetTechniqueByName("Light0TexAlphaClipFogReflect");
-	Light1TexAlphaClipFogReflectTech = mFX->GetTechniqueByName("Light1TexAlphaClipFogReflect");
-	Light2TexAlphaClipFogReflectTech = mFX->GetTechniqueByName("Light2TexAlphaClipFogReflect");
-	Light3TexAlphaClipFogReflectTech = mFX->GetTechniqueByName("Light3TexAlphaClipFogReflect");
+	std::map<UINT, Permutation>::iterator it = mPermutations.find(features.Bits());
+	if( it != mPermutations.end() )
+		return it->second.Tech;
+
+	Permutation p;
+	p.FX = LoadEffect(md3dDevice, mCache, mSourcePath, mDefines, features);
+	p.Tech = p.FX->GetTechniqueByName("Lit");
+
+	mConstants.Share(p.FX);
+
+	// Catch up on the resources set so far.
+	for(size_t i = 0; i < mResourceNames.size(); ++i)
+	{
+		ID3DX11EffectShaderResourceVariable* var = p.FX->GetVariableByName(mResourceNames[i].c_str())->AsShaderResource();
+
+		ID3D11ShaderResourceView* srv = 0;
+		mResources[i]->GetResource(&srv);
+		var->SetResource(srv);
+		ReleaseCOM(srv);
+
+		p.Resources.push_back(var);
+	}
 
+	mPermutations[features.Bits()] = p;
+	return p.Tech;
+}
+
+UINT PermutationEffect::PermutationCount()const
+{
+	return (UINT)mPermutations.size();
+}
+
+ID3DX11EffectShaderResourceVariable* PermutationEffect::ResourceVariable(const char* name)
+{
+	ID3DX11EffectShaderResourceVariable* var = mFX->GetVariableByName(name)->AsShaderResource();
+
+	mResourceNames.push_back(name);
+	mResources.push_back(var);
+
+	for(std::map<UINT, Permutation>::iterator it = mPermutations.begin(); it != mPermutations.end(); ++it)
+	{
+		if( it->second.FX != mFX )
+			it->second.Resources.push_back(it->second.FX->GetVariableByName(name)->AsShaderResource());
+	}
+
+	return var;
+}
+
+void PermutationEffect::SetResource(ID3DX11EffectShaderResourceVariable* var, ID3D11ShaderResourceView* srv)
+{
+	var->SetResource(srv);
+
+	size_t index = std::find(mResources.begin(), mResources.end(), var) - mResources.begin();
+	if( index == mResources.size() )
+		return;
+
+	for(std::map<UINT, Permutation>::iterator it = mPermutations.begin(); it != mPermutations.end(); ++it)
+	{
+		if( it->second.FX != mFX )
+			it->second.Resources[index]->SetResource(srv);
+	}
+}
+
+ID3DX11Effect* PermutationEffect::LoadEffect(ID3D11Device* device, ShaderCache* cache, const std::string& sourcePath,
+	const ShaderDefines& defines, const LitFeatures& features)
+{
+	ShaderDefines all = defines;
+	all.Merge(features.Defines());
+
+	std::vector<char> bytecode;
+	std::string errors;
+	if( !cache->Load(sourcePath, all, bytecode, &errors) )
+	{
+		// Nothing can be drawn without the permutation, and every caller uses its
+		// technique right away, so show the compiler's messages and stop here.
+		std::string message = sourcePath + " (" + all.ToString() + ")\n\n" + errors;
+		MessageBoxA(0, message.c_str(), 0, 0);
+		ExitProcess(1);
+	}
+
+	ID3DX11Effect* fx = 0;
+	HR(D3DX11CreateEffectFromMemory(&bytecode[0], bytecode.size(), 0, device, &fx));
+	return fx;
+}
+#pragma endregion
+
+#pragma region BasicEffect
+BasicEffect::BasicEffect(ID3D11Device* device, ShaderCache* cache, const std::string& sourcePath, const ShaderDefines& defines)
+	: PermutationEffect(device, cache, sourcePath, defines, LitFeatures())
+{
 	WorldViewProj     = mFX->GetVariableByName("gWorldViewProj")->AsMatrix();
 	WorldViewProjTex  = mFX->GetVariableByName("gWorldViewProjTex")->AsMatrix();
+	ViewProj          = mFX->GetVariableByName("gViewProj")->AsMatrix();
+	ViewProjTex       = mFX->GetVariableByName("gViewProjTex")->AsMatrix();
 	World             = mFX->GetVariableByName("gWorld")->AsMatrix();
 	WorldInvTranspose = mFX->GetVariableByName("gWorldInvTranspose")->AsMatrix();
 	TexTransform      = mFX->GetVariableByName("gTexTransform")->AsMatrix();
 	ShadowTransform   = mFX->GetVariableByName("gShadowTransform")->AsMatrix();
+	ShadowCascadeTransforms = mFX->GetVariableByName("gShadowCascadeTransforms")->AsMatrix();
+	ShadowCascadeSplits     = mFX->GetVariableByName("gShadowCascadeSplits")->AsVector();
+	ShadowCascadeCount      = mFX->GetVariableByName("gShadowCascadeCount")->AsScalar();
+	ShadowMapSize           = mFX->GetVariableByName("gShadowMapSize")->AsVector();
+	ShadowCascadeMapSize    = mFX->GetVariableByName("gShadowCascadeMapSize")->AsVector();
 	EyePosW           = mFX->GetVariableByName("gEyePosW")->AsVector();
 	FogColor          = mFX->GetVariableByName("gFogColor")->AsVector();
 	FogStart          = mFX->GetVariableByName("gFogStart")->AsScalar();
 	FogRange          = mFX->GetVariableByName("gFogRange")->AsScalar();
 	DirLights         = mFX->GetVariableByName("gDirLights");
 	Mat               = mFX->GetVariableByName("gMaterial");
-	DiffuseMap        = mFX->GetVariableByName("gDiffuseMap")->AsShaderResource();
-	CubeMap           = mFX->GetVariableByName("gCubeMap")->AsShaderResource();
-	ShadowMap         = mFX->GetVariableByName("gShadowMap")->AsShaderResource();
-	SsaoMap           = mFX->GetVariableByName("gSsaoMap")->AsShaderResource();
+	ClusterGrid             = mFX->GetVariableByName("gClusterGrid");
+	ClusterTileScale        = mFX->GetVariableByName("gClusterTileScale");
+	ClusterDepthScale       = mFX->GetVariableByName("gClusterDepthScale")->AsScalar();
+	ClusterDepthBias        = mFX->GetVariableByName("gClusterDepthBias")->AsScalar();
+	ClusterPointLightCount  = mFX->GetVariableByName("gClusterPointLightCount");
+	ClusterLightCount       = mFX->GetVariableByName("gClusterLightCount");
+	ClusterPointLights      = ResourceVariable("gClusterPointLights");
+	ClusterSpotLights       = ResourceVariable("gClusterSpotLights");
+	Clusters                = ResourceVariable("gClusters");
+	ClusterLightIndices     = ResourceVariable("gClusterLightIndices");
+	DiffuseMap        = ResourceVariable("gDiffuseMap");
+	CubeMap           = ResourceVariable("gCubeMap");
+	ShadowMap         = ResourceVariable("gShadowMap");
+	ShadowCascadeMap  = ResourceVariable("gShadowCascadeMap");
+	SsaoMap           = ResourceVariable("gSsaoMap");
+
+	const char* cachedBuffers[] = { "cbPerFrame", "cbPerObject", "cbClusteredLights" };
+	mConstants.Init(device, mFX, cachedBuffers, 3);
 }
 
 BasicEffect::~BasicEffect()
@@ -112,70 +224,21 @@ BasicEffect::~BasicEffect()
 #pragma endregion
 
 #pragma region NormalMapEffect
-NormalMapEffect::NormalMapEffect(ID3D11Device* device, const std::wstring& filename)
-	: Effect(device, filename)
+NormalMapEffect::NormalMapEffect(ID3D11Device* device, ShaderCache* cache, const std::string& sourcePath, const ShaderDefines& defines)
+	: PermutationEffect(device, cache, sourcePath, defines, LitFeatures())
 {
-	Light1Tech    = mFX->GetTechniqueByName("Light1");
-	Light2Tech    = mFX->GetTechniqueByName("Light2");
-	Light3Tech    = mFX->GetTechniqueByName("Light3");
-
-	Light0TexTech = mFX->GetTechniqueByName("Light0Tex");
-	Light1TexTech = mFX->GetTechniqueByName("Light1Tex");
-	Light2TexTech = mFX->GetTechniqueByName("Light2Tex");
-	Light3TexTech = mFX->GetTechniqueByName("Light3Tex");
-
-	Light0TexAlphaClipTech = mFX->GetTechniqueByName("Light0TexAlphaClip");
-	Light1TexAlphaClipTech = mFX->GetTechniqueByName("Light1TexAlphaClip");
-	Light2TexAlphaClipTech = mFX->GetTechniqueByName("Light2TexAlphaClip");
-	Light3TexAlphaClipTech = mFX->GetTechniqueByName("Light3TexAlphaClip");
-
-	Light1FogTech    = mFX->GetTechniqueByName("Light1Fog");
-	Light2FogTech    = mFX->GetTechniqueByName("Light2Fog");
-	Light3FogTech    = mFX->GetTechniqueByName("Light3Fog");
-
-	Light0TexFogTech = mFX->GetTechniqueByName("Light0TexFog");
-	Light1TexFogTech = mFX->GetTechniqueByName("Light1TexFog");
-	Light2TexFogTech = mFX->GetTechniqueByName("Light2TexFog");
-	Light3TexFogTech = mFX->GetTechniqueByName("Light3TexFog");
-
-	Light0TexAlphaClipFogTech = mFX->GetTechniqueByName("Light0TexAlphaClipFog");
-	Light1TexAlphaClipFogTech = mFX->GetTechniqueByName("Light1TexAlphaClipFog");
-	Light2TexAlphaClipFogTech = mFX->GetTechniqueByName("Light2TexAlphaClipFog");
-	Light3TexAlphaClipFogTech = mFX->GetTechniqueByName("Light3TexAlphaClipFog");
-
-	Light1ReflectTech    = mFX->GetTechniqueByName("Light1Reflect");
-	Light2ReflectTech    = mFX->GetTechniqueByName("Light2Reflect");
-	Light3ReflectTech    = mFX->GetTechniqueByName("Light3Reflect");
-
-	Light0TexReflectTech = mFX->GetTechniqueByName("Light0TexReflect");
-	Light1TexReflectTech = mFX->GetTechniqueByName("Light1TexReflect");
-	Light2TexReflectTech = mFX->GetTechniqueByName("Light2TexReflect");
-	Light3TexReflectTech = mFX->GetTechniqueByName("Light3TexReflect");
-
-	Light0TexAlphaClipReflectTech = mFX->GetTechniqueByName("Light0TexAlphaClipReflect");
-	Light1TexAlphaClipReflectTech = mFX->GetTechniqueByName("Light1TexAlphaClipReflect");
-	Light2TexAlphaClipReflectTech = mFX->GetTechniqueByName("Light2TexAlphaClipReflect");
-	Light3TexAlphaClipReflectTech = mFX->GetTechniqueByName("Light3TexAlphaClipReflect");
-
-	Light1FogReflectTech    = mFX->GetTechniqueByName("Light1FogReflect");
-	Light2FogReflectTech    = mFX->GetTechniqueByName("Light2FogReflect");
-	Light3FogReflectTech    = mFX->GetTechniqueByName("Light3FogReflect");
-
-	Light0TexFogReflectTech = mFX->GetTechniqueByName("Light0TexFogReflect");
-	Light1TexFogReflectTech = mFX->GetTechniqueByName("Light1TexFogReflect");
-	Light2TexFogReflectTech = mFX->GetTechniqueByName("Light2TexFogReflect");
-	Light3TexFogReflectTech = mFX->GetTechniqueByName("Light3TexFogReflect");
-
-	Light0TexAlphaClipFogReflectTech = mFX->GetTechniqueByName("Light0TexAlphaClipFogReflect");
-	Light1TexAlphaClipFogReflectTech = mFX->GetTechniqueByName("Light1TexAlphaClipFogReflect");
-	Light2TexAlphaClipFogReflectTech = mFX->GetTechniqueByName("Light2TexAlphaClipFogReflect");
-	Light3TexAlphaClipFogReflectTech = mFX->GetTechniqueByName("Light3TexAlphaClipFogReflect");
-
 	WorldViewProj     = mFX->GetVariableByName("gWorldViewProj")->AsMatrix();
 	WorldViewProjTex  = mFX->GetVariableByName("gWorldViewProjTex")->AsMatrix();
+	ViewProj          = mFX->GetVariableByName("gViewProj")->AsMatrix();
+	ViewProjTex       = mFX->GetVariableByName("gViewProjTex")->AsMatrix();
 	World             = mFX->GetVariableByName("gWorld")->AsMatrix();
 	WorldInvTranspose = mFX->GetVariableByName("gWorldInvTranspose")->AsMatrix();
 	ShadowTransform   = mFX->GetVariableByName("gShadowTransform")->AsMatrix();
+	ShadowCascadeTransforms = mFX->GetVariableByName("gShadowCascadeTransforms")->AsMatrix();
+	ShadowCascadeSplits     = mFX->GetVariableByName("gShadowCascadeSplits")->AsVector();
+	ShadowCascadeCount      = mFX->GetVariableByName("gShadowCascadeCount")->AsScalar();
+	ShadowMapSize           = mFX->GetVariableByName("gShadowMapSize")->AsVector();
+	ShadowCascadeMapSize    = mFX->GetVariableByName("gShadowCascadeMapSize")->AsVector();
 	TexTransform      = mFX->GetVariableByName("gTexTransform")->AsMatrix();
 	EyePosW           = mFX->GetVariableByName("gEyePosW")->AsVector();
 	FogColor          = mFX->GetVariableByName("gFogColor")->AsVector();
@@ -183,11 +246,35 @@ NormalMapEffect::NormalMapEffect(ID3D11Device* device, const std::wstring& filen
 	FogRange          = mFX->GetVariableByName("gFogRange")->AsScalar();
 	DirLights         = mFX->GetVariableByName("gDirLights");
 	Mat               = mFX->GetVariableByName("gMaterial");
-	DiffuseMap        = mFX->GetVariableByName("gDiffuseMap")->AsShaderResource();
-	CubeMap           = mFX->GetVariableByName("gCubeMap")->AsShaderResource();
-	NormalMap         = mFX->GetVariableByName("gNormalMap")->AsShaderResource();
-	ShadowMap         = mFX->GetVariableByName("gShadowMap")->AsShaderResource();
-	SsaoMap           = mFX->GetVariableByName("gSsaoMap")->AsShaderResource();
+	ClusterGrid             = mFX->GetVariableByName("gClusterGrid");
+	ClusterTileScale        = mFX->GetVariableByName("gClusterTileScale");
+	ClusterDepthScale       = mFX->GetVariableByName("gClusterDepthScale")->AsScalar();
+	ClusterDepthBias        = mFX->GetVariableByName("gClusterDepthBias")->AsScalar();
+	ClusterPointLightCount  = mFX->GetVariableByName("gClusterPointLightCount");
+	ClusterLightCount       = mFX->GetVariableByName("gClusterLightCount");
+	ClusterPointLights      = ResourceVariable("gClusterPointLights");
+	ClusterSpotLights       = ResourceVariable("gClusterSpotLights");
+	Clusters                = ResourceVariable("gClusters");
+	ClusterLightIndices     = ResourceVariable("gClusterLightIndices");
+	HeightScale       = mFX->GetVariableByName("gHeightScale")->AsScalar();
+	MaxTessDistance   = mFX->GetVariableByName("gMaxTessDistance")->AsScalar();
+	MinTessDistance   = mFX->GetVariableByName("gMinTessDistance")->AsScalar();
+	MinTessFactor     = mFX->GetVariableByName("gMinTessFactor")->AsScalar();
+	MaxTessFactor     = mFX->GetVariableByName("gMaxTessFactor")->AsScalar();
+	TessEdgeLength    = mFX->GetVariableByName("gTessEdgeLength")->AsScalar();
+	TessProjScale     = mFX->GetVariableByName("gTessProjScale")->AsScalar();
+	TessBackfaceSlack = mFX->GetVariableByName("gTessBackfaceSlack")->AsScalar();
+	TessCullPlanes    = mFX->GetVariableByName("gTessCullPlanes")->AsVector();
+	TessCullView      = mFX->GetVariableByName("gTessCullView")->AsVector();
+	DiffuseMap        = ResourceVariable("gDiffuseMap");
+	CubeMap           = ResourceVariable("gCubeMap");
+	NormalMap         = ResourceVariable("gNormalMap");
+	ShadowMap         = ResourceVariable("gShadowMap");
+	ShadowCascadeMap  = ResourceVariable("gShadowCascadeMap");
+	SsaoMap           = ResourceVariable("gSsaoMap");
+
+	const char* cachedBuffers[] = { "cbPerFrame", "cbPerObject", "cbTessellation", "cbClusteredLights" };
+	mConstants.Init(device, mFX, cachedBuffers, 4);
 }
 
 NormalMapEffect::~NormalMapEffect()
@@ -198,6 +285,26 @@ NormalMapEffect::~NormalMapEffect()
 #pragma region BuildShadowMapEffect
 BuildShadowMapEffect::BuildShadowMapEffect(ID3D11Device* device, const std::wstring& filename)
 	: Effect(device, filename)
+{
+	GetVariables();
+}
+
+BuildShadowMapEffect::BuildShadowMapEffect(ID3DX11Effect* fx)
+	: Effect(fx)
+{
+	GetVariables();
+}
+
+BuildShadowMapEffect::~BuildShadowMapEffect()
+{
+}
+
+BuildShadowMapEffect* BuildShadowMapEffect::Clone()const
+{
+	return new BuildShadowMapEffect(CloneFX());
+}
+
+void BuildShadowMapEffect::GetVariables()
 {
 	BuildShadowMapTech           = mFX->GetTechniqueByName("BuildShadowMapTech");
 	BuildShadowMapAlphaClipTech  = mFX->GetTechniqueByName("BuildShadowMapAlphaClipTech");
@@ -216,18 +323,39 @@ BuildShadowMapEffect::BuildShadowMapEffect(ID3D11Device* device, const std::wstr
 	MinTessDistance   = mFX->GetVariableByName("gMinTessDistance")->AsScalar();
 	MinTessFactor     = mFX->GetVariableByName("gMinTessFactor")->AsScalar();
 	MaxTessFactor     = mFX->GetVariableByName("gMaxTessFactor")->AsScalar();
+	TessEdgeLength    = mFX->GetVariableByName("gTessEdgeLength")->AsScalar();
+	TessProjScale     = mFX->GetVariableByName("gTessProjScale")->AsScalar();
+	TessBackfaceSlack = mFX->GetVariableByName("gTessBackfaceSlack")->AsScalar();
+	TessCullPlanes    = mFX->GetVariableByName("gTessCullPlanes")->AsVector();
+	TessCullView      = mFX->GetVariableByName("gTessCullView")->AsVector();
 	DiffuseMap        = mFX->GetVariableByName("gDiffuseMap")->AsShaderResource();
 	NormalMap         = mFX->GetVariableByName("gNormalMap")->AsShaderResource();
 }
-
-BuildShadowMapEffect::~BuildShadowMapEffect()
-{
-}
 #pragma endregion
 
 #pragma region SsaoNormalDepthEffect
 SsaoNormalDepthEffect::SsaoNormalDepthEffect(ID3D11Device* device, const std::wstring& filename)
 	: Effect(device, filename)
+{
+	GetVariables();
+}
+
+SsaoNormalDepthEffect::SsaoNormalDepthEffect(ID3DX11Effect* fx)
+	: Effect(fx)
+{
+	GetVariables();
+}
+
+SsaoNormalDepthEffect::~SsaoNormalDepthEffect()
+{
+}
+
+SsaoNormalDepthEffect* SsaoNormalDepthEffect::Clone()const
+{
+	return new SsaoNormalDepthEffect(CloneFX());
+}
+
+void SsaoNormalDepthEffect::GetVariables()
 {
 	NormalDepthTech          = mFX->GetTechniqueByName("NormalDepth");
 	NormalDepthAlphaClipTech = mFX->GetTechniqueByName("NormalDepthAlphaClip");
@@ -238,10 +366,6 @@ SsaoNormalDepthEffect::SsaoNormalDepthEffect(ID3D11Device* device, const std::ws
 	TexTransform          = mFX->GetVariableByName("gTexTransform")->AsMatrix();
 	DiffuseMap            = mFX->GetVariableByName("gDiffuseMap")->AsShaderResource();
 }
-
-SsaoNormalDepthEffect::~SsaoNormalDepthEffect()
-{
-}
 #pragma endregion
 
 #pragma region SsaoEffect
@@ -249,6 +373,7 @@ SsaoEffect::SsaoEffect(ID3D11Device* device, const std::wstring& filename)
 	: Effect(device, filename)
 {
 	SsaoTech           = mFX->GetTechniqueByName("Ssao");
+	SsaoTemporalTech   = mFX->GetTechniqueByName("SsaoTemporal");
 
 	ViewToTexSpace     = mFX->GetVariableByName("gViewToTexSpace")->AsMatrix();
 	OffsetVectors      = mFX->GetVariableByName("gOffsetVectors")->AsVector();
@@ -257,6 +382,8 @@ SsaoEffect::SsaoEffect(ID3D11Device* device, const std::wstring& filename)
 	OcclusionFadeStart = mFX->GetVariableByName("gOcclusionFadeStart")->AsScalar();
 	OcclusionFadeEnd   = mFX->GetVariableByName("gOcclusionFadeEnd")->AsScalar();
 	SurfaceEpsilon     = mFX->GetVariableByName("gSurfaceEpsilon")->AsScalar();
+	SampleCount        = mFX->GetVariableByName("gSampleCount")->AsScalar();
+	FirstSample        = mFX->GetVariableByName("gFirstSample")->AsScalar();
 
 	NormalDepthMap     = mFX->GetVariableByName("gNormalDepthMap")->AsShaderResource();
 	RandomVecMap       = mFX->GetVariableByName("gRandomVecMap")->AsShaderResource();
@@ -267,6 +394,56 @@ SsaoEffect::~SsaoEffect()
 }
 #pragma endregion
 
+#pragma region SsaoComputeEffect
+SsaoComputeEffect::SsaoComputeEffect(ID3D11Device* device, const std::wstring& filename)
+	: Effect(device, filename)
+{
+	SsaoTech           = mFX->GetTechniqueByName("Ssao");
+
+	ViewToTexSpace     = mFX->GetVariableByName("gViewToTexSpace")->AsMatrix();
+	OffsetVectors      = mFX->GetVariableByName("gOffsetVectors")->AsVector();
+	FrustumCorners     = mFX->GetVariableByName("gFrustumCorners")->AsVector();
+	OcclusionRadius    = mFX->GetVariableByName("gOcclusionRadius")->AsScalar();
+	OcclusionFadeStart = mFX->GetVariableByName("gOcclusionFadeStart")->AsScalar();
+	OcclusionFadeEnd   = mFX->GetVariableByName("gOcclusionFadeEnd")->AsScalar();
+	SurfaceEpsilon     = mFX->GetVariableByName("gSurfaceEpsilon")->AsScalar();
+	SampleCount        = mFX->GetVariableByName("gSampleCount")->AsScalar();
+	ResolutionScale    = mFX->GetVariableByName("gResolutionScale")->AsScalar();
+
+	NormalDepthMap     = mFX->GetVariableByName("gNormalDepthMap")->AsShaderResource();
+	RandomVecMap       = mFX->GetVariableByName("gRandomVecMap")->AsShaderResource();
+	AmbientMap         = mFX->GetVariableByName("gAmbientMap")->AsUnorderedAccessView();
+}
+
+SsaoComputeEffect::~SsaoComputeEffect()
+{
+}
+#pragma endregion
+
+#pragma region SsaoTemporalEffect
+SsaoTemporalEffect::SsaoTemporalEffect(ID3D11Device* device, const std::wstring& filename)
+	: Effect(device, filename)
+{
+	SsaoTemporalTech   = mFX->GetTechniqueByName("SsaoTemporal");
+
+	ViewToPrevView     = mFX->GetVariableByName("gViewToPrevView")->AsMatrix();
+	PrevViewToTex      = mFX->GetVariableByName("gPrevViewToTex")->AsMatrix();
+	FrustumCorners     = mFX->GetVariableByName("gFrustumCorners")->AsVector();
+	HistoryWeight      = mFX->GetVariableByName("gHistoryWeight")->AsScalar();
+	DepthTolerance     = mFX->GetVariableByName("gDepthTolerance")->AsScalar();
+	NormalThreshold    = mFX->GetVariableByName("gNormalThreshold")->AsScalar();
+
+	NormalDepthMap     = mFX->GetVariableByName("gNormalDepthMap")->AsShaderResource();
+	PrevNormalDepthMap = mFX->GetVariableByName("gPrevNormalDepthMap")->AsShaderResource();
+	CurrentAmbientMap  = mFX->GetVariableByName("gCurrentAmbientMap")->AsShaderResource();
+	HistoryMap         = mFX->GetVariableByName("gHistoryMap")->AsShaderResource();
+}
+
+SsaoTemporalEffect::~SsaoTemporalEffect()
+{
+}
+#pragma endregion
+
 #pragma region SsaoBlurEffect
 SsaoBlurEffect::SsaoBlurEffect(ID3D11Device* device, const std::wstring& filename)
 	: Effect(device, filename)
@@ -276,6 +453,7 @@ SsaoBlurEffect::SsaoBlurEffect(ID3D11Device* device, const std::wstring& filenam
 
 	TexelWidth      = mFX->GetVariableByName("gTexelWidth")->AsScalar();
 	TexelHeight     = mFX->GetVariableByName("gTexelHeight")->AsScalar();
+	BlurRadius      = mFX->GetVariableByName("gBlurRadius")->AsScalar();
 
 	NormalDepthMap  = mFX->GetVariableByName("gNormalDepthMap")->AsShaderResource();
 	InputImage      = mFX->GetVariableByName("gInputImage")->AsShaderResource();
@@ -286,6 +464,42 @@ SsaoBlurEffect::~SsaoBlurEffect()
 }
 #pragma endregion
 
+#pragma region SsaoBlurComputeEffect
+SsaoBlurComputeEffect::SsaoBlurComputeEffect(ID3D11Device* device, const std::wstring& filename)
+	: Effect(device, filename)
+{
+	HorzBlurTech    = mFX->GetTechniqueByName("HorzBlur");
+	VertBlurTech    = mFX->GetTechniqueByName("VertBlur");
+	BlurTech        = mFX->GetTechniqueByName("Blur");
+
+	BlurRadius      = mFX->GetVariableByName("gBlurRadius")->AsScalar();
+	ResolutionScale = mFX->GetVariableByName("gResolutionScale")->AsScalar();
+
+	NormalDepthMap  = mFX->GetVariableByName("gNormalDepthMap")->AsShaderResource();
+	InputImage      = mFX->GetVariableByName("gInputImage")->AsShaderResource();
+	OutputImage     = mFX->GetVariableByName("gOutputImage")->AsUnorderedAccessView();
+}
+
+SsaoBlurComputeEffect::~SsaoBlurComputeEffect()
+{
+}
+#pragma endregion
+
+#pragma region SsaoUpsampleEffect
+SsaoUpsampleEffect::SsaoUpsampleEffect(ID3D11Device* device, const std::wstring& filename)
+	: Effect(device, filename)
+{
+	UpsampleTech    = mFX->GetTechniqueByName("Upsample");
+
+	NormalDepthMap  = mFX->GetVariableByName("gNormalDepthMap")->AsShaderResource();
+	AmbientMap      = mFX->GetVariableByName("gAmbientMap")->AsShaderResource();
+}
+
+SsaoUpsampleEffect::~SsaoUpsampleEffect()
+{
+}
+#pragma endregion
+
 #pragma region SkyEffect
 SkyEffect::SkyEffect(ID3D11Device* device, const std::wstring& filename)
 	: Effect(device, filename)
@@ -323,23 +537,95 @@ DebugTexEffect::~DebugTexEffect()
 
 #pragma region Effects
 
+namespace
+{
+	// The ShaderCache's compiler.
+	bool CompileEffect(const std::string& sourcePath, const ShaderDefines& defines,
+		std::vector<char>& bytecode, std::string& errors)
+	{
+		const std::vector<ShaderDefines::Define>& items = defines.Items();
+
+		std::vector<D3D10_SHADER_MACRO> macros(items.size() + 1);
+		for(size_t i = 0; i < items.size(); ++i)
+		{
+			macros[i].Name = items[i].first.c_str();
+			macros[i].Definition = items[i].second.c_str();
+		}
+		macros[items.size()].Name = 0;
+		macros[items.size()].Definition = 0;
+
+		DWORD shaderFlags = 0;
+#if defined( DEBUG ) || defined( _DEBUG )
+		shaderFlags |= D3D10_SHADER_DEBUG;
+		shaderFlags |= D3D10_SHADER_SKIP_OPTIMIZATION;
+#endif
+
+		std::wstring path(sourcePath.begin(), sourcePath.end());
+
+		ID3D10Blob* compiledShader = 0;
+		ID3D10Blob* compilationMsgs = 0;
+		HRESULT hr = D3DX11CompileFromFile(path.c_str(), &macros[0], 0, 0, "fx_5_0", shaderFlags,
+			0, 0, &compiledShader, &compilationMsgs, 0);
+
+		if( compilationMsgs != 0 )
+		{
+			errors.assign((const char*)compilationMsgs->GetBufferPointer(), compilationMsgs->GetBufferSize());
+			ReleaseCOM(compilationMsgs);
+		}
+
+		if( FAILED(hr) || compiledShader == 0 )
+		{
+			ReleaseCOM(compiledShader);
+			return false;
+		}
+
+		const char* data = (const char*)compiledShader->GetBufferPointer();
+		bytecode.assign(data, data + compiledShader->GetBufferSize());
+		ReleaseCOM(compiledShader);
+
+		return true;
+	}
+}
+
+ShaderCache*           Effects::Cache             = 0;
 BasicEffect*           Effects::BasicFX           = 0;
 NormalMapEffect*       Effects::NormalMapFX       = 0;
 BuildShadowMapEffect*  Effects::BuildShadowMapFX  = 0;
 SsaoNormalDepthEffect* Effects::SsaoNormalDepthFX = 0;
 SsaoEffect*            Effects::SsaoFX            = 0;
+SsaoComputeEffect*     Effects::SsaoComputeFX     = 0;
+SsaoTemporalEffect*    Effects::SsaoTemporalFX    = 0;
 SsaoBlurEffect*        Effects::SsaoBlurFX        = 0;
+SsaoBlurComputeEffect* Effects::SsaoBlurComputeFX = 0;
+SsaoUpsampleEffect*    Effects::SsaoUpsampleFX    = 0;
 SkyEffect*             Effects::SkyFX             = 0;
 DebugTexEffect*        Effects::DebugTexFX        = 0;
 
-void Effects::InitAll(ID3D11Device* device)
+void Effects::InitAll(ID3D11Device* device, ShadowFilter shadowFilter)
 {
-	BasicFX           = new BasicEffect(device, L"FX/Basic.fxo");
-	NormalMapFX       = new NormalMapEffect(device, L"FX/NormalMap.fxo");
+	// The flags change the bytecode, so they are part of every key.
+#if defined( DEBUG ) || defined( _DEBUG )
+	const char* compilerTag = "fx_5_0 debug";
+#else
+	const char* compilerTag = "fx_5_0";
+#endif
+
+	CreateDirectoryA("FX/Cache", 0);
+	Cache = new ShaderCache("FX/Cache", compilerTag, CompileEffect);
+
+	ShaderDefines defines;
+	defines.Set("SHADOW_FILTER", ShadowFilterDefine(shadowFilter));
+
+	BasicFX           = new BasicEffect(device, Cache, "FX/Basic.fx", defines);
+	NormalMapFX       = new NormalMapEffect(device, Cache, "FX/NormalMap.fx", defines);
 	BuildShadowMapFX  = new BuildShadowMapEffect(device, L"FX/BuildShadowMap.fxo");
 	SsaoNormalDepthFX = new SsaoNormalDepthEffect(device, L"FX/SsaoNormalDepth.fxo");
 	SsaoFX            = new SsaoEffect(device, L"FX/Ssao.fxo");
+	SsaoComputeFX     = new SsaoComputeEffect(device, L"FX/SsaoCS.fxo");
+	SsaoTemporalFX    = new SsaoTemporalEffect(device, L"FX/SsaoTemporal.fxo");
 	SsaoBlurFX        = new SsaoBlurEffect(device, L"FX/SsaoBlur.fxo");
+	SsaoBlurComputeFX = new SsaoBlurComputeEffect(device, L"FX/SsaoBlurCS.fxo");
+	SsaoUpsampleFX    = new SsaoUpsampleEffect(device, L"FX/SsaoUpsample.fxo");
 	SkyFX             = new SkyEffect(device, L"FX/Sky.fxo");
 	DebugTexFX        = new DebugTexEffect(device, L"FX/DebugTexture.fxo");
 }
@@ -351,9 +637,25 @@ void Effects::DestroyAll()
 	SafeDelete(BuildShadowMapFX);
 	SafeDelete(SsaoNormalDepthFX);
 	SafeDelete(SsaoFX);
+	SafeDelete(SsaoComputeFX);
+	SafeDelete(SsaoTemporalFX);
 	SafeDelete(SsaoBlurFX);
+	SafeDelete(SsaoBlurComputeFX);
+	SafeDelete(SsaoUpsampleFX);
 	SafeDelete(SkyFX);
 	SafeDelete(DebugTexFX);
+	SafeDelete(Cache);
+}
+
+const char* Effects::ShadowFilterDefine(ShadowFilter shadowFilter)
+{
+	switch( shadowFilter )
+	{
+	case ShadowFilter1Tap:    return "SHADOW_FILTER_1TAP";
+	case ShadowFilterPcf5x5:  return "SHADOW_FILTER_PCF5X5";
+	case ShadowFilterPoisson: return "SHADOW_FILTER_POISSON";
+	default:                  return "SHADOW_FILTER_PCF3X3";
+	}
 }
 
 #pragma endregion
\ No newline at end of file
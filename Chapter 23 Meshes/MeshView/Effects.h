@@ -9,6 +9,10 @@
 #define EFFECTS_H
 
 #include "d3dUtil.h"
+#include "EffectConstantCache.h"
+#include "ShaderCache.h"
+#include "LitFeatures.h"
+#include <map>
 
 #pragma region Effect
 class Effect
@@ -17,100 +21,150 @@ public:
 	Effect(ID3D11Device* device, const std::wstring& filename);
 	virtual ~Effect();
 
+	// Uploads the constant buffers changed since the last pass, then applies the
+	// pass.  Use in place of pass->Apply for effects with cached constants.
+	void Apply(ID3DX11EffectPass* pass, ID3D11DeviceContext* dc);
+
+	const EffectConstantCache::Stats& ConstantStats()const;
+	void ResetConstantStats();
+
+protected:
+	// Takes ownership of an effect made by CloneFX().
+	explicit Effect(ID3DX11Effect* fx);
+
+	// Copy of the effect with its own constant buffers and variable values, so it
+	// can be used on another thread.  The shaders and states are shared.
+	ID3DX11Effect* CloneFX()const;
+
+	// Sets a float4 of (width, height, 1/width, 1/height) through mConstants.
+	void SetMapSize(ID3DX11EffectVectorVariable* var, float width, float height);
+
 private:
 	Effect(const Effect& rhs);
 	Effect& operator=(const Effect& rhs);
 
 protected:
 	ID3DX11Effect* mFX;
+
+	// Empty unless a derived class hands it some constant buffers.
+	EffectConstantCache mConstants;
+};
+#pragma endregion
+
+#pragma region PermutationEffect
+// An effect compiled from its source once per combination of LitFeatures, each
+// permutation holding the one technique "Lit".  A permutation is compiled, or
+// loaded from the ShaderCache, the first time Technique asks for it, so only the
+// combinations a scene draws with cost compile time and memory.
+//   -The permutation given to the constructor is this effect itself; the
+//    derived class looks up its variables there.
+//   -Every permutation loaded later is given this effect's cached constant
+//    buffers, and SetResource sets a shader resource in all of them, so the
+//    setters reach whichever permutation a pass comes from.  Constants of these
+//    effects must be in cached buffers.
+// Technique loads on the calling thread; use it from the render thread.  A
+// permutation that fails to compile shows the compiler's messages and ends the
+// program, so Technique never returns null.
+class PermutationEffect : public Effect
+{
+public:
+	PermutationEffect(ID3D11Device* device, ShaderCache* cache, const std::string& sourcePath,
+		const ShaderDefines& defines, const LitFeatures& features);
+	~PermutationEffect();
+
+	// The Lit technique of the permutation with the features.
+	ID3DX11EffectTechnique* Technique(const LitFeatures& features);
+
+	UINT PermutationCount()const;
+
+protected:
+	// Looks up a shader resource variable for SetResource.
+	ID3DX11EffectShaderResourceVariable* ResourceVariable(const char* name);
+	void SetResource(ID3DX11EffectShaderResourceVariable* var, ID3D11ShaderResourceView* srv);
+
+private:
+	static ID3DX11Effect* LoadEffect(ID3D11Device* device, ShaderCache* cache, const std::string& sourcePath,
+		const ShaderDefines& defines, const LitFeatures& features);
+
+	struct Permutation
+	{
+		ID3DX11Effect* FX;
+		ID3DX11EffectTechnique* Tech;
+
+		// The permutation's variables for mResourceNames.
+		std::vector<ID3DX11EffectShaderResourceVariable*> Resources;
+	};
+
+	ID3D11Device* md3dDevice;
+	ShaderCache* mCache;
+	std::string mSourcePath;
+	ShaderDefines mDefines;
+
+	// By LitFeatures::Bits.  This effect's own permutation has FX == mFX.
+	std::map<UINT, Permutation> mPermutations;
+
+	std::vector<std::string> mResourceNames;
+	std::vector<ID3DX11EffectShaderResourceVariable*> mResources;
 };
 #pragma endregion
 
 #pragma region BasicEffect
-class BasicEffect : public Effect
+class BasicEffect : public PermutationEffect
 {
 public:
-	BasicEffect(ID3D11Device* device, const std::wstring& filename);
+	// The effect itself is the permutation with the default LitFeatures.
+	BasicEffect(ID3D11Device* device, ShaderCache* cache, const std::string& sourcePath, const ShaderDefines& defines);
 	~BasicEffect();
 
-	void SetWorldViewProj(CXMMATRIX M)                  { WorldViewProj->SetMatrix(reinterpret_cast<const float*>(&M)); }
-	void SetWorldViewProjTex(CXMMATRIX M)               { WorldViewProjTex->SetMatrix(reinterpret_cast<const float*>(&M)); }
-	void SetWorld(CXMMATRIX M)                          { World->SetMatrix(reinterpret_cast<const float*>(&M)); }
-	void SetWorldInvTranspose(CXMMATRIX M)              { WorldInvTranspose->SetMatrix(reinterpret_cast<const float*>(&M)); }
-	void SetShadowTransform(CXMMATRIX M)                { ShadowTransform->SetMatrix(reinterpret_cast<const float*>(&M)); }
-	void SetTexTransform(CXMMATRIX M)                   { TexTransform->SetMatrix(reinterpret_cast<const float*>(&M)); }
-	void SetEyePosW(const XMFLOAT3& v)                  { EyePosW->SetRawValue(&v, 0, sizeof(XMFLOAT3)); }
-	void SetFogColor(const FXMVECTOR v)                 { FogColor->SetFloatVector(reinterpret_cast<const float*>(&v)); }
-	void SetFogStart(float f)                           { FogStart->SetFloat(f); }
-	void SetFogRange(float f)                           { FogRange->SetFloat(f); }
-	void SetDirLights(const DirectionalLight* lights)   { DirLights->SetRawValue(lights, 0, 3*sizeof(DirectionalLight)); }
-	void SetMaterial(const Material& mat)               { Mat->SetRawValue(&mat, 0, sizeof(Material)); }
-	void SetDiffuseMap(ID3D11ShaderResourceView* tex)   { DiffuseMap->SetResource(tex); }
-	void SetShadowMap(ID3D11ShaderResourceView* tex)    { ShadowMap->SetResource(tex); }
-	void SetSsaoMap(ID3D11ShaderResourceView* tex)      { SsaoMap->SetResource(tex); }
-	void SetCubeMap(ID3D11ShaderResourceView* tex)      { CubeMap->SetResource(tex); }
-
-	ID3DX11EffectTechnique* Light1Tech;
-	ID3DX11EffectTechnique* Light2Tech;
-	ID3DX11EffectTechnique* Light3Tech;
-
-	ID3DX11EffectTechnique* Light0TexTech;
-	ID3DX11EffectTechnique* Light1TexTech;
-	ID3DX11EffectTechnique* Light2TexTech;
-	ID3DX11EffectTechnique* Light3TexTech;
-
-	ID3DX11EffectTechnique* Light0TexAlphaClipTech;
-	ID3DX11EffectTechnique* Light1TexAlphaClipTech;
-	ID3DX11EffectTechnique* Light2TexAlphaClipTech;
-	ID3DX11EffectTechnique* Light3TexAlphaClipTech;
-
-	ID3DX11EffectTechnique* Light1FogTech;
-	ID3DX11EffectTechnique* Light2FogTech;
-	ID3DX11EffectTechnique* Light3FogTech;
-
-	ID3DX11EffectTechnique* Light0TexFogTech;
-	ID3DX11EffectTechnique* Light1TexFogTech;
-	ID3DX11EffectTechnique* Light2TexFogTech;
-	ID3DX11EffectTechnique* Light3TexFogTech;
-
-	ID3DX11EffectTechnique* Light0TexAlphaClipFogTech;
-	ID3DX11EffectTechnique* Light1TexAlphaClipFogTech;
-	ID3DX11EffectTechnique* Light2TexAlphaClipFogTech;
-	ID3DX11EffectTechnique* Light3TexAlphaClipFogTech;
-
-	ID3DX11EffectTechnique* Light1ReflectTech;
-	ID3DX11EffectTechnique* Light2ReflectTech;
-	ID3DX11EffectTechnique* Light3ReflectTech;
-
-	ID3DX11EffectTechnique* Light0TexReflectTech;
-	ID3DX11EffectTechnique* Light1TexReflectTech;
-	ID3DX11EffectTechnique* Light2TexReflectTech;
-	ID3DX11EffectTechnique* Light3TexReflectTech;
-
-	ID3DX11EffectTechnique* Light0TexAlphaClipReflectTech;
-	ID3DX11EffectTechnique* Light1TexAlphaClipReflectTech;
-	ID3DX11EffectTechnique* Light2TexAlphaClipReflectTech;
-	ID3DX11EffectTechnique* Light3TexAlphaClipReflectTech;
-
-	ID3DX11EffectTechnique* Light1FogReflectTech;
-	ID3DX11EffectTechnique* Light2FogReflectTech;
-	ID3DX11EffectTechnique* Light3FogReflectTech;
-
-	ID3DX11EffectTechnique* Light0TexFogReflectTech;
-	ID3DX11EffectTechnique* Light1TexFogReflectTech;
-	ID3DX11EffectTechnique* Light2TexFogReflectTech;
-	ID3DX11EffectTechnique* Light3TexFogReflectTech;
-
-	ID3DX11EffectTechnique* Light0TexAlphaClipFogReflectTech;
-	ID3DX11EffectTechnique* Light1TexAlphaClipFogReflectTech;
-	ID3DX11EffectTechnique* Light2TexAlphaClipFogReflectTech;
-	ID3DX11EffectTechnique* Light3TexAlphaClipFogReflectTech;
+	void SetWorldViewProj(CXMMATRIX M)                  { mConstants.SetMatrix(WorldViewProj, M); }
+	void SetWorldViewProjTex(CXMMATRIX M)               { mConstants.SetMatrix(WorldViewProjTex, M); }
+	void SetViewProj(CXMMATRIX M)                       { mConstants.SetMatrix(ViewProj, M); }
+	void SetViewProjTex(CXMMATRIX M)                    { mConstants.SetMatrix(ViewProjTex, M); }
+	void SetWorld(CXMMATRIX M)                          { mConstants.SetMatrix(World, M); }
+	void SetWorldInvTranspose(CXMMATRIX M)              { mConstants.SetMatrix(WorldInvTranspose, M); }
+	void SetShadowTransform(CXMMATRIX M)                { mConstants.SetMatrix(ShadowTransform, M); }
+	void SetShadowCascadeTransforms(const XMFLOAT4X4* M, UINT count) { mConstants.SetMatrixArray(ShadowCascadeTransforms, M, count); }
+	void SetShadowCascadeSplits(const XMFLOAT4& v)      { mConstants.SetRawValue(ShadowCascadeSplits, &v, sizeof(XMFLOAT4)); }
+	void SetShadowCascadeCount(int i)                   { mConstants.SetRawValue(ShadowCascadeCount, &i, sizeof(int)); }
+	void SetShadowMapSize(float width, float height)    { SetMapSize(ShadowMapSize, width, height); }
+	void SetShadowCascadeMapSize(float width, float height) { SetMapSize(ShadowCascadeMapSize, width, height); }
+	void SetTexTransform(CXMMATRIX M)                   { mConstants.SetMatrix(TexTransform, M); }
+	void SetEyePosW(const XMFLOAT3& v)                  { mConstants.SetRawValue(EyePosW, &v, sizeof(XMFLOAT3)); }
+	void SetFogColor(const FXMVECTOR v)                 { mConstants.SetFloatVector(FogColor, v); }
+	void SetFogStart(float f)                           { mConstants.SetFloat(FogStart, f); }
+	void SetFogRange(float f)                           { mConstants.SetFloat(FogRange, f); }
+	void SetDirLights(const DirectionalLight* lights)   { mConstants.SetRawValue(DirLights, lights, 3*sizeof(DirectionalLight)); }
+	void SetMaterial(const Material& mat)               { mConstants.SetRawValue(Mat, &mat, sizeof(Material)); }
+
+	// Clustered point and spot lights, from ClusteredLighting::Apply.
+	void SetClusterGrid(UINT tilesX, UINT tilesY, UINT slices) { UINT v[3] = { tilesX, tilesY, slices }; mConstants.SetRawValue(ClusterGrid, v, sizeof(v)); }
+	void SetClusterTileScale(const XMFLOAT2& v)         { mConstants.SetRawValue(ClusterTileScale, &v, sizeof(XMFLOAT2)); }
+	void SetClusterDepthScale(float f)                  { mConstants.SetFloat(ClusterDepthScale, f); }
+	void SetClusterDepthBias(float f)                   { mConstants.SetFloat(ClusterDepthBias, f); }
+	void SetClusterPointLightCount(UINT n)              { mConstants.SetRawValue(ClusterPointLightCount, &n, sizeof(UINT)); }
+	void SetClusterLightCount(UINT n)                   { mConstants.SetRawValue(ClusterLightCount, &n, sizeof(UINT)); }
+	void SetClusterPointLights(ID3D11ShaderResourceView* srv) { SetResource(ClusterPointLights, srv); }
+	void SetClusterSpotLights(ID3D11ShaderResourceView* srv)  { SetResource(ClusterSpotLights, srv); }
+	void SetClusters(ID3D11ShaderResourceView* srv)     { SetResource(Clusters, srv); }
+	void SetClusterLightIndices(ID3D11ShaderResourceView* srv) { SetResource(ClusterLightIndices, srv); }
+	void SetDiffuseMap(ID3D11ShaderResourceView* tex)   { SetResource(DiffuseMap, tex); }
+	void SetShadowMap(ID3D11ShaderResourceView* tex)    { SetResource(ShadowMap, tex); }
+	void SetShadowCascadeMap(ID3D11ShaderResourceView* tex) { SetResource(ShadowCascadeMap, tex); }
+	void SetSsaoMap(ID3D11ShaderResourceView* tex)      { SetResource(SsaoMap, tex); }
+	void SetCubeMap(ID3D11ShaderResourceView* tex)      { SetResource(CubeMap, tex); }
 
 	ID3DX11EffectMatrixVariable* WorldViewProj;
 	ID3DX11EffectMatrixVariable* WorldViewProjTex;
+	ID3DX11EffectMatrixVariable* ViewProj;
+	ID3DX11EffectMatrixVariable* ViewProjTex;
 	ID3DX11EffectMatrixVariable* World;
 	ID3DX11EffectMatrixVariable* WorldInvTranspose;
 	ID3DX11EffectMatrixVariable* ShadowTransform;
+	ID3DX11EffectMatrixVariable* ShadowCascadeTransforms;
+	ID3DX11EffectVectorVariable* ShadowCascadeSplits;
+	ID3DX11EffectScalarVariable* ShadowCascadeCount;
+	ID3DX11EffectVectorVariable* ShadowMapSize;
+	ID3DX11EffectVectorVariable* ShadowCascadeMapSize;
 	ID3DX11EffectMatrixVariable* TexTransform;
 	ID3DX11EffectVectorVariable* EyePosW;
 	ID3DX11EffectVectorVariable* FogColor;
@@ -119,99 +173,95 @@ public:
 	ID3DX11EffectVariable* DirLights;
 	ID3DX11EffectVariable* Mat;
 
+	ID3DX11EffectVariable* ClusterGrid;
+	ID3DX11EffectVariable* ClusterTileScale;
+	ID3DX11EffectScalarVariable* ClusterDepthScale;
+	ID3DX11EffectScalarVariable* ClusterDepthBias;
+	ID3DX11EffectVariable* ClusterPointLightCount;
+	ID3DX11EffectVariable* ClusterLightCount;
+	ID3DX11EffectShaderResourceVariable* ClusterPointLights;
+	ID3DX11EffectShaderResourceVariable* ClusterSpotLights;
+	ID3DX11EffectShaderResourceVariable* Clusters;
+	ID3DX11EffectShaderResourceVariable* ClusterLightIndices;
+
 	ID3DX11EffectShaderResourceVariable* DiffuseMap;
 	ID3DX11EffectShaderResourceVariable* ShadowMap;
+	ID3DX11EffectShaderResourceVariable* ShadowCascadeMap;
 	ID3DX11EffectShaderResourceVariable* SsaoMap;
 	ID3DX11EffectShaderResourceVariable* CubeMap;
 };
 #pragma endregion
 
 #pragma region NormalMapEffect
-class NormalMapEffect : public Effect
+class NormalMapEffect : public PermutationEffect
 {
 public:
-	NormalMapEffect(ID3D11Device* device, const std::wstring& filename);
+	// The effect itself is the permutation with the default LitFeatures.
+	NormalMapEffect(ID3D11Device* device, ShaderCache* cache, const std::string& sourcePath, const ShaderDefines& defines);
 	~NormalMapEffect();
 
-	void SetWorldViewProj(CXMMATRIX M)                  { WorldViewProj->SetMatrix(reinterpret_cast<const float*>(&M)); }
-	void SetWorldViewProjTex(CXMMATRIX M)               { WorldViewProjTex->SetMatrix(reinterpret_cast<const float*>(&M)); }
-	void SetWorld(CXMMATRIX M)                          { World->SetMatrix(reinterpret_cast<const float*>(&M)); }
-	void SetWorldInvTranspose(CXMMATRIX M)              { WorldInvTranspose->SetMatrix(reinterpret_cast<const float*>(&M)); }
-	void SetShadowTransform(CXMMATRIX M)                { ShadowTransform->SetMatrix(reinterpret_cast<const float*>(&M)); }
-	void SetTexTransform(CXMMATRIX M)                   { TexTransform->SetMatrix(reinterpret_cast<const float*>(&M)); }
-	void SetEyePosW(const XMFLOAT3& v)                  { EyePosW->SetRawValue(&v, 0, sizeof(XMFLOAT3)); }
-	void SetFogColor(const FXMVECTOR v)                 { FogColor->SetFloatVector(reinterpret_cast<const float*>(&v)); }
-	void SetFogStart(float f)                           { FogStart->SetFloat(f); }
-	void SetFogRange(float f)                           { FogRange->SetFloat(f); }
-	void SetDirLights(const DirectionalLight* lights)   { DirLights->SetRawValue(lights, 0, 3*sizeof(DirectionalLight)); }
-	void SetMaterial(const Material& mat)               { Mat->SetRawValue(&mat, 0, sizeof(Material)); }
-	void SetDiffuseMap(ID3D11ShaderResourceView* tex)   { DiffuseMap->SetResource(tex); }
-	void SetCubeMap(ID3D11ShaderResourceView* tex)      { CubeMap->SetResource(tex); }
-	void SetNormalMap(ID3D11ShaderResourceView* tex)    { NormalMap->SetResource(tex); }
-	void SetSsaoMap(ID3D11ShaderResourceView* tex)      { SsaoMap->SetResource(tex); }
-	void SetShadowMap(ID3D11ShaderResourceView* tex)    { ShadowMap->SetResource(tex); }
-
-	ID3DX11EffectTechnique* Light1Tech;
-	ID3DX11EffectTechnique* Light2Tech;
-	ID3DX11EffectTechnique* Light3Tech;
-
-	ID3DX11EffectTechnique* Light0TexTech;
-	ID3DX11EffectTechnique* Light1TexTech;
-	ID3DX11EffectTechnique* Light2TexTech;
-	ID3DX11EffectTechnique* Light3TexTech;
-
-	ID3DX11EffectTechnique* Light0TexAlphaClipTech;
-	ID3DX11EffectTechnique* Light1TexAlphaClipTech;
-	ID3DX11EffectTechnique* Light2TexAlphaClipTech;
-	ID3DX11EffectTechnique* Light3TexAlphaClipTech;
-
-	ID3DX11EffectTechnique* Light1FogTech;
-	ID3DX11EffectTechnique* Light2FogTech;
-	ID3DX11EffectTechnique* Light3FogTech;
-
-	ID3DX11EffectTechnique* Light0TexFogTech;
-	ID3DX11EffectTechnique* Light1TexFogTech;
-	ID3DX11EffectTechnique* Light2TexFogTech;
-	ID3DX11EffectTechnique* Light3TexFogTech;
-
-	ID3DX11EffectTechnique* Light0TexAlphaClipFogTech;
-	ID3DX11EffectTechnique* Light1TexAlphaClipFogTech;
-	ID3DX11EffectTechnique* Light2TexAlphaClipFogTech;
-	ID3DX11EffectTechnique* Light3TexAlphaClipFogTech;
-
-	ID3DX11EffectTechnique* Light1ReflectTech;
-	ID3DX11EffectTechnique* Light2ReflectTech;
-	ID3DX11EffectTechnique* Light3ReflectTech;
-
-	ID3DX11EffectTechnique* Light0TexReflectTech;
-	ID3DX11EffectTechnique* Light1TexReflectTech;
-	ID3DX11EffectTechnique* Light2TexReflectTech;
-	ID3DX11EffectTechnique* Light3TexReflectTech;
-
-	ID3DX11EffectTechnique* Light0TexAlphaClipReflectTech;
-	ID3DX11EffectTechnique* Light1TexAlphaClipReflectTech;
-	ID3DX11EffectTechnique* Light2TexAlphaClipReflectTech;
-	ID3DX11EffectTechnique* Light3TexAlphaClipReflectTech;
-
-	ID3DX11EffectTechnique* Light1FogReflectTech;
-	ID3DX11EffectTechnique* Light2FogReflectTech;
-	ID3DX11EffectTechnique* Light3FogReflectTech;
-
-	ID3DX11EffectTechnique* Light0TexFogReflectTech;
-	ID3DX11EffectTechnique* Light1TexFogReflectTech;
-	ID3DX11EffectTechnique* Light2TexFogReflectTech;
-	ID3DX11EffectTechnique* Light3TexFogReflectTech;
-
-	ID3DX11EffectTechnique* Light0TexAlphaClipFogReflectTech;
-	ID3DX11EffectTechnique* Light1TexAlphaClipFogReflectTech;
-	ID3DX11EffectTechnique* Light2TexAlphaClipFogReflectTech;
-	ID3DX11EffectTechnique* Light3TexAlphaClipFogReflectTech;
+	void SetWorldViewProj(CXMMATRIX M)                  { mConstants.SetMatrix(WorldViewProj, M); }
+	void SetWorldViewProjTex(CXMMATRIX M)               { mConstants.SetMatrix(WorldViewProjTex, M); }
+	void SetViewProj(CXMMATRIX M)                       { mConstants.SetMatrix(ViewProj, M); }
+	void SetViewProjTex(CXMMATRIX M)                    { mConstants.SetMatrix(ViewProjTex, M); }
+	void SetWorld(CXMMATRIX M)                          { mConstants.SetMatrix(World, M); }
+	void SetWorldInvTranspose(CXMMATRIX M)              { mConstants.SetMatrix(WorldInvTranspose, M); }
+	void SetShadowTransform(CXMMATRIX M)                { mConstants.SetMatrix(ShadowTransform, M); }
+	void SetShadowCascadeTransforms(const XMFLOAT4X4* M, UINT count) { mConstants.SetMatrixArray(ShadowCascadeTransforms, M, count); }
+	void SetShadowCascadeSplits(const XMFLOAT4& v)      { mConstants.SetRawValue(ShadowCascadeSplits, &v, sizeof(XMFLOAT4)); }
+	void SetShadowCascadeCount(int i)                   { mConstants.SetRawValue(ShadowCascadeCount, &i, sizeof(int)); }
+	void SetShadowMapSize(float width, float height)    { SetMapSize(ShadowMapSize, width, height); }
+	void SetShadowCascadeMapSize(float width, float height) { SetMapSize(ShadowCascadeMapSize, width, height); }
+	void SetTexTransform(CXMMATRIX M)                   { mConstants.SetMatrix(TexTransform, M); }
+	void SetEyePosW(const XMFLOAT3& v)                  { mConstants.SetRawValue(EyePosW, &v, sizeof(XMFLOAT3)); }
+	void SetFogColor(const FXMVECTOR v)                 { mConstants.SetFloatVector(FogColor, v); }
+	void SetFogStart(float f)                           { mConstants.SetFloat(FogStart, f); }
+	void SetFogRange(float f)                           { mConstants.SetFloat(FogRange, f); }
+	void SetDirLights(const DirectionalLight* lights)   { mConstants.SetRawValue(DirLights, lights, 3*sizeof(DirectionalLight)); }
+	void SetMaterial(const Material& mat)               { mConstants.SetRawValue(Mat, &mat, sizeof(Material)); }
+
+	// Clustered point and spot lights, from ClusteredLighting::Apply.
+	void SetClusterGrid(UINT tilesX, UINT tilesY, UINT slices) { UINT v[3] = { tilesX, tilesY, slices }; mConstants.SetRawValue(ClusterGrid, v, sizeof(v)); }
+	void SetClusterTileScale(const XMFLOAT2& v)         { mConstants.SetRawValue(ClusterTileScale, &v, sizeof(XMFLOAT2)); }
+	void SetClusterDepthScale(float f)                  { mConstants.SetFloat(ClusterDepthScale, f); }
+	void SetClusterDepthBias(float f)                   { mConstants.SetFloat(ClusterDepthBias, f); }
+	void SetClusterPointLightCount(UINT n)              { mConstants.SetRawValue(ClusterPointLightCount, &n, sizeof(UINT)); }
+	void SetClusterLightCount(UINT n)                   { mConstants.SetRawValue(ClusterLightCount, &n, sizeof(UINT)); }
+	void SetClusterPointLights(ID3D11ShaderResourceView* srv) { SetResource(ClusterPointLights, srv); }
+	void SetClusterSpotLights(ID3D11ShaderResourceView* srv)  { SetResource(ClusterSpotLights, srv); }
+	void SetClusters(ID3D11ShaderResourceView* srv)     { SetResource(Clusters, srv); }
+	void SetClusterLightIndices(ID3D11ShaderResourceView* srv) { SetResource(ClusterLightIndices, srv); }
+
+	void SetHeightScale(float f)                        { mConstants.SetFloat(HeightScale, f); }
+	void SetMaxTessDistance(float f)                    { mConstants.SetFloat(MaxTessDistance, f); }
+	void SetMinTessDistance(float f)                    { mConstants.SetFloat(MinTessDistance, f); }
+	void SetMinTessFactor(float f)                      { mConstants.SetFloat(MinTessFactor, f); }
+	void SetMaxTessFactor(float f)                      { mConstants.SetFloat(MaxTessFactor, f); }
+	void SetTessEdgeLength(float f)                     { mConstants.SetFloat(TessEdgeLength, f); }
+	void SetTessProjScale(float f)                      { mConstants.SetFloat(TessProjScale, f); }
+	void SetTessBackfaceSlack(float f)                  { mConstants.SetFloat(TessBackfaceSlack, f); }
+	void SetTessCullPlanes(const XMFLOAT4* planes)      { mConstants.SetRawValue(TessCullPlanes, planes, 6*sizeof(XMFLOAT4)); }
+	void SetTessCullView(const XMFLOAT4& v)             { mConstants.SetRawValue(TessCullView, &v, sizeof(XMFLOAT4)); }
+
+	void SetDiffuseMap(ID3D11ShaderResourceView* tex)   { SetResource(DiffuseMap, tex); }
+	void SetCubeMap(ID3D11ShaderResourceView* tex)      { SetResource(CubeMap, tex); }
+	void SetNormalMap(ID3D11ShaderResourceView* tex)    { SetResource(NormalMap, tex); }
+	void SetSsaoMap(ID3D11ShaderResourceView* tex)      { SetResource(SsaoMap, tex); }
+	void SetShadowMap(ID3D11ShaderResourceView* tex)    { SetResource(ShadowMap, tex); }
+	void SetShadowCascadeMap(ID3D11ShaderResourceView* tex) { SetResource(ShadowCascadeMap, tex); }
 
 	ID3DX11EffectMatrixVariable* WorldViewProj;
 	ID3DX11EffectMatrixVariable* WorldViewProjTex;
+	ID3DX11EffectMatrixVariable* ViewProj;
+	ID3DX11EffectMatrixVariable* ViewProjTex;
 	ID3DX11EffectMatrixVariable* World;
 	ID3DX11EffectMatrixVariable* WorldInvTranspose;
 	ID3DX11EffectMatrixVariable* ShadowTransform;
+	ID3DX11EffectMatrixVariable* ShadowCascadeTransforms;
+	ID3DX11EffectVectorVariable* ShadowCascadeSplits;
+	ID3DX11EffectScalarVariable* ShadowCascadeCount;
+	ID3DX11EffectVectorVariable* ShadowMapSize;
+	ID3DX11EffectVectorVariable* ShadowCascadeMapSize;
 	ID3DX11EffectMatrixVariable* TexTransform;
 	ID3DX11EffectVectorVariable* EyePosW;
 	ID3DX11EffectVectorVariable* FogColor;
@@ -220,10 +270,32 @@ public:
 	ID3DX11EffectVariable* DirLights;
 	ID3DX11EffectVariable* Mat;
 
+	ID3DX11EffectVariable* ClusterGrid;
+	ID3DX11EffectVariable* ClusterTileScale;
+	ID3DX11EffectScalarVariable* ClusterDepthScale;
+	ID3DX11EffectScalarVariable* ClusterDepthBias;
+	ID3DX11EffectVariable* ClusterPointLightCount;
+	ID3DX11EffectVariable* ClusterLightCount;
+	ID3DX11EffectShaderResourceVariable* ClusterPointLights;
+	ID3DX11EffectShaderResourceVariable* ClusterSpotLights;
+	ID3DX11EffectShaderResourceVariable* Clusters;
+	ID3DX11EffectShaderResourceVariable* ClusterLightIndices;
+	ID3DX11EffectScalarVariable* HeightScale;
+	ID3DX11EffectScalarVariable* MaxTessDistance;
+	ID3DX11EffectScalarVariable* MinTessDistance;
+	ID3DX11EffectScalarVariable* MinTessFactor;
+	ID3DX11EffectScalarVariable* MaxTessFactor;
+	ID3DX11EffectScalarVariable* TessEdgeLength;
+	ID3DX11EffectScalarVariable* TessProjScale;
+	ID3DX11EffectScalarVariable* TessBackfaceSlack;
+	ID3DX11EffectVectorVariable* TessCullPlanes;
+	ID3DX11EffectVectorVariable* TessCullView;
+
 	ID3DX11EffectShaderResourceVariable* DiffuseMap;
 	ID3DX11EffectShaderResourceVariable* CubeMap;
 	ID3DX11EffectShaderResourceVariable* NormalMap;
 	ID3DX11EffectShaderResourceVariable* ShadowMap;
+	ID3DX11EffectShaderResourceVariable* ShadowCascadeMap;
 	ID3DX11EffectShaderResourceVariable* SsaoMap;
 };
 #pragma endregion
@@ -235,6 +307,9 @@ public:
 	BuildShadowMapEffect(ID3D11Device* device, const std::wstring& filename);
 	~BuildShadowMapEffect();
 
+	// For recording on another thread.  The caller deletes the clone.
+	BuildShadowMapEffect* Clone()const;
+
 	void SetViewProj(CXMMATRIX M)                       { ViewProj->SetMatrix(reinterpret_cast<const float*>(&M)); }
 	void SetWorldViewProj(CXMMATRIX M)                  { WorldViewProj->SetMatrix(reinterpret_cast<const float*>(&M)); }
 	void SetWorld(CXMMATRIX M)                          { World->SetMatrix(reinterpret_cast<const float*>(&M)); }
@@ -247,6 +322,11 @@ public:
 	void SetMinTessDistance(float f)                    { MinTessDistance->SetFloat(f); }
 	void SetMinTessFactor(float f)                      { MinTessFactor->SetFloat(f); }
 	void SetMaxTessFactor(float f)                      { MaxTessFactor->SetFloat(f); }
+	void SetTessEdgeLength(float f)                     { TessEdgeLength->SetFloat(f); }
+	void SetTessProjScale(float f)                      { TessProjScale->SetFloat(f); }
+	void SetTessBackfaceSlack(float f)                  { TessBackfaceSlack->SetFloat(f); }
+	void SetTessCullPlanes(const XMFLOAT4* planes)      { TessCullPlanes->SetFloatVectorArray(reinterpret_cast<const float*>(planes), 0, 6); }
+	void SetTessCullView(const XMFLOAT4& v)             { TessCullView->SetFloatVector(reinterpret_cast<const float*>(&v)); }
 
 	void SetDiffuseMap(ID3D11ShaderResourceView* tex)   { DiffuseMap->SetResource(tex); }
 	void SetNormalMap(ID3D11ShaderResourceView* tex)    { NormalMap->SetResource(tex); }
@@ -267,9 +347,18 @@ public:
 	ID3DX11EffectScalarVariable* MinTessDistance;
 	ID3DX11EffectScalarVariable* MinTessFactor;
 	ID3DX11EffectScalarVariable* MaxTessFactor;
+	ID3DX11EffectScalarVariable* TessEdgeLength;
+	ID3DX11EffectScalarVariable* TessProjScale;
+	ID3DX11EffectScalarVariable* TessBackfaceSlack;
+	ID3DX11EffectVectorVariable* TessCullPlanes;
+	ID3DX11EffectVectorVariable* TessCullView;
  
 	ID3DX11EffectShaderResourceVariable* DiffuseMap;
 	ID3DX11EffectShaderResourceVariable* NormalMap;
+
+private:
+	explicit BuildShadowMapEffect(ID3DX11Effect* fx);
+	void GetVariables();
 };
 #pragma endregion
 
@@ -280,6 +369,9 @@ public:
 	SsaoNormalDepthEffect(ID3D11Device* device, const std::wstring& filename);
 	~SsaoNormalDepthEffect();
 
+	// For recording on another thread.  The caller deletes the clone.
+	SsaoNormalDepthEffect* Clone()const;
+
 	void SetWorldView(CXMMATRIX M)                      { WorldView->SetMatrix(reinterpret_cast<const float*>(&M)); }
 	void SetWorldInvTransposeView(CXMMATRIX M)          { WorldInvTransposeView->SetMatrix(reinterpret_cast<const float*>(&M)); }
 	void SetWorldViewProj(CXMMATRIX M)                  { WorldViewProj->SetMatrix(reinterpret_cast<const float*>(&M)); }
@@ -295,6 +387,10 @@ public:
 	ID3DX11EffectMatrixVariable* TexTransform;
 
 	ID3DX11EffectShaderResourceVariable* DiffuseMap;
+
+private:
+	explicit SsaoNormalDepthEffect(ID3DX11Effect* fx);
+	void GetVariables();
 };
 #pragma endregion
 
@@ -306,17 +402,20 @@ public:
 	~SsaoEffect();
 
 	void SetViewToTexSpace(CXMMATRIX M)                    { ViewToTexSpace->SetMatrix(reinterpret_cast<const float*>(&M)); }
-	void SetOffsetVectors(const XMFLOAT4 v[14])            { OffsetVectors->SetFloatVectorArray(reinterpret_cast<const float*>(v), 0, 14); }
+	void SetOffsetVectors(const XMFLOAT4* v, UINT count)   { OffsetVectors->SetFloatVectorArray(reinterpret_cast<const float*>(v), 0, count); }
 	void SetFrustumCorners(const XMFLOAT4 v[4])            { FrustumCorners->SetFloatVectorArray(reinterpret_cast<const float*>(v), 0, 4); }
 	void SetOcclusionRadius(float f)                       { OcclusionRadius->SetFloat(f); }
 	void SetOcclusionFadeStart(float f)                    { OcclusionFadeStart->SetFloat(f); }
 	void SetOcclusionFadeEnd(float f)                      { OcclusionFadeEnd->SetFloat(f); }
 	void SetSurfaceEpsilon(float f)                        { SurfaceEpsilon->SetFloat(f); }
+	void SetSampleCount(int i)                             { SampleCount->SetInt(i); }
+	void SetFirstSample(int i)                             { FirstSample->SetInt(i); }
 
 	void SetNormalDepthMap(ID3D11ShaderResourceView* srv)  { NormalDepthMap->SetResource(srv); }
 	void SetRandomVecMap(ID3D11ShaderResourceView* srv)    { RandomVecMap->SetResource(srv); }
 
 	ID3DX11EffectTechnique* SsaoTech;
+	ID3DX11EffectTechnique* SsaoTemporalTech;
 
 	ID3DX11EffectMatrixVariable* ViewToTexSpace;
 	ID3DX11EffectVectorVariable* OffsetVectors;
@@ -325,12 +424,88 @@ public:
 	ID3DX11EffectScalarVariable* OcclusionFadeStart;
 	ID3DX11EffectScalarVariable* OcclusionFadeEnd;
 	ID3DX11EffectScalarVariable* SurfaceEpsilon;
+	ID3DX11EffectScalarVariable* SampleCount;
+	ID3DX11EffectScalarVariable* FirstSample;
 
 	ID3DX11EffectShaderResourceVariable* NormalDepthMap;
 	ID3DX11EffectShaderResourceVariable* RandomVecMap;
 };
 #pragma endregion
 
+#pragma region SsaoComputeEffect
+class SsaoComputeEffect : public Effect
+{
+public:
+	SsaoComputeEffect(ID3D11Device* device, const std::wstring& filename);
+	~SsaoComputeEffect();
+
+	void SetViewToTexSpace(CXMMATRIX M)                    { ViewToTexSpace->SetMatrix(reinterpret_cast<const float*>(&M)); }
+	void SetOffsetVectors(const XMFLOAT4* v, UINT count)   { OffsetVectors->SetFloatVectorArray(reinterpret_cast<const float*>(v), 0, count); }
+	void SetFrustumCorners(const XMFLOAT4 v[4])            { FrustumCorners->SetFloatVectorArray(reinterpret_cast<const float*>(v), 0, 4); }
+	void SetOcclusionRadius(float f)                       { OcclusionRadius->SetFloat(f); }
+	void SetOcclusionFadeStart(float f)                    { OcclusionFadeStart->SetFloat(f); }
+	void SetOcclusionFadeEnd(float f)                      { OcclusionFadeEnd->SetFloat(f); }
+	void SetSurfaceEpsilon(float f)                        { SurfaceEpsilon->SetFloat(f); }
+	void SetSampleCount(int i)                             { SampleCount->SetInt(i); }
+	void SetResolutionScale(int i)                         { ResolutionScale->SetInt(i); }
+
+	void SetNormalDepthMap(ID3D11ShaderResourceView* srv)  { NormalDepthMap->SetResource(srv); }
+	void SetRandomVecMap(ID3D11ShaderResourceView* srv)    { RandomVecMap->SetResource(srv); }
+	void SetAmbientMap(ID3D11UnorderedAccessView* uav)     { AmbientMap->SetUnorderedAccessView(uav); }
+
+	ID3DX11EffectTechnique* SsaoTech;
+
+	ID3DX11EffectMatrixVariable* ViewToTexSpace;
+	ID3DX11EffectVectorVariable* OffsetVectors;
+	ID3DX11EffectVectorVariable* FrustumCorners;
+	ID3DX11EffectScalarVariable* OcclusionRadius;
+	ID3DX11EffectScalarVariable* OcclusionFadeStart;
+	ID3DX11EffectScalarVariable* OcclusionFadeEnd;
+	ID3DX11EffectScalarVariable* SurfaceEpsilon;
+	ID3DX11EffectScalarVariable* SampleCount;
+	ID3DX11EffectScalarVariable* ResolutionScale;
+
+	ID3DX11EffectShaderResourceVariable* NormalDepthMap;
+	ID3DX11EffectShaderResourceVariable* RandomVecMap;
+	ID3DX11EffectUnorderedAccessViewVariable* AmbientMap;
+};
+#pragma endregion
+
+#pragma region SsaoTemporalEffect
+class SsaoTemporalEffect : public Effect
+{
+public:
+	SsaoTemporalEffect(ID3D11Device* device, const std::wstring& filename);
+	~SsaoTemporalEffect();
+
+	void SetViewToPrevView(CXMMATRIX M)                      { ViewToPrevView->SetMatrix(reinterpret_cast<const float*>(&M)); }
+	void SetPrevViewToTex(CXMMATRIX M)                       { PrevViewToTex->SetMatrix(reinterpret_cast<const float*>(&M)); }
+	void SetFrustumCorners(const XMFLOAT4 v[4])              { FrustumCorners->SetFloatVectorArray(reinterpret_cast<const float*>(v), 0, 4); }
+	void SetHistoryWeight(float f)                           { HistoryWeight->SetFloat(f); }
+	void SetDepthTolerance(float f)                          { DepthTolerance->SetFloat(f); }
+	void SetNormalThreshold(float f)                         { NormalThreshold->SetFloat(f); }
+
+	void SetNormalDepthMap(ID3D11ShaderResourceView* srv)    { NormalDepthMap->SetResource(srv); }
+	void SetPrevNormalDepthMap(ID3D11ShaderResourceView* srv){ PrevNormalDepthMap->SetResource(srv); }
+	void SetCurrentAmbientMap(ID3D11ShaderResourceView* srv) { CurrentAmbientMap->SetResource(srv); }
+	void SetHistoryMap(ID3D11ShaderResourceView* srv)        { HistoryMap->SetResource(srv); }
+
+	ID3DX11EffectTechnique* SsaoTemporalTech;
+
+	ID3DX11EffectMatrixVariable* ViewToPrevView;
+	ID3DX11EffectMatrixVariable* PrevViewToTex;
+	ID3DX11EffectVectorVariable* FrustumCorners;
+	ID3DX11EffectScalarVariable* HistoryWeight;
+	ID3DX11EffectScalarVariable* DepthTolerance;
+	ID3DX11EffectScalarVariable* NormalThreshold;
+
+	ID3DX11EffectShaderResourceVariable* NormalDepthMap;
+	ID3DX11EffectShaderResourceVariable* PrevNormalDepthMap;
+	ID3DX11EffectShaderResourceVariable* CurrentAmbientMap;
+	ID3DX11EffectShaderResourceVariable* HistoryMap;
+};
+#pragma endregion
+
 #pragma region SsaoBlurEffect
 class SsaoBlurEffect : public Effect
 {
@@ -340,6 +515,7 @@ public:
 
 	void SetTexelWidth(float f)                            { TexelWidth->SetFloat(f); }
 	void SetTexelHeight(float f)                           { TexelHeight->SetFloat(f); }
+	void SetBlurRadius(int i)                              { BlurRadius->SetInt(i); }
 
 	void SetNormalDepthMap(ID3D11ShaderResourceView* srv)  { NormalDepthMap->SetResource(srv); }
 	void SetInputImage(ID3D11ShaderResourceView* srv)      { InputImage->SetResource(srv); }
@@ -349,12 +525,57 @@ public:
 
 	ID3DX11EffectScalarVariable* TexelWidth;
 	ID3DX11EffectScalarVariable* TexelHeight;
+	ID3DX11EffectScalarVariable* BlurRadius;
 
 	ID3DX11EffectShaderResourceVariable* NormalDepthMap;
 	ID3DX11EffectShaderResourceVariable* InputImage;
 };
 #pragma endregion
 
+#pragma region SsaoBlurComputeEffect
+class SsaoBlurComputeEffect : public Effect
+{
+public:
+	SsaoBlurComputeEffect(ID3D11Device* device, const std::wstring& filename);
+	~SsaoBlurComputeEffect();
+
+	void SetBlurRadius(int i)                              { BlurRadius->SetInt(i); }
+	void SetResolutionScale(int i)                         { ResolutionScale->SetInt(i); }
+
+	void SetNormalDepthMap(ID3D11ShaderResourceView* srv)  { NormalDepthMap->SetResource(srv); }
+	void SetInputImage(ID3D11ShaderResourceView* srv)      { InputImage->SetResource(srv); }
+	void SetOutputImage(ID3D11UnorderedAccessView* uav)    { OutputImage->SetUnorderedAccessView(uav); }
+
+	ID3DX11EffectTechnique* HorzBlurTech;
+	ID3DX11EffectTechnique* VertBlurTech;
+	ID3DX11EffectTechnique* BlurTech;
+
+	ID3DX11EffectScalarVariable* BlurRadius;
+	ID3DX11EffectScalarVariable* ResolutionScale;
+
+	ID3DX11EffectShaderResourceVariable* NormalDepthMap;
+	ID3DX11EffectShaderResourceVariable* InputImage;
+	ID3DX11EffectUnorderedAccessViewVariable* OutputImage;
+};
+#pragma endregion
+
+#pragma region SsaoUpsampleEffect
+class SsaoUpsampleEffect : public Effect
+{
+public:
+	SsaoUpsampleEffect(ID3D11Device* device, const std::wstring& filename);
+	~SsaoUpsampleEffect();
+
+	void SetNormalDepthMap(ID3D11ShaderResourceView* srv)  { NormalDepthMap->SetResource(srv); }
+	void SetAmbientMap(ID3D11ShaderResourceView* srv)      { AmbientMap->SetResource(srv); }
+
+	ID3DX11EffectTechnique* UpsampleTech;
+
+	ID3DX11EffectShaderResourceVariable* NormalDepthMap;
+	ID3DX11EffectShaderResourceVariable* AmbientMap;
+};
+#pragma endregion
+
 #pragma region SkyEffect
 class SkyEffect : public Effect
 {
@@ -398,15 +619,35 @@ public:
 class Effects
 {
 public:
-	static void InitAll(ID3D11Device* device);
+	// Basic.fx and NormalMap.fx take the filter as the SHADOW_FILTER define;
+	// InitAll compiles their permutations with the filter given.
+	enum ShadowFilter
+	{
+		ShadowFilter1Tap,
+		ShadowFilterPcf3x3,
+		ShadowFilterPcf5x5,
+		ShadowFilterPoisson
+	};
+
+	static void InitAll(ID3D11Device* device, ShadowFilter shadowFilter = ShadowFilterPcf3x3);
 	static void DestroyAll();
 
+	// The SHADOW_FILTER value for a filter.
+	static const char* ShadowFilterDefine(ShadowFilter shadowFilter);
+
+	// Compiled permutations of Basic.fx and NormalMap.fx, kept in FX/Cache.
+	static ShaderCache* Cache;
+
 	static BasicEffect* BasicFX;
 	static NormalMapEffect* NormalMapFX;
 	static BuildShadowMapEffect* BuildShadowMapFX;
 	static SsaoNormalDepthEffect* SsaoNormalDepthFX;
 	static SsaoEffect* SsaoFX;
+	static SsaoComputeEffect* SsaoComputeFX;
+	static SsaoTemporalEffect* SsaoTemporalFX;
 	static SsaoBlurEffect* SsaoBlurFX;
+	static SsaoBlurComputeEffect* SsaoBlurComputeFX;
+	static SsaoUpsampleEffect* SsaoUpsampleFX;
 	static SkyEffect* SkyFX;
 	static DebugTexEffect* DebugTexFX;
 };
@@ -5,6 +5,13 @@
 //=============================================================================
 
 #include "LightHelper.fx"
+#include "ClusteredLights.fx"
+
+// Shadow filter to compile with.  Effects::InitAll defines it for every
+// permutation.
+#ifndef SHADOW_FILTER
+#define SHADOW_FILTER SHADOW_FILTER_PCF3X3
+#endif
  
 cbuffer cbPerFrame
 {
@@ -14,6 +21,24 @@ cbuffer cbPerFrame
 	float  gFogStart;
 	float  gFogRange;
 	float4 gFogColor; 
+
+	// Used by the instanced techniques, which get the world matrices per instance.
+	// Their gShadowTransform maps from world space rather than object space.
+	float4x4 gViewProj;
+	float4x4 gViewProjTex;
+
+	// Cascaded shadows of the first light, used in place of gShadowMap when
+	// gShadowCascadeCount is above zero.  The transforms map world space to the
+	// texture space of each cascade; gShadowCascadeSplits holds the view depth
+	// where each cascade ends.
+	float4x4 gShadowCascadeTransforms[MAX_CASCADES];
+	float4   gShadowCascadeSplits;
+	int      gShadowCascadeCount = 0;
+
+	// (width, height, 1/width, 1/height) of gShadowMap and of each slice of
+	// gShadowCascadeMap.
+	float4   gShadowMapSize        = float4(2048.0f, 2048.0f, 1.0f/2048.0f, 1.0f/2048.0f);
+	float4   gShadowCascadeMapSize = float4(2048.0f, 2048.0f, 1.0f/2048.0f, 1.0f/2048.0f);
 };
 
 cbuffer cbPerObject
@@ -30,6 +55,7 @@ cbuffer cbPerObject
 // Nonnumeric values cannot be added to a cbuffer.
 Texture2D gDiffuseMap;
 Texture2D gShadowMap;
+Texture2DArray gShadowCascadeMap;
 Texture2D gSsaoMap;
 TextureCube gCubeMap;
 
@@ -91,6 +117,38 @@ VertexOut VS(VertexIn vin)
 	return vout;
 }
  
+struct InstancedVertexIn
+{
+	float3 PosL    : POSITION;
+	float3 NormalL : NORMAL;
+	float2 Tex     : TEXCOORD;
+	row_major float4x4 World             : WORLD;
+	row_major float4x4 WorldInvTranspose : WORLDINVTRANSPOSE;
+};
+
+VertexOut InstancedVS(InstancedVertexIn vin)
+{
+	VertexOut vout;
+	
+	// Transform to world space space.
+	vout.PosW    = mul(float4(vin.PosL, 1.0f), vin.World).xyz;
+	vout.NormalW = mul(vin.NormalL, (float3x3)vin.WorldInvTranspose);
+		
+	// Transform to homogeneous clip space.
+	vout.PosH = mul(float4(vout.PosW, 1.0f), gViewProj);
+	
+	// Output vertex attributes for interpolation across triangle.
+	vout.Tex = mul(float4(vin.Tex, 0.0f, 1.0f), gTexTransform).xy;
+
+	// Generate projective tex-coords to project shadow map onto scene.
+	vout.ShadowPosH = mul(float4(vout.PosW, 1.0f), gShadowTransform);
+
+	// Generate projective tex-coords to project SSAO map onto scene.
+	vout.SsaoPosH = mul(float4(vout.PosW, 1.0f), gViewProjTex);
+
+	return vout;
+}
+ 
 float4 PS(VertexOut pin, 
           uniform int gLightCount, 
 		  uniform bool gUseTexure, 
@@ -140,7 +198,17 @@ float4 PS(VertexOut pin,
 
 		// Only the first light casts a shadow.
 		float3 shadow = float3(1.0f, 1.0f, 1.0f);
-		shadow[0] = CalcShadowFactor(samShadow, gShadowMap, pin.ShadowPosH);
+		// SV_Position.w is the view space depth of the pixel.
+		if( gShadowCascadeCount > 0 )
+		{
+			shadow[0] = CalcCascadedShadowFactor(samShadow, gShadowCascadeMap, gShadowCascadeTransforms,
+				gShadowCascadeSplits, gShadowCascadeCount, pin.PosW, pin.PosH.w,
+				gShadowCascadeMapSize, SHADOW_FILTER);
+		}
+		else
+		{
+			shadow[0] = CalcShadowFactor(samShadow, gShadowMap, pin.ShadowPosH, gShadowMapSize, SHADOW_FILTER);
+		}
 
 		// Finish texture projection and sample SSAO map.
 		pin.SsaoPosH /= pin.SsaoPosH.w;
@@ -159,6 +227,18 @@ float4 PS(VertexOut pin,
 			spec    += shadow[i]*S;
 		}
 
+		// Point and spot lights of the pixel's cluster.  They cast no shadows.
+		if( gClusterLightCount > 0 )
+		{
+			float4 A, D, S;
+			ComputeClusteredLights(gMaterial, pin.PosH, pin.PosW, pin.NormalW, toEye,
+				A, D, S);
+
+			ambient += ambientAccess*A;
+			diffuse += D;
+			spec    += S;
+		}
+
 		litColor = texColor*(ambient + diffuse) + spec;
 
 		if( gReflectionEnabled )
@@ -189,442 +269,46 @@ float4 PS(VertexOut pin,
     return litColor;
 }
 
-technique11 Light1
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(1, false, false, false, false) ) );
-    }
-}
-
-technique11 Light2
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(2, false, false, false, false) ) );
-    }
-}
-
-technique11 Light3
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(3, false, false, false, false) ) );
-    }
-}
-
-technique11 Light0Tex
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(0, true, false, false, false) ) );
-    }
-}
-
-technique11 Light1Tex
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(1, true, false, false, false) ) );
-    }
-}
-
-technique11 Light2Tex
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(2, true, false, false, false) ) );
-    }
-}
-
-technique11 Light3Tex
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(3, true, false, false, false) ) );
-    }
-}
-
-technique11 Light0TexAlphaClip
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(0, true, true, false, false) ) );
-    }
-}
-
-technique11 Light1TexAlphaClip
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(1, true, true, false, false) ) );
-    }
-}
-
-technique11 Light2TexAlphaClip
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(2, true, true, false, false) ) );
-    }
-}
-
-technique11 Light3TexAlphaClip
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(3, true, true, false, false) ) );
-    }
-}
-
-technique11 Light1Fog
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(1, false, false, true, false) ) );
-    }
-}
-
-technique11 Light2Fog
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(2, false, false, true, false) ) );
-    }
-}
-
-technique11 Light3Fog
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(3, false, false, true, false) ) );
-    }
-}
-
-technique11 Light0TexFog
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(0, true, false, true, false) ) );
-    }
-}
-
-technique11 Light1TexFog
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(1, true, false, true, false) ) );
-    }
-}
-
-technique11 Light2TexFog
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(2, true, false, true, false) ) );
-    }
-}
-
-technique11 Light3TexFog
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(3, true, false, true, false) ) );
-    }
-}
-
-technique11 Light0TexAlphaClipFog
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(0, true, true, true, false) ) );
-    }
-}
-
-technique11 Light1TexAlphaClipFog
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(1, true, true, true, false) ) );
-    }
-}
-
-technique11 Light2TexAlphaClipFog
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(2, true, true, true, false) ) );
-    }
-}
-
-technique11 Light3TexAlphaClipFog
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(3, true, true, true, false) ) ); 
-    }
-}
-
-technique11 Light1Reflect
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(1, false, false, false, true) ) );
-    }
-}
-
-technique11 Light2Reflect
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(2, false, false, false, true) ) );
-    }
-}
-
-technique11 Light3Reflect
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(3, false, false, false, true) ) );
-    }
-}
-
-technique11 Light0TexReflect
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(0, true, false, false, true) ) );
-    }
-}
-
-technique11 Light1TexReflect
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(1, true, false, false, true) ) );
-    }
-}
-
-technique11 Light2TexReflect
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(2, true, false, false, true) ) );
-    }
-}
-
-technique11 Light3TexReflect
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(3, true, false, false, true) ) );
-    }
-}
-
-technique11 Light0TexAlphaClipReflect
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(0, true, true, false, true) ) );
-    }
-}
-
-technique11 Light1TexAlphaClipReflect
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(1, true, true, false, true) ) );
-    }
-}
+//
+// Feature switches, set by LitFeatures::Defines.  The file is compiled once for
+// each combination a scene asks for, and each permutation holds the one
+// technique below; see PermutationEffect in Effects.h.
+//
 
-technique11 Light2TexAlphaClipReflect
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(2, true, true, false, true) ) );
-    }
-}
+#ifndef LIT_LIGHT_COUNT
+#define LIT_LIGHT_COUNT 1
+#endif
 
-technique11 Light3TexAlphaClipReflect
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(3, true, true, false, true) ) );
-    }
-}
+#ifndef LIT_TEXTURE
+#define LIT_TEXTURE 0
+#endif
 
-technique11 Light1FogReflect
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(1, false, false, true, true) ) );
-    }
-}
+#ifndef LIT_ALPHA_CLIP
+#define LIT_ALPHA_CLIP 0
+#endif
 
-technique11 Light2FogReflect
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(2, false, false, true, true) ) );
-    }
-}
+#ifndef LIT_FOG
+#define LIT_FOG 0
+#endif
 
-technique11 Light3FogReflect
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(3, false, false, true, true) ) );
-    }
-}
+#ifndef LIT_REFLECTION
+#define LIT_REFLECTION 0
+#endif
 
-technique11 Light0TexFogReflect
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(0, true, false, true, true) ) );
-    }
-}
+#ifndef LIT_INSTANCED
+#define LIT_INSTANCED 0
+#endif
 
-technique11 Light1TexFogReflect
+technique11 Lit
 {
     pass P0
     {
+#if LIT_INSTANCED
+        SetVertexShader( CompileShader( vs_5_0, InstancedVS() ) );
+#else
         SetVertexShader( CompileShader( vs_5_0, VS() ) );
+#endif
 		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(1, true, false, true, true) ) );
+        SetPixelShader( CompileShader( ps_5_0, PS(LIT_LIGHT_COUNT, LIT_TEXTURE, LIT_ALPHA_CLIP, LIT_FOG, LIT_REFLECTION) ) );
     }
 }
-
-technique11 Light2TexFogReflect
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(2, true, false, true, true) ) );
-    }
-}
-
-technique11 Light3TexFogReflect
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(3, true, false, true, true) ) );
-    }
-}
-
-technique11 Light0TexAlphaClipFogReflect
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(0, true, true, true, true) ) );
-    }
-}
-
-technique11 Light1TexAlphaClipFogReflect
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(1, true, true, true, true) ) );
-    }
-}
-
-technique11 Light2TexAlphaClipFogReflect
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(2, true, true, true, true) ) );
-    }
-}
-
-technique11 Light3TexAlphaClipFogReflect
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(3, true, true, true, true) ) ); 
-    }
-}
\ No newline at end of file
@@ -9,15 +9,13 @@
 // geometry the eye sees.
 //=============================================================================
 
+#include "Tessellation.fx"
+
 cbuffer cbPerFrame
 {
+	// The eye the tessellation is chosen for, even though the pass draws from
+	// the light.
 	float3 gEyePosW;
-	
-	float gHeightScale;
-	float gMaxTessDistance;
-	float gMinTessDistance;
-	float gMinTessFactor;
-	float gMaxTessFactor;
 };
 
 cbuffer cbPerObject
@@ -68,7 +66,6 @@ struct TessVertexOut
 	float3 PosW       : POSITION;
 	float3 NormalW    : NORMAL;
 	float2 Tex        : TEXCOORD;
-	float  TessFactor : TESS;
 };
 
 TessVertexOut TessVS(VertexIn vin)
@@ -79,42 +76,15 @@ TessVertexOut TessVS(VertexIn vin)
 	vout.NormalW  = mul(vin.NormalL, (float3x3)gWorldInvTranspose);
 	vout.Tex      = mul(float4(vin.Tex, 0.0f, 1.0f), gTexTransform).xy;
 
-	float d = distance(vout.PosW, gEyePosW);
-
-	// Normalized tessellation factor. 
-	// The tessellation is 
-	//   0 if d >= gMinTessDistance and
-	//   1 if d <= gMaxTessDistance.  
-	float tess = saturate( (gMinTessDistance - d) / (gMinTessDistance - gMaxTessDistance) );
-	
-	// Rescale [0,1] --> [gMinTessFactor, gMaxTessFactor].
-	vout.TessFactor = gMinTessFactor + tess*(gMaxTessFactor-gMinTessFactor);
-
 	return vout;
 }
 
-struct PatchTess
-{
-	float EdgeTess[3] : SV_TessFactor;
-	float InsideTess  : SV_InsideTessFactor;
-};
-
 PatchTess PatchHS(InputPatch<TessVertexOut,3> patch, 
                   uint patchID : SV_PrimitiveID)
 {
-	PatchTess pt;
-	
-	// Average tess factors along edges, and pick an edge tess factor for 
-	// the interior tessellation.  It is important to do the tess factor
-	// calculation based on the edge properties so that edges shared by 
-	// more than one triangle will have the same tessellation factor.  
-	// Otherwise, gaps can appear.
-	pt.EdgeTess[0] = 0.5f*(patch[1].TessFactor + patch[2].TessFactor);
-	pt.EdgeTess[1] = 0.5f*(patch[2].TessFactor + patch[0].TessFactor);
-	pt.EdgeTess[2] = 0.5f*(patch[0].TessFactor + patch[1].TessFactor);
-	pt.InsideTess  = pt.EdgeTess[0];
-	
-	return pt;
+	// Patches outside the light's volume or facing away from the light get
+	// factors of zero and are not tessellated at all.
+	return CalcPatchTess(patch[0].PosW, patch[1].PosW, patch[2].PosW, gEyePosW);
 }
 
 struct HullOut
@@ -0,0 +1,82 @@
+//=============================================================================
+// ClusteredLights.fx
+//
+// Point and spot lights binned into clusters of the camera frustum by
+// ClusteredLighting (see LightClusters.h).  A pixel finds its cluster from its
+// screen position and view depth and only runs the lights of that cluster.
+// Include after LightHelper.fx.
+//=============================================================================
+
+cbuffer cbClusteredLights
+{
+	// Tiles across, tiles down and depth slices.
+	uint3  gClusterGrid;
+
+	// Lights numbered below this are point lights, the rest spot lights.
+	uint   gClusterPointLightCount;
+
+	// Tiles per pixel, across and down.
+	float2 gClusterTileScale;
+
+	// The slice of view depth z is log(z)*gClusterDepthScale + gClusterDepthBias.
+	float  gClusterDepthScale;
+	float  gClusterDepthBias;
+
+	// Point and spot lights together.  Zero skips the clustered lights.
+	uint   gClusterLightCount = 0;
+};
+
+// World space lights, as in LightHelper.fx.
+StructuredBuffer<PointLight> gClusterPointLights;
+StructuredBuffer<SpotLight>  gClusterSpotLights;
+
+// (offset, count) of each cluster's run of gClusterLightIndices.
+StructuredBuffer<uint2> gClusters;
+StructuredBuffer<uint>  gClusterLightIndices;
+
+// posH is the pixel's SV_Position: pixel coordinates, and w the view depth.
+// LightClusters::FindCluster does the same on the CPU.
+uint FindCluster(float4 posH)
+{
+	float2 tile = min(posH.xy*gClusterTileScale, float2(gClusterGrid.xy - 1));
+
+	float slice = log(posH.w)*gClusterDepthScale + gClusterDepthBias;
+	slice = clamp(slice, 0.0f, (float)(gClusterGrid.z - 1));
+
+	return ((uint)slice*gClusterGrid.y + (uint)tile.y)*gClusterGrid.x + (uint)tile.x;
+}
+
+// Sums the terms of the lights in the pixel's cluster.
+void ComputeClusteredLights(Material mat, float4 posH, float3 pos, float3 normal, float3 toEye,
+				   out float4 ambient, out float4 diffuse, out float4 spec)
+{
+	ambient = float4(0.0f, 0.0f, 0.0f, 0.0f);
+	diffuse = float4(0.0f, 0.0f, 0.0f, 0.0f);
+	spec    = float4(0.0f, 0.0f, 0.0f, 0.0f);
+
+	uint2 cluster = gClusters[FindCluster(posH)];
+
+	[loop]
+	for(uint i = 0; i < cluster.y; ++i)
+	{
+		uint light = gClusterLightIndices[cluster.x + i];
+
+		float4 A, D, S;
+
+		[branch]
+		if( light < gClusterPointLightCount )
+		{
+			ComputePointLight(mat, gClusterPointLights[light], pos, normal, toEye,
+				A, D, S);
+		}
+		else
+		{
+			ComputeSpotLight(mat, gClusterSpotLights[light - gClusterPointLightCount], pos, normal, toEye,
+				A, D, S);
+		}
+
+		ambient += A;
+		diffuse += D;
+		spec    += S;
+	}
+}
@@ -219,15 +219,109 @@ float3 NormalSampleToWorldSpace(float3 normalMapSample, float3 unitNormalW, floa
 }
 
 //---------------------------------------------------------------------------------------
-// Performs shadowmap test to determine if a pixel is in shadow.
+// Shadow filters.  Each is a set of comparison taps with weights; the sampler's
+// linear comparison filtering blends 2x2 texels per tap.  The filter is a
+// compile time choice, so each one is its own shader.
+//   1TAP    -- one tap.
+//   PCF3X3  -- 3x3 grid of taps one texel apart.
+//   PCF5X5  -- 5x5 tent filter in 9 taps, by placing each tap so the bilinear
+//              weights of the texels it covers match the tent's.
+//   POISSON -- 16 taps on a Poisson disk of POISSON_RADIUS texels.
+// ShadowFilterReference.cpp repeats the taps on the CPU; keep the two in step.
 //---------------------------------------------------------------------------------------
 
-static const float SMAP_SIZE = 2048.0f;
-static const float SMAP_DX = 1.0f / SMAP_SIZE;
+#define SHADOW_FILTER_1TAP    0
+#define SHADOW_FILTER_PCF3X3  1
+#define SHADOW_FILTER_PCF5X5  2
+#define SHADOW_FILTER_POISSON 3
+
+static const int MAX_SHADOW_TAPS = 16;
+
+static const float POISSON_RADIUS = 2.0f;
+
+static const float2 PoissonDisk[16] =
+{
+	float2(-0.94201624f, -0.39906216f), float2( 0.94558609f, -0.76890725f),
+	float2(-0.09418410f, -0.92938870f), float2( 0.34495938f,  0.29387760f),
+	float2(-0.91588581f,  0.45771432f), float2(-0.81544232f, -0.87912464f),
+	float2(-0.38277543f,  0.27676845f), float2( 0.97484398f,  0.75648379f),
+	float2( 0.44323325f, -0.97511554f), float2( 0.53742981f, -0.47373420f),
+	float2(-0.26496911f, -0.41893023f), float2( 0.79197514f,  0.19090188f),
+	float2(-0.24188840f,  0.99706507f), float2(-0.81409955f,  0.91437590f),
+	float2( 0.19984126f,  0.78641367f), float2( 0.14383161f, -0.14100790f)
+};
+
+// Fills taps with the texture coordinates (xy) and weights (z) of the filter
+// around uv and returns how many there are.  mapSize is (width, height,
+// 1/width, 1/height) of the shadow map.
+int ShadowFilterTaps(float2 uv, float4 mapSize, uniform int shadowFilter, out float3 taps[MAX_SHADOW_TAPS])
+{
+	[unroll]
+	for(int k = 0; k < MAX_SHADOW_TAPS; ++k)
+		taps[k] = float3(0.0f, 0.0f, 0.0f);
+
+	if( shadowFilter == SHADOW_FILTER_1TAP )
+	{
+		taps[0] = float3(uv, 1.0f);
+		return 1;
+	}
+
+	if( shadowFilter == SHADOW_FILTER_PCF3X3 )
+	{
+		[unroll]
+		for(int i = 0; i < 9; ++i)
+		{
+			float2 offset = float2(i % 3 - 1, i / 3 - 1);
+			taps[i] = float3(uv + offset*mapSize.zw, 1.0f / 9.0f);
+		}
+		return 9;
+	}
+
+	if( shadowFilter == SHADOW_FILTER_PCF5X5 )
+	{
+		// In texels, relative to the texel corner nearest to uv.
+		float2 texel = uv*mapSize.xy;
+		float2 baseTexel = floor(texel + 0.5f);
+		float2 st = texel + 0.5f - baseTexel;
+		float2 baseUV = (baseTexel - 0.5f)*mapSize.zw;
+
+		float2 w0 = 4.0f - 3.0f*st;
+		float2 w1 = float2(7.0f, 7.0f);
+		float2 w2 = 1.0f + 3.0f*st;
+
+		float2 o0 = (3.0f - 2.0f*st) / w0 - 2.0f;
+		float2 o1 = (3.0f + st) / w1;
+		float2 o2 = st / w2 + 2.0f;
+
+		float2 w[3] = { w0, w1, w2 };
+		float2 o[3] = { o0, o1, o2 };
+
+		[unroll]
+		for(int i = 0; i < 9; ++i)
+		{
+			int x = i % 3;
+			int y = i / 3;
+			taps[i] = float3(baseUV + float2(o[x].x, o[y].y)*mapSize.zw, w[x].x*w[y].y / 144.0f);
+		}
+		return 9;
+	}
+
+	[unroll]
+	for(int j = 0; j < 16; ++j)
+		taps[j] = float3(uv + POISSON_RADIUS*PoissonDisk[j]*mapSize.zw, 1.0f / 16.0f);
+
+	return 16;
+}
+
+//---------------------------------------------------------------------------------------
+// Performs shadowmap test to determine if a pixel is in shadow.
+//---------------------------------------------------------------------------------------
 
 float CalcShadowFactor(SamplerComparisonState samShadow, 
                        Texture2D shadowMap, 
-					   float4 shadowPosH)
+					   float4 shadowPosH,
+					   float4 mapSize,
+					   uniform int shadowFilter)
 {
 	// Complete projection by doing division by w.
 	shadowPosH.xyz /= shadowPosH.w;
@@ -235,23 +329,61 @@ float CalcShadowFactor(SamplerComparisonState samShadow,
 	// Depth in NDC space.
 	float depth = shadowPosH.z;
 
-	// Texel size.
-	const float dx = SMAP_DX;
+	float3 taps[MAX_SHADOW_TAPS];
+	int tapCount = ShadowFilterTaps(shadowPosH.xy, mapSize, shadowFilter, taps);
 
 	float percentLit = 0.0f;
-	const float2 offsets[9] = 
+
+	[unroll]
+	for(int i = 0; i < tapCount; ++i)
 	{
-		float2(-dx,  -dx), float2(0.0f,  -dx), float2(dx,  -dx),
-		float2(-dx, 0.0f), float2(0.0f, 0.0f), float2(dx, 0.0f),
-		float2(-dx,  +dx), float2(0.0f,  +dx), float2(dx,  +dx)
-	};
+		percentLit += taps[i].z*shadowMap.SampleCmpLevelZero(samShadow, 
+			taps[i].xy, depth).r;
+	}
+
+	return percentLit;
+}
+
+//---------------------------------------------------------------------------------------
+// Shadow test against a cascaded shadow map.  The pixel uses the first cascade
+// whose split distance is past its view depth; past the last one it is lit.
+// cascadeTransforms map world space to the texture space of each cascade.
+//---------------------------------------------------------------------------------------
+
+static const int MAX_CASCADES = 4;
+
+float CalcCascadedShadowFactor(SamplerComparisonState samShadow, 
+                               Texture2DArray shadowMap, 
+                               float4x4 cascadeTransforms[MAX_CASCADES],
+                               float4 cascadeSplits,
+                               int cascadeCount,
+                               float3 posW,
+                               float viewDepth,
+                               float4 mapSize,
+                               uniform int shadowFilter)
+{
+	// Number of splits the pixel is past.
+	int cascade = (int)dot((float4)(viewDepth > cascadeSplits), float4(1.0f, 1.0f, 1.0f, 1.0f));
+
+	if( cascade >= cascadeCount )
+		return 1.0f;
+
+	float4 shadowPosH = mul(float4(posW, 1.0f), cascadeTransforms[cascade]);
+
+	// Orthographic, so w is 1.
+	float depth = shadowPosH.z;
+
+	float3 taps[MAX_SHADOW_TAPS];
+	int tapCount = ShadowFilterTaps(shadowPosH.xy, mapSize, shadowFilter, taps);
+
+	float percentLit = 0.0f;
 
 	[unroll]
-	for(int i = 0; i < 9; ++i)
+	for(int i = 0; i < tapCount; ++i)
 	{
-		percentLit += shadowMap.SampleCmpLevelZero(samShadow, 
-			shadowPosH.xy + offsets[i], depth).r;
+		percentLit += taps[i].z*shadowMap.SampleCmpLevelZero(samShadow, 
+			float3(taps[i].xy, cascade), depth).r;
 	}
 
-	return percentLit /= 9.0f;
-}
\ No newline at end of file
+	return percentLit;
+}
@@ -3,6 +3,14 @@
 //=============================================================================
 
 #include "LightHelper.fx"
+#include "Tessellation.fx"
+#include "ClusteredLights.fx"
+
+// Shadow filter to compile with.  Effects::InitAll defines it for every
+// permutation.
+#ifndef SHADOW_FILTER
+#define SHADOW_FILTER SHADOW_FILTER_PCF3X3
+#endif
  
 cbuffer cbPerFrame
 {
@@ -12,6 +20,24 @@ cbuffer cbPerFrame
 	float  gFogStart;
 	float  gFogRange;
 	float4 gFogColor; 
+
+	// Used by the instanced techniques, which get the world matrices per instance.
+	// Their gShadowTransform maps from world space rather than object space.
+	float4x4 gViewProj;
+	float4x4 gViewProjTex;
+
+	// Cascaded shadows of the first light, used in place of gShadowMap when
+	// gShadowCascadeCount is above zero.  The transforms map world space to the
+	// texture space of each cascade; gShadowCascadeSplits holds the view depth
+	// where each cascade ends.
+	float4x4 gShadowCascadeTransforms[MAX_CASCADES];
+	float4   gShadowCascadeSplits;
+	int      gShadowCascadeCount = 0;
+
+	// (width, height, 1/width, 1/height) of gShadowMap and of each slice of
+	// gShadowCascadeMap.
+	float4   gShadowMapSize        = float4(2048.0f, 2048.0f, 1.0f/2048.0f, 1.0f/2048.0f);
+	float4   gShadowCascadeMapSize = float4(2048.0f, 2048.0f, 1.0f/2048.0f, 1.0f/2048.0f);
 };
 
 cbuffer cbPerObject
@@ -27,6 +53,7 @@ cbuffer cbPerObject
 
 // Nonnumeric values cannot be added to a cbuffer.
 Texture2D gShadowMap;
+Texture2DArray gShadowCascadeMap;
 Texture2D gDiffuseMap;
 Texture2D gNormalMap;
 Texture2D gSsaoMap;
@@ -94,6 +121,127 @@ VertexOut VS(VertexIn vin)
 	return vout;
 }
  
+struct InstancedVertexIn
+{
+	float3 PosL     : POSITION;
+	float3 NormalL  : NORMAL;
+	float2 Tex      : TEXCOORD;
+	float3 TangentL : TANGENT;
+	row_major float4x4 World             : WORLD;
+	row_major float4x4 WorldInvTranspose : WORLDINVTRANSPOSE;
+};
+
+VertexOut InstancedVS(InstancedVertexIn vin)
+{
+	VertexOut vout;
+	
+	// Transform to world space space.
+	vout.PosW     = mul(float4(vin.PosL, 1.0f), vin.World).xyz;
+	vout.NormalW  = mul(vin.NormalL, (float3x3)vin.WorldInvTranspose);
+	vout.TangentW = mul(vin.TangentL, (float3x3)vin.World);
+
+	// Transform to homogeneous clip space.
+	vout.PosH = mul(float4(vout.PosW, 1.0f), gViewProj);
+	
+	// Output vertex attributes for interpolation across triangle.
+	vout.Tex = mul(float4(vin.Tex, 0.0f, 1.0f), gTexTransform).xy;
+
+	// Generate projective tex-coords to project shadow map onto scene.
+	vout.ShadowPosH = mul(float4(vout.PosW, 1.0f), gShadowTransform);
+
+	// Generate projective tex-coords to project SSAO map onto scene.
+	vout.SsaoPosH = mul(float4(vout.PosW, 1.0f), gViewProjTex);
+
+	return vout;
+}
+ 
+//
+// Displacement mapped techniques, tessellated by Tessellation.fx.  Like the
+// instanced techniques they work in world space: gShadowTransform must map from
+// world space, and gViewProj and gViewProjTex take the place of the per-object
+// matrices.  The height map is the alpha channel of gNormalMap.
+//
+
+struct TessVertexOut
+{
+	float3 PosW     : POSITION;
+	float3 NormalW  : NORMAL;
+	float3 TangentW : TANGENT;
+	float2 Tex      : TEXCOORD;
+};
+
+TessVertexOut TessVS(VertexIn vin)
+{
+	TessVertexOut vout;
+
+	vout.PosW     = mul(float4(vin.PosL, 1.0f), gWorld).xyz;
+	vout.NormalW  = mul(vin.NormalL, (float3x3)gWorldInvTranspose);
+	vout.TangentW = mul(vin.TangentL, (float3x3)gWorld);
+	vout.Tex      = mul(float4(vin.Tex, 0.0f, 1.0f), gTexTransform).xy;
+
+	return vout;
+}
+
+PatchTess PatchHS(InputPatch<TessVertexOut,3> patch, 
+                  uint patchID : SV_PrimitiveID)
+{
+	// Patches outside the camera frustum or facing away from the eye get
+	// factors of zero and are not tessellated at all.
+	return CalcPatchTess(patch[0].PosW, patch[1].PosW, patch[2].PosW, gEyePosW);
+}
+
+[domain("tri")]
+[partitioning("fractional_odd")]
+[outputtopology("triangle_cw")]
+[outputcontrolpoints(3)]
+[patchconstantfunc("PatchHS")]
+TessVertexOut HS(InputPatch<TessVertexOut,3> p, 
+                 uint i : SV_OutputControlPointID,
+                 uint patchId : SV_PrimitiveID)
+{
+	// Pass through shader.
+	return p[i];
+}
+
+[domain("tri")]
+VertexOut DS(PatchTess patchTess, 
+             float3 bary : SV_DomainLocation, 
+             const OutputPatch<TessVertexOut,3> tri)
+{
+	VertexOut dout;
+
+	// Interpolate patch attributes to generated vertices.
+	dout.PosW     = bary.x*tri[0].PosW     + bary.y*tri[1].PosW     + bary.z*tri[2].PosW;
+	dout.NormalW  = bary.x*tri[0].NormalW  + bary.y*tri[1].NormalW  + bary.z*tri[2].NormalW;
+	dout.TangentW = bary.x*tri[0].TangentW + bary.y*tri[1].TangentW + bary.z*tri[2].TangentW;
+	dout.Tex      = bary.x*tri[0].Tex      + bary.y*tri[1].Tex      + bary.z*tri[2].Tex;
+
+	// Interpolating normal can unnormalize it, so normalize it.
+	dout.NormalW = normalize(dout.NormalW);
+
+	// Same mip choice as BuildShadowMap.fx, so the shadow pass displaces the
+	// surface to the same place.
+	const float MipInterval = 20.0f;
+	float mipLevel = clamp( (distance(dout.PosW, gEyePosW) - MipInterval) / MipInterval, 0.0f, 6.0f);
+
+	// Sample height map (stored in alpha channel).
+	float h = gNormalMap.SampleLevel(samLinear, dout.Tex, mipLevel).a;
+
+	// Offset vertex along normal.
+	dout.PosW += (gHeightScale*(h-1.0))*dout.NormalW;
+
+	// Project to homogeneous clip space.
+	dout.PosH = mul(float4(dout.PosW, 1.0f), gViewProj);
+
+	// Generate projective tex-coords to project shadow map onto scene.
+	dout.ShadowPosH = mul(float4(dout.PosW, 1.0f), gShadowTransform);
+
+	// Generate projective tex-coords to project SSAO map onto scene.
+	dout.SsaoPosH = mul(float4(dout.PosW, 1.0f), gViewProjTex);
+
+	return dout;
+}
+ 
 float4 PS(VertexOut pin, 
           uniform int gLightCount, 
 		  uniform bool gUseTexure, 
@@ -150,7 +298,17 @@ float4 PS(VertexOut pin,
 		  
 		// Only the first light casts a shadow.
 		float3 shadow = float3(1.0f, 1.0f, 1.0f);
-		shadow[0] = CalcShadowFactor(samShadow, gShadowMap, pin.ShadowPosH);
+		// SV_Position.w is the view space depth of the pixel.
+		if( gShadowCascadeCount > 0 )
+		{
+			shadow[0] = CalcCascadedShadowFactor(samShadow, gShadowCascadeMap, gShadowCascadeTransforms,
+				gShadowCascadeSplits, gShadowCascadeCount, pin.PosW, pin.PosH.w,
+				gShadowCascadeMapSize, SHADOW_FILTER);
+		}
+		else
+		{
+			shadow[0] = CalcShadowFactor(samShadow, gShadowMap, pin.ShadowPosH, gShadowMapSize, SHADOW_FILTER);
+		}
 
 		// Finish texture projection and sample SSAO map.
 		pin.SsaoPosH /= pin.SsaoPosH.w;
@@ -168,7 +326,19 @@ float4 PS(VertexOut pin,
 			diffuse += shadow[i]*D;
 			spec    += shadow[i]*S;
 		}
-		   
+
+		// Point and spot lights of the pixel's cluster.  They cast no shadows.
+		if( gClusterLightCount > 0 )
+		{
+			float4 A, D, S;
+			ComputeClusteredLights(gMaterial, pin.PosH, pin.PosW, bumpedNormalW, toEye,
+				A, D, S);
+
+			ambient += ambientAccess*A;
+			diffuse += D;
+			spec    += S;
+		}
+
 		litColor = texColor*(ambient + diffuse) + spec;
 		  
 		if( gReflectionEnabled )
@@ -199,442 +369,58 @@ float4 PS(VertexOut pin,
     return litColor;
 }
 
-technique11 Light1
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(1, false, false, false, false) ) );
-    }
-}
-
-technique11 Light2
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(2, false, false, false, false) ) );
-    }
-}
-
-technique11 Light3
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(3, false, false, false, false) ) );
-    }
-}
-
-technique11 Light0Tex
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(0, true, false, false, false) ) );
-    }
-}
-
-technique11 Light1Tex
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(1, true, false, false, false) ) );
-    }
-}
+//
+// Feature switches, set by LitFeatures::Defines.  The file is compiled once for
+// each combination a scene asks for, and each permutation holds the one
+// technique below; see PermutationEffect in Effects.h.
+//
 
-technique11 Light2Tex
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(2, true, false, false, false) ) );
-    }
-}
+#ifndef LIT_LIGHT_COUNT
+#define LIT_LIGHT_COUNT 1
+#endif
 
-technique11 Light3Tex
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(3, true, false, false, false) ) );
-    }
-}
+#ifndef LIT_TEXTURE
+#define LIT_TEXTURE 0
+#endif
 
-technique11 Light0TexAlphaClip
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(0, true, true, false, false) ) );
-    }
-}
+#ifndef LIT_ALPHA_CLIP
+#define LIT_ALPHA_CLIP 0
+#endif
 
-technique11 Light1TexAlphaClip
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(1, true, true, false, false) ) );
-    }
-}
+#ifndef LIT_FOG
+#define LIT_FOG 0
+#endif
 
-technique11 Light2TexAlphaClip
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(2, true, true, false, false) ) );
-    }
-}
+#ifndef LIT_REFLECTION
+#define LIT_REFLECTION 0
+#endif
 
-technique11 Light3TexAlphaClip
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(3, true, true, false, false) ) );
-    }
-}
+#ifndef LIT_INSTANCED
+#define LIT_INSTANCED 0
+#endif
 
-technique11 Light1Fog
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(1, false, false, true, false) ) );
-    }
-}
-
-technique11 Light2Fog
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(2, false, false, true, false) ) );
-    }
-}
-
-technique11 Light3Fog
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(3, false, false, true, false) ) );
-    }
-}
-
-technique11 Light0TexFog
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(0, true, false, true, false) ) );
-    }
-}
+#ifndef LIT_TESSELLATED
+#define LIT_TESSELLATED 0
+#endif
 
-technique11 Light1TexFog
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(1, true, false, true, false) ) );
-    }
-}
+#if LIT_TESSELLATED && LIT_INSTANCED
+#error The tessellated techniques are not instanced.
+#endif
 
-technique11 Light2TexFog
+technique11 Lit
 {
     pass P0
     {
+#if LIT_TESSELLATED
+        SetVertexShader( CompileShader( vs_5_0, TessVS() ) );
+        SetHullShader( CompileShader( hs_5_0, HS() ) );
+        SetDomainShader( CompileShader( ds_5_0, DS() ) );
+#elif LIT_INSTANCED
+        SetVertexShader( CompileShader( vs_5_0, InstancedVS() ) );
+#else
         SetVertexShader( CompileShader( vs_5_0, VS() ) );
+#endif
 		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(2, true, false, true, false) ) );
+        SetPixelShader( CompileShader( ps_5_0, PS(LIT_LIGHT_COUNT, LIT_TEXTURE, LIT_ALPHA_CLIP, LIT_FOG, LIT_REFLECTION) ) );
     }
 }
-
-technique11 Light3TexFog
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(3, true, false, true, false) ) );
-    }
-}
-
-technique11 Light0TexAlphaClipFog
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(0, true, true, true, false) ) );
-    }
-}
-
-technique11 Light1TexAlphaClipFog
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(1, true, true, true, false) ) );
-    }
-}
-
-technique11 Light2TexAlphaClipFog
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(2, true, true, true, false) ) );
-    }
-}
-
-technique11 Light3TexAlphaClipFog
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(3, true, true, true, false) ) ); 
-    }
-}
-
-technique11 Light1Reflect
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(1, false, false, false, true) ) );
-    }
-}
-
-technique11 Light2Reflect
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(2, false, false, false, true) ) );
-    }
-}
-
-technique11 Light3Reflect
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(3, false, false, false, true) ) );
-    }
-}
-
-technique11 Light0TexReflect
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(0, true, false, false, true) ) );
-    }
-}
-
-technique11 Light1TexReflect
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(1, true, false, false, true) ) );
-    }
-}
-
-technique11 Light2TexReflect
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(2, true, false, false, true) ) );
-    }
-}
-
-technique11 Light3TexReflect
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(3, true, false, false, true) ) );
-    }
-}
-
-technique11 Light0TexAlphaClipReflect
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(0, true, true, false, true) ) );
-    }
-}
-
-technique11 Light1TexAlphaClipReflect
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(1, true, true, false, true) ) );
-    }
-}
-
-technique11 Light2TexAlphaClipReflect
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(2, true, true, false, true) ) );
-    }
-}
-
-technique11 Light3TexAlphaClipReflect
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(3, true, true, false, true) ) );
-    }
-}
-
-technique11 Light1FogReflect
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(1, false, false, true, true) ) );
-    }
-}
-
-technique11 Light2FogReflect
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(2, false, false, true, true) ) );
-    }
-}
-
-technique11 Light3FogReflect
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(3, false, false, true, true) ) );
-    }
-}
-
-technique11 Light0TexFogReflect
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(0, true, false, true, true) ) );
-    }
-}
-
-technique11 Light1TexFogReflect
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(1, true, false, true, true) ) );
-    }
-}
-
-technique11 Light2TexFogReflect
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(2, true, false, true, true) ) );
-    }
-}
-
-technique11 Light3TexFogReflect
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(3, true, false, true, true) ) );
-    }
-}
-
-technique11 Light0TexAlphaClipFogReflect
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(0, true, true, true, true) ) );
-    }
-}
-
-technique11 Light1TexAlphaClipFogReflect
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(1, true, true, true, true) ) );
-    }
-}
-
-technique11 Light2TexAlphaClipFogReflect
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(2, true, true, true, true) ) );
-    }
-}
-
-technique11 Light3TexAlphaClipFogReflect
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_5_0, VS() ) );
-		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(3, true, true, true, true) ) ); 
-    }
-}
\ No newline at end of file
@@ -7,7 +7,7 @@
 cbuffer cbPerFrame
 {
 	float4x4 gViewToTexSpace; // Proj*Texture
-	float4   gOffsetVectors[14];
+	float4   gOffsetVectors[32];
 	float4   gFrustumCorners[4];
 
 	// Coordinates given in view space.
@@ -15,6 +15,13 @@ cbuffer cbPerFrame
 	float    gOcclusionFadeStart = 0.2f;
 	float    gOcclusionFadeEnd   = 2.0f;
 	float    gSurfaceEpsilon     = 0.05f;
+
+	// Number of offset vectors, from 4 to 32.
+	int      gSampleCount        = 14;
+
+	// Offset vector the first sample uses in the temporal mode, which takes 4
+	// samples a frame.  It advances every frame so the history sees all of them.
+	int      gFirstSample        = 0;
 };
  
 // Nonnumeric values cannot be added to a cbuffer.
@@ -105,7 +112,7 @@ float OcclusionFunction(float distZ)
 	return occlusion;	
 }
 
-float4 PS(VertexOut pin, uniform int gSampleCount) : SV_Target
+float4 PS(VertexOut pin, uniform bool gTemporal) : SV_Target
 {
 	// p -- the point we are computing the ambient occlusion for.
 	// n -- normal vector at p.
@@ -131,15 +138,18 @@ float4 PS(VertexOut pin, uniform int gSampleCount) : SV_Target
 	float3 randVec = 2.0f*gRandomVecMap.SampleLevel(samRandomVec, 4.0f*pin.Tex, 0.0f).rgb - 1.0f;
 
 	float occlusionSum = 0.0f;
+
+	int sampleCount = gTemporal ? 4 : gSampleCount;
 	
 	// Sample neighboring points about p in the hemisphere oriented by n.
-	[unroll]
-	for(int i = 0; i < gSampleCount; ++i)
+	[loop]
+	for(int i = 0; i < sampleCount; ++i)
 	{
 		// Are offset vectors are fixed and uniformly distributed (so that our offset vectors
 		// do not clump in the same direction).  If we reflect them about a random vector
 		// then we get a random uniform distribution of offset vectors.
-		float3 offset = reflect(gOffsetVectors[i].xyz, randVec);
+		int k = gTemporal ? (gFirstSample + i) % gSampleCount : i;
+		float3 offset = reflect(gOffsetVectors[k].xyz, randVec);
 	
 		// Flip offset vector if it is behind the plane defined by (p, n).
 		float flip = sign( dot(offset, n) );
@@ -182,7 +192,7 @@ float4 PS(VertexOut pin, uniform int gSampleCount) : SV_Target
 		occlusionSum += occlusion;
 	}
 	
-	occlusionSum /= gSampleCount;
+	occlusionSum /= sampleCount;
 	
 	float access = 1.0f - occlusionSum;
 
@@ -196,7 +206,16 @@ technique11 Ssao
     {
 		SetVertexShader( CompileShader( vs_5_0, VS() ) );
 		SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_5_0, PS(14) ) );
+        SetPixelShader( CompileShader( ps_5_0, PS(false) ) );
+    }
+}
+
+technique11 SsaoTemporal
+{
+    pass P0
+    {
+		SetVertexShader( CompileShader( vs_5_0, VS() ) );
+		SetGeometryShader( NULL );
+        SetPixelShader( CompileShader( ps_5_0, PS(true) ) );
     }
 }
- 
\ No newline at end of file
@@ -13,6 +13,10 @@ cbuffer cbPerFrame
 {
 	float gTexelWidth;
 	float gTexelHeight;
+
+	// Taps on each side, up to gMaxBlurRadius.  Smaller radii use the middle
+	// of gWeights.
+	int   gBlurRadius = 5;
 };
 
 cbuffer cbSettings
@@ -25,7 +29,7 @@ cbuffer cbSettings
 
 cbuffer cbFixed
 {
-	static const int gBlurRadius = 5;
+	static const int gMaxBlurRadius = 5;
 };
  
 // Nonnumeric values cannot be added to a cbuffer.
@@ -88,8 +92,8 @@ float4 PS(VertexOut pin, uniform bool gHorizontalBlur) : SV_Target
 	}
 
 	// The center value always contributes to the sum.
-	float4 color      = gWeights[5]*gInputImage.SampleLevel(samInputImage, pin.Tex, 0.0);
-	float totalWeight = gWeights[5];
+	float4 color      = gWeights[gMaxBlurRadius]*gInputImage.SampleLevel(samInputImage, pin.Tex, 0.0);
+	float totalWeight = gWeights[gMaxBlurRadius];
 	 
 	float4 centerNormalDepth = gNormalDepthMap.SampleLevel(samNormalDepth, pin.Tex, 0.0f);
 
@@ -113,7 +117,7 @@ float4 PS(VertexOut pin, uniform bool gHorizontalBlur) : SV_Target
 		if( dot(neighborNormalDepth.xyz, centerNormalDepth.xyz) >= 0.8f &&
 		    abs(neighborNormalDepth.a - centerNormalDepth.a) <= 0.2f )
 		{
-			float weight = gWeights[i+gBlurRadius];
+			float weight = gWeights[i+gMaxBlurRadius];
 
 			// Add neighbor pixel to blur.
 			color += weight*gInputImage.SampleLevel(
@@ -0,0 +1,272 @@
+//=============================================================================
+// SsaoBlurCS.fx
+//
+// The bilateral edge preserving blur of SsaoBlur.fx as compute shaders.  Each
+// group reads the ambient and normal/depth texels of its tile, plus an apron of
+// gMaxBlurRadius texels, into groupshared memory once, and every tap of the blur
+// reads from there.
+//
+// HorzBlurCS and VertBlurCS do one pass each over a 256 texel row or column.
+// BlurCS does a horizontal and a vertical pass in one dispatch: it blurs the
+// rows of a 16x16 tile and its apron into groupshared memory and blurs the
+// columns of that.  The horizontal result is not rounded to the 16-bit ambient
+// format in between, so it differs from two separate passes in the last bits.
+//
+// The normal/depth map is gResolutionScale times the size of the ambient map.
+// As with the linear sampler of the pixel shader, a texel of the ambient map
+// uses the average of the 2x2 normal/depth texels around its center, or the
+// one texel at full resolution.  Reads past the edges are clamped, as with
+// CLAMP addressing.
+//
+// SsaoBlurReference.cpp does the same on the CPU; keep the two in step.
+//=============================================================================
+
+cbuffer cbPerFrame
+{
+	// Taps on each side, up to gMaxBlurRadius.  Smaller radii use the middle
+	// of gWeights.
+	int gBlurRadius = 5;
+
+	// Size of the normal/depth map over the size of the ambient map: 1, 2 or 4.
+	int gResolutionScale = 2;
+};
+
+cbuffer cbSettings
+{
+	float gWeights[11] =
+	{
+		0.05f, 0.05f, 0.1f, 0.1f, 0.1f, 0.2f, 0.1f, 0.1f, 0.1f, 0.05f, 0.05f
+	};
+};
+
+cbuffer cbFixed
+{
+	static const int gMaxBlurRadius = 5;
+};
+
+// Nonnumeric values cannot be added to a cbuffer.
+Texture2D gNormalDepthMap;
+Texture2D gInputImage;
+
+RWTexture2D<float> gOutputImage;
+
+// Threads per group of the single pass kernels.
+#define N 256
+#define CacheSize (N + 2*gMaxBlurRadius)
+
+// Tile of the fused kernel.
+#define TileSize 16
+#define TileCacheSize (TileSize + 2*gMaxBlurRadius)
+
+groupshared float  gAmbientCache[TileCacheSize*TileCacheSize];
+groupshared float4 gNormalDepthCache[TileCacheSize*TileCacheSize];
+groupshared float  gHorzCache[TileCacheSize*TileSize];
+
+int2 ClampTexel(int2 texel, int2 size)
+{
+	return clamp(texel, int2(0, 0), size - 1);
+}
+
+// Normal and depth at an ambient map texel.
+float4 LoadNormalDepth(int2 texel)
+{
+	if( gResolutionScale == 1 )
+		return gNormalDepthMap.Load(int3(texel, 0));
+
+	int3 t = int3(gResolutionScale*texel + gResolutionScale/2 - 1, 0);
+
+	float4 sum = gNormalDepthMap.Load(t);
+	sum += gNormalDepthMap.Load(t + int3(1, 0, 0));
+	sum += gNormalDepthMap.Load(t + int3(0, 1, 0));
+	sum += gNormalDepthMap.Load(t + int3(1, 1, 0));
+
+	return 0.25f*sum;
+}
+
+// Adds the neighbor to the blur if it is on the same surface as the center.
+// If the center value and neighbor values differ too much (either in normal or
+// depth), then we assume we are sampling across a discontinuity and skip it.
+void AddTap(float4 centerNormalDepth, float4 neighborNormalDepth, float neighborAmbient, float weight,
+	inout float color, inout float totalWeight)
+{
+	if( dot(neighborNormalDepth.xyz, centerNormalDepth.xyz) >= 0.8f &&
+	    abs(neighborNormalDepth.a - centerNormalDepth.a) <= 0.2f )
+	{
+		color += weight*neighborAmbient;
+		totalWeight += weight;
+	}
+}
+
+int2 ImageSize()
+{
+	uint width, height;
+	gOutputImage.GetDimensions(width, height);
+	return int2(width, height);
+}
+
+//
+// Single passes.  Thread i of the group caches texel i of the row (or column),
+// and the first and last gMaxBlurRadius threads also cache the apron.
+//
+
+groupshared float  gLineAmbient[CacheSize];
+groupshared float4 gLineNormalDepth[CacheSize];
+
+void CacheLineTexel(int cacheIndex, int2 texel, int2 size)
+{
+	texel = ClampTexel(texel, size);
+
+	gLineAmbient[cacheIndex]     = gInputImage[texel].r;
+	gLineNormalDepth[cacheIndex] = LoadNormalDepth(texel);
+}
+
+void BlurLine(int groupThreadIndex, int2 texel, int2 step, int2 size)
+{
+	if(groupThreadIndex < gMaxBlurRadius)
+		CacheLineTexel(groupThreadIndex, texel - gMaxBlurRadius*step, size);
+
+	if(groupThreadIndex >= N-gMaxBlurRadius)
+		CacheLineTexel(groupThreadIndex + 2*gMaxBlurRadius, texel + gMaxBlurRadius*step, size);
+
+	CacheLineTexel(groupThreadIndex + gMaxBlurRadius, texel, size);
+
+	// Wait for all threads to finish.
+	GroupMemoryBarrierWithGroupSync();
+
+	if( any(texel >= size) )
+		return;
+
+	int c = groupThreadIndex + gMaxBlurRadius;
+
+	// The center value always contributes to the sum.
+	float color       = gWeights[gMaxBlurRadius]*gLineAmbient[c];
+	float totalWeight = gWeights[gMaxBlurRadius];
+
+	[loop]
+	for(int i = -gBlurRadius; i <= gBlurRadius; ++i)
+	{
+		// We already added in the center weight.
+		if( i == 0 )
+			continue;
+
+		AddTap(gLineNormalDepth[c], gLineNormalDepth[c+i], gLineAmbient[c+i], gWeights[i+gMaxBlurRadius],
+			color, totalWeight);
+	}
+
+	// Compensate for discarded samples by making total weights sum to 1.
+	gOutputImage[texel] = color / totalWeight;
+}
+
+[numthreads(N, 1, 1)]
+void HorzBlurCS(int3 groupThreadID : SV_GroupThreadID,
+				int3 dispatchThreadID : SV_DispatchThreadID)
+{
+	BlurLine(groupThreadID.x, dispatchThreadID.xy, int2(1, 0), ImageSize());
+}
+
+[numthreads(1, N, 1)]
+void VertBlurCS(int3 groupThreadID : SV_GroupThreadID,
+				int3 dispatchThreadID : SV_DispatchThreadID)
+{
+	BlurLine(groupThreadID.y, dispatchThreadID.xy, int2(0, 1), ImageSize());
+}
+
+//
+// Both passes in one dispatch.
+//
+
+[numthreads(TileSize, TileSize, 1)]
+void BlurCS(int3 groupThreadID : SV_GroupThreadID,
+			int3 dispatchThreadID : SV_DispatchThreadID)
+{
+	int2 size = ImageSize();
+	int2 cacheOrigin = dispatchThreadID.xy - groupThreadID.xy - gMaxBlurRadius;
+	int threadIndex = groupThreadID.y*TileSize + groupThreadID.x;
+
+	// Cache the tile and its apron.  Each thread reads several texels.
+	for(int i = threadIndex; i < TileCacheSize*TileCacheSize; i += TileSize*TileSize)
+	{
+		int2 texel = ClampTexel(cacheOrigin + int2(i % TileCacheSize, i / TileCacheSize), size);
+
+		gAmbientCache[i]     = gInputImage[texel].r;
+		gNormalDepthCache[i] = LoadNormalDepth(texel);
+	}
+
+	GroupMemoryBarrierWithGroupSync();
+
+	// Blur the rows of the tile's columns, apron rows included.
+	for(int j = threadIndex; j < TileCacheSize*TileSize; j += TileSize*TileSize)
+	{
+		int row = j / TileSize;
+		int c = row*TileCacheSize + (j % TileSize) + gMaxBlurRadius;
+
+		float color       = gWeights[gMaxBlurRadius]*gAmbientCache[c];
+		float totalWeight = gWeights[gMaxBlurRadius];
+
+		[loop]
+		for(int k = -gBlurRadius; k <= gBlurRadius; ++k)
+		{
+			if( k == 0 )
+				continue;
+
+			AddTap(gNormalDepthCache[c], gNormalDepthCache[c+k], gAmbientCache[c+k], gWeights[k+gMaxBlurRadius],
+				color, totalWeight);
+		}
+
+		gHorzCache[j] = color / totalWeight;
+	}
+
+	GroupMemoryBarrierWithGroupSync();
+
+	if( any(dispatchThreadID.xy >= size) )
+		return;
+
+	// Blur the column of the horizontal result.
+	int h = (groupThreadID.y + gMaxBlurRadius)*TileSize + groupThreadID.x;
+	int c = (groupThreadID.y + gMaxBlurRadius)*TileCacheSize + groupThreadID.x + gMaxBlurRadius;
+
+	float color       = gWeights[gMaxBlurRadius]*gHorzCache[h];
+	float totalWeight = gWeights[gMaxBlurRadius];
+
+	[loop]
+	for(int k = -gBlurRadius; k <= gBlurRadius; ++k)
+	{
+		if( k == 0 )
+			continue;
+
+		AddTap(gNormalDepthCache[c], gNormalDepthCache[c + k*TileCacheSize], gHorzCache[h + k*TileSize],
+			gWeights[k+gMaxBlurRadius], color, totalWeight);
+	}
+
+	gOutputImage[dispatchThreadID.xy] = color / totalWeight;
+}
+
+technique11 HorzBlur
+{
+    pass P0
+    {
+		SetVertexShader( NULL );
+		SetPixelShader( NULL );
+		SetComputeShader( CompileShader( cs_5_0, HorzBlurCS() ) );
+    }
+}
+
+technique11 VertBlur
+{
+    pass P0
+    {
+		SetVertexShader( NULL );
+		SetPixelShader( NULL );
+		SetComputeShader( CompileShader( cs_5_0, VertBlurCS() ) );
+    }
+}
+
+technique11 Blur
+{
+    pass P0
+    {
+		SetVertexShader( NULL );
+		SetPixelShader( NULL );
+		SetComputeShader( CompileShader( cs_5_0, BlurCS() ) );
+    }
+}
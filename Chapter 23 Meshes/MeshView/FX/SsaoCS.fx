@@ -0,0 +1,188 @@
+//=============================================================================
+// SsaoCS.fx
+//
+// Computes the SSAO map with a compute shader.  The algorithm is the one in
+// Ssao.fx, except that the normal/depth map is point sampled at the resolution
+// of the ambient map, which is 1/gResolutionScale of the normal/depth map.
+// That way every depth a group looks up near its own tile can be read once
+// into groupshared memory and shared by all its threads.
+//
+// SsaoReference.cpp does the same steps in the same order on the CPU; keep the
+// two in step.
+//=============================================================================
+
+cbuffer cbPerFrame
+{
+	float4x4 gViewToTexSpace; // Proj*Texture
+	float4   gOffsetVectors[32];
+	float4   gFrustumCorners[4];
+
+	// Coordinates given in view space.
+	float    gOcclusionRadius    = 0.5f;
+	float    gOcclusionFadeStart = 0.2f;
+	float    gOcclusionFadeEnd   = 2.0f;
+	float    gSurfaceEpsilon     = 0.05f;
+
+	// Number of offset vectors, from 4 to 32.
+	int      gSampleCount        = 14;
+
+	// Size of the normal/depth map over the size of the ambient map: 1, 2 or 4.
+	int      gResolutionScale    = 2;
+};
+
+// Nonnumeric values cannot be added to a cbuffer.
+Texture2D gNormalDepthMap;
+Texture2D gRandomVecMap;
+
+RWTexture2D<float> gAmbientMap;
+
+// Threads per group in x and y; one per ambient map texel.
+#define N 16
+
+// Texels cached beyond each side of the group's tile.  Lookups that land
+// further out read the normal/depth map directly.
+#define Apron 16
+#define CacheSize (N + 2*Apron)
+
+// Same as the border color of the pixel shader's sampler, so there are no false
+// occlusions from outside the map.
+#define FarDepth 1e5f
+
+groupshared float gDepthCache[CacheSize*CacheSize];
+
+// Normal and depth at an ambient map texel.
+float4 LoadNormalDepth(int2 texel, int2 size)
+{
+	if( any(texel < 0) || any(texel >= size) )
+		return float4(0.0f, 0.0f, 0.0f, FarDepth);
+
+	return gNormalDepthMap.Load(int3(gResolutionScale*texel, 0));
+}
+
+// Determines how much the sample point q occludes the point p as a function
+// of distZ.  See Ssao.fx.
+float OcclusionFunction(float distZ)
+{
+	float occlusion = 0.0f;
+	if(distZ > gSurfaceEpsilon)
+	{
+		float fadeLength = gOcclusionFadeEnd - gOcclusionFadeStart;
+
+		// Linearly decrease occlusion from 1 to 0 as distZ goes
+		// from gOcclusionFadeStart to gOcclusionFadeEnd.
+		occlusion = saturate( (gOcclusionFadeEnd-distZ)/fadeLength );
+	}
+
+	return occlusion;
+}
+
+[numthreads(N, N, 1)]
+void CS(int3 groupThreadID : SV_GroupThreadID,
+		int3 dispatchThreadID : SV_DispatchThreadID)
+{
+	uint width, height;
+	gAmbientMap.GetDimensions(width, height);
+	int2 size = int2(width, height);
+
+	//
+	// Cache the depths of the tile and its apron.  Each thread reads several.
+	//
+
+	int2 cacheOrigin = dispatchThreadID.xy - groupThreadID.xy - Apron;
+
+	for(int i = groupThreadID.y*N + groupThreadID.x; i < CacheSize*CacheSize; i += N*N)
+	{
+		int2 cacheTexel = int2(i % CacheSize, i / CacheSize);
+		gDepthCache[i] = LoadNormalDepth(cacheOrigin + cacheTexel, size).w;
+	}
+
+	// Wait for all threads to finish.
+	GroupMemoryBarrierWithGroupSync();
+
+	int2 texel = dispatchThreadID.xy;
+	if( texel.x >= size.x || texel.y >= size.y )
+		return;
+
+	// p -- the point we are computing the ambient occlusion for.
+	// n -- normal vector at p.
+	// q -- a random offset from p.
+	// r -- a potential occluder that might occlude p.
+
+	float4 normalDepth = LoadNormalDepth(texel, size);
+
+	float3 n = normalDepth.xyz;
+	float pz = normalDepth.w;
+
+	// The vector to the far plane the pixel shader gets interpolated from the
+	// frustum corners of the full screen quad.
+	float2 tex = (float2(texel) + 0.5f) / float2(size);
+
+	float3 toFarPlane;
+	toFarPlane.x = gFrustumCorners[0].x + (gFrustumCorners[2].x - gFrustumCorners[0].x)*tex.x;
+	toFarPlane.y = gFrustumCorners[1].y + (gFrustumCorners[0].y - gFrustumCorners[1].y)*tex.y;
+	toFarPlane.z = gFrustumCorners[0].z;
+
+	float3 p = (pz/toFarPlane.z)*toFarPlane;
+
+	// The random vector map is tiled 4 times across the screen, as in the pixel
+	// shader, but read at the nearest texel.  Map from [0,1] --> [-1, +1].
+	int2 randTexel = ((texel*1024 + 512) / size) & 255;
+	float3 randVec = 2.0f*gRandomVecMap.Load(int3(randTexel, 0)).rgb - 1.0f;
+
+	float occlusionSum = 0.0f;
+
+	[loop]
+	for(int j = 0; j < gSampleCount; ++j)
+	{
+		float3 offset = reflect(gOffsetVectors[j].xyz, randVec);
+
+		// Flip offset vector if it is behind the plane defined by (p, n).
+		float flip = sign( dot(offset, n) );
+
+		// Sample a point near p within the occlusion radius.
+		float3 q = p + flip * gOcclusionRadius * offset;
+
+		// Project q and generate projective tex-coords.
+		float4 projQ = mul(float4(q, 1.0f), gViewToTexSpace);
+		projQ /= projQ.w;
+
+		// Nearest depth along the ray from the eye to q.  Clamping keeps the
+		// conversion to int defined; anything outside [0,1] is off the map anyway.
+		int2 rTexel = int2(floor(clamp(projQ.xy, -1.0f, 2.0f)*float2(size)));
+		int2 cacheTexel = rTexel - cacheOrigin;
+
+		float rz;
+		if( all(cacheTexel >= 0) && all(cacheTexel < CacheSize) )
+			rz = gDepthCache[cacheTexel.y*CacheSize + cacheTexel.x];
+		else
+			rz = LoadNormalDepth(rTexel, size).w;
+
+		// Reconstruct full view space position r = (rx,ry,rz).
+		float3 r = (rz / q.z) * q;
+
+		float distZ = p.z - r.z;
+		float dp = max(dot(n, normalize(r - p)), 0.0f);
+		float occlusion = dp * OcclusionFunction(distZ);
+
+		occlusionSum += occlusion;
+	}
+
+	occlusionSum /= gSampleCount;
+
+	float access = 1.0f - occlusionSum;
+
+	// Sharpen the contrast of the SSAO map to make the SSAO affect more dramatic.
+	// access^4 as two products, which the reference can repeat exactly.
+	float access2 = access*access;
+	gAmbientMap[texel] = saturate(access2*access2);
+}
+
+technique11 Ssao
+{
+    pass P0
+    {
+		SetVertexShader( NULL );
+		SetPixelShader( NULL );
+		SetComputeShader( CompileShader( cs_5_0, CS() ) );
+    }
+}
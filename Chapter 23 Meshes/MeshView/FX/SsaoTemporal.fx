@@ -0,0 +1,130 @@
+//=============================================================================
+// SsaoTemporal.fx
+//
+// Accumulates the ambient map over frames.  Each pixel is reprojected into the
+// previous frame with the previous view and projection, and the history found
+// there is blended with the few samples taken this frame.  The history is
+// dropped where the previous frame saw a different surface: off the screen, or
+// where its depth or normal does not match the reprojected point.
+//
+// SsaoTemporalReference.cpp does the reprojection on the CPU; keep the two in
+// step.
+//=============================================================================
+
+cbuffer cbPerFrame
+{
+	float4x4 gViewToPrevView;  // InvView*PrevView
+	float4x4 gPrevViewToTex;   // PrevProj*Texture
+	float4   gFrustumCorners[4];
+
+	// Weight of the history; 0 when there is none.
+	float    gHistoryWeight   = 0.8f;
+
+	// Largest depth difference, as a fraction of the depth, and smallest normal
+	// dot product for the history to count as the same surface.
+	float    gDepthTolerance  = 0.05f;
+	float    gNormalThreshold = 0.9f;
+};
+
+// Nonnumeric values cannot be added to a cbuffer.
+Texture2D gNormalDepthMap;
+Texture2D gPrevNormalDepthMap;
+Texture2D gCurrentAmbientMap;
+Texture2D gHistoryMap;
+
+SamplerState samPoint
+{
+	Filter = MIN_MAG_MIP_POINT;
+
+	AddressU = CLAMP;
+	AddressV = CLAMP;
+};
+
+SamplerState samLinear
+{
+	Filter = MIN_MAG_LINEAR_MIP_POINT;
+
+	AddressU = CLAMP;
+	AddressV = CLAMP;
+};
+
+struct VertexIn
+{
+	float3 PosL            : POSITION;
+	float3 ToFarPlaneIndex : NORMAL;
+	float2 Tex             : TEXCOORD;
+};
+
+struct VertexOut
+{
+	float4 PosH       : SV_POSITION;
+	float3 ToFarPlane : TEXCOORD0;
+	float2 Tex        : TEXCOORD1;
+};
+
+// The ambient map the scene reads this frame, and the history for the next.
+struct PixelOut
+{
+	float Ambient : SV_Target0;
+	float History : SV_Target1;
+};
+
+VertexOut VS(VertexIn vin)
+{
+	VertexOut vout;
+
+	// Already in NDC space.
+	vout.PosH = float4(vin.PosL, 1.0f);
+
+	// We store the index to the frustum corner in the normal x-coord slot.
+	vout.ToFarPlane = gFrustumCorners[vin.ToFarPlaneIndex.x].xyz;
+
+	// Pass onto pixel shader.
+	vout.Tex = vin.Tex;
+
+	return vout;
+}
+
+PixelOut PS(VertexOut pin)
+{
+	float4 normalDepth = gNormalDepthMap.SampleLevel(samLinear, pin.Tex, 0.0f);
+
+	float3 n = normalDepth.xyz;
+	float3 p = (normalDepth.w/pin.ToFarPlane.z)*pin.ToFarPlane;
+
+	// Where p was in the previous frame.
+	float3 prevP = mul(float4(p, 1.0f), gViewToPrevView).xyz;
+	float3 prevN = mul(n, (float3x3)gViewToPrevView);
+
+	float4 prevTex = mul(float4(prevP, 1.0f), gPrevViewToTex);
+	prevTex /= prevTex.w;
+
+	// Point sampled, so depths from both sides of an edge are not averaged.
+	float4 prevNormalDepth = gPrevNormalDepthMap.SampleLevel(samPoint, prevTex.xy, 0.0f);
+
+	bool onScreen = all(prevTex.xy >= 0.0f) && all(prevTex.xy <= 1.0f);
+	bool sameSurface = abs(prevNormalDepth.w - prevP.z) <= gDepthTolerance*prevP.z &&
+	                   dot(prevN, prevNormalDepth.xyz) >= gNormalThreshold;
+
+	float historyWeight = (onScreen && sameSurface) ? gHistoryWeight : 0.0f;
+
+	float current = gCurrentAmbientMap.SampleLevel(samPoint, pin.Tex, 0.0f).r;
+	float history = gHistoryMap.SampleLevel(samLinear, prevTex.xy, 0.0f).r;
+
+	// Without a history its contents are undefined; keep them out of the sum.
+	PixelOut pout;
+	pout.Ambient = historyWeight > 0.0f ? current + historyWeight*(history - current) : current;
+	pout.History = pout.Ambient;
+
+	return pout;
+}
+
+technique11 SsaoTemporal
+{
+    pass P0
+    {
+		SetVertexShader( CompileShader( vs_5_0, VS() ) );
+		SetGeometryShader( NULL );
+        SetPixelShader( CompileShader( ps_5_0, PS() ) );
+    }
+}
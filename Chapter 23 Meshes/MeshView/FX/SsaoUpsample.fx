@@ -0,0 +1,110 @@
+//=============================================================================
+// SsaoUpsample.fx
+//
+// Brings an ambient map computed below full resolution up to the size of the
+// normal/depth map.  Each pixel blends the 4 nearest ambient texels with their
+// bilinear weights, scaled down for texels whose depth or normal differs from
+// the pixel's, so occlusion does not bleed across the edges of objects.
+//=============================================================================
+
+cbuffer cbSettings
+{
+	// Depth difference, in view space units, at which a texel's weight halves.
+	float gDepthFalloff = 0.1f;
+
+	// Power the normal dot product is raised to.
+	float gNormalPower  = 8.0f;
+};
+
+// Nonnumeric values cannot be added to a cbuffer.
+Texture2D gNormalDepthMap;
+Texture2D gAmbientMap;
+
+SamplerState samPoint
+{
+	Filter = MIN_MAG_MIP_POINT;
+
+	AddressU = CLAMP;
+	AddressV = CLAMP;
+};
+
+struct VertexIn
+{
+	float3 PosL    : POSITION;
+	float3 NormalL : NORMAL;
+	float2 Tex     : TEXCOORD;
+};
+
+struct VertexOut
+{
+	float4 PosH : SV_POSITION;
+	float2 Tex  : TEXCOORD;
+};
+
+VertexOut VS(VertexIn vin)
+{
+	VertexOut vout;
+
+	// Already in NDC space.
+	vout.PosH = float4(vin.PosL, 1.0f);
+
+	// Pass onto pixel shader.
+	vout.Tex = vin.Tex;
+
+	return vout;
+}
+
+float PS(VertexOut pin) : SV_Target
+{
+	float4 centerNormalDepth = gNormalDepthMap.Load(int3(pin.PosH.xy, 0));
+
+	uint width, height;
+	gAmbientMap.GetDimensions(width, height);
+	float2 size = float2(width, height);
+
+	// The 4 ambient texels around the pixel and the bilinear weights.
+	float2 pos = pin.Tex*size - 0.5f;
+	float2 base = floor(pos);
+	float2 f = pos - base;
+
+	float4 bilinear = float4((1.0f-f.x)*(1.0f-f.y), f.x*(1.0f-f.y), (1.0f-f.x)*f.y, f.x*f.y);
+
+	const float2 offsets[4] = { float2(0.0f, 0.0f), float2(1.0f, 0.0f), float2(0.0f, 1.0f), float2(1.0f, 1.0f) };
+
+	float ambient = 0.0f;
+	float totalWeight = 0.0f;
+	float bilinearAmbient = 0.0f;
+
+	[unroll]
+	for(int i = 0; i < 4; ++i)
+	{
+		float2 tex = (base + offsets[i] + 0.5f) / size;
+
+		// The surface the texel was computed for.
+		float4 normalDepth = gNormalDepthMap.SampleLevel(samPoint, tex, 0.0f);
+		float a = gAmbientMap.SampleLevel(samPoint, tex, 0.0f).r;
+
+		float depthWeight = gDepthFalloff / (gDepthFalloff + abs(normalDepth.w - centerNormalDepth.w));
+		float normalWeight = pow(saturate(dot(normalDepth.xyz, centerNormalDepth.xyz)), gNormalPower);
+
+		float w = bilinear[i]*depthWeight*normalWeight;
+
+		ambient += w*a;
+		totalWeight += w;
+		bilinearAmbient += bilinear[i]*a;
+	}
+
+	// No texel is on the pixel's surface, as on thin objects; plain bilinear is
+	// the best there is.
+	return totalWeight > 1e-4f ? ambient / totalWeight : bilinearAmbient;
+}
+
+technique11 Upsample
+{
+    pass P0
+    {
+		SetVertexShader( CompileShader( vs_5_0, VS() ) );
+		SetGeometryShader( NULL );
+        SetPixelShader( CompileShader( ps_5_0, PS() ) );
+    }
+}
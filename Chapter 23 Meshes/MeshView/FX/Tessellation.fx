@@ -0,0 +1,132 @@
+//=============================================================================
+// Tessellation.fx
+//
+// Tessellation factors and patch culling shared by the displacement mapped
+// techniques of NormalMap.fx and BuildShadowMap.fx.  Both pass their gEyePosW
+// as eyePosW, the camera's position even in a shadow pass, so a shadow map
+// records the same geometry the eye sees; only the culling differs per pass.
+//
+// TessellationReference.cpp repeats these functions on the CPU; keep the two
+// in step.
+//=============================================================================
+
+cbuffer cbTessellation
+{
+	// Distance mode: the factor runs from gMaxTessFactor at gMaxTessDistance
+	// and nearer down to gMinTessFactor at gMinTessDistance and farther.
+	float gMaxTessDistance;
+	float gMinTessDistance;
+	float gMinTessFactor;
+	float gMaxTessFactor;
+
+	// Screen space mode, used when gTessEdgeLength is above zero: each edge is
+	// split into pieces about gTessEdgeLength pixels long on the eye's screen.
+	// gTessProjScale is the height in pixels of one unit at unit distance.
+	float gTessEdgeLength = 0.0f;
+	float gTessProjScale;
+
+	// Displacement along the normal, as a multiple of the height map.
+	float gHeightScale;
+
+	// Cosine of how far past edge on a patch may face away from gTessCullView
+	// before it is culled, leaving room for displacement to turn it back.
+	float gTessBackfaceSlack = 0.25f;
+
+	// Inward facing world space planes of the pass's view volume.  A patch
+	// wholly outside one, by more than gHeightScale, is culled.
+	float4 gTessCullPlanes[6];
+
+	// Viewpoint for backface culling: a position with w = 1, or with w = 0 the
+	// direction an orthographic view looks.  w < 0 culls no back faces.
+	float4 gTessCullView = float4(0.0f, 0.0f, 0.0f, -1.0f);
+};
+
+struct PatchTess
+{
+	float EdgeTess[3] : SV_TessFactor;
+	float InsideTess  : SV_InsideTessFactor;
+};
+
+// Distance mode factor of a vertex.
+float VertexTessFactor(float3 posW, float3 eyePosW)
+{
+	float d = distance(posW, eyePosW);
+
+	// Normalized tessellation factor.
+	// The tessellation is
+	//   0 if d >= gMinTessDistance and
+	//   1 if d <= gMaxTessDistance.
+	float tess = saturate( (gMinTessDistance - d) / (gMinTessDistance - gMaxTessDistance) );
+
+	// Rescale [0,1] --> [gMinTessFactor, gMaxTessFactor].
+	return gMinTessFactor + tess*(gMaxTessFactor-gMinTessFactor);
+}
+
+// Factor of the edge from p0 to p1.  It depends only on the edge, not on the
+// patch, so patches sharing the edge split it the same way and no cracks open.
+float EdgeTessFactor(float3 p0, float3 p1, float3 eyePosW)
+{
+	if( gTessEdgeLength <= 0.0f )
+		return 0.5f*(VertexTessFactor(p0, eyePosW) + VertexTessFactor(p1, eyePosW));
+
+	// Projected size of the edge's bounding sphere, which unlike the edge's own
+	// projection does not shrink when the edge is seen end on.
+	float3 center = 0.5f*(p0 + p1);
+	float d = max(distance(center, eyePosW), 0.0001f);
+	float pixels = distance(p0, p1)*gTessProjScale / d;
+
+	return clamp(pixels / gTessEdgeLength, gMinTessFactor, gMaxTessFactor);
+}
+
+// True if no part of the displaced patch can be seen from the pass's view.
+bool PatchCulled(float3 p0, float3 p1, float3 p2)
+{
+	// Displacement moves a point at most gHeightScale along its normal.
+	[unroll]
+	for(int i = 0; i < 6; ++i)
+	{
+		float3 d = float3(dot(gTessCullPlanes[i], float4(p0, 1.0f)),
+		                  dot(gTessCullPlanes[i], float4(p1, 1.0f)),
+		                  dot(gTessCullPlanes[i], float4(p2, 1.0f)));
+
+		if( all(d < -gHeightScale) )
+			return true;
+	}
+
+	if( gTessCullView.w >= 0.0f )
+	{
+		// Front faces are clockwise, so in a left handed frame the normal
+		// cross(p1-p0, p2-p0) points to the side they are seen from.
+		float3 n = cross(p1 - p0, p2 - p0);
+		float3 toPatch = gTessCullView.w > 0.0f ? p0 - gTessCullView.xyz : gTessCullView.xyz;
+
+		float lengths = length(n)*length(toPatch);
+		if( lengths > 0.0f && dot(n, toPatch) > gTessBackfaceSlack*lengths )
+			return true;
+	}
+
+	return false;
+}
+
+// Tessellation of a triangle patch, with factors of zero if it is culled.
+PatchTess CalcPatchTess(float3 p0, float3 p1, float3 p2, float3 eyePosW)
+{
+	PatchTess pt;
+
+	if( PatchCulled(p0, p1, p2) )
+	{
+		pt.EdgeTess[0] = 0.0f;
+		pt.EdgeTess[1] = 0.0f;
+		pt.EdgeTess[2] = 0.0f;
+		pt.InsideTess  = 0.0f;
+		return pt;
+	}
+
+	// Edge i is the one opposite vertex i.
+	pt.EdgeTess[0] = EdgeTessFactor(p1, p2, eyePosW);
+	pt.EdgeTess[1] = EdgeTessFactor(p2, p0, eyePosW);
+	pt.EdgeTess[2] = EdgeTessFactor(p0, p1, eyePosW);
+	pt.InsideTess  = (pt.EdgeTess[0] + pt.EdgeTess[1] + pt.EdgeTess[2]) / 3.0f;
+
+	return pt;
+}
@@ -0,0 +1,571 @@
+//***************************************************************************************
+// InstanceBvh.cpp
+//***************************************************************************************
+
+#include "InstanceBvh.h"
+
+namespace
+{
+	const UINT SahBinCount = 16;
+
+	struct SahBin
+	{
+		XMVECTOR Min;
+		XMVECTOR Max;
+		UINT Count;
+	};
+
+	struct BuildEntry
+	{
+		UINT Node;
+		UINT First;
+		UINT Count;
+	};
+
+	struct PickEntry
+	{
+		UINT Node;
+		float Dist;
+	};
+
+	float GetAxis(const XMFLOAT3& v, UINT axis)
+	{
+		return (&v.x)[axis];
+	}
+
+	UINT GetBin(float c, float lo, float scale)
+	{
+		UINT bin = static_cast<UINT>((c - lo)*scale);
+		return MathHelper::Min(bin, SahBinCount-1);
+	}
+
+	float BoxArea(FXMVECTOR vMin, FXMVECTOR vMax)
+	{
+		XMFLOAT3 d;
+		XMStoreFloat3(&d, vMax - vMin);
+		return 2.0f*(d.x*d.y + d.y*d.z + d.z*d.x);
+	}
+}
+
+InstanceBvh::InstanceBvh()
+: RebuildThreshold(2.0f)
+{
+}
+
+InstanceBvh::~InstanceBvh()
+{
+}
+
+UINT InstanceBvh::InstanceCount()const
+{
+	return mInstanceBounds.size();
+}
+
+const XNA::AxisAlignedBox& InstanceBvh::InstanceBounds(UINT i)const
+{
+	return mInstanceBounds[i];
+}
+
+void InstanceBvh::ComputeWorldBounds(const BasicModelInstance& instance, XNA::AxisAlignedBox* bounds)
+{
+	// XNA::TransformAxisAlignedBox only handles uniform scale, and scales the
+	// center too, so transform the box directly: the center by the whole World
+	// matrix, the extents by the absolute value of its upper 3x3.
+	const XNA::AxisAlignedBox& box = instance.Model->Bounds;
+	XMMATRIX W = XMLoadFloat4x4(&instance.World);
+
+	XMVECTOR extents = XMLoadFloat3(&box.Extents);
+	XMVECTOR worldExtents = XMVectorMultiply(XMVectorAbs(W.r[0]), XMVectorSplatX(extents));
+	worldExtents = XMVectorMultiplyAdd(XMVectorAbs(W.r[1]), XMVectorSplatY(extents), worldExtents);
+	worldExtents = XMVectorMultiplyAdd(XMVectorAbs(W.r[2]), XMVectorSplatZ(extents), worldExtents);
+
+	XMStoreFloat3(&bounds->Center, XMVector3TransformCoord(XMLoadFloat3(&box.Center), W));
+	XMStoreFloat3(&bounds->Extents, worldExtents);
+}
+
+void InstanceBvh::Build(const std::vector<BasicModelInstance>& instances)
+{
+	UINT n = instances.size();
+
+	mInstanceBounds.resize(n);
+	mInstanceOrder.resize(n);
+
+	for(UINT i = 0; i < n; ++i)
+	{
+		ComputeWorldBounds(instances[i], &mInstanceBounds[i]);
+		mInstanceOrder[i] = i;
+	}
+
+	mNodes.resize(n > 0 ? 2*n-1 : 0);
+	mBuildArea.resize(mNodes.size());
+
+	if( n > 0 )
+		BuildSubtree(0, 0, n);
+}
+
+UINT InstanceBvh::Update(const std::vector<BasicModelInstance>& instances)
+{
+	if( instances.size() != mInstanceBounds.size() )
+	{
+		Build(instances);
+		return 1;
+	}
+
+	if( mNodes.empty() )
+		return 0;
+
+	for(UINT i = 0; i < instances.size(); ++i)
+		ComputeWorldBounds(instances[i], &mInstanceBounds[i]);
+
+	//
+	// Refit.  Children are always stored after their parent, so walking the nodes
+	// backwards visits both children of a node before the node itself.
+	//
+
+	for(UINT i = mNodes.size(); i-- > 0; )
+	{
+		Node& node = mNodes[i];
+
+		XMVECTOR vMin;
+		XMVECTOR vMax;
+
+		if( node.Count == 1 )
+		{
+			const XNA::AxisAlignedBox& box = mInstanceBounds[mInstanceOrder[node.First]];
+			XMVECTOR center  = XMLoadFloat3(&box.Center);
+			XMVECTOR extents = XMLoadFloat3(&box.Extents);
+
+			vMin = center - extents;
+			vMax = center + extents;
+		}
+		else
+		{
+			const Node& left  = mNodes[i + 1];
+			const Node& right = mNodes[i + 2*left.Count];
+
+			vMin = XMVectorMin(XMLoadFloat3(&left.Min), XMLoadFloat3(&right.Min));
+			vMax = XMVectorMax(XMLoadFloat3(&left.Max), XMLoadFloat3(&right.Max));
+		}
+
+		XMStoreFloat3(&node.Min, vMin);
+		XMStoreFloat3(&node.Max, vMax);
+	}
+
+	//
+	// Rebuild the topmost subtrees that degraded too much.  Rebuilding a subtree
+	// does not change the union of its bounds, so its ancestors stay valid.
+	//
+
+	UINT rebuilt = 0;
+
+	std::vector<UINT> stack;
+	stack.push_back(0);
+
+	while( !stack.empty() )
+	{
+		UINT i = stack.back();
+		stack.pop_back();
+
+		Node node = mNodes[i];
+		if( node.Count == 1 )
+			continue;
+
+		if( SurfaceArea(node.Min, node.Max) > RebuildThreshold*mBuildArea[i] )
+		{
+			BuildSubtree(i, node.First, node.Count);
+			++rebuilt;
+			continue;
+		}
+
+		stack.push_back(i + 2*mNodes[i + 1].Count);
+		stack.push_back(i + 1);
+	}
+
+	return rebuilt;
+}
+
+void InstanceBvh::BuildSubtree(UINT root, UINT first, UINT count)
+{
+	// Use an explicit stack; a poorly distributed scene can produce deep trees.
+	std::vector<BuildEntry> stack;
+
+	BuildEntry rootEntry = { root, first, count };
+	stack.push_back(rootEntry);
+
+	while( !stack.empty() )
+	{
+		BuildEntry e = stack.back();
+		stack.pop_back();
+
+		XMVECTOR vMin = XMVectorReplicate(+MathHelper::Infinity);
+		XMVECTOR vMax = XMVectorReplicate(-MathHelper::Infinity);
+
+		for(UINT i = e.First; i < e.First + e.Count; ++i)
+		{
+			const XNA::AxisAlignedBox& box = mInstanceBounds[mInstanceOrder[i]];
+			XMVECTOR center  = XMLoadFloat3(&box.Center);
+			XMVECTOR extents = XMLoadFloat3(&box.Extents);
+
+			vMin = XMVectorMin(vMin, center - extents);
+			vMax = XMVectorMax(vMax, center + extents);
+		}
+
+		Node& node = mNodes[e.Node];
+		XMStoreFloat3(&node.Min, vMin);
+		XMStoreFloat3(&node.Max, vMax);
+		node.First = e.First;
+		node.Count = e.Count;
+
+		mBuildArea[e.Node] = SurfaceArea(node.Min, node.Max);
+
+		if( e.Count == 1 )
+			continue;
+
+		UINT leftCount = PartitionSah(e.First, e.Count);
+
+		BuildEntry right = { e.Node + 2*leftCount, e.First + leftCount, e.Count - leftCount };
+		BuildEntry left  = { e.Node + 1, e.First, leftCount };
+
+		stack.push_back(right);
+		stack.push_back(left);
+	}
+}
+
+UINT InstanceBvh::PartitionSah(UINT first, UINT count)
+{
+	UINT* order = &mInstanceOrder[first];
+
+	//
+	// Split along the axis where the instance centers are spread the most.
+	//
+
+	XMVECTOR cMin = XMVectorReplicate(+MathHelper::Infinity);
+	XMVECTOR cMax = XMVectorReplicate(-MathHelper::Infinity);
+
+	for(UINT i = 0; i < count; ++i)
+	{
+		XMVECTOR c = XMLoadFloat3(&mInstanceBounds[order[i]].Center);
+		cMin = XMVectorMin(cMin, c);
+		cMax = XMVectorMax(cMax, c);
+	}
+
+	XMFLOAT3 lo;
+	XMFLOAT3 extent;
+	XMStoreFloat3(&lo, cMin);
+	XMStoreFloat3(&extent, cMax - cMin);
+
+	UINT axis = 0;
+	if( extent.y > GetAxis(extent, axis) ) axis = 1;
+	if( extent.z > GetAxis(extent, axis) ) axis = 2;
+
+	// All the centers coincide, so any split is as good as another.
+	if( GetAxis(extent, axis) <= 0.0f )
+		return count / 2;
+
+	float axisLo = GetAxis(lo, axis);
+	float scale  = SahBinCount / GetAxis(extent, axis);
+
+	//
+	// Bin the instances by center.
+	//
+
+	SahBin bins[SahBinCount];
+	for(UINT b = 0; b < SahBinCount; ++b)
+	{
+		bins[b].Min = XMVectorReplicate(+MathHelper::Infinity);
+		bins[b].Max = XMVectorReplicate(-MathHelper::Infinity);
+		bins[b].Count = 0;
+	}
+
+	for(UINT i = 0; i < count; ++i)
+	{
+		const XNA::AxisAlignedBox& box = mInstanceBounds[order[i]];
+		XMVECTOR center  = XMLoadFloat3(&box.Center);
+		XMVECTOR extents = XMLoadFloat3(&box.Extents);
+
+		SahBin& bin = bins[GetBin(GetAxis(box.Center, axis), axisLo, scale)];
+		bin.Min = XMVectorMin(bin.Min, center - extents);
+		bin.Max = XMVectorMax(bin.Max, center + extents);
+		bin.Count++;
+	}
+
+	//
+	// Sweep from the right to get the area and count to the right of every
+	// split plane, then sweep from the left and keep the cheapest plane.
+	// Split plane b puts bins [0, b) on the left.
+	//
+
+	float rightArea[SahBinCount];
+	UINT rightCount[SahBinCount];
+
+	XMVECTOR accMin = XMVectorReplicate(+MathHelper::Infinity);
+	XMVECTOR accMax = XMVectorReplicate(-MathHelper::Infinity);
+	UINT accCount = 0;
+
+	for(UINT b = SahBinCount-1; b > 0; --b)
+	{
+		accMin = XMVectorMin(accMin, bins[b].Min);
+		accMax = XMVectorMax(accMax, bins[b].Max);
+		accCount += bins[b].Count;
+
+		rightArea[b]  = accCount > 0 ? BoxArea(accMin, accMax) : 0.0f;
+		rightCount[b] = accCount;
+	}
+
+	accMin = XMVectorReplicate(+MathHelper::Infinity);
+	accMax = XMVectorReplicate(-MathHelper::Infinity);
+	accCount = 0;
+
+	float bestCost = MathHelper::Infinity;
+	UINT bestSplit = 0;
+
+	for(UINT b = 1; b < SahBinCount; ++b)
+	{
+		accMin = XMVectorMin(accMin, bins[b-1].Min);
+		accMax = XMVectorMax(accMax, bins[b-1].Max);
+		accCount += bins[b-1].Count;
+
+		if( accCount == 0 || rightCount[b] == 0 )
+			continue;
+
+		float cost = BoxArea(accMin, accMax)*accCount + rightArea[b]*rightCount[b];
+		if( cost < bestCost )
+		{
+			bestCost  = cost;
+			bestSplit = b;
+		}
+	}
+
+	// Every center landed in the same bin; fall back to a median split.
+	if( bestSplit == 0 )
+	{
+		const std::vector<XNA::AxisAlignedBox>& bounds = mInstanceBounds;
+		std::nth_element(order, order + count/2, order + count,
+			[&](UINT a, UINT b) { return GetAxis(bounds[a].Center, axis) < GetAxis(bounds[b].Center, axis); });
+
+		return count / 2;
+	}
+
+	const std::vector<XNA::AxisAlignedBox>& bounds = mInstanceBounds;
+	UINT* mid = std::partition(order, order + count,
+		[&](UINT i) { return GetBin(GetAxis(bounds[i].Center, axis), axisLo, scale) < bestSplit; });
+
+	return static_cast<UINT>(mid - order);
+}
+
+void InstanceBvh::QueryFrustum(const XMFLOAT4 planes[6], std::vector<UINT>& visible)const
+{
+	if( mNodes.empty() )
+		return;
+
+	// The XNA collision routines treat the positive side of a plane as outside,
+	// so flip the inward facing frustum planes.
+	XMVECTOR p[6];
+	for(int i = 0; i < 6; ++i)
+		p[i] = -XMLoadFloat4(&planes[i]);
+
+	std::vector<UINT> stack;
+	stack.push_back(0);
+
+	while( !stack.empty() )
+	{
+		UINT i = stack.back();
+		stack.pop_back();
+
+		const Node& node = mNodes[i];
+
+		XNA::AxisAlignedBox box;
+		GetNodeBox(node, &box);
+
+		INT result = XNA::IntersectAxisAlignedBox6Planes(&box, p[0], p[1], p[2], p[3], p[4], p[5]);
+		if( result == 0 )
+			continue;
+
+		// If the node is completely inside, everything below it is visible and
+		// needs no further tests.  The instances below a node are contiguous.
+		if( result == 2 || node.Count == 1 )
+		{
+			for(UINT j = node.First; j < node.First + node.Count; ++j)
+				visible.push_back(mInstanceOrder[j]);
+			continue;
+		}
+
+		stack.push_back(i + 2*mNodes[i + 1].Count);
+		stack.push_back(i + 1);
+	}
+}
+
+void InstanceBvh::QueryRay(FXMVECTOR origin, FXMVECTOR dir, std::vector<UINT>& hits)const
+{
+	if( mNodes.empty() )
+		return;
+
+	std::vector<UINT> stack;
+	stack.push_back(0);
+
+	while( !stack.empty() )
+	{
+		UINT i = stack.back();
+		stack.pop_back();
+
+		const Node& node = mNodes[i];
+
+		XNA::AxisAlignedBox box;
+		GetNodeBox(node, &box);
+
+		float t;
+		if( !XNA::IntersectRayAxisAlignedBox(origin, dir, &box, &t) )
+			continue;
+
+		if( node.Count == 1 )
+		{
+			hits.push_back(mInstanceOrder[node.First]);
+			continue;
+		}
+
+		stack.push_back(i + 2*mNodes[i + 1].Count);
+		stack.push_back(i + 1);
+	}
+}
+
+template<typename LeafTest>
+bool InstanceBvh::PickNearest(FXMVECTOR origin, FXMVECTOR dir, LeafTest& leafTest, UINT& instance, float& dist)const
+{
+	if( mNodes.empty() )
+		return false;
+
+	XNA::AxisAlignedBox box;
+	GetNodeBox(mNodes[0], &box);
+
+	float t;
+	if( !XNA::IntersectRayAxisAlignedBox(origin, dir, &box, &t) )
+		return false;
+
+	float best = MathHelper::Infinity;
+
+	std::vector<PickEntry> stack;
+	PickEntry rootEntry = { 0, MathHelper::Max(t, 0.0f) };
+	stack.push_back(rootEntry);
+
+	while( !stack.empty() )
+	{
+		PickEntry e = stack.back();
+		stack.pop_back();
+
+		// Something nearer was found after this node was pushed.
+		if( e.Dist >= best )
+			continue;
+
+		const Node& node = mNodes[e.Node];
+
+		if( node.Count == 1 )
+		{
+			float hitDist;
+			if( leafTest(mInstanceOrder[node.First], e.Dist, best, hitDist) && hitDist < best )
+			{
+				best = hitDist;
+				instance = mInstanceOrder[node.First];
+			}
+			continue;
+		}
+
+		PickEntry child[2];
+		bool hit[2];
+
+		child[0].Node = e.Node + 1;
+		child[1].Node = e.Node + 2*mNodes[e.Node + 1].Count;
+
+		for(int c = 0; c < 2; ++c)
+		{
+			GetNodeBox(mNodes[child[c].Node], &box);
+			hit[c] = XNA::IntersectRayAxisAlignedBox(origin, dir, &box, &t) != FALSE;
+
+			// A negative distance means the origin is inside the box.
+			child[c].Dist = MathHelper::Max(t, 0.0f);
+		}
+
+		// Push the far child first so the near child is visited first.
+		int nearChild = (hit[0] && hit[1] && child[1].Dist < child[0].Dist) ? 1 : 0;
+		int farChild  = 1 - nearChild;
+
+		if( hit[farChild] )
+			stack.push_back(child[farChild]);
+		if( hit[nearChild] )
+			stack.push_back(child[nearChild]);
+	}
+
+	if( best == MathHelper::Infinity )
+		return false;
+
+	dist = best;
+	return true;
+}
+
+bool InstanceBvh::Pick(FXMVECTOR origin, FXMVECTOR dir, UINT& instance, float& dist)const
+{
+	// The box distance is the answer.
+	auto boxTest = [](UINT i, float boxDist, float best, float& hitDist) -> bool
+	{
+		hitDist = boxDist;
+		return true;
+	};
+
+	return PickNearest(origin, dir, boxTest, instance, dist);
+}
+
+bool InstanceBvh::PickTriangles(FXMVECTOR origin, FXMVECTOR dir, const std::vector<BasicModelInstance>& instances,
+								UINT& instance, UINT& triangle, float& dist)const
+{
+	XMVECTOR rayOrigin = origin;
+	XMVECTOR rayDir    = dir;
+
+	auto triangleTest = [&](UINT i, float boxDist, float best, float& hitDist) -> bool
+	{
+		const BasicModelInstance& inst = instances[i];
+
+		XMMATRIX W = XMLoadFloat4x4(&inst.World);
+		XMVECTOR det = XMMatrixDeterminant(W);
+		XMMATRIX invWorld = XMMatrixInverse(&det, W);
+
+		// Transform the ray to the local space of the mesh.  The triangle test wants a
+		// unit direction, so distances are scaled by the length of the local direction
+		// to convert between the two spaces.
+		XMVECTOR localOrigin = XMVector3TransformCoord(rayOrigin, invWorld);
+		XMVECTOR localDir    = XMVector3TransformNormal(rayDir, invWorld);
+
+		float scale = XMVectorGetX(XMVector3Length(localDir));
+		localDir = localDir / scale;
+
+		float maxDist = best == MathHelper::Infinity ? best : best*scale;
+
+		UINT tri;
+		float t;
+		if( !inst.Model->PickBvh.IntersectClosest(localOrigin, localDir, maxDist, tri, t) )
+			return false;
+
+		// IntersectClosest takes ties and the division can round, so only keep
+		// the triangle when PickNearest will take the hit too.
+		hitDist = t / scale;
+		if( hitDist >= best )
+			return false;
+
+		triangle = tri;
+		return true;
+	};
+
+	return PickNearest(origin, dir, triangleTest, instance, dist);
+}
+
+void InstanceBvh::GetNodeBox(const Node& node, XNA::AxisAlignedBox* box)const
+{
+	XMVECTOR vMin = XMLoadFloat3(&node.Min);
+	XMVECTOR vMax = XMLoadFloat3(&node.Max);
+
+	XMStoreFloat3(&box->Center,  (vMin + vMax)*0.5f);
+	XMStoreFloat3(&box->Extents, (vMax - vMin)*0.5f);
+}
+
+float InstanceBvh::SurfaceArea(const XMFLOAT3& minPt, const XMFLOAT3& maxPt)
+{
+	return BoxArea(XMLoadFloat3(&minPt), XMLoadFloat3(&maxPt));
+}
@@ -0,0 +1,87 @@
+//***************************************************************************************
+// InstanceBvh.h
+//
+// Bounding volume hierarchy over the world space bounds of a list of model instances.
+// Lets frustum culling and mouse picking visit O(log n) nodes instead of testing
+// every instance in the scene.
+//***************************************************************************************
+
+#ifndef INSTANCEBVH_H
+#define INSTANCEBVH_H
+
+#include "BasicModel.h"
+
+class InstanceBvh
+{
+public:
+	InstanceBvh();
+	~InstanceBvh();
+
+	// Builds the tree from scratch using the surface area heuristic.
+	void Build(const std::vector<BasicModelInstance>& instances);
+
+	// Recomputes the instance bounds from the current World matrices and refits the
+	// tree bottom up.  Subtrees whose surface area grew past RebuildThreshold times
+	// their area when they were built are then rebuilt in place.  Falls back to a full
+	// Build if the instance count changed.  Returns the number of subtrees rebuilt.
+	UINT Update(const std::vector<BasicModelInstance>& instances);
+
+	// Appends the indices of the instances that intersect the frustum given by six
+	// inward facing planes, as returned by ExtractFrustumPlanes.
+	void QueryFrustum(const XMFLOAT4 planes[6], std::vector<UINT>& visible)const;
+
+	// Appends the indices of the instances whose bounds are hit by the ray.  The
+	// direction must be normalized.
+	void QueryRay(FXMVECTOR origin, FXMVECTOR dir, std::vector<UINT>& hits)const;
+
+	// Finds the instance whose bounds are hit nearest to the ray origin.
+	bool Pick(FXMVECTOR origin, FXMVECTOR dir, UINT& instance, float& dist)const;
+
+	// Finds the nearest triangle hit by the ray, testing the triangle tree of each
+	// instance whose bounds are reached before anything nearer has been hit.
+	// instances must be the list the tree was last built or updated from.
+	bool PickTriangles(FXMVECTOR origin, FXMVECTOR dir, const std::vector<BasicModelInstance>& instances,
+		UINT& instance, UINT& triangle, float& dist)const;
+
+	UINT InstanceCount()const;
+	const XNA::AxisAlignedBox& InstanceBounds(UINT i)const;
+
+	static void ComputeWorldBounds(const BasicModelInstance& instance, XNA::AxisAlignedBox* bounds);
+
+	float RebuildThreshold;
+
+private:
+	InstanceBvh(const InstanceBvh& rhs);
+	InstanceBvh& operator=(const InstanceBvh& rhs);
+
+	// Nodes are stored depth first.  The left child of an interior node follows it
+	// directly and the right child follows the whole left subtree.  Every leaf holds
+	// exactly one instance, so a subtree over n instances always occupies 2n-1
+	// consecutive nodes and can be rebuilt without moving the rest of the tree.
+	struct Node
+	{
+		XMFLOAT3 Min;
+		UINT First; // First entry in mInstanceOrder covered by this node.
+		XMFLOAT3 Max;
+		UINT Count; // Number of instances covered; 1 for a leaf.
+	};
+
+	// Visits the leaves nearest first.  leafTest(instance, boxDist, best, hitDist)
+	// returns true with the hit distance if the instance is hit nearer than best.
+	template<typename LeafTest>
+	bool PickNearest(FXMVECTOR origin, FXMVECTOR dir, LeafTest& leafTest, UINT& instance, float& dist)const;
+
+	void BuildSubtree(UINT root, UINT first, UINT count);
+	UINT PartitionSah(UINT first, UINT count);
+	void GetNodeBox(const Node& node, XNA::AxisAlignedBox* box)const;
+	static float SurfaceArea(const XMFLOAT3& minPt, const XMFLOAT3& maxPt);
+
+private:
+	std::vector<Node> mNodes;
+	std::vector<float> mBuildArea;
+
+	std::vector<UINT> mInstanceOrder;
+	std::vector<XNA::AxisAlignedBox> mInstanceBounds;
+};
+
+#endif // INSTANCEBVH_H
@@ -0,0 +1,454 @@
+//***************************************************************************************
+// LightClusters.cpp
+//***************************************************************************************
+
+#include "LightClusters.h"
+#include "ScopeProfiler.h"
+#include <algorithm>
+#include <functional>
+#include <cfloat>
+#include <cmath>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#define LIGHTCLUSTERS_SSE2 1
+#include <emmintrin.h>
+#else
+#define LIGHTCLUSTERS_SSE2 0
+#endif
+
+const float LightClusters::MinSpotFactor = 1.0f/256.0f;
+
+namespace
+{
+	// Bounds over a slice of the planes x = slope*z (or y = slope*z).
+	float SlopeMin(float slope, float z0, float z1)
+	{
+		return std::min(slope*z0, slope*z1);
+	}
+
+	float SlopeMax(float slope, float z0, float z1)
+	{
+		return std::max(slope*z0, slope*z1);
+	}
+
+	// Distance from c to the interval [lo, hi] along one axis.  The SSE path
+	// does the same operations, so both give the same answer.
+	float AxisDistance(float lo, float hi, float c)
+	{
+		return std::max(std::max(lo - c, c - hi), 0.0f);
+	}
+}
+
+LightClusters::LightClusters()
+	: mTilesX(16), mTilesY(9), mSlices(24),
+	  mFovY(0.25f*3.1415926535f), mAspect(1.0f), mNearZ(1.0f), mFarZ(1000.0f),
+	  mLights(0), mLightCount(0)
+{
+	for(int i = 1; i < MaxThreads; ++i)
+		mWorkers.push_back(std::unique_ptr<WorkerThread>(new WorkerThread("LightBin")));
+
+	UpdateSlopes();
+}
+
+LightClusters::~LightClusters()
+{
+}
+
+void LightClusters::SetGrid(unsigned int tilesX, unsigned int tilesY, unsigned int slices)
+{
+	mTilesX = std::max(tilesX, 1u);
+	mTilesY = std::max(tilesY, 1u);
+	mSlices = std::max(slices, 1u);
+
+	UpdateSlopes();
+}
+
+void LightClusters::SetFrustum(float fovY, float aspect, float nearZ, float farZ)
+{
+	mFovY = fovY;
+	mAspect = aspect;
+	mNearZ = nearZ;
+	mFarZ = farZ;
+
+	UpdateSlopes();
+}
+
+unsigned int LightClusters::TilesX()const
+{
+	return mTilesX;
+}
+
+unsigned int LightClusters::TilesY()const
+{
+	return mTilesY;
+}
+
+unsigned int LightClusters::Slices()const
+{
+	return mSlices;
+}
+
+unsigned int LightClusters::ClusterCount()const
+{
+	return mTilesX*mTilesY*mSlices;
+}
+
+float LightClusters::SliceDepth(unsigned int k)const
+{
+	return mSliceDepths[std::min(k, mSlices)];
+}
+
+float LightClusters::DepthScale()const
+{
+	return mSlices / logf(mFarZ/mNearZ);
+}
+
+float LightClusters::DepthBias()const
+{
+	return -logf(mNearZ)*DepthScale();
+}
+
+unsigned int LightClusters::ClusterIndex(unsigned int x, unsigned int y, unsigned int slice)const
+{
+	return (slice*mTilesY + y)*mTilesX + x;
+}
+
+unsigned int LightClusters::FindCluster(float u, float v, float viewDepth)const
+{
+	// As the shader does it, from the pixel's position and SV_Position.w.
+	float x = std::min(std::max(u*mTilesX, 0.0f), (float)(mTilesX - 1));
+	float y = std::min(std::max(v*mTilesY, 0.0f), (float)(mTilesY - 1));
+
+	float s = logf(std::max(viewDepth, FLT_MIN))*DepthScale() + DepthBias();
+	s = std::min(std::max(s, 0.0f), (float)(mSlices - 1));
+
+	return ClusterIndex((unsigned int)x, (unsigned int)y, (unsigned int)s);
+}
+
+LightClusters::Sphere LightClusters::PointBounds(const float position[3], float range)
+{
+	Sphere s;
+	s.Center[0] = position[0];
+	s.Center[1] = position[1];
+	s.Center[2] = position[2];
+	s.Radius = range;
+
+	return s;
+}
+
+LightClusters::Sphere LightClusters::SpotBounds(const float position[3], const float direction[3], float range, float spot)
+{
+	// pow(cos(angle), spot) falls below MinSpotFactor past this angle.  With a
+	// zero exponent the spot factor is one everywhere in range.
+	float cosAngle = spot > 0.0f ? powf(MinSpotFactor, 1.0f/spot) : 0.0f;
+	if( cosAngle <= 0.0f )
+		return PointBounds(position, range);
+
+	float offset;
+	float radius;
+	if( cosAngle < 0.70710678f )
+	{
+		// Wider than 45 degrees: the sphere around the rim of the cone's cap
+		// also holds the apex.
+		offset = range*cosAngle;
+		radius = range*sqrtf(1.0f - cosAngle*cosAngle);
+	}
+	else
+	{
+		// The sphere through the apex and the rim.
+		offset = 0.5f*range/cosAngle;
+		radius = offset;
+	}
+
+	Sphere s;
+	s.Center[0] = position[0] + offset*direction[0];
+	s.Center[1] = position[1] + offset*direction[1];
+	s.Center[2] = position[2] + offset*direction[2];
+	s.Radius = radius;
+
+	return s;
+}
+
+const std::vector<LightClusters::Cluster>& LightClusters::Clusters()const
+{
+	return mClusters;
+}
+
+const std::vector<unsigned int>& LightClusters::LightIndices()const
+{
+	return mLightIndices;
+}
+
+void LightClusters::UpdateSlopes()
+{
+	float tanY = tanf(0.5f*mFovY);
+	float tanX = mAspect*tanY;
+
+	mSlopesX.resize(mTilesX + 1);
+	for(unsigned int x = 0; x <= mTilesX; ++x)
+		mSlopesX[x] = (2.0f*x/mTilesX - 1.0f)*tanX;
+
+	mSlopesY.resize(mTilesY + 1);
+	for(unsigned int y = 0; y <= mTilesY; ++y)
+		mSlopesY[y] = (1.0f - 2.0f*y/mTilesY)*tanY;
+
+	mSliceDepths.resize(mSlices + 1);
+	for(unsigned int k = 0; k < mSlices; ++k)
+		mSliceDepths[k] = mNearZ*powf(mFarZ/mNearZ, (float)k/mSlices);
+	mSliceDepths[mSlices] = mFarZ;
+
+	Cluster empty = { 0, 0 };
+	mClusters.assign(ClusterCount(), empty);
+	mLightIndices.clear();
+}
+
+bool LightClusters::Touches(const Sphere& light, unsigned int cluster)const
+{
+	unsigned int tilesPerSlice = mTilesX*mTilesY;
+	unsigned int slice = cluster / tilesPerSlice;
+	unsigned int x = (cluster % tilesPerSlice) % mTilesX;
+	unsigned int y = (cluster % tilesPerSlice) / mTilesX;
+
+	float z0 = mSliceDepths[slice];
+	float z1 = mSliceDepths[slice + 1];
+
+	float dx = AxisDistance(SlopeMin(mSlopesX[x], z0, z1), SlopeMax(mSlopesX[x+1], z0, z1), light.Center[0]);
+	float dy = AxisDistance(SlopeMin(mSlopesY[y+1], z0, z1), SlopeMax(mSlopesY[y], z0, z1), light.Center[1]);
+	float dz = AxisDistance(z0, z1, light.Center[2]);
+
+	// Summed in the order BinSlice sums them.
+	float dyz2 = dz*dz + dy*dy;
+	return dx*dx + dyz2 <= light.Radius*light.Radius;
+}
+
+void LightClusters::Bin(const Sphere* lights, unsigned int count)
+{
+	PROFILE_SCOPE("LightClusters::Bin");
+
+	mLights = lights;
+	mLightCount = count;
+
+	// The slices each light might touch, one extra each way so rounding in the
+	// log cannot drop one.  BinSlice makes the exact test.
+	float scale = DepthScale();
+	float bias = DepthBias();
+
+	mFirstSlice.resize(count);
+	mLastSlice.resize(count);
+	for(unsigned int i = 0; i < count; ++i)
+	{
+		float zMin = lights[i].Center[2] - lights[i].Radius;
+		float zMax = lights[i].Center[2] + lights[i].Radius;
+
+		if( zMax < mNearZ || zMin > mFarZ )
+		{
+			mFirstSlice[i] = 1;
+			mLastSlice[i] = 0;
+			continue;
+		}
+
+		int first = zMin > mNearZ ? (int)floorf(logf(zMin)*scale + bias) - 1 : 0;
+		int last = (int)floorf(logf(zMax)*scale + bias) + 1;
+
+		mFirstSlice[i] = std::max(first, 0);
+		mLastSlice[i] = std::min(last, (int)mSlices - 1);
+	}
+
+	// Thread t bins slices t, t + threadCount, ... so each thread gets near
+	// and far slices alike.
+	unsigned int threadCount = count < MinThreadedLights ? 1 : std::min((unsigned int)MaxThreads, mSlices);
+
+	for(unsigned int t = 1; t < threadCount; ++t)
+	{
+		ThreadBins* bins = &mThreadBins[t];
+		mWorkers[t-1]->Start([this, t, threadCount, bins]()
+		{
+			BinSlices(t, threadCount, *bins);
+		});
+	}
+
+	BinSlices(0, threadCount, mThreadBins[0]);
+
+	for(unsigned int t = 1; t < threadCount; ++t)
+		mWorkers[t-1]->Wait();
+
+	// Join the lists.  Each thread's offsets count from the start of its own
+	// list.
+	unsigned int tilesPerSlice = mTilesX*mTilesY;
+
+	mLightIndices.clear();
+	for(unsigned int t = 0; t < threadCount; ++t)
+	{
+		const std::vector<unsigned int>& indices = mThreadBins[t].Indices;
+		unsigned int base = (unsigned int)mLightIndices.size();
+
+		mLightIndices.insert(mLightIndices.end(), indices.begin(), indices.end());
+
+		for(unsigned int s = t; s < mSlices && base > 0; s += threadCount)
+		{
+			for(unsigned int c = s*tilesPerSlice; c < (s + 1)*tilesPerSlice; ++c)
+				mClusters[c].Offset += base;
+		}
+	}
+
+	mLights = 0;
+}
+
+void LightClusters::BinSlices(unsigned int first, unsigned int stride, ThreadBins& bins)
+{
+	PROFILE_SCOPE("LightClusters::BinSlices");
+
+	bins.Indices.clear();
+
+	for(unsigned int s = first; s < mSlices; s += stride)
+		BinSlice(s, bins);
+}
+
+void LightClusters::SliceBounds(unsigned int slice, ThreadBins& bins)const
+{
+	float z0 = mSliceDepths[slice];
+	float z1 = mSliceDepths[slice + 1];
+
+	unsigned int paddedX = (mTilesX + 3) & ~3u;
+
+	bins.MinX.resize(paddedX);
+	bins.MaxX.resize(paddedX);
+	for(unsigned int x = 0; x < mTilesX; ++x)
+	{
+		bins.MinX[x] = SlopeMin(mSlopesX[x], z0, z1);
+		bins.MaxX[x] = SlopeMax(mSlopesX[x+1], z0, z1);
+	}
+
+	// Padding columns are out of every light's reach.
+	for(unsigned int x = mTilesX; x < paddedX; ++x)
+	{
+		bins.MinX[x] = FLT_MAX;
+		bins.MaxX[x] = FLT_MAX;
+	}
+
+	bins.MinY.resize(mTilesY);
+	bins.MaxY.resize(mTilesY);
+	for(unsigned int y = 0; y < mTilesY; ++y)
+	{
+		bins.MinY[y] = SlopeMin(mSlopesY[y+1], z0, z1);
+		bins.MaxY[y] = SlopeMax(mSlopesY[y], z0, z1);
+	}
+}
+
+void LightClusters::BinSlice(unsigned int slice, ThreadBins& bins)
+{
+	SliceBounds(slice, bins);
+
+	bins.HitTiles.clear();
+	bins.HitLights.clear();
+
+	float z0 = mSliceDepths[slice];
+	float z1 = mSliceDepths[slice + 1];
+
+	const float* minX = &bins.MinX[0];
+	const float* maxX = &bins.MaxX[0];
+	const float* minY = &bins.MinY[0];
+	const float* maxY = &bins.MaxY[0];
+
+	for(unsigned int i = 0; i < mLightCount; ++i)
+	{
+		if( (int)slice < mFirstSlice[i] || (int)slice > mLastSlice[i] )
+			continue;
+
+		const Sphere& light = mLights[i];
+		float cx = light.Center[0];
+		float cy = light.Center[1];
+		float r = light.Radius;
+		float r2 = r*r;
+
+		float dz = AxisDistance(z0, z1, light.Center[2]);
+		float dz2 = dz*dz;
+		if( dz2 > r2 )
+			continue;
+
+		// The columns and rows whose bounds overlap the sphere's, found by
+		// binary search since the bounds grow left to right and shrink top to
+		// bottom.  One more each way covers rounding; the test below decides.
+		int x0 = (int)(std::lower_bound(maxX, maxX + mTilesX, cx - r) - maxX) - 1;
+		int x1 = (int)(std::upper_bound(minX, minX + mTilesX, cx + r) - minX) + 1;
+		int y0 = (int)(std::lower_bound(minY, minY + mTilesY, cy + r, std::greater<float>()) - minY) - 1;
+		int y1 = (int)(std::upper_bound(maxY, maxY + mTilesY, cy - r, std::greater<float>()) - maxY) + 1;
+
+		x0 = std::max(x0, 0);
+		y0 = std::max(y0, 0);
+		x1 = std::min(x1, (int)mTilesX);
+		y1 = std::min(y1, (int)mTilesY);
+
+		for(int y = y0; y < y1; ++y)
+		{
+			float dy = AxisDistance(minY[y], maxY[y], cy);
+			float dyz2 = dz2 + dy*dy;
+			if( dyz2 > r2 )
+				continue;
+
+			unsigned int row = y*mTilesX;
+
+#if LIGHTCLUSTERS_SSE2
+			const __m128 zero = _mm_setzero_ps();
+			const __m128 c = _mm_set1_ps(cx);
+			const __m128 radius2 = _mm_set1_ps(r2);
+			const __m128 rowDist2 = _mm_set1_ps(dyz2);
+
+			// Four columns at a time from a multiple of four.  Columns outside
+			// [x0, x1) fail the test on their own, padding included.
+			for(int x = x0 & ~3; x < x1; x += 4)
+			{
+				__m128 lo = _mm_loadu_ps(minX + x);
+				__m128 hi = _mm_loadu_ps(maxX + x);
+
+				__m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(lo, c), _mm_sub_ps(c, hi)), zero);
+				__m128 d2 = _mm_add_ps(_mm_mul_ps(dx, dx), rowDist2);
+
+				int hits = _mm_movemask_ps(_mm_cmple_ps(d2, radius2));
+				for(int lane = 0; hits != 0; ++lane, hits >>= 1)
+				{
+					if( hits & 1 )
+					{
+						bins.HitTiles.push_back(row + x + lane);
+						bins.HitLights.push_back(i);
+					}
+				}
+			}
+#else
+			for(int x = x0; x < x1; ++x)
+			{
+				float dx = AxisDistance(minX[x], maxX[x], cx);
+				if( dx*dx + dyz2 <= r2 )
+				{
+					bins.HitTiles.push_back(row + x);
+					bins.HitLights.push_back(i);
+				}
+			}
+#endif
+		}
+	}
+
+	// Counting sort of the hits by tile.  The lights of a cluster keep their
+	// order, so the result does not depend on the thread count.
+	unsigned int tilesPerSlice = mTilesX*mTilesY;
+	Cluster* clusters = &mClusters[slice*tilesPerSlice];
+
+	bins.TileCounts.assign(tilesPerSlice, 0);
+	for(size_t h = 0; h < bins.HitTiles.size(); ++h)
+		bins.TileCounts[bins.HitTiles[h]]++;
+
+	unsigned int offset = (unsigned int)bins.Indices.size();
+	for(unsigned int t = 0; t < tilesPerSlice; ++t)
+	{
+		clusters[t].Offset = offset;
+		clusters[t].Count = bins.TileCounts[t];
+
+		// From here on, where the tile's next light goes.
+		bins.TileCounts[t] = offset;
+		offset += clusters[t].Count;
+	}
+
+	bins.Indices.resize(offset);
+	for(size_t h = 0; h < bins.HitTiles.size(); ++h)
+		bins.Indices[bins.TileCounts[bins.HitTiles[h]]++] = bins.HitLights[h];
+}
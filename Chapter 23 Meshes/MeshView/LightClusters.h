@@ -0,0 +1,156 @@
+//***************************************************************************************
+// LightClusters.h
+//
+// Bins point and spot lights into the clusters ("froxels") of a grid over the camera
+// frustum, so a pixel only lights itself with the lights of its cluster.
+//   -The screen is split into TilesX by TilesY tiles and the depth range into
+//    Slices slices.  Slice k ends at view depth near*(far/near)^((k+1)/Slices),
+//    so slices are thin near the camera and thick far away, and the shader finds
+//    a pixel's slice with one log.
+//   -Each light is a view space bounding sphere.  It is tested against the
+//    axis aligned box around each cluster it might touch, four tiles of a row at
+//    a time with SSE2.
+//   -The depth slices are shared out across the calling thread and worker
+//    threads.  Every thread writes its own light list, and the lists are joined
+//    afterwards, so the clusters get the same lights however many threads run.
+//   -The result is a Cluster (offset, count) per cluster into one list of light
+//    indices, in the order ClusterIndex numbers the clusters.
+// Uses only the standard library, so the binning can be checked without a device.
+// View space is left handed: x right, y up, z into the screen.
+//***************************************************************************************
+
+#ifndef LIGHTCLUSTERS_H
+#define LIGHTCLUSTERS_H
+
+#include "WorkerThread.h"
+#include <vector>
+#include <memory>
+
+class LightClusters
+{
+public:
+	enum { MaxThreads = 4 };
+
+	// Fewer lights than this are binned on the calling thread alone.
+	enum { MinThreadedLights = 64 };
+
+	// A light's bounding sphere in view space.
+	struct Sphere
+	{
+		float Center[3];
+		float Radius;
+	};
+
+	// The run of a cluster's lights in LightIndices().
+	struct Cluster
+	{
+		unsigned int Offset;
+		unsigned int Count;
+	};
+
+	LightClusters();
+	~LightClusters();
+
+	// 16 by 9 tiles and 24 slices by default.
+	void SetGrid(unsigned int tilesX, unsigned int tilesY, unsigned int slices);
+
+	// The camera's vertical field of view in radians, width over height, and
+	// near and far plane distances.
+	void SetFrustum(float fovY, float aspect, float nearZ, float farZ);
+
+	unsigned int TilesX()const;
+	unsigned int TilesY()const;
+	unsigned int Slices()const;
+	unsigned int ClusterCount()const;
+
+	// View depth where slice k begins; SliceDepth(Slices()) is the far plane.
+	float SliceDepth(unsigned int k)const;
+
+	// The slice of a view depth is floor(log(depth)*DepthScale() + DepthBias()).
+	float DepthScale()const;
+	float DepthBias()const;
+
+	// Tile x grows to the right and tile y down the screen, as pixels do.
+	unsigned int ClusterIndex(unsigned int x, unsigned int y, unsigned int slice)const;
+
+	// The cluster the shader finds for a pixel at (u, v) across the screen, each
+	// in [0, 1) with v = 0 at the top, and at the given view depth.
+	unsigned int FindCluster(float u, float v, float viewDepth)const;
+
+	// Bounds of a point light.
+	static Sphere PointBounds(const float position[3], float range);
+
+	// Bounds of a spot light, with direction a unit vector and spot the exponent
+	// of LightHelper.fx's spot factor.  The cone is cut off where the spot factor
+	// drops below MinSpotFactor, since the light is too faint to see past it.
+	static Sphere SpotBounds(const float position[3], const float direction[3], float range, float spot);
+	static const float MinSpotFactor;
+
+	// Bins the lights, given as view space bounds.  Light i is index i in
+	// LightIndices().
+	void Bin(const Sphere* lights, unsigned int count);
+
+	const std::vector<Cluster>& Clusters()const;
+	const std::vector<unsigned int>& LightIndices()const;
+
+	// The test Bin makes, one light and cluster at a time without SSE.
+	bool Touches(const Sphere& light, unsigned int cluster)const;
+
+private:
+	LightClusters(const LightClusters& rhs);
+	LightClusters& operator=(const LightClusters& rhs);
+
+	// Scratch and output of one thread.
+	struct ThreadBins
+	{
+		// Light indices of the thread's slices, cluster by cluster.
+		std::vector<unsigned int> Indices;
+
+		// Bounds of each tile column and row across the current slice.  The
+		// columns are padded to a multiple of four.
+		std::vector<float> MinX;
+		std::vector<float> MaxX;
+		std::vector<float> MinY;
+		std::vector<float> MaxY;
+
+		// Tile and light of each hit in the current slice.
+		std::vector<unsigned int> HitTiles;
+		std::vector<unsigned int> HitLights;
+		std::vector<unsigned int> TileCounts;
+	};
+
+	void UpdateSlopes();
+	void SliceBounds(unsigned int slice, ThreadBins& bins)const;
+	void BinSlices(unsigned int first, unsigned int stride, ThreadBins& bins);
+	void BinSlice(unsigned int slice, ThreadBins& bins);
+
+private:
+	unsigned int mTilesX;
+	unsigned int mTilesY;
+	unsigned int mSlices;
+
+	float mFovY;
+	float mAspect;
+	float mNearZ;
+	float mFarZ;
+
+	// x/z of each tile column's edges, left to right, and y/z of each tile
+	// row's edges, top to bottom.
+	std::vector<float> mSlopesX;
+	std::vector<float> mSlopesY;
+	std::vector<float> mSliceDepths;
+
+	// The lights being binned, and the first and last slice each might touch.
+	const Sphere* mLights;
+	unsigned int mLightCount;
+	std::vector<int> mFirstSlice;
+	std::vector<int> mLastSlice;
+
+	std::vector<Cluster> mClusters;
+	std::vector<unsigned int> mLightIndices;
+
+	ThreadBins mThreadBins[MaxThreads];
+	std::vector<std::unique_ptr<WorkerThread> > mWorkers;
+};
+
+#endif // LIGHTCLUSTERS_H
@@ -0,0 +1,53 @@
+//***************************************************************************************
+// LitFeatures.cpp
+//***************************************************************************************
+
+#include "LitFeatures.h"
+#include <algorithm>
+
+namespace
+{
+	// Basic.fx and NormalMap.fx have three directional lights.  Bits and Defines
+	// both clamp, so a count set after construction cannot make them disagree.
+	int ClampLightCount(int lightCount)
+	{
+		return std::min(std::max(lightCount, 0), 3);
+	}
+}
+
+LitFeatures::LitFeatures(int lightCount, bool texture, bool alphaClip)
+	: LightCount(ClampLightCount(lightCount)),
+	  Texture(texture),
+	  AlphaClip(alphaClip),
+	  Fog(false),
+	  Reflection(false),
+	  Instanced(false),
+	  Tessellated(false)
+{
+}
+
+unsigned int LitFeatures::Bits()const
+{
+	// Two bits of light count, then one per switch.
+	return (unsigned int)ClampLightCount(LightCount) |
+		(Texture     ? 1u << 2 : 0u) |
+		(AlphaClip   ? 1u << 3 : 0u) |
+		(Fog         ? 1u << 4 : 0u) |
+		(Reflection  ? 1u << 5 : 0u) |
+		(Instanced   ? 1u << 6 : 0u) |
+		(Tessellated ? 1u << 7 : 0u);
+}
+
+ShaderDefines LitFeatures::Defines()const
+{
+	ShaderDefines defines;
+	defines.Set("LIT_LIGHT_COUNT", ClampLightCount(LightCount));
+	defines.Set("LIT_TEXTURE",     Texture ? 1 : 0);
+	defines.Set("LIT_ALPHA_CLIP",  AlphaClip ? 1 : 0);
+	defines.Set("LIT_FOG",         Fog ? 1 : 0);
+	defines.Set("LIT_REFLECTION",  Reflection ? 1 : 0);
+	defines.Set("LIT_INSTANCED",   Instanced ? 1 : 0);
+	defines.Set("LIT_TESSELLATED", Tessellated ? 1 : 0);
+
+	return defines;
+}
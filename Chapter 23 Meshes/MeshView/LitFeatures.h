@@ -0,0 +1,46 @@
+//***************************************************************************************
+// LitFeatures.h
+//
+// The features of a lit technique of Basic.fx or NormalMap.fx.  Each combination
+// is its own permutation of the file, compiled with the defines Defines() gives
+// and holding a single technique, "Lit" (see PermutationEffect in Effects.h).
+// Uses only the standard library.
+//***************************************************************************************
+
+#ifndef LITFEATURES_H
+#define LITFEATURES_H
+
+#include "ShaderCache.h"
+
+struct LitFeatures
+{
+	// Light0Tex, for instance, is LitFeatures(0, true).
+	explicit LitFeatures(int lightCount = 1, bool texture = false, bool alphaClip = false);
+
+	// Directional lights, 0 to 3; other counts are clamped to that range.  With
+	// none the surface is only textured.
+	int LightCount;
+
+	bool Texture;
+	bool AlphaClip;
+	bool Fog;
+	bool Reflection;
+
+	// World and WorldInvTranspose per instance, with ViewProj and ViewProjTex
+	// in place of the per-object matrices; see ModelInstancer.
+	bool Instanced;
+
+	// Displacement mapping of 3 control point patch lists, with ViewProj and
+	// ViewProjTex; the factors come from TessellationLod::Apply.  NormalMap.fx
+	// only, and not with Instanced.
+	bool Tessellated;
+
+	// A different number for each combination.
+	unsigned int Bits()const;
+
+	// LIT_LIGHT_COUNT, LIT_TEXTURE, LIT_ALPHA_CLIP, LIT_FOG, LIT_REFLECTION,
+	// LIT_INSTANCED and LIT_TESSELLATED, each always set.
+	ShaderDefines Defines()const;
+};
+
+#endif // LITFEATURES_H
@@ -1,4 +1,5 @@
 #include "LoadM3d.h"
+#include "ScopeProfiler.h"
  
 bool M3DLoader::LoadM3d(const std::string& filename, 
 						std::vector<Vertex::PosNormalTexTan>& vertices,
@@ -6,6 +7,8 @@ bool M3DLoader::LoadM3d(const std::string& filename,
 						std::vector<MeshGeometry::Subset>& subsets,
 						std::vector<M3dMaterial>& mats)
 {
+	PROFILE_SCOPE("M3DLoader::LoadM3d");
+
 	std::ifstream fin(filename);
 
 	UINT numMaterials = 0;
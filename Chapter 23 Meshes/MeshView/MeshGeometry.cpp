@@ -1,4 +1,6 @@
 #include "MeshGeometry.h"
+#include <atomic>
+#include <thread>
 
 MeshGeometry::MeshGeometry()
 	: mVB(0), mIB(0), 
@@ -45,4 +47,97 @@ void MeshGeometry::Draw(ID3D11DeviceContext* dc, UINT subsetId)
 		mSubsetTable[subsetId].FaceCount*3, 
 		mSubsetTable[subsetId].FaceStart*3, 
 		0);
-}
\ No newline at end of file
+}
+
+void MeshGeometry::DrawInstanced(ID3D11DeviceContext* dc, UINT subsetId, ID3D11Buffer* instanceBuffer, 
+	UINT instanceStride, UINT startInstance, UINT instanceCount)
+{
+	ID3D11Buffer* vbs[2] = { mVB, instanceBuffer };
+	UINT strides[2] = { mVertexStride, instanceStride };
+	UINT offsets[2] = { 0, 0 };
+
+	dc->IASetVertexBuffers(0, 2, vbs, strides, offsets);
+	dc->IASetIndexBuffer(mIB, mIndexBufferFormat, 0);
+
+	dc->DrawIndexedInstanced(
+		mSubsetTable[subsetId].FaceCount*3, 
+		instanceCount,
+		mSubsetTable[subsetId].FaceStart*3, 
+		0,
+		startInstance);
+}
+
+void MeshGeometry::ComputeSubsetBounds(const std::vector<Subset>& subsets, const XMFLOAT3* positions, UINT vertexStride,
+	XNA::AxisAlignedBox* boxes, XNA::Sphere* spheres)
+{
+	const BYTE* base = reinterpret_cast<const BYTE*>(positions);
+
+	std::vector<UINT> smallSubsets;
+
+	for(UINT i = 0; i < subsets.size(); ++i)
+	{
+		const Subset& subset = subsets[i];
+		const XMFLOAT3* first = reinterpret_cast<const XMFLOAT3*>(base + subset.VertexStart*vertexStride);
+
+		if( subset.VertexCount == 0 )
+		{
+			if( boxes )
+			{
+				boxes[i].Center  = XMFLOAT3(0.0f, 0.0f, 0.0f);
+				boxes[i].Extents = XMFLOAT3(0.0f, 0.0f, 0.0f);
+			}
+			if( spheres )
+			{
+				spheres[i].Center = XMFLOAT3(0.0f, 0.0f, 0.0f);
+				spheres[i].Radius = 0.0f;
+			}
+		}
+		else if( subset.VertexCount >= 2*XNA::ParallelBoundsMinPoints )
+		{
+			if( boxes )
+				XNA::ComputeBoundingAxisAlignedBoxFromPointsParallel(&boxes[i], subset.VertexCount, first, vertexStride);
+			if( spheres )
+				XNA::ComputeBoundingSphereFromPointsParallel(&spheres[i], subset.VertexCount, first, vertexStride);
+		}
+		else
+		{
+			smallSubsets.push_back(i);
+		}
+	}
+
+	if( smallSubsets.empty() )
+		return;
+
+	std::atomic<UINT> next(0);
+
+	auto worker = [&]()
+	{
+		for(;;)
+		{
+			UINT k = next++;
+			if( k >= smallSubsets.size() )
+				return;
+
+			UINT i = smallSubsets[k];
+			const Subset& subset = subsets[i];
+			const XMFLOAT3* first = reinterpret_cast<const XMFLOAT3*>(base + subset.VertexStart*vertexStride);
+
+			if( boxes )
+				XNA::ComputeBoundingAxisAlignedBoxFromPoints(&boxes[i], subset.VertexCount, first, vertexStride);
+			if( spheres )
+				XNA::ComputeBoundingSphereFromPoints(&spheres[i], subset.VertexCount, first, vertexStride);
+		}
+	};
+
+	UINT threadCount = MathHelper::Min<UINT>(std::thread::hardware_concurrency(), smallSubsets.size());
+
+	// The calling thread is one of the workers.
+	std::vector<std::thread> threads;
+	for(UINT t = 1; t < threadCount; ++t)
+		threads.push_back(std::thread(worker));
+
+	worker();
+
+	for(UINT t = 0; t < threads.size(); ++t)
+		threads[t].join();
+}
@@ -2,6 +2,7 @@
 #define MESHGEOMETRY_H
 
 #include "d3dUtil.h"
+#include "xnacollision.h"
 
 class MeshGeometry
 {
@@ -35,6 +36,17 @@ public:
 
 	void Draw(ID3D11DeviceContext* dc, UINT subsetId);
 
+	// Draws instanceCount copies of the subset, reading per-instance data from
+	// instanceBuffer bound to slot 1.
+	void DrawInstanced(ID3D11DeviceContext* dc, UINT subsetId, ID3D11Buffer* instanceBuffer, 
+		UINT instanceStride, UINT startInstance, UINT instanceCount);
+
+	// Fills the bounds of every subset from the positions of the vertices it
+	// covers.  Large subsets are split across threads on their own and the rest
+	// are shared out whole between worker threads.  Either output may be null.
+	static void ComputeSubsetBounds(const std::vector<Subset>& subsets, const XMFLOAT3* positions, UINT vertexStride,
+		XNA::AxisAlignedBox* boxes, XNA::Sphere* spheres);
+
 private:
 	MeshGeometry(const MeshGeometry& rhs);
 	MeshGeometry& operator=(const MeshGeometry& rhs);
@@ -43,11 +43,14 @@ public:
 	void OnResize();
 	void UpdateScene(float dt);
 	void DrawScene(); 
+	void DrawScene(float alpha);
 
 	void OnMouseDown(WPARAM btnState, int x, int y);
 	void OnMouseUp(WPARAM btnState, int x, int y);
 	void OnMouseMove(WPARAM btnState, int x, int y);
 
+	void AppendFrameStats(std::wostream& outs);
+
 private:
 	void DrawSceneToSsaoNormalDepthMap();
 	void DrawSceneToShadowMap();
@@ -73,6 +76,9 @@ private:
 
 	Camera mCam;
 
+	// Camera position before the last simulation tick, for interpolation.
+	XMFLOAT3 mPrevCamPos;
+
 	POINT mLastMousePos;
 };
 
@@ -103,6 +109,10 @@ MeshViewApp::MeshViewApp(HINSTANCE hInstance)
 	mLastMousePos.y = 0;
 
 	mCam.SetPosition(0.0f, 2.0f, -15.0f);
+	mPrevCamPos = mCam.GetPosition();
+
+	// Move the camera in fixed ticks and blend between them when drawing.
+	mFixedTimeStep = 1.0f / 60.0f;
  
 	mDirLights[0].Ambient  = XMFLOAT4(0.6f, 0.6f, 0.6f, 1.0f);
 	mDirLights[0].Diffuse  = XMFLOAT4(0.8f, 0.7f, 0.7f, 1.0f);
@@ -174,19 +184,21 @@ void MeshViewApp::OnResize()
 
 void MeshViewApp::UpdateScene(float dt)
 {
+	mPrevCamPos = mCam.GetPosition();
+
 	//
 	// Control the camera.
 	//
-	if( GetAsyncKeyState('W') & 0x8000 )
+	if( IsKeyDown('W') )
 		mCam.Walk(10.0f*dt);
 
-	if( GetAsyncKeyState('S') & 0x8000 )
+	if( IsKeyDown('S') )
 		mCam.Walk(-10.0f*dt);
 
-	if( GetAsyncKeyState('A') & 0x8000 )
+	if( IsKeyDown('A') )
 		mCam.Strafe(-10.0f*dt);
 
-	if( GetAsyncKeyState('D') & 0x8000 )
+	if( IsKeyDown('D') )
 		mCam.Strafe(10.0f*dt);
 
 	//
@@ -200,6 +212,8 @@ void MeshViewApp::UpdateScene(float dt)
 
 void MeshViewApp::DrawScene()
 {
+	// Count the constant buffer uploads of this frame only.
+	Effects::BasicFX->ResetConstantStats();
 
 	md3dImmediateContext->ClearRenderTargetView(mRenderTargetView, reinterpret_cast<const float*>(&Colors::LightSteelBlue));
 	md3dImmediateContext->ClearDepthStencilView(mDepthStencilView, D3D11_CLEAR_DEPTH|D3D11_CLEAR_STENCIL, 1.0f, 0);
@@ -213,6 +227,37 @@ void MeshViewApp::DrawScene()
 	HR(mSwapChain->Present(0, 0));
 }
 
+void MeshViewApp::DrawScene(float alpha)
+{
+	// Draw from between the positions before and after the last tick, so the 
+	// motion stays smooth when ticks and frames do not line up.
+	XMFLOAT3 camPos = mCam.GetPosition();
+
+	XMFLOAT3 drawPos;
+	XMStoreFloat3(&drawPos, XMVectorLerp(XMLoadFloat3(&mPrevCamPos), XMLoadFloat3(&camPos), alpha));
+
+	mCam.SetPosition(drawPos);
+	mCam.UpdateViewMatrix();
+
+	DrawScene();
+
+	mCam.SetPosition(camPos);
+	mCam.UpdateViewMatrix();
+}
+
+void MeshViewApp::AppendFrameStats(std::wostream& outs)
+{
+	const RenderQueue::FrameStats& stats = mHuman->QueueStats();
+
+	outs << L"    State changes: " << stats.UnfilteredChanges
+		 << L" -> " << stats.StateChanges;
+
+	const EffectConstantCache::Stats& constants = Effects::BasicFX->ConstantStats();
+
+	outs << L"    Constants: " << constants.BytesUploaded << L" bytes, "
+		 << constants.SkippedWrites << L" sets skipped";
+}
+
 void MeshViewApp::OnMouseDown(WPARAM btnState, int x, int y)
 {
 	mLastMousePos.x = x;
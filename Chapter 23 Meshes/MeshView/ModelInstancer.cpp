@@ -0,0 +1,210 @@
+//***************************************************************************************
+// ModelInstancer.cpp
+//***************************************************************************************
+
+#include "ModelInstancer.h"
+#include "Effects.h"
+#include "MathHelper.h"
+#include "ScopeProfiler.h"
+#include <map>
+
+namespace
+{
+	void SetSubsetMaps(BasicEffect* fx, const BasicModel* model, UINT subset)
+	{
+		fx->SetDiffuseMap(model->textureResourceView[subset]);
+	}
+
+	void SetSubsetMaps(NormalMapEffect* fx, const BasicModel* model, UINT subset)
+	{
+		fx->SetDiffuseMap(model->textureResourceView[subset]);
+		fx->SetNormalMap(model->NormalMapSRV[subset]);
+	}
+}
+
+ModelInstancer::ModelInstancer(ID3D11Device* device, UINT initialCapacity)
+	: md3dDevice(device), mInstanceBuffer(0), mCapacity(0)
+{
+	mStats.Models = 0;
+	mStats.Instances = 0;
+	mStats.DrawCalls = 0;
+
+	Reserve(initialCapacity > 0 ? initialCapacity : 1);
+}
+
+ModelInstancer::~ModelInstancer()
+{
+	ReleaseCOM(mInstanceBuffer);
+}
+
+const ModelInstancer::DrawStats& ModelInstancer::Stats()const
+{
+	return mStats;
+}
+
+void ModelInstancer::Reserve(UINT instanceCount)
+{
+	if( instanceCount <= mCapacity )
+		return;
+
+	UINT capacity = mCapacity > 0 ? mCapacity : 1;
+	while( capacity < instanceCount )
+		capacity *= 2;
+
+	ReleaseCOM(mInstanceBuffer);
+
+	D3D11_BUFFER_DESC vbd;
+	vbd.Usage = D3D11_USAGE_DYNAMIC;
+	vbd.ByteWidth = sizeof(Vertex::InstancedData) * capacity;
+	vbd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+	vbd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	vbd.MiscFlags = 0;
+	vbd.StructureByteStride = 0;
+
+	HR(md3dDevice->CreateBuffer(&vbd, 0, &mInstanceBuffer));
+
+	mCapacity = capacity;
+}
+
+void ModelInstancer::Upload(ID3D11DeviceContext* dc, const std::vector<BasicModelInstance>& instances)
+{
+	PROFILE_SCOPE("ModelInstancer::Upload");
+
+	mBatches.clear();
+
+	// Count the instances of each model, numbering the models in the order they
+	// first appear so the draw order does not depend on pointer values.
+	std::map<BasicModel*, UINT> batchIndex;
+	std::vector<UINT> instanceBatch(instances.size());
+
+	for(size_t i = 0; i < instances.size(); ++i)
+	{
+		std::map<BasicModel*, UINT>::iterator it = batchIndex.find(instances[i].Model);
+		if( it == batchIndex.end() )
+		{
+			Batch batch;
+			batch.Model = instances[i].Model;
+			batch.StartInstance = 0;
+			batch.InstanceCount = 0;
+
+			it = batchIndex.insert(std::make_pair(instances[i].Model, (UINT)mBatches.size())).first;
+			mBatches.push_back(batch);
+		}
+
+		instanceBatch[i] = it->second;
+		mBatches[it->second].InstanceCount++;
+	}
+
+	UINT start = 0;
+	for(size_t b = 0; b < mBatches.size(); ++b)
+	{
+		mBatches[b].StartInstance = start;
+		start += mBatches[b].InstanceCount;
+	}
+
+	// Scatter the matrices into their batch's run.
+	mInstanceData.resize(instances.size());
+
+	std::vector<UINT> next(mBatches.size());
+	for(size_t b = 0; b < mBatches.size(); ++b)
+		next[b] = mBatches[b].StartInstance;
+
+	for(size_t i = 0; i < instances.size(); ++i)
+	{
+		Vertex::InstancedData& data = mInstanceData[next[instanceBatch[i]]++];
+
+		XMMATRIX world = XMLoadFloat4x4(&instances[i].World);
+		data.World = instances[i].World;
+		XMStoreFloat4x4(&data.WorldInvTranspose, MathHelper::InverseTranspose(world));
+	}
+
+	mStats.Models = (UINT)mBatches.size();
+	mStats.Instances = (UINT)instances.size();
+
+	if( instances.empty() )
+		return;
+
+	Reserve((UINT)instances.size());
+
+	D3D11_MAPPED_SUBRESOURCE mappedData;
+	HR(dc->Map(mInstanceBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedData));
+	memcpy(mappedData.pData, &mInstanceData[0], sizeof(Vertex::InstancedData) * mInstanceData.size());
+	dc->Unmap(mInstanceBuffer, 0);
+}
+
+void ModelInstancer::Draw(ID3D11DeviceContext* dc, BasicEffect* fx,
+	ID3DX11EffectTechnique* tech, ID3DX11EffectTechnique* alphaClipTech)
+{
+	DrawBatches(dc, fx, tech, alphaClipTech);
+}
+
+void ModelInstancer::Draw(ID3D11DeviceContext* dc, NormalMapEffect* fx,
+	ID3DX11EffectTechnique* tech, ID3DX11EffectTechnique* alphaClipTech)
+{
+	DrawBatches(dc, fx, tech, alphaClipTech);
+}
+
+bool ModelInstancer::HasSubsets(bool alphaClip)const
+{
+	for(size_t b = 0; b < mBatches.size(); ++b)
+	{
+		const BasicModel* model = mBatches[b].Model;
+
+		for(UINT subset = 0; subset < model->SubsetCount; ++subset)
+		{
+			if( model->AlphaClip[subset] == alphaClip )
+				return true;
+		}
+	}
+
+	return false;
+}
+
+template <typename EffectType>
+void ModelInstancer::DrawBatches(ID3D11DeviceContext* dc, EffectType* fx,
+	ID3DX11EffectTechnique* tech, ID3DX11EffectTechnique* alphaClipTech)
+{
+	PROFILE_SCOPE("ModelInstancer::Draw");
+
+	mStats.DrawCalls = 0;
+
+	fx->SetTexTransform(XMMatrixIdentity());
+
+	// Opaque subsets first, then the alpha clipped ones, so the technique only
+	// changes once.
+	for(int clipped = 0; clipped < 2; ++clipped)
+	{
+		ID3DX11EffectTechnique* activeTech = clipped ? alphaClipTech : tech;
+
+		// Callers that never clip may pass no clip technique at all.
+		if( activeTech == 0 || !HasSubsets(clipped != 0) )
+			continue;
+
+		D3DX11_TECHNIQUE_DESC techDesc;
+		activeTech->GetDesc(&techDesc);
+
+		for(UINT p = 0; p < techDesc.Passes; ++p)
+		{
+			for(size_t b = 0; b < mBatches.size(); ++b)
+			{
+				const Batch& batch = mBatches[b];
+				BasicModel* model = batch.Model;
+
+				for(UINT subset = 0; subset < model->SubsetCount; ++subset)
+				{
+					if( model->AlphaClip[subset] != (clipped != 0) )
+						continue;
+
+					fx->SetMaterial(model->Mat[subset]);
+					SetSubsetMaps(fx, model, subset);
+
+					fx->Apply(activeTech->GetPassByIndex(p), dc);
+					model->ModelMesh.DrawInstanced(dc, subset, mInstanceBuffer, sizeof(Vertex::InstancedData),
+						batch.StartInstance, batch.InstanceCount);
+
+					mStats.DrawCalls++;
+				}
+			}
+		}
+	}
+}
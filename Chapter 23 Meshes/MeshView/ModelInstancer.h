@@ -0,0 +1,86 @@
+//***************************************************************************************
+// ModelInstancer.h
+//
+// Draws lists of model instances with hardware instancing.  The instances are
+// grouped by model and their world matrices streamed into a dynamic vertex buffer,
+// so each model subset costs one DrawIndexedInstanced however many copies of the
+// model there are.
+//
+// The caller binds InputLayouts::InstancedPosNormalTexTan and sets the per frame
+// effect variables (lights, eye position, ViewProj, ViewProjTex, shadow and SSAO
+// maps).  Note the instanced techniques apply gShadowTransform to world space
+// positions, so it should not include a world matrix.  The instancer sets the
+// material and textures of each subset.
+//***************************************************************************************
+
+#ifndef MODELINSTANCER_H
+#define MODELINSTANCER_H
+
+#include "BasicModel.h"
+
+class BasicEffect;
+class NormalMapEffect;
+struct ID3DX11EffectTechnique;
+
+class ModelInstancer
+{
+public:
+	struct DrawStats
+	{
+		UINT Models;     // Distinct models in the last upload.
+		UINT Instances;
+		UINT DrawCalls;  // Instanced draws issued by the last Draw.
+	};
+
+	// The instance buffer starts with room for initialCapacity instances and
+	// doubles whenever an upload does not fit.
+	ModelInstancer(ID3D11Device* device, UINT initialCapacity = 256);
+	~ModelInstancer();
+
+	// Groups the instances by model, keeping the order in which the models first
+	// appear, and writes them to the instance buffer.
+	void Upload(ID3D11DeviceContext* dc, const std::vector<BasicModelInstance>& instances);
+
+	// Draws everything from the last upload.  Subsets whose material asks for
+	// alpha clipping use alphaClipTech, the rest tech.  A null technique skips
+	// its subsets.
+	void Draw(ID3D11DeviceContext* dc, BasicEffect* fx,
+		ID3DX11EffectTechnique* tech, ID3DX11EffectTechnique* alphaClipTech);
+	void Draw(ID3D11DeviceContext* dc, NormalMapEffect* fx,
+		ID3DX11EffectTechnique* tech, ID3DX11EffectTechnique* alphaClipTech);
+
+	const DrawStats& Stats()const;
+
+private:
+	ModelInstancer(const ModelInstancer& rhs);
+	ModelInstancer& operator=(const ModelInstancer& rhs);
+
+	// A run of instances of one model in the instance buffer.
+	struct Batch
+	{
+		BasicModel* Model;
+		UINT StartInstance;
+		UINT InstanceCount;
+	};
+
+	void Reserve(UINT instanceCount);
+
+	// True if any batched subset does, or does not, ask for alpha clipping.
+	bool HasSubsets(bool alphaClip)const;
+
+	template <typename EffectType>
+	void DrawBatches(ID3D11DeviceContext* dc, EffectType* fx,
+		ID3DX11EffectTechnique* tech, ID3DX11EffectTechnique* alphaClipTech);
+
+private:
+	ID3D11Device* md3dDevice;
+	ID3D11Buffer* mInstanceBuffer;
+	UINT mCapacity;
+
+	std::vector<Batch> mBatches;
+	std::vector<Vertex::InstancedData> mInstanceData;
+
+	DrawStats mStats;
+};
+
+#endif // MODELINSTANCER_H
@@ -0,0 +1,262 @@
+//***************************************************************************************
+// ModelPasses.cpp
+//***************************************************************************************
+
+#include "ModelPasses.h"
+#include "Effects.h"
+#include "Vertex.h"
+#include "RenderStates.h"
+#include "ScopeProfiler.h"
+#include <thread>
+
+namespace
+{
+	UINT DefaultContextCount()
+	{
+		UINT threads = std::thread::hardware_concurrency();
+		return threads > 0 ? threads : 1;
+	}
+
+	// Instance i of the pass, counting the opaque instances first.
+	const BasicModelInstance& GetInstance(const std::vector<BasicModelInstance>& instances,
+		const std::vector<BasicModelInstance>& alphaClippedInstances, UINT i)
+	{
+		return i < instances.size() ? instances[i] : alphaClippedInstances[i - instances.size()];
+	}
+}
+
+ModelPasses::ModelPasses(ID3D11Device* device, ID3D11DeviceContext* immediateContext, UINT contextCount)
+	: mContexts(device, immediateContext, contextCount > 0 ? contextCount : DefaultContextCount()),
+	  mRecorder(mContexts),
+	  mTessellation(0)
+{
+	// Large models make a few instances enough work for a context.
+	mRecorder.SetMinItemsPerChunk(4);
+
+	for(UINT i = 0; i < mContexts.ContextCount(); ++i)
+	{
+		mShadowFX.push_back(Effects::BuildShadowMapFX->Clone());
+		mNormalDepthFX.push_back(Effects::SsaoNormalDepthFX->Clone());
+	}
+}
+
+ModelPasses::~ModelPasses()
+{
+	for(size_t i = 0; i < mShadowFX.size(); ++i)
+	{
+		SafeDelete(mShadowFX[i]);
+		SafeDelete(mNormalDepthFX[i]);
+	}
+}
+
+UINT ModelPasses::LastChunkCount()const
+{
+	return (UINT)mRecorder.Chunks().size();
+}
+
+void ModelPasses::SetTessellation(const TessellationLod* tessellation)
+{
+	mTessellation = tessellation;
+}
+
+void ModelPasses::DrawShadowMap(const std::vector<BasicModelInstance>& instances,
+	const std::vector<BasicModelInstance>& alphaClippedInstances,
+	CXMMATRIX lightView, CXMMATRIX lightProj, const XMFLOAT3& eyePosW, bool wireframe)
+{
+	UINT itemCount = (UINT)(instances.size() + alphaClippedInstances.size());
+
+	DrawShadowMap(instances, alphaClippedInstances, 0, itemCount, lightView, lightProj, eyePosW, wireframe);
+}
+
+void ModelPasses::DrawShadowMap(const std::vector<BasicModelInstance>& instances,
+	const std::vector<BasicModelInstance>& alphaClippedInstances, const std::vector<UINT>& casters,
+	CXMMATRIX lightView, CXMMATRIX lightProj, const XMFLOAT3& eyePosW, bool wireframe)
+{
+	if( casters.empty() )
+		return;
+
+	DrawShadowMap(instances, alphaClippedInstances, &casters[0], (UINT)casters.size(),
+		lightView, lightProj, eyePosW, wireframe);
+}
+
+void ModelPasses::DrawShadowMap(const std::vector<BasicModelInstance>& instances,
+	const std::vector<BasicModelInstance>& alphaClippedInstances, const UINT* order, UINT itemCount,
+	CXMMATRIX lightView, CXMMATRIX lightProj, const XMFLOAT3& eyePosW, bool wireframe)
+{
+	PROFILE_SCOPE("ModelPasses::DrawShadowMap");
+
+	XMFLOAT4X4 view;
+	XMFLOAT4X4 proj;
+	XMStoreFloat4x4(&view, lightView);
+	XMStoreFloat4x4(&proj, lightProj);
+
+	// Culling for the tessellated subsets; each adds its material.
+	TessellationReference::Constants passTess = TessellationReference::Constants();
+	if( mTessellation )
+		passTess = mTessellation->ShadowPass(lightView, lightProj);
+
+	mRecorder.Record(itemCount, [&](UINT context, UINT begin, UINT end)
+	{
+		ID3D11DeviceContext* dc = mContexts.Context(context);
+		BuildShadowMapEffect* fx = mShadowFX[context];
+
+		XMMATRIX V = XMLoadFloat4x4(&view);
+		XMMATRIX P = XMLoadFloat4x4(&proj);
+
+		fx->SetEyePosW(eyePosW);
+		fx->SetViewProj(V*P);
+		fx->SetTexTransform(XMMatrixScaling(1.0f, 1.0f, 1.0f));
+
+		dc->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+		dc->IASetInputLayout(InputLayouts::PosNormalTexTan);
+
+		if( wireframe )
+			dc->RSSetState(RenderStates::WireframeRS);
+
+		bool tessellating = false;
+
+		D3DX11_TECHNIQUE_DESC techDesc;
+		for(UINT item = begin; item < end; ++item)
+		{
+			UINT i = order ? order[item] : item;
+
+			const BasicModelInstance& instance = GetInstance(instances, alphaClippedInstances, i);
+			bool alphaClipped = i >= instances.size();
+
+			XMMATRIX world = XMLoadFloat4x4(&instance.World);
+
+			fx->SetWorld(world);
+			fx->SetWorldInvTranspose(MathHelper::InverseTranspose(world));
+			fx->SetWorldViewProj(world*V*P);
+
+			ID3DX11EffectTechnique* appliedTech = 0;
+
+			for(UINT subset = 0; subset < instance.Model->SubsetCount; ++subset)
+			{
+				const TessellationSettings& settings = instance.Model->Tessellation[subset];
+				bool tessellated = mTessellation && settings.Enabled;
+
+				ID3DX11EffectTechnique* tech;
+				if( tessellated )
+					tech = alphaClipped ? fx->TessBuildShadowMapAlphaClipTech : fx->TessBuildShadowMapTech;
+				else
+					tech = alphaClipped ? fx->BuildShadowMapAlphaClipTech : fx->BuildShadowMapTech;
+
+				// Opaque subsets drawn without tessellation all share one state.
+				bool newState = alphaClipped || tessellated || tech != appliedTech;
+
+				if( tessellated )
+				{
+					TessellationReference::Constants c = passTess;
+					TessellationLod::SetMaterial(settings, c);
+					TessellationLod::Apply(fx, c);
+
+					fx->SetNormalMap(instance.Model->NormalMapSRV[subset]);
+				}
+
+				if( alphaClipped )
+					fx->SetDiffuseMap(instance.Model->textureResourceView[subset]);
+
+				if( tessellated != tessellating )
+				{
+					dc->IASetPrimitiveTopology(tessellated ? D3D11_PRIMITIVE_TOPOLOGY_3_CONTROL_POINT_PATCHLIST :
+						D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+					// FX sets the tessellation stages, but it does not disable them.
+					if( !tessellated )
+					{
+						dc->HSSetShader(0, 0, 0);
+						dc->DSSetShader(0, 0, 0);
+					}
+
+					tessellating = tessellated;
+				}
+
+				tech->GetDesc( &techDesc );
+				for(UINT p = 0; p < techDesc.Passes; ++p)
+				{
+					if( newState || techDesc.Passes > 1 )
+						tech->GetPassByIndex(p)->Apply(0, dc);
+
+					instance.Model->ModelMesh.Draw(dc, subset);
+				}
+
+				appliedTech = tech;
+			}
+		}
+
+		if( tessellating )
+		{
+			dc->HSSetShader(0, 0, 0);
+			dc->DSSetShader(0, 0, 0);
+		}
+	});
+}
+
+void ModelPasses::DrawNormalDepth(const std::vector<BasicModelInstance>& instances,
+	const std::vector<BasicModelInstance>& alphaClippedInstances,
+	const Camera& camera, bool wireframe)
+{
+	PROFILE_SCOPE("ModelPasses::DrawNormalDepth");
+
+	XMFLOAT4X4 view;
+	XMFLOAT4X4 proj;
+	XMStoreFloat4x4(&view, camera.View());
+	XMStoreFloat4x4(&proj, camera.Proj());
+
+	UINT itemCount = (UINT)(instances.size() + alphaClippedInstances.size());
+
+	mRecorder.Record(itemCount, [&](UINT context, UINT begin, UINT end)
+	{
+		ID3D11DeviceContext* dc = mContexts.Context(context);
+		SsaoNormalDepthEffect* fx = mNormalDepthFX[context];
+
+		XMMATRIX V = XMLoadFloat4x4(&view);
+		XMMATRIX P = XMLoadFloat4x4(&proj);
+
+		fx->SetTexTransform(XMMatrixScaling(1.0f, 1.0f, 1.0f));
+
+		dc->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+		dc->IASetInputLayout(InputLayouts::PosNormalTexTan);
+
+		if( wireframe )
+			dc->RSSetState(RenderStates::WireframeRS);
+
+		D3DX11_TECHNIQUE_DESC techDesc;
+		for(UINT i = begin; i < end; ++i)
+		{
+			const BasicModelInstance& instance = GetInstance(instances, alphaClippedInstances, i);
+			bool alphaClipped = i >= instances.size();
+
+			XMMATRIX world = XMLoadFloat4x4(&instance.World);
+			XMMATRIX worldInvTranspose = MathHelper::InverseTranspose(world);
+
+			fx->SetWorldView(world*V);
+			fx->SetWorldInvTransposeView(worldInvTranspose*V);
+			fx->SetWorldViewProj(world*V*P);
+
+			// The alpha tested triangles are leaves, so render them double sided.
+			if( alphaClipped && !wireframe )
+				dc->RSSetState(RenderStates::NoCullRS);
+
+			ID3DX11EffectTechnique* tech = alphaClipped ? fx->NormalDepthAlphaClipTech : fx->NormalDepthTech;
+			tech->GetDesc( &techDesc );
+
+			for(UINT p = 0; p < techDesc.Passes; ++p)
+			{
+				for(UINT subset = 0; subset < instance.Model->SubsetCount; ++subset)
+				{
+					if( alphaClipped || subset == 0 )
+					{
+						if( alphaClipped )
+							fx->SetDiffuseMap(instance.Model->textureResourceView[subset]);
+
+						tech->GetPassByIndex(p)->Apply(0, dc);
+					}
+
+					instance.Model->ModelMesh.Draw(dc, subset);
+				}
+			}
+		}
+	});
+}
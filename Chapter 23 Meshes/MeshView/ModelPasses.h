@@ -0,0 +1,74 @@
+//***************************************************************************************
+// ModelPasses.h
+//
+// The shadow map and SSAO normal/depth passes over lists of model instances,
+// recorded on several threads with deferred contexts.  Each context draws with its
+// own clone of the pass effect, since effect variables are not thread safe.
+//
+// Both passes draw into whatever render targets, depth buffer and viewport are
+// bound on the immediate context when they are called, e.g. after
+// ShadowMap::BindDsvAndSetNullRenderTarget or Ssao::SetNormalDepthRenderTarget.
+//***************************************************************************************
+
+#ifndef MODELPASSES_H
+#define MODELPASSES_H
+
+#include "DeferredContexts.h"
+#include "BasicModel.h"
+#include "Camera.h"
+
+class BuildShadowMapEffect;
+class SsaoNormalDepthEffect;
+
+class ModelPasses
+{
+public:
+	// The effects must have been created with Effects::InitAll.  A contextCount of
+	// 0 uses one context per hardware thread.
+	ModelPasses(ID3D11Device* device, ID3D11DeviceContext* immediateContext, UINT contextCount = 0);
+	~ModelPasses();
+
+	void DrawShadowMap(const std::vector<BasicModelInstance>& instances,
+		const std::vector<BasicModelInstance>& alphaClippedInstances,
+		CXMMATRIX lightView, CXMMATRIX lightProj, const XMFLOAT3& eyePosW, bool wireframe);
+
+	// Draws only the listed instances, as found by ShadowCasterCuller: indices
+	// count the opaque instances first, then the alpha clipped ones.
+	void DrawShadowMap(const std::vector<BasicModelInstance>& instances,
+		const std::vector<BasicModelInstance>& alphaClippedInstances, const std::vector<UINT>& casters,
+		CXMMATRIX lightView, CXMMATRIX lightProj, const XMFLOAT3& eyePosW, bool wireframe);
+
+	void DrawNormalDepth(const std::vector<BasicModelInstance>& instances,
+		const std::vector<BasicModelInstance>& alphaClippedInstances,
+		const Camera& camera, bool wireframe);
+
+	// With a TessellationLod, the shadow passes draw the subsets whose
+	// Tessellation is enabled with the displacement mapped techniques, culling
+	// the patches outside the light's volume.  Its eye should be the one passed
+	// as eyePosW.  Null, the default, draws every subset untessellated.
+	void SetTessellation(const TessellationLod* tessellation);
+
+	// Chunks the last pass was split into.
+	UINT LastChunkCount()const;
+
+private:
+	ModelPasses(const ModelPasses& rhs);
+	ModelPasses& operator=(const ModelPasses& rhs);
+
+	// Draws items [0, itemCount), where item i is instance order[i], or instance
+	// i if order is null.
+	void DrawShadowMap(const std::vector<BasicModelInstance>& instances,
+		const std::vector<BasicModelInstance>& alphaClippedInstances, const UINT* order, UINT itemCount,
+		CXMMATRIX lightView, CXMMATRIX lightProj, const XMFLOAT3& eyePosW, bool wireframe);
+
+private:
+	DeferredContexts mContexts;
+	PassRecorder mRecorder;
+
+	std::vector<BuildShadowMapEffect*> mShadowFX;
+	std::vector<SsaoNormalDepthEffect*> mNormalDepthFX;
+
+	const TessellationLod* mTessellation;
+};
+
+#endif // MODELPASSES_H
@@ -0,0 +1,356 @@
+//***************************************************************************************
+// ShaderCache.cpp
+//***************************************************************************************
+
+#include "ShaderCache.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+const unsigned long long ShaderCache::HashSeed = 14695981039346656037ULL;
+
+namespace
+{
+	// Bumped when the entry layout changes.
+	const char EntryMagic[4] = { 'S', 'H', 'C', '1' };
+
+	bool ReadFile(const std::string& path, std::vector<char>& data)
+	{
+		std::ifstream fin(path.c_str(), std::ios::binary);
+		if( !fin )
+			return false;
+
+		fin.seekg(0, std::ios_base::end);
+		std::streamoff size = fin.tellg();
+		fin.seekg(0, std::ios_base::beg);
+
+		data.resize((size_t)size);
+		if( size > 0 )
+			fin.read(&data[0], size);
+
+		return !fin.fail();
+	}
+
+	std::string DirectoryOf(const std::string& path)
+	{
+		size_t slash = path.find_last_of("/\\");
+		return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+	}
+
+	// The file names of the #include "..." lines of a source.  Includes in
+	// angle brackets are system headers and are not followed.
+	void FindIncludes(const std::vector<char>& source, std::vector<std::string>& includes)
+	{
+		const char* p = source.empty() ? 0 : &source[0];
+		const char* end = p + source.size();
+
+		while( p < end )
+		{
+			const char* lineEnd = std::find(p, end, '\n');
+
+			const char* c = p;
+			while( c < lineEnd && (*c == ' ' || *c == '\t') )
+				++c;
+
+			if( c < lineEnd && *c == '#' )
+			{
+				++c;
+				while( c < lineEnd && (*c == ' ' || *c == '\t') )
+					++c;
+
+				static const char directive[] = "include";
+				size_t length = sizeof(directive) - 1;
+				if( (size_t)(lineEnd - c) > length && std::equal(directive, directive + length, c) )
+				{
+					const char* open = std::find(c + length, lineEnd, '"');
+					const char* close = open < lineEnd ? std::find(open + 1, lineEnd, '"') : lineEnd;
+
+					if( close < lineEnd )
+						includes.push_back(std::string(open + 1, close));
+				}
+			}
+
+			p = lineEnd + 1;
+		}
+	}
+
+	void WriteUInt32(std::ofstream& fout, unsigned int v)
+	{
+		unsigned char bytes[4] = { (unsigned char)v, (unsigned char)(v >> 8), (unsigned char)(v >> 16), (unsigned char)(v >> 24) };
+		fout.write(reinterpret_cast<const char*>(bytes), 4);
+	}
+
+	bool ReadUInt32(std::ifstream& fin, unsigned int& v)
+	{
+		unsigned char bytes[4];
+		if( !fin.read(reinterpret_cast<char*>(bytes), 4) )
+			return false;
+
+		v = bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((unsigned int)bytes[3] << 24);
+		return true;
+	}
+}
+
+//
+// ShaderDefines
+//
+
+void ShaderDefines::Set(const std::string& name, const std::string& value)
+{
+	std::vector<Define>::iterator it = std::lower_bound(mItems.begin(), mItems.end(), Define(name, std::string()));
+
+	if( it != mItems.end() && it->first == name )
+		it->second = value;
+	else
+		mItems.insert(it, Define(name, value));
+}
+
+void ShaderDefines::Set(const std::string& name, int value)
+{
+	std::ostringstream ss;
+	ss << value;
+	Set(name, ss.str());
+}
+
+void ShaderDefines::Merge(const ShaderDefines& other)
+{
+	for(size_t i = 0; i < other.mItems.size(); ++i)
+		Set(other.mItems[i].first, other.mItems[i].second);
+}
+
+const std::vector<ShaderDefines::Define>& ShaderDefines::Items()const
+{
+	return mItems;
+}
+
+std::string ShaderDefines::ToString()const
+{
+	std::string s;
+	for(size_t i = 0; i < mItems.size(); ++i)
+	{
+		if( i > 0 )
+			s += ';';
+		s += mItems[i].first + '=' + mItems[i].second;
+	}
+
+	return s;
+}
+
+//
+// ShaderCache
+//
+
+ShaderCache::ShaderCache(const std::string& directory, const std::string& compilerTag, const Compiler& compiler)
+	: mDirectory(directory), mCompilerTag(compilerTag), mCompiler(compiler)
+{
+	if( !mDirectory.empty() && mDirectory[mDirectory.size() - 1] != '/' && mDirectory[mDirectory.size() - 1] != '\\' )
+		mDirectory += '/';
+
+	ResetStats();
+}
+
+const ShaderCache::Stats& ShaderCache::GetStats()const
+{
+	return mStats;
+}
+
+void ShaderCache::ResetStats()
+{
+	mStats.Loads = 0;
+	mStats.DiskHits = 0;
+	mStats.Compiles = 0;
+	mStats.Failures = 0;
+}
+
+void ShaderCache::ForgetSources()
+{
+	mSourceHashes.clear();
+}
+
+unsigned long long ShaderCache::Hash(const void* data, size_t size, unsigned long long hash)
+{
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	for(size_t i = 0; i < size; ++i)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+
+	return hash;
+}
+
+void ShaderCache::HashFile(const std::string& path, unsigned long long& hash, std::set<std::string>& visited)const
+{
+	// The name goes in too, so moving text between files changes the key.
+	hash = Hash(path.c_str(), path.size() + 1, hash);
+
+	// A file included twice adds nothing the first time did not.
+	if( !visited.insert(path).second )
+		return;
+
+	std::vector<char> source;
+	if( !ReadFile(path, source) )
+		return;
+
+	if( !source.empty() )
+		hash = Hash(&source[0], source.size(), hash);
+
+	std::vector<std::string> includes;
+	FindIncludes(source, includes);
+
+	std::string directory = DirectoryOf(path);
+	for(size_t i = 0; i < includes.size(); ++i)
+		HashFile(directory + includes[i], hash, visited);
+}
+
+unsigned long long ShaderCache::SourceHash(const std::string& sourcePath)
+{
+	std::map<std::string, unsigned long long>::iterator it = mSourceHashes.find(sourcePath);
+	if( it != mSourceHashes.end() )
+		return it->second;
+
+	unsigned long long hash = HashSeed;
+	std::set<std::string> visited;
+	HashFile(sourcePath, hash, visited);
+
+	mSourceHashes[sourcePath] = hash;
+	return hash;
+}
+
+std::string ShaderCache::Description(const std::string& sourcePath, const ShaderDefines& defines)const
+{
+	return sourcePath + '|' + mCompilerTag + '|' + defines.ToString();
+}
+
+unsigned long long ShaderCache::Key(const std::string& sourcePath, const ShaderDefines& defines)
+{
+	std::string description = Description(sourcePath, defines);
+	return Hash(description.c_str(), description.size(), SourceHash(sourcePath));
+}
+
+std::string ShaderCache::EntryPath(const std::string& sourcePath, unsigned long long key)const
+{
+	// The source's file name without its directory or extension.
+	size_t slash = sourcePath.find_last_of("/\\");
+	std::string name = slash == std::string::npos ? sourcePath : sourcePath.substr(slash + 1);
+	name = name.substr(0, name.find_last_of('.'));
+
+	std::ostringstream ss;
+	ss << mDirectory << name << '_' << std::hex << std::setw(16) << std::setfill('0') << key << ".fxo";
+
+	return ss.str();
+}
+
+bool ShaderCache::Load(const std::string& sourcePath, const ShaderDefines& defines,
+	std::vector<char>& bytecode, std::string* errors)
+{
+	mStats.Loads++;
+
+	unsigned long long key = Key(sourcePath, defines);
+	std::string description = Description(sourcePath, defines);
+	std::string path = EntryPath(sourcePath, key);
+
+	if( ReadEntry(path, key, description, bytecode) )
+	{
+		mStats.DiskHits++;
+		return true;
+	}
+
+	mStats.Compiles++;
+
+	std::string messages;
+	bytecode.clear();
+	if( !mCompiler(sourcePath, defines, bytecode, messages) )
+	{
+		mStats.Failures++;
+		if( errors )
+			*errors = messages;
+
+		return false;
+	}
+
+	// A failed write only costs a compile next time.
+	WriteEntry(path, key, description, bytecode);
+
+	return true;
+}
+
+bool ShaderCache::ReadEntry(const std::string& path, unsigned long long key, const std::string& description,
+	std::vector<char>& bytecode)const
+{
+	std::ifstream fin(path.c_str(), std::ios::binary);
+	if( !fin )
+		return false;
+
+	char magic[4];
+	if( !fin.read(magic, 4) || !std::equal(magic, magic + 4, EntryMagic) )
+		return false;
+
+	unsigned int keyLow, keyHigh, descriptionSize;
+	if( !ReadUInt32(fin, keyLow) || !ReadUInt32(fin, keyHigh) || !ReadUInt32(fin, descriptionSize) )
+		return false;
+
+	if( (((unsigned long long)keyHigh << 32) | keyLow) != key || descriptionSize != description.size() )
+		return false;
+
+	std::string stored(descriptionSize, '\0');
+	if( descriptionSize > 0 && !fin.read(&stored[0], descriptionSize) )
+		return false;
+
+	if( stored != description )
+		return false;
+
+	unsigned int size;
+	if( !ReadUInt32(fin, size) || size == 0 )
+		return false;
+
+	bytecode.resize(size);
+	if( !fin.read(&bytecode[0], size) )
+	{
+		bytecode.clear();
+		return false;
+	}
+
+	return true;
+}
+
+bool ShaderCache::WriteEntry(const std::string& path, unsigned long long key, const std::string& description,
+	const std::vector<char>& bytecode)const
+{
+	if( bytecode.empty() )
+		return false;
+
+	std::string temp = path + ".tmp";
+	{
+		std::ofstream fout(temp.c_str(), std::ios::binary | std::ios::trunc);
+		if( !fout )
+			return false;
+
+		fout.write(EntryMagic, 4);
+		WriteUInt32(fout, (unsigned int)key);
+		WriteUInt32(fout, (unsigned int)(key >> 32));
+		WriteUInt32(fout, (unsigned int)description.size());
+		fout.write(description.c_str(), description.size());
+		WriteUInt32(fout, (unsigned int)bytecode.size());
+		fout.write(&bytecode[0], bytecode.size());
+
+		if( !fout )
+		{
+			fout.close();
+			std::remove(temp.c_str());
+			return false;
+		}
+	}
+
+	// rename does not replace an existing file on Windows.
+	std::remove(path.c_str());
+	if( std::rename(temp.c_str(), path.c_str()) != 0 )
+	{
+		std::remove(temp.c_str());
+		return false;
+	}
+
+	return true;
+}
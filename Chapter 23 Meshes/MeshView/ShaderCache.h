@@ -0,0 +1,118 @@
+//***************************************************************************************
+// ShaderCache.h
+//
+// Compiles a shader source file once per set of defines and keeps the bytecode
+// on disk, so a permutation is only compiled the first time any run asks for it.
+//   -The key of a permutation is a 64 bit FNV-1a hash of the source file, every
+//    file it #includes (followed recursively), the defines, and a tag naming
+//    the compiler and its flags.  Editing any of them gives a new key.
+//   -An entry is one file in the cache directory, named after the source and
+//    the key.  It repeats the source path, tag and defines, which are checked
+//    on load, so two permutations whose keys collide are never confused.
+//   -On a miss the Compiler function is called and its output written to a
+//    temporary file that is then renamed, so an interrupted write never leaves
+//    a truncated entry behind.
+// Uses only the standard library; the compiler is supplied by the caller, so the
+// keys and cache can be checked without a device.
+//***************************************************************************************
+
+#ifndef SHADERCACHE_H
+#define SHADERCACHE_H
+
+#include <functional>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+
+// A set of preprocessor defines, kept sorted by name so the same set always
+// gives the same key, whatever order it was built in.
+class ShaderDefines
+{
+public:
+	typedef std::pair<std::string, std::string> Define;
+
+	// Adds a define, or replaces the value of one with the same name.
+	void Set(const std::string& name, const std::string& value);
+	void Set(const std::string& name, int value);
+
+	// Sets each of other's defines.
+	void Merge(const ShaderDefines& other);
+
+	const std::vector<Define>& Items()const;
+
+	// "NAME=value;NAME=value" in name order.
+	std::string ToString()const;
+
+private:
+	std::vector<Define> mItems;
+};
+
+class ShaderCache
+{
+public:
+	// Compiles the source with the defines.  On failure returns false, with
+	// the compiler's messages in errors.
+	typedef std::function<bool(const std::string& sourcePath, const ShaderDefines& defines,
+		std::vector<char>& bytecode, std::string& errors)> Compiler;
+
+	struct Stats
+	{
+		unsigned int Loads;     // Calls to Load.
+		unsigned int DiskHits;  // Loads served from the cache directory.
+		unsigned int Compiles;  // Loads that ran the compiler.
+		unsigned int Failures;  // Compiles that failed.
+	};
+
+	// directory must exist.  compilerTag names the compiler, profile and
+	// flags; entries made with another tag are not used.
+	ShaderCache(const std::string& directory, const std::string& compilerTag, const Compiler& compiler);
+
+	// Bytecode of the source compiled with the defines, from the cache if it
+	// holds the permutation, else compiled and stored.  Returns false if the
+	// compile fails, with its messages in errors if given.
+	bool Load(const std::string& sourcePath, const ShaderDefines& defines,
+		std::vector<char>& bytecode, std::string* errors = 0);
+
+	unsigned long long Key(const std::string& sourcePath, const ShaderDefines& defines);
+
+	// The entry file of a permutation.
+	std::string EntryPath(const std::string& sourcePath, unsigned long long key)const;
+
+	// Source hashes are read once and remembered; this makes the next Load read
+	// the files again, after they have been edited.
+	void ForgetSources();
+
+	const Stats& GetStats()const;
+	void ResetStats();
+
+	// FNV-1a over the bytes, continuing from hash.
+	static unsigned long long Hash(const void* data, size_t size, unsigned long long hash = HashSeed);
+	static const unsigned long long HashSeed;
+
+private:
+	ShaderCache(const ShaderCache& rhs);
+	ShaderCache& operator=(const ShaderCache& rhs);
+
+	unsigned long long SourceHash(const std::string& sourcePath);
+	void HashFile(const std::string& path, unsigned long long& hash, std::set<std::string>& visited)const;
+
+	// What an entry must repeat to be used.
+	std::string Description(const std::string& sourcePath, const ShaderDefines& defines)const;
+
+	bool ReadEntry(const std::string& path, unsigned long long key, const std::string& description,
+		std::vector<char>& bytecode)const;
+	bool WriteEntry(const std::string& path, unsigned long long key, const std::string& description,
+		const std::vector<char>& bytecode)const;
+
+private:
+	std::string mDirectory;
+	std::string mCompilerTag;
+	Compiler mCompiler;
+
+	std::map<std::string, unsigned long long> mSourceHashes;
+
+	Stats mStats;
+};
+
+#endif // SHADERCACHE_H
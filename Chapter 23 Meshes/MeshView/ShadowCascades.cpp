@@ -0,0 +1,177 @@
+//***************************************************************************************
+// ShadowCascades.cpp
+//***************************************************************************************
+
+#include "ShadowCascades.h"
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+
+ShadowCascades::ShadowCascades()
+	: mCascadeCount(MaxCascades), mSplitLambda(0.75f), mShadowMapSize(2048), mSceneRadius(0.0f)
+{
+	for(int i = 0; i < 3; ++i)
+		mSceneCenter[i] = 0.0f;
+
+	for(int i = 0; i < 4; ++i)
+	{
+		for(int j = 0; j < 4; ++j)
+			mLightView[i][j] = i == j ? 1.0f : 0.0f;
+	}
+
+	for(int i = 0; i <= MaxCascades; ++i)
+		mSplits[i] = 0.0f;
+
+	for(int i = 0; i < MaxCascades; ++i)
+	{
+		Box box = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+		mBoxes[i] = box;
+	}
+}
+
+void ShadowCascades::SetCascadeCount(int count)
+{
+	mCascadeCount = count < 1 ? 1 : (count > MaxCascades ? MaxCascades : count);
+}
+
+int ShadowCascades::CascadeCount()const
+{
+	return mCascadeCount;
+}
+
+void ShadowCascades::SetSplitLambda(float lambda)
+{
+	mSplitLambda = lambda < 0.0f ? 0.0f : (lambda > 1.0f ? 1.0f : lambda);
+}
+
+void ShadowCascades::SetShadowMapSize(unsigned int size)
+{
+	// The fit leaves a texel of room on each side.
+	assert( size > 2 );
+	mShadowMapSize = size;
+}
+
+void ShadowCascades::SetSceneBounds(const float center[3], float radius)
+{
+	for(int i = 0; i < 3; ++i)
+		mSceneCenter[i] = center[i];
+
+	mSceneRadius = radius;
+}
+
+void ShadowCascades::SetLightView(const float lightView[4][4])
+{
+	for(int i = 0; i < 4; ++i)
+	{
+		for(int j = 0; j < 4; ++j)
+			mLightView[i][j] = lightView[i][j];
+	}
+}
+
+float ShadowCascades::SplitDistance(int i)const
+{
+	assert( i >= 0 && i <= mCascadeCount );
+	return mSplits[i];
+}
+
+const ShadowCascades::Box& ShadowCascades::CascadeBox(int cascade)const
+{
+	assert( cascade >= 0 && cascade < mCascadeCount );
+	return mBoxes[cascade];
+}
+
+void ShadowCascades::CascadeEnds(float ends[MaxCascades])const
+{
+	for(int i = 0; i < MaxCascades; ++i)
+		ends[i] = i < mCascadeCount ? mSplits[i+1] : FLT_MAX;
+}
+
+void ShadowCascades::ComputeSplits(float nearZ, float farZ, int count, float lambda, float* splits)
+{
+	splits[0] = nearZ;
+
+	for(int i = 1; i < count; ++i)
+	{
+		float f = (float)i / count;
+
+		float logSplit = nearZ * powf(farZ / nearZ, f);
+		float uniformSplit = nearZ + (farZ - nearZ)*f;
+
+		splits[i] = lambda*logSplit + (1.0f - lambda)*uniformSplit;
+	}
+
+	// Exactly the far plane, without rounding.
+	splits[count] = farZ;
+}
+
+void ShadowCascades::TransformToLight(const float p[3], float out[3])const
+{
+	for(int j = 0; j < 3; ++j)
+		out[j] = p[0]*mLightView[0][j] + p[1]*mLightView[1][j] + p[2]*mLightView[2][j] + mLightView[3][j];
+}
+
+void ShadowCascades::Fit(const Frustum& camera)
+{
+	ComputeSplits(camera.NearZ, camera.FarZ, mCascadeCount, mSplitLambda, mSplits);
+
+	float tanHalfFovY = tanf(0.5f*camera.FovY);
+	float tanHalfFovX = camera.Aspect*tanHalfFovY;
+
+	// Squared distance from the look axis to a frustum corner, per unit of depth.
+	float cornerSlope2 = tanHalfFovX*tanHalfFovX + tanHalfFovY*tanHalfFovY;
+
+	float sceneCenterLS[3];
+	TransformToLight(mSceneCenter, sceneCenterLS);
+
+	for(int i = 0; i < mCascadeCount; ++i)
+	{
+		float zn = mSplits[i];
+		float zf = mSplits[i+1];
+
+		// Bounding sphere of the slice.  Its center is on the look axis, where
+		// it is as far from the near corners as from the far corners, but not
+		// past the far plane.
+		float nearRadius2 = zn*zn*cornerSlope2;
+		float farRadius2 = zf*zf*cornerSlope2;
+
+		float centerZ = 0.5f*(farRadius2 - nearRadius2 + zf*zf - zn*zn) / (zf - zn);
+		if( centerZ > zf )
+			centerZ = zf;
+
+		float toNear = zn - centerZ;
+		float toFar = zf - centerZ;
+		float radius2 = nearRadius2 + toNear*toNear;
+		float farCorner2 = farRadius2 + toFar*toFar;
+		if( farCorner2 > radius2 )
+			radius2 = farCorner2;
+
+		float radius = sqrtf(radius2);
+
+		float centerW[3];
+		for(int j = 0; j < 3; ++j)
+			centerW[j] = camera.Position[j] + centerZ*camera.Look[j];
+
+		float centerLS[3];
+		TransformToLight(centerW, centerLS);
+
+		// The box is wide enough that the sphere still fits after the center
+		// moves by up to a texel:  halfExtent = radius + texelSize, where
+		// texelSize = 2*halfExtent/size.
+		float halfExtent = radius*mShadowMapSize / (mShadowMapSize - 2.0f);
+		float texelSize = 2.0f*halfExtent / mShadowMapSize;
+
+		float x = floorf(centerLS[0] / texelSize) * texelSize;
+		float y = floorf(centerLS[1] / texelSize) * texelSize;
+
+		Box& box = mBoxes[i];
+		box.Left   = x - halfExtent;
+		box.Right  = x + halfExtent;
+		box.Bottom = y - halfExtent;
+		box.Top    = y + halfExtent;
+		box.Near   = centerLS[2] - radius;
+		box.Far    = centerLS[2] + radius;
+
+		if( mSceneRadius > 0.0f && sceneCenterLS[2] - mSceneRadius < box.Near )
+			box.Near = sceneCenterLS[2] - mSceneRadius;
+	}
+}
@@ -0,0 +1,108 @@
+//***************************************************************************************
+// ShadowCascades.h
+//
+// Splits the camera frustum into depth ranges and fits a light space box around
+// each, for cascaded shadow maps.
+//   -Split distances blend a logarithmic and a uniform split ("practical split
+//    scheme"), by SplitLambda.
+//   -Each cascade is fit around the bounding sphere of its slice of the frustum.
+//    The radius depends only on the lens, so the box keeps its size as the camera
+//    turns.
+//   -The box center is snapped to whole shadow map texels in light space, so it
+//    only ever moves by whole texels and the shadow edges do not shimmer.
+// Uses only the standard library, so the math can be checked without a device.
+// Matrices are row vector, row major, laid out like XMFLOAT4X4.
+//***************************************************************************************
+
+#ifndef SHADOWCASCADES_H
+#define SHADOWCASCADES_H
+
+class ShadowCascades
+{
+public:
+	enum { MaxCascades = 4 };
+
+	// The camera the cascades cover.  Right, Up and Look are unit vectors in
+	// world space.
+	struct Frustum
+	{
+		float Position[3];
+		float Right[3];
+		float Up[3];
+		float Look[3];
+
+		float FovY;
+		float Aspect;
+		float NearZ;
+		float FarZ;
+	};
+
+	// Light view space bounds of a cascade, for an off center orthographic
+	// projection.
+	struct Box
+	{
+		float Left;
+		float Right;
+		float Bottom;
+		float Top;
+		float Near;
+		float Far;
+	};
+
+	ShadowCascades();
+
+	// From 1 to MaxCascades.
+	void SetCascadeCount(int count);
+	int CascadeCount()const;
+
+	// 0 splits uniformly, 1 logarithmically.
+	void SetSplitLambda(float lambda);
+
+	// Width and height of the shadow map of each cascade, in texels.
+	void SetShadowMapSize(unsigned int size);
+
+	// Sphere around everything that casts shadows.  The boxes reach back to it
+	// toward the light so casters outside a cascade's slice still cast into it.
+	// A radius of 0 leaves the boxes at the slice.
+	void SetSceneBounds(const float center[3], float radius);
+
+	// World space to light view space.  Keep the translation fixed from frame to
+	// frame, or the texel grid moves with it.
+	void SetLightView(const float lightView[4][4]);
+
+	void Fit(const Frustum& camera);
+
+	// Distance along the camera's look vector where cascade i starts; i ==
+	// CascadeCount() gives the far plane.
+	float SplitDistance(int i)const;
+
+	const Box& CascadeBox(int cascade)const;
+
+	// Distance where each cascade ends, as the shaders take them.  Cascades past
+	// CascadeCount() end at FLT_MAX, so no pixel selects them.
+	void CascadeEnds(float ends[MaxCascades])const;
+
+	// splits receives count+1 distances from nearZ to farZ.
+	static void ComputeSplits(float nearZ, float farZ, int count, float lambda, float* splits);
+
+private:
+	ShadowCascades(const ShadowCascades& rhs);
+	ShadowCascades& operator=(const ShadowCascades& rhs);
+
+	void TransformToLight(const float p[3], float out[3])const;
+
+private:
+	int mCascadeCount;
+	float mSplitLambda;
+	unsigned int mShadowMapSize;
+
+	float mSceneCenter[3];
+	float mSceneRadius;
+
+	float mLightView[4][4];
+
+	float mSplits[MaxCascades + 1];
+	Box mBoxes[MaxCascades];
+};
+
+#endif // SHADOWCASCADES_H
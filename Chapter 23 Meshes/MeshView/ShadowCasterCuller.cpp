@@ -0,0 +1,83 @@
+//***************************************************************************************
+// ShadowCasterCuller.cpp
+//***************************************************************************************
+
+#include "ShadowCasterCuller.h"
+#include "ScopeProfiler.h"
+
+ShadowCasterCuller::ShadowCasterCuller()
+{
+	for(int i = 1; i < MaxVolumes; ++i)
+		mWorkers.push_back(std::unique_ptr<WorkerThread>(new WorkerThread("CasterCull")));
+}
+
+ShadowCasterCuller::~ShadowCasterCuller()
+{
+}
+
+void ShadowCasterCuller::Update(const std::vector<BasicModelInstance>& instances,
+	const std::vector<BasicModelInstance>& alphaClippedInstances)
+{
+	PROFILE_SCOPE("ShadowCasterCuller::Update");
+
+	mBvh.Update(instances);
+	mAlphaClippedBvh.Update(alphaClippedInstances);
+}
+
+UINT ShadowCasterCuller::InstanceCount()const
+{
+	return mBvh.InstanceCount() + mAlphaClippedBvh.InstanceCount();
+}
+
+void ShadowCasterCuller::BuildCasterPlanes(CXMMATRIX lightView, CXMMATRIX lightProj, float extrusion, XMFLOAT4 planes[6])
+{
+	ExtractFrustumPlanes(planes, lightView*lightProj);
+
+	for(int i = 0; i < 6; ++i)
+		XMStoreFloat4(&planes[i], XMPlaneNormalize(XMLoadFloat4(&planes[i])));
+
+	// The near plane faces away from the light; moving it back along its normal
+	// takes in the space between the volume and the light.
+	planes[4].w += extrusion;
+}
+
+void ShadowCasterCuller::Cull(const XMFLOAT4 planes[][6], UINT volumeCount, std::vector<UINT> casters[])
+{
+	PROFILE_SCOPE("ShadowCasterCuller::Cull");
+
+	assert( volumeCount <= MaxVolumes );
+
+	for(UINT i = 1; i < volumeCount; ++i)
+	{
+		const XMFLOAT4* volumePlanes = planes[i];
+		std::vector<UINT>* volumeCasters = &casters[i];
+
+		mWorkers[i-1]->Start([this, volumePlanes, volumeCasters]()
+		{
+			CullVolume(volumePlanes, *volumeCasters);
+		});
+	}
+
+	if( volumeCount > 0 )
+		CullVolume(planes[0], casters[0]);
+
+	for(UINT i = 1; i < volumeCount; ++i)
+		mWorkers[i-1]->Wait();
+}
+
+void ShadowCasterCuller::CullVolume(const XMFLOAT4 planes[6], std::vector<UINT>& casters)const
+{
+	casters.clear();
+
+	mBvh.QueryFrustum(planes, casters);
+	size_t opaqueCount = casters.size();
+
+	mAlphaClippedBvh.QueryFrustum(planes, casters);
+
+	// The alpha clipped instances come after the opaque ones.
+	UINT offset = mBvh.InstanceCount();
+	for(size_t i = opaqueCount; i < casters.size(); ++i)
+		casters[i] += offset;
+
+	std::sort(casters.begin(), casters.end());
+}
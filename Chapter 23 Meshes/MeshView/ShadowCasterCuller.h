@@ -0,0 +1,62 @@
+//***************************************************************************************
+// ShadowCasterCuller.h
+//
+// Finds the model instances that can cast a shadow into each shadow map (or each
+// cascade of a CascadedShadowMap), so the shadow pass skips the rest.
+//   -The caster volume of a light is its orthographic view volume with the near
+//    plane pulled back toward the light, since a caster in front of the volume
+//    still shadows what is inside it.
+//   -The volume's six planes are tested against an InstanceBvh over the opaque
+//    instances and one over the alpha clipped instances, with
+//    XNA::IntersectAxisAlignedBox6Planes.
+//   -With several volumes, the calling thread culls the first and worker
+//    threads cull the rest.
+// The caster lists number the instances as ModelPasses does: the opaque ones
+// first, then the alpha clipped ones.  They are sorted, so the pass draws in the
+// same order as without culling.
+//***************************************************************************************
+
+#ifndef SHADOWCASTERCULLER_H
+#define SHADOWCASTERCULLER_H
+
+#include "InstanceBvh.h"
+#include "WorkerThread.h"
+#include <memory>
+
+class ShadowCasterCuller
+{
+public:
+	enum { MaxVolumes = 4 };
+
+	ShadowCasterCuller();
+	~ShadowCasterCuller();
+
+	// Refits the trees to the instances' current World matrices.  Call when the
+	// instances have moved, before Cull.
+	void Update(const std::vector<BasicModelInstance>& instances,
+		const std::vector<BasicModelInstance>& alphaClippedInstances);
+
+	// Inward facing planes of the caster volume of a light with the given view
+	// and orthographic projection.  The near plane is moved extrusion units
+	// toward the light; use at least the diameter of the scene's casters.
+	static void BuildCasterPlanes(CXMMATRIX lightView, CXMMATRIX lightProj, float extrusion, XMFLOAT4 planes[6]);
+
+	// Fills casters[i] with the instances that intersect volume i.
+	void Cull(const XMFLOAT4 planes[][6], UINT volumeCount, std::vector<UINT> casters[]);
+
+	UINT InstanceCount()const;
+
+private:
+	ShadowCasterCuller(const ShadowCasterCuller& rhs);
+	ShadowCasterCuller& operator=(const ShadowCasterCuller& rhs);
+
+	void CullVolume(const XMFLOAT4 planes[6], std::vector<UINT>& casters)const;
+
+private:
+	InstanceBvh mBvh;
+	InstanceBvh mAlphaClippedBvh;
+
+	std::vector<std::unique_ptr<WorkerThread> > mWorkers;
+};
+
+#endif // SHADOWCASTERCULLER_H
@@ -0,0 +1,139 @@
+//***************************************************************************************
+// ShadowFilterReference.cpp
+//***************************************************************************************
+
+#include "ShadowFilterReference.h"
+#include <cmath>
+
+namespace
+{
+	const float PoissonRadius = 2.0f;
+
+	const float PoissonDisk[16][2] =
+	{
+		{-0.94201624f, -0.39906216f}, { 0.94558609f, -0.76890725f},
+		{-0.09418410f, -0.92938870f}, { 0.34495938f,  0.29387760f},
+		{-0.91588581f,  0.45771432f}, {-0.81544232f, -0.87912464f},
+		{-0.38277543f,  0.27676845f}, { 0.97484398f,  0.75648379f},
+		{ 0.44323325f, -0.97511554f}, { 0.53742981f, -0.47373420f},
+		{-0.26496911f, -0.41893023f}, { 0.79197514f,  0.19090188f},
+		{-0.24188840f,  0.99706507f}, {-0.81409955f,  0.91437590f},
+		{ 0.19984126f,  0.78641367f}, { 0.14383161f, -0.14100790f}
+	};
+
+	// Weights and offsets, in texels, of the three taps along one axis of the
+	// 5x5 filter.  s is the position of the sample past the nearest texel corner.
+	void Pcf5x5Axis(float s, float w[3], float o[3])
+	{
+		w[0] = 4.0f - 3.0f*s;
+		w[1] = 7.0f;
+		w[2] = 1.0f + 3.0f*s;
+
+		o[0] = (3.0f - 2.0f*s) / w[0] - 2.0f;
+		o[1] = (3.0f + s) / w[1];
+		o[2] = s / w[2] + 2.0f;
+	}
+}
+
+int ShadowFilterReference::FilterTaps(float u, float v, unsigned int width, unsigned int height, Filter filter, Tap taps[MaxTaps])
+{
+	float dx = 1.0f / width;
+	float dy = 1.0f / height;
+
+	switch( filter )
+	{
+	case OneTap:
+		{
+			Tap tap = { u, v, 1.0f };
+			taps[0] = tap;
+			return 1;
+		}
+
+	case Pcf3x3:
+		for(int i = 0; i < 9; ++i)
+		{
+			Tap tap = { u + (i % 3 - 1)*dx, v + (i / 3 - 1)*dy, 1.0f / 9.0f };
+			taps[i] = tap;
+		}
+		return 9;
+
+	case Pcf5x5:
+		{
+			float texelU = u*width;
+			float texelV = v*height;
+			float baseTexelU = floorf(texelU + 0.5f);
+			float baseTexelV = floorf(texelV + 0.5f);
+
+			float wu[3], ou[3];
+			float wv[3], ov[3];
+			Pcf5x5Axis(texelU + 0.5f - baseTexelU, wu, ou);
+			Pcf5x5Axis(texelV + 0.5f - baseTexelV, wv, ov);
+
+			float baseU = (baseTexelU - 0.5f)*dx;
+			float baseV = (baseTexelV - 0.5f)*dy;
+
+			for(int i = 0; i < 9; ++i)
+			{
+				int x = i % 3;
+				int y = i / 3;
+
+				Tap tap = { baseU + ou[x]*dx, baseV + ov[y]*dy, wu[x]*wv[y] / 144.0f };
+				taps[i] = tap;
+			}
+			return 9;
+		}
+
+	default:
+		for(int i = 0; i < 16; ++i)
+		{
+			Tap tap = { u + PoissonRadius*PoissonDisk[i][0]*dx, v + PoissonRadius*PoissonDisk[i][1]*dy, 1.0f / 16.0f };
+			taps[i] = tap;
+		}
+		return 16;
+	}
+}
+
+float ShadowFilterReference::SampleCmp(const float* depthMap, unsigned int width, unsigned int height,
+	float u, float v, float depth)
+{
+	float x = u*width - 0.5f;
+	float y = v*height - 0.5f;
+
+	float x0 = floorf(x);
+	float y0 = floorf(y);
+	float fx = x - x0;
+	float fy = y - y0;
+
+	float lit[2][2];
+	for(int j = 0; j < 2; ++j)
+	{
+		for(int i = 0; i < 2; ++i)
+		{
+			int tx = (int)x0 + i;
+			int ty = (int)y0 + j;
+
+			bool inside = tx >= 0 && ty >= 0 && tx < (int)width && ty < (int)height;
+			float texel = inside ? depthMap[ty*width + tx] : 0.0f;
+
+			lit[j][i] = depth < texel ? 1.0f : 0.0f;
+		}
+	}
+
+	float top = lit[0][0] + fx*(lit[0][1] - lit[0][0]);
+	float bottom = lit[1][0] + fx*(lit[1][1] - lit[1][0]);
+
+	return top + fy*(bottom - top);
+}
+
+float ShadowFilterReference::ShadowFactor(const float* depthMap, unsigned int width, unsigned int height,
+	float u, float v, float depth, Filter filter)
+{
+	Tap taps[MaxTaps];
+	int tapCount = FilterTaps(u, v, width, height, filter, taps);
+
+	float percentLit = 0.0f;
+	for(int i = 0; i < tapCount; ++i)
+		percentLit += taps[i].Weight*SampleCmp(depthMap, width, height, taps[i].U, taps[i].V, depth);
+
+	return percentLit;
+}
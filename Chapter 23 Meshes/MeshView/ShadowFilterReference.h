@@ -0,0 +1,56 @@
+//***************************************************************************************
+// ShadowFilterReference.h
+//
+// CPU version of the shadow filters in FX/LightHelper.fx, for checking the taps
+// and weights of each filter and the GPU's results.
+//   -FilterTaps places the taps as ShadowFilterTaps does.
+//   -SampleCmp stands in for SampleCmpLevelZero with the samShadow sampler of
+//    Basic.fx: each of the 2x2 texels around the tap is compared with LESS, the
+//    results are blended bilinearly, and texels off the map read the border
+//    value of 0.
+// Hardware blends with a few bits of fraction only, so GPU results match to
+// within about 1/256 per tap rather than exactly.
+// Uses only the standard library.
+//***************************************************************************************
+
+#ifndef SHADOWFILTERREFERENCE_H
+#define SHADOWFILTERREFERENCE_H
+
+class ShadowFilterReference
+{
+public:
+	// Same order as the SHADOW_FILTER_* values of LightHelper.fx.
+	enum Filter
+	{
+		OneTap,
+		Pcf3x3,
+		Pcf5x5,
+		Poisson
+	};
+
+	enum { MaxTaps = 16 };
+
+	struct Tap
+	{
+		float U;
+		float V;
+		float Weight;
+	};
+
+	// Fills taps for a filter around (u, v) and returns how many there are.
+	static int FilterTaps(float u, float v, unsigned int width, unsigned int height, Filter filter, Tap taps[MaxTaps]);
+
+	// depthMap holds width*height depths in rows.  Returns the fraction of the
+	// bilinear footprint at (u, v) that is farther than depth.
+	static float SampleCmp(const float* depthMap, unsigned int width, unsigned int height,
+		float u, float v, float depth);
+
+	// CalcShadowFactor for a shadow position already divided by w.
+	static float ShadowFactor(const float* depthMap, unsigned int width, unsigned int height,
+		float u, float v, float depth, Filter filter);
+
+private:
+	ShadowFilterReference();
+};
+
+#endif // SHADOWFILTERREFERENCE_H
@@ -4,8 +4,8 @@
 
 #include "ShadowMap.h"
 
-ShadowMap::ShadowMap(ID3D11Device* device, UINT width, UINT height)
-: mWidth(width), mHeight(height), mDepthMapSRV(0), mDepthMapDSV(0)
+ShadowMap::ShadowMap(ID3D11Device* device, UINT width, UINT height, UINT arraySize)
+: mWidth(width), mHeight(height), mArraySize(arraySize), mDepthMapSRV(0), mDepthMapDSV(arraySize, 0)
 {
     mViewport.TopLeftX = 0.0f;
     mViewport.TopLeftY = 0.0f;
@@ -21,7 +21,7 @@ ShadowMap::ShadowMap(ID3D11Device* device, UINT width, UINT height)
     texDesc.Width     = mWidth;
     texDesc.Height    = mHeight;
     texDesc.MipLevels = 1;
-    texDesc.ArraySize = 1;
+    texDesc.ArraySize = mArraySize;
     texDesc.Format    = DXGI_FORMAT_R24G8_TYPELESS;
     texDesc.SampleDesc.Count   = 1;  
     texDesc.SampleDesc.Quality = 0;  
@@ -36,15 +36,43 @@ ShadowMap::ShadowMap(ID3D11Device* device, UINT width, UINT height)
     D3D11_DEPTH_STENCIL_VIEW_DESC dsvDesc;
 	dsvDesc.Flags = 0;
     dsvDesc.Format = DXGI_FORMAT_D24_UNORM_S8_UINT;
-    dsvDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2D;
-    dsvDesc.Texture2D.MipSlice = 0;
-    HR(device->CreateDepthStencilView(depthMap, &dsvDesc, &mDepthMapDSV));
+
+	if( mArraySize == 1 )
+	{
+		dsvDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2D;
+		dsvDesc.Texture2D.MipSlice = 0;
+		HR(device->CreateDepthStencilView(depthMap, &dsvDesc, &mDepthMapDSV[0]));
+	}
+	else
+	{
+		for(UINT i = 0; i < mArraySize; ++i)
+		{
+			dsvDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2DARRAY;
+			dsvDesc.Texture2DArray.MipSlice = 0;
+			dsvDesc.Texture2DArray.FirstArraySlice = i;
+			dsvDesc.Texture2DArray.ArraySize = 1;
+			HR(device->CreateDepthStencilView(depthMap, &dsvDesc, &mDepthMapDSV[i]));
+		}
+	}
 
     D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc;
     srvDesc.Format = DXGI_FORMAT_R24_UNORM_X8_TYPELESS;
-    srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
-    srvDesc.Texture2D.MipLevels = texDesc.MipLevels;
-    srvDesc.Texture2D.MostDetailedMip = 0;
+
+	if( mArraySize == 1 )
+	{
+		srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+		srvDesc.Texture2D.MipLevels = texDesc.MipLevels;
+		srvDesc.Texture2D.MostDetailedMip = 0;
+	}
+	else
+	{
+		srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2DARRAY;
+		srvDesc.Texture2DArray.MipLevels = texDesc.MipLevels;
+		srvDesc.Texture2DArray.MostDetailedMip = 0;
+		srvDesc.Texture2DArray.FirstArraySlice = 0;
+		srvDesc.Texture2DArray.ArraySize = mArraySize;
+	}
+
     HR(device->CreateShaderResourceView(depthMap, &srvDesc, &mDepthMapSRV));
 
     // View saves a reference to the texture so we can release our reference.
@@ -54,7 +82,9 @@ ShadowMap::ShadowMap(ID3D11Device* device, UINT width, UINT height)
 ShadowMap::~ShadowMap()
 {
     ReleaseCOM(mDepthMapSRV);
-	ReleaseCOM(mDepthMapDSV);
+
+	for(UINT i = 0; i < mArraySize; ++i)
+		ReleaseCOM(mDepthMapDSV[i]);
 }
 
 ID3D11ShaderResourceView* ShadowMap::DepthMapSRV()
@@ -62,15 +92,33 @@ ID3D11ShaderResourceView* ShadowMap::DepthMapSRV()
     return mDepthMapSRV;
 }
 
-void ShadowMap::BindDsvAndSetNullRenderTarget(ID3D11DeviceContext* dc)
+UINT ShadowMap::Width()const
+{
+	return mWidth;
+}
+
+UINT ShadowMap::Height()const
 {
+	return mHeight;
+}
+
+UINT ShadowMap::ArraySize()const
+{
+	return mArraySize;
+}
+
+void ShadowMap::BindDsvAndSetNullRenderTarget(ID3D11DeviceContext* dc, UINT slice)
+{
+	assert( slice < mArraySize );
+	ID3D11DepthStencilView* dsv = mDepthMapDSV[slice];
+
     dc->RSSetViewports(1, &mViewport);
 
 	// Set null render target because we are only going to draw to depth buffer.
 	// Setting a null render target will disable color writes.
     ID3D11RenderTargetView* renderTargets[1] = {0};
-    dc->OMSetRenderTargets(1, renderTargets, mDepthMapDSV);
+    dc->OMSetRenderTargets(1, renderTargets, dsv);
     
-    dc->ClearDepthStencilView(mDepthMapDSV, D3D11_CLEAR_DEPTH, 1.0f, 0);
+    dc->ClearDepthStencilView(dsv, D3D11_CLEAR_DEPTH, 1.0f, 0);
 }
 
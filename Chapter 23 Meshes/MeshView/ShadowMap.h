@@ -13,12 +13,18 @@
 class ShadowMap
 {
 public:
-	ShadowMap(ID3D11Device* device, UINT width, UINT height);
+	// With an arraySize above 1 the map is a texture array, one slice per
+	// cascade, and the SRV views it as a Texture2DArray.
+	ShadowMap(ID3D11Device* device, UINT width, UINT height, UINT arraySize = 1);
 	~ShadowMap();
 
 	ID3D11ShaderResourceView* DepthMapSRV();
 
-	void BindDsvAndSetNullRenderTarget(ID3D11DeviceContext* dc);
+	UINT Width()const;
+	UINT Height()const;
+	UINT ArraySize()const;
+
+	void BindDsvAndSetNullRenderTarget(ID3D11DeviceContext* dc, UINT slice = 0);
 
 private:
 	ShadowMap(const ShadowMap& rhs);
@@ -27,9 +33,12 @@ private:
 private:
 	UINT mWidth;
 	UINT mHeight;
+	UINT mArraySize;
 
 	ID3D11ShaderResourceView* mDepthMapSRV;
-	ID3D11DepthStencilView* mDepthMapDSV;
+
+	// One per slice.
+	std::vector<ID3D11DepthStencilView*> mDepthMapDSV;
 
 	D3D11_VIEWPORT mViewport;
 };
@@ -6,12 +6,93 @@
 #include "Camera.h"
 #include "Effects.h"
 #include "Vertex.h"
+#include "ScopeProfiler.h"
+
+namespace
+{
+	// Weight of the history in the temporal mode.  About the last five frames
+	// contribute.
+	const float TemporalHistoryWeight = 0.8f;
+
+	// Samples per pixel in the temporal mode.  Must match SsaoTemporal in Ssao.fx.
+	const int TemporalSampleCount = 4;
+
+	// Radical inverse of i in the given base, for the Halton offset vectors.
+	float RadicalInverse(UINT i, UINT base)
+	{
+		float inverseBase = 1.0f / base;
+		float digitScale = inverseBase;
+		float result = 0.0f;
+
+		while( i > 0 )
+		{
+			result += (i % base) * digitScale;
+			i /= base;
+			digitScale *= inverseBase;
+		}
+
+		return result;
+	}
+
+	template<typename T>
+	T Clamp(T x, T low, T high)
+	{
+		return x < low ? low : (x > high ? high : x);
+	}
+}
+
+Ssao::Settings::Settings()
+	: ResolutionScale(2), SampleCount(14), BlurRadius(5), BlurCount(4)
+{
+}
+
+Ssao::Settings Ssao::TierSettings(QualityTier tier)
+{
+	Settings settings;
+
+	switch( tier )
+	{
+	case LowQuality:
+		settings.ResolutionScale = 4;
+		settings.SampleCount = 8;
+		settings.BlurRadius = 3;
+		settings.BlurCount = 1;
+		break;
+	case MediumQuality:
+		settings.ResolutionScale = 2;
+		settings.SampleCount = 8;
+		settings.BlurRadius = 4;
+		settings.BlurCount = 2;
+		break;
+	case UltraQuality:
+		settings.ResolutionScale = 1;
+		settings.SampleCount = 24;
+		settings.BlurRadius = 5;
+		settings.BlurCount = 4;
+		break;
+	default:
+		break;
+	}
+
+	return settings;
+}
 
 Ssao::Ssao(ID3D11Device* device, ID3D11DeviceContext* dc, int width, int height, float fovy, float farZ)
 	: md3dDevice(device), mDC(dc), mScreenQuadVB(0), mScreenQuadIB(0), mRandomVectorSRV(0),
-	  mNormalDepthRTV(0), mNormalDepthSRV(0), mAmbientRTV0(0), mAmbientSRV0(0), mAmbientRTV1(0), mAmbientSRV1(0)
+	  mNormalDepthRTV(0), mNormalDepthSRV(0), mAmbientRTV0(0), mAmbientSRV0(0), mAmbientUAV0(0), mAmbientRTV1(0), mAmbientSRV1(0), mAmbientUAV1(0),
+	  mPrevNormalDepthRTV(0), mPrevNormalDepthSRV(0), mHistoryIndex(0), mUpsampledRTV(0), mUpsampledSRV(0),
+	  mUseComputeShader(false), mUseComputeBlur(false), mTemporal(false), mHistoryValid(false), mTemporalFrame(0)
 
 {
+	mHistoryRTV[0] = mHistoryRTV[1] = 0;
+	mHistorySRV[0] = mHistorySRV[1] = 0;
+
+	XMStoreFloat4x4(&mPrevView, XMMatrixIdentity());
+	XMStoreFloat4x4(&mPrevProj, XMMatrixIdentity());
+
+	mSsaoTimer.Init(device);
+	mBlurTimer.Init(device);
+
 	OnSize(width, height, fovy, farZ);
 
 	BuildFullScreenQuad();
@@ -35,7 +116,7 @@ ID3D11ShaderResourceView* Ssao::NormalDepthSRV()
 
 ID3D11ShaderResourceView* Ssao::AmbientSRV()
 {
-	return mAmbientSRV0;
+	return mSettings.ResolutionScale > 1 ? mUpsampledSRV : mAmbientSRV0;
 }
 
 void Ssao::OnSize(int width, int height, float fovy, float farZ)
@@ -43,20 +124,55 @@ void Ssao::OnSize(int width, int height, float fovy, float farZ)
 	mRenderTargetWidth = width;
 	mRenderTargetHeight = height;
 
-	// We render to ambient map at half the resolution.
-	mAmbientMapViewport.TopLeftX = 0.0f;
-	mAmbientMapViewport.TopLeftY = 0.0f;
-	mAmbientMapViewport.Width = width / 2.0f;
-	mAmbientMapViewport.Height = height / 2.0f;
-	mAmbientMapViewport.MinDepth = 0.0f;
-	mAmbientMapViewport.MaxDepth = 1.0f;
-	
 	BuildFrustumFarCorners(fovy, farZ);
     BuildTextureViews();
 }
+
+void Ssao::SetSettings(const Settings& settings)
+{
+	Settings s = settings;
+
+	if( s.ResolutionScale != 1 && s.ResolutionScale != 2 && s.ResolutionScale != 4 )
+		s.ResolutionScale = s.ResolutionScale < 2 ? 1 : (s.ResolutionScale < 4 ? 2 : 4);
+
+	s.SampleCount = Clamp<UINT>(s.SampleCount, 4, MaxSampleCount);
+	s.BlurRadius = Clamp(s.BlurRadius, 1, 5);
+	s.BlurCount = Clamp(s.BlurCount, 0, 8);
+
+	bool rebuildTextures = s.ResolutionScale != mSettings.ResolutionScale;
+	bool rebuildOffsets = s.SampleCount != mSettings.SampleCount;
+
+	mSettings = s;
+
+	if( rebuildTextures )
+		BuildTextureViews();
+
+	if( rebuildOffsets )
+	{
+		BuildOffsetVectors();
+		mHistoryValid = false;
+	}
+}
+
+const Ssao::Settings& Ssao::GetSettings()const
+{
+	return mSettings;
+}
+
+float Ssao::GpuMilliseconds()const
+{
+	return mSsaoTimer.Milliseconds() + mBlurTimer.Milliseconds();
+}
  
 void Ssao::SetNormalDepthRenderTarget(ID3D11DepthStencilView* dsv)
 {
+	// Keep last frame's map for the reprojection.
+	if( mTemporal )
+	{
+		std::swap(mNormalDepthRTV, mPrevNormalDepthRTV);
+		std::swap(mNormalDepthSRV, mPrevNormalDepthSRV);
+	}
+
     ID3D11RenderTargetView* renderTargets[1] = {mNormalDepthRTV};
     mDC->OMSetRenderTargets(1, renderTargets, dsv);
 
@@ -65,16 +181,19 @@ void Ssao::SetNormalDepthRenderTarget(ID3D11DepthStencilView* dsv)
 	mDC->ClearRenderTargetView(mNormalDepthRTV, clearColor);
 }
 
-void Ssao::ComputeSsao(const Camera& camera)
+void Ssao::SetUseComputeShader(bool enable)
 {
-	// Bind the ambient map as the render target.  Observe that this pass does not bind 
-	// a depth/stencil buffer--it does not need it, and without one, no depth test is
-	// performed, which is what we want.
-	ID3D11RenderTargetView* renderTargets[1] = {mAmbientRTV0};
-	mDC->OMSetRenderTargets(1, renderTargets, 0);
-	mDC->ClearRenderTargetView(mAmbientRTV0, reinterpret_cast<const float*>(&Colors::Black));
-	mDC->RSSetViewports(1, &mAmbientMapViewport);
+	mUseComputeShader = enable;
+}
 
+void Ssao::SetTemporal(bool enable)
+{
+	mTemporal = enable;
+	mHistoryValid = false;
+}
+
+XMMATRIX Ssao::ViewToTexSpace(CXMMATRIX proj)
+{
 	// Transform NDC space [-1,+1]^2 to texture space [0,1]^2
 	static const XMMATRIX T(
 		0.5f, 0.0f, 0.0f, 0.0f,
@@ -82,24 +201,47 @@ void Ssao::ComputeSsao(const Camera& camera)
 		0.0f, 0.0f, 1.0f, 0.0f,
 		0.5f, 0.5f, 0.0f, 1.0f);
 
-	XMMATRIX P  = camera.Proj();
-	XMMATRIX PT = XMMatrixMultiply(P, T);
+	return XMMatrixMultiply(proj, T);
+}
+
+void Ssao::ComputeSsao(const Camera& camera)
+{
+	PROFILE_SCOPE("Ssao::ComputeSsao");
+
+	mSsaoTimer.Begin(mDC);
+
+	// The temporal mode always uses the pixel shader.
+	if( mTemporal )
+		ComputeSsaoTemporal(camera);
+	else if( mUseComputeShader )
+		ComputeSsaoCS(camera);
+	else
+		DrawSsao(camera, mAmbientRTV0, Effects::SsaoFX->SsaoTech);
+
+	mSsaoTimer.End(mDC);
+}
+
+void Ssao::DrawSsao(const Camera& camera, ID3D11RenderTargetView* outputRTV, ID3DX11EffectTechnique* tech)
+{
+	// Bind the ambient map as the render target.  Observe that this pass does not bind 
+	// a depth/stencil buffer--it does not need it, and without one, no depth test is
+	// performed, which is what we want.
+	ID3D11RenderTargetView* renderTargets[1] = {outputRTV};
+	mDC->OMSetRenderTargets(1, renderTargets, 0);
+	mDC->ClearRenderTargetView(outputRTV, reinterpret_cast<const float*>(&Colors::Black));
+	mDC->RSSetViewports(1, &mAmbientMapViewport);
+
+	XMMATRIX PT = ViewToTexSpace(camera.Proj());
 
 	Effects::SsaoFX->SetViewToTexSpace(PT);
-	Effects::SsaoFX->SetOffsetVectors(mOffsets);
+	Effects::SsaoFX->SetOffsetVectors(mOffsets, mSettings.SampleCount);
+	Effects::SsaoFX->SetSampleCount(mSettings.SampleCount);
 	Effects::SsaoFX->SetFrustumCorners(mFrustumFarCorner);
 	Effects::SsaoFX->SetNormalDepthMap(mNormalDepthSRV);
 	Effects::SsaoFX->SetRandomVecMap(mRandomVectorSRV);
 
-	UINT stride = sizeof(Vertex::Basic32);
-    UINT offset = 0;
-
-	mDC->IASetInputLayout(InputLayouts::Basic32);
-    mDC->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-	mDC->IASetVertexBuffers(0, 1, &mScreenQuadVB, &stride, &offset);
-	mDC->IASetIndexBuffer(mScreenQuadIB, DXGI_FORMAT_R16_UINT, 0);
+	BindFullScreenQuad();
 	
-	ID3DX11EffectTechnique* tech = Effects::SsaoFX->SsaoTech;
 	D3DX11_TECHNIQUE_DESC techDesc;
 
 	tech->GetDesc( &techDesc );
@@ -110,15 +252,287 @@ void Ssao::ComputeSsao(const Camera& camera)
     }
 }
 
+void Ssao::ComputeSsaoCS(const Camera& camera)
+{
+	// The shader writes every texel, so there is nothing to clear.  Unbind the
+	// ambient map from the output merger in case it is still there.
+	mDC->OMSetRenderTargets(0, 0, 0);
+
+	XMMATRIX PT = ViewToTexSpace(camera.Proj());
+
+	Effects::SsaoComputeFX->SetViewToTexSpace(PT);
+	Effects::SsaoComputeFX->SetOffsetVectors(mOffsets, mSettings.SampleCount);
+	Effects::SsaoComputeFX->SetSampleCount(mSettings.SampleCount);
+	Effects::SsaoComputeFX->SetResolutionScale(mSettings.ResolutionScale);
+	Effects::SsaoComputeFX->SetFrustumCorners(mFrustumFarCorner);
+	Effects::SsaoComputeFX->SetNormalDepthMap(mNormalDepthSRV);
+	Effects::SsaoComputeFX->SetRandomVecMap(mRandomVectorSRV);
+	Effects::SsaoComputeFX->SetAmbientMap(mAmbientUAV0);
+
+	// One thread per ambient map texel, in 16x16 groups.
+	UINT groupsX = ((UINT)mAmbientMapViewport.Width + 15) / 16;
+	UINT groupsY = ((UINT)mAmbientMapViewport.Height + 15) / 16;
+
+	ID3DX11EffectTechnique* tech = Effects::SsaoComputeFX->SsaoTech;
+	D3DX11_TECHNIQUE_DESC techDesc;
+
+	tech->GetDesc( &techDesc );
+	for(UINT p = 0; p < techDesc.Passes; ++p)
+	{
+		tech->GetPassByIndex(p)->Apply(0, mDC);
+		mDC->Dispatch(groupsX, groupsY, 1);
+	}
+
+	// Unbind the ambient map from the compute shader so the blur and the scene
+	// can read it, and the normal/depth map so it can be drawn to again.
+	Effects::SsaoComputeFX->SetAmbientMap(0);
+	Effects::SsaoComputeFX->SetNormalDepthMap(0);
+	tech->GetPassByIndex(0)->Apply(0, mDC);
+
+	mDC->CSSetShader(0, 0, 0);
+}
+
+void Ssao::ComputeSsaoTemporal(const Camera& camera)
+{
+	// This frame's few samples go to ambient map 1, so the blend can write map 0.
+	Effects::SsaoFX->SetFirstSample( (mTemporalFrame*TemporalSampleCount) % mSettings.SampleCount );
+	DrawSsao(camera, mAmbientRTV1, Effects::SsaoFX->SsaoTemporalTech);
+
+	UINT prevHistory = mHistoryIndex;
+	UINT nextHistory = 1 - mHistoryIndex;
+
+	// Write the ambient map to blur and the history for the next frame at once.
+	ID3D11RenderTargetView* renderTargets[2] = {mAmbientRTV0, mHistoryRTV[nextHistory]};
+	mDC->OMSetRenderTargets(2, renderTargets, 0);
+	mDC->RSSetViewports(1, &mAmbientMapViewport);
+
+	XMFLOAT4X4 viewToPrevView;
+	XMFLOAT4X4 prevViewToTex;
+	BuildTemporalMatrices(camera, viewToPrevView, prevViewToTex);
+
+	SsaoTemporalEffect* fx = Effects::SsaoTemporalFX;
+
+	fx->SetViewToPrevView(XMLoadFloat4x4(&viewToPrevView));
+	fx->SetPrevViewToTex(XMLoadFloat4x4(&prevViewToTex));
+	fx->SetFrustumCorners(mFrustumFarCorner);
+	fx->SetHistoryWeight(mHistoryValid ? TemporalHistoryWeight : 0.0f);
+	fx->SetNormalDepthMap(mNormalDepthSRV);
+	fx->SetPrevNormalDepthMap(mPrevNormalDepthSRV);
+	fx->SetCurrentAmbientMap(mAmbientSRV1);
+	fx->SetHistoryMap(mHistorySRV[prevHistory]);
+
+	// The quad is still bound from DrawSsao.
+	ID3DX11EffectTechnique* tech = fx->SsaoTemporalTech;
+	D3DX11_TECHNIQUE_DESC techDesc;
+
+	tech->GetDesc( &techDesc );
+	for(UINT p = 0; p < techDesc.Passes; ++p)
+	{
+		tech->GetPassByIndex(p)->Apply(0, mDC);
+		mDC->DrawIndexed(6, 0, 0);
+	}
+
+	// Unbind the inputs; each of them is a render target again later.
+	fx->SetNormalDepthMap(0);
+	fx->SetPrevNormalDepthMap(0);
+	fx->SetCurrentAmbientMap(0);
+	fx->SetHistoryMap(0);
+	tech->GetPassByIndex(0)->Apply(0, mDC);
+
+	XMStoreFloat4x4(&mPrevView, camera.View());
+	XMStoreFloat4x4(&mPrevProj, camera.Proj());
+
+	mHistoryIndex = nextHistory;
+	mHistoryValid = true;
+	++mTemporalFrame;
+}
+
+void Ssao::BuildTemporalMatrices(const Camera& camera, XMFLOAT4X4& viewToPrevView, XMFLOAT4X4& prevViewToTex)const
+{
+	XMMATRIX view = camera.View();
+	XMVECTOR det = XMMatrixDeterminant(view);
+	XMMATRIX invView = XMMatrixInverse(&det, view);
+
+	XMStoreFloat4x4(&viewToPrevView, XMMatrixMultiply(invView, XMLoadFloat4x4(&mPrevView)));
+	XMStoreFloat4x4(&prevViewToTex, ViewToTexSpace(XMLoadFloat4x4(&mPrevProj)));
+}
+
+void Ssao::GetTemporalReferenceParams(const Camera& camera, SsaoTemporalReference::Params& params)const
+{
+	XMFLOAT4X4 viewToPrevView;
+	XMFLOAT4X4 prevViewToTex;
+	BuildTemporalMatrices(camera, viewToPrevView, prevViewToTex);
+
+	for(int i = 0; i < 4; ++i)
+	{
+		for(int j = 0; j < 4; ++j)
+		{
+			params.ViewToPrevView[i][j] = viewToPrevView(i, j);
+			params.PrevViewToTex[i][j] = prevViewToTex(i, j);
+		}
+	}
+
+	params.HistoryWeight = mHistoryValid ? TemporalHistoryWeight : 0.0f;
+}
+
+void Ssao::GetReferenceParams(const Camera& camera, SsaoReference::Params& params)const
+{
+	XMFLOAT4X4 PT;
+	XMStoreFloat4x4(&PT, ViewToTexSpace(camera.Proj()));
+
+	for(int i = 0; i < 4; ++i)
+	{
+		for(int j = 0; j < 4; ++j)
+			params.ViewToTexSpace[i][j] = PT(i, j);
+
+		params.FrustumCorners[i][0] = mFrustumFarCorner[i].x;
+		params.FrustumCorners[i][1] = mFrustumFarCorner[i].y;
+		params.FrustumCorners[i][2] = mFrustumFarCorner[i].z;
+		params.FrustumCorners[i][3] = mFrustumFarCorner[i].w;
+	}
+
+	params.SampleCount = mSettings.SampleCount;
+	params.ResolutionScale = mSettings.ResolutionScale;
+
+	for(UINT i = 0; i < mSettings.SampleCount; ++i)
+	{
+		params.OffsetVectors[i][0] = mOffsets[i].x;
+		params.OffsetVectors[i][1] = mOffsets[i].y;
+		params.OffsetVectors[i][2] = mOffsets[i].z;
+		params.OffsetVectors[i][3] = mOffsets[i].w;
+	}
+}
+
+const unsigned char* Ssao::RandomVectorData()const
+{
+	// XMCOLOR is stored as B,G,R,A bytes, which the R8G8B8A8 texture reads as
+	// r,g,b,a.  Handing out the bytes as they are keeps the reference reading
+	// what the shader reads.
+	return reinterpret_cast<const unsigned char*>(&mRandomVectors[0]);
+}
+
+void Ssao::SetUseComputeBlur(bool enable)
+{
+	mUseComputeBlur = enable;
+}
+
 void Ssao::BlurAmbientMap(int blurCount)
 {
-	for(int i = 0; i < blurCount; ++i)
+	PROFILE_SCOPE("Ssao::BlurAmbientMap");
+
+	mBlurTimer.Begin(mDC);
+
+	if( mUseComputeBlur )
+	{
+		BlurAmbientMapCS(blurCount);
+	}
+	else
+	{
+		for(int i = 0; i < blurCount; ++i)
+		{
+			// Ping-pong the two ambient map textures as we apply
+			// horizontal and vertical blur passes.
+			BlurAmbientMap(mAmbientSRV0, mAmbientRTV1, true);
+			BlurAmbientMap(mAmbientSRV1, mAmbientRTV0, false);
+		}
+	}
+
+	if( mSettings.ResolutionScale > 1 )
+		UpsampleAmbientMap();
+
+	mBlurTimer.End(mDC);
+}
+
+void Ssao::BlurAmbientMap()
+{
+	BlurAmbientMap(mSettings.BlurCount);
+}
+
+void Ssao::UpsampleAmbientMap()
+{
+	ID3D11RenderTargetView* renderTargets[1] = {mUpsampledRTV};
+	mDC->OMSetRenderTargets(1, renderTargets, 0);
+	mDC->RSSetViewports(1, &mUpsampledViewport);
+
+	SsaoUpsampleEffect* fx = Effects::SsaoUpsampleFX;
+
+	fx->SetNormalDepthMap(mNormalDepthSRV);
+	fx->SetAmbientMap(mAmbientSRV0);
+
+	BindFullScreenQuad();
+
+	ID3DX11EffectTechnique* tech = fx->UpsampleTech;
+	D3DX11_TECHNIQUE_DESC techDesc;
+
+	tech->GetDesc( &techDesc );
+	for(UINT p = 0; p < techDesc.Passes; ++p)
+	{
+		tech->GetPassByIndex(p)->Apply(0, mDC);
+		mDC->DrawIndexed(6, 0, 0);
+	}
+
+	// Unbind the inputs; both are render targets again next frame.
+	fx->SetNormalDepthMap(0);
+	fx->SetAmbientMap(0);
+	tech->GetPassByIndex(0)->Apply(0, mDC);
+}
+
+void Ssao::BlurAmbientMapCS(int blurCount)
+{
+	// The ambient maps are about to be shader outputs.
+	mDC->OMSetRenderTargets(0, 0, 0);
+
+	SsaoBlurComputeEffect* fx = Effects::SsaoBlurComputeFX;
+
+	fx->SetNormalDepthMap(mNormalDepthSRV);
+	fx->SetBlurRadius(mSettings.BlurRadius);
+	fx->SetResolutionScale(mSettings.ResolutionScale);
+
+	UINT width = (UINT)mAmbientMapViewport.Width;
+	UINT height = (UINT)mAmbientMapViewport.Height;
+
+	// A fused pass blurs map 0 into map 1 or back, so they are used in pairs to
+	// leave the result in map 0.  With an odd count, one iteration uses the two
+	// single passes, which go through map 1 and back.
+	int fusedCount = blurCount > 1 ? blurCount & ~1 : 0;
+
+	for(int i = fusedCount; i < blurCount; ++i)
+	{
+		BlurAmbientMapCS(mAmbientSRV0, mAmbientUAV1, fx->HorzBlurTech, (width + 255) / 256, height);
+		BlurAmbientMapCS(mAmbientSRV1, mAmbientUAV0, fx->VertBlurTech, width, (height + 255) / 256);
+	}
+
+	for(int i = 0; i < fusedCount; i += 2)
+	{
+		BlurAmbientMapCS(mAmbientSRV0, mAmbientUAV1, fx->BlurTech, (width + 15) / 16, (height + 15) / 16);
+		BlurAmbientMapCS(mAmbientSRV1, mAmbientUAV0, fx->BlurTech, (width + 15) / 16, (height + 15) / 16);
+	}
+
+	// Let the normal/depth map be drawn to again.
+	fx->SetNormalDepthMap(0);
+	fx->BlurTech->GetPassByIndex(0)->Apply(0, mDC);
+
+	mDC->CSSetShader(0, 0, 0);
+}
+
+void Ssao::BlurAmbientMapCS(ID3D11ShaderResourceView* inputSRV, ID3D11UnorderedAccessView* outputUAV,
+							ID3DX11EffectTechnique* tech, UINT groupsX, UINT groupsY)
+{
+	Effects::SsaoBlurComputeFX->SetInputImage(inputSRV);
+	Effects::SsaoBlurComputeFX->SetOutputImage(outputUAV);
+
+	D3DX11_TECHNIQUE_DESC techDesc;
+	tech->GetDesc( &techDesc );
+	for(UINT p = 0; p < techDesc.Passes; ++p)
 	{
-		// Ping-pong the two ambient map textures as we apply
-		// horizontal and vertical blur passes.
-		BlurAmbientMap(mAmbientSRV0, mAmbientRTV1, true);
-		BlurAmbientMap(mAmbientSRV1, mAmbientRTV0, false);
+		tech->GetPassByIndex(p)->Apply(0, mDC);
+		mDC->Dispatch(groupsX, groupsY, 1);
 	}
+
+	// Unbind both maps; the output is the input of the next pass.
+	Effects::SsaoBlurComputeFX->SetInputImage(0);
+	Effects::SsaoBlurComputeFX->SetOutputImage(0);
+	tech->GetPassByIndex(0)->Apply(0, mDC);
 }
 
 void Ssao::BlurAmbientMap(ID3D11ShaderResourceView* inputSRV, ID3D11RenderTargetView* outputRTV, bool horzBlur)
@@ -130,6 +544,7 @@ void Ssao::BlurAmbientMap(ID3D11ShaderResourceView* inputSRV, ID3D11RenderTarget
 
 	Effects::SsaoBlurFX->SetTexelWidth(1.0f / mAmbientMapViewport.Width );
 	Effects::SsaoBlurFX->SetTexelHeight(1.0f / mAmbientMapViewport.Height );
+	Effects::SsaoBlurFX->SetBlurRadius(mSettings.BlurRadius);
 	Effects::SsaoBlurFX->SetNormalDepthMap(mNormalDepthSRV);
 	Effects::SsaoBlurFX->SetInputImage(inputSRV);
 
@@ -143,13 +558,7 @@ void Ssao::BlurAmbientMap(ID3D11ShaderResourceView* inputSRV, ID3D11RenderTarget
 		tech = Effects::SsaoBlurFX->VertBlurTech;
 	}
 
-	UINT stride = sizeof(Vertex::Basic32);
-    UINT offset = 0;
-
-	mDC->IASetInputLayout(InputLayouts::Basic32);
-    mDC->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-	mDC->IASetVertexBuffers(0, 1, &mScreenQuadVB, &stride, &offset);
-	mDC->IASetIndexBuffer(mScreenQuadIB, DXGI_FORMAT_R16_UINT, 0);
+	BindFullScreenQuad();
 
 	D3DX11_TECHNIQUE_DESC techDesc;
 	tech->GetDesc( &techDesc );
@@ -230,9 +639,34 @@ void Ssao::BuildFullScreenQuad()
 	HR(md3dDevice->CreateBuffer(&ibd, &iinitData, &mScreenQuadIB));
 }
 
+void Ssao::BindFullScreenQuad()
+{
+	UINT stride = sizeof(Vertex::Basic32);
+    UINT offset = 0;
+
+	mDC->IASetInputLayout(InputLayouts::Basic32);
+    mDC->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	mDC->IASetVertexBuffers(0, 1, &mScreenQuadVB, &stride, &offset);
+	mDC->IASetIndexBuffer(mScreenQuadIB, DXGI_FORMAT_R16_UINT, 0);
+}
+
 void Ssao::BuildTextureViews()
 {
 	ReleaseTextureViews();
+
+	UINT ambientWidth = mRenderTargetWidth / mSettings.ResolutionScale;
+	UINT ambientHeight = mRenderTargetHeight / mSettings.ResolutionScale;
+
+	mAmbientMapViewport.TopLeftX = 0.0f;
+	mAmbientMapViewport.TopLeftY = 0.0f;
+	mAmbientMapViewport.Width = (float)ambientWidth;
+	mAmbientMapViewport.Height = (float)ambientHeight;
+	mAmbientMapViewport.MinDepth = 0.0f;
+	mAmbientMapViewport.MaxDepth = 1.0f;
+
+	mUpsampledViewport = mAmbientMapViewport;
+	mUpsampledViewport.Width = (float)mRenderTargetWidth;
+	mUpsampledViewport.Height = (float)mRenderTargetHeight;
 	
 	D3D11_TEXTURE2D_DESC texDesc;
 	texDesc.Width = mRenderTargetWidth;
@@ -255,20 +689,53 @@ void Ssao::BuildTextureViews()
 	
 	// view saves a reference.
 	ReleaseCOM(normalDepthTex);
+
+	ID3D11Texture2D* prevNormalDepthTex = 0;
+	HR(md3dDevice->CreateTexture2D(&texDesc, 0, &prevNormalDepthTex));
+	HR(md3dDevice->CreateShaderResourceView(prevNormalDepthTex, 0, &mPrevNormalDepthSRV));
+	HR(md3dDevice->CreateRenderTargetView(prevNormalDepthTex, 0, &mPrevNormalDepthRTV));
+	ReleaseCOM(prevNormalDepthTex);
 	
-	// Render ambient map at half resolution.
-	texDesc.Width = mRenderTargetWidth / 2;
-	texDesc.Height = mRenderTargetHeight / 2;
+	if( mSettings.ResolutionScale > 1 )
+	{
+		texDesc.Format = DXGI_FORMAT_R16_FLOAT;
+
+		ID3D11Texture2D* upsampledTex = 0;
+		HR(md3dDevice->CreateTexture2D(&texDesc, 0, &upsampledTex));
+		HR(md3dDevice->CreateShaderResourceView(upsampledTex, 0, &mUpsampledSRV));
+		HR(md3dDevice->CreateRenderTargetView(upsampledTex, 0, &mUpsampledRTV));
+		ReleaseCOM(upsampledTex);
+	}
+
+	// Render ambient map at 1/ResolutionScale of the render target size.
+	texDesc.Width = ambientWidth;
+	texDesc.Height = ambientHeight;
 	texDesc.Format = DXGI_FORMAT_R16_FLOAT;
+	texDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_RENDER_TARGET | D3D11_BIND_UNORDERED_ACCESS;
 	ID3D11Texture2D* ambientTex0 = 0;
 	HR(md3dDevice->CreateTexture2D(&texDesc, 0, &ambientTex0));
 	HR(md3dDevice->CreateShaderResourceView(ambientTex0, 0, &mAmbientSRV0));
 	HR(md3dDevice->CreateRenderTargetView(ambientTex0, 0, &mAmbientRTV0));
+	HR(md3dDevice->CreateUnorderedAccessView(ambientTex0, 0, &mAmbientUAV0));
 	
 	ID3D11Texture2D* ambientTex1 = 0;
 	HR(md3dDevice->CreateTexture2D(&texDesc, 0, &ambientTex1));
 	HR(md3dDevice->CreateShaderResourceView(ambientTex1, 0, &mAmbientSRV1));
 	HR(md3dDevice->CreateRenderTargetView(ambientTex1, 0, &mAmbientRTV1));
+	HR(md3dDevice->CreateUnorderedAccessView(ambientTex1, 0, &mAmbientUAV1));
+
+	texDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_RENDER_TARGET;
+	for(int i = 0; i < 2; ++i)
+	{
+		ID3D11Texture2D* historyTex = 0;
+		HR(md3dDevice->CreateTexture2D(&texDesc, 0, &historyTex));
+		HR(md3dDevice->CreateShaderResourceView(historyTex, 0, &mHistorySRV[i]));
+		HR(md3dDevice->CreateRenderTargetView(historyTex, 0, &mHistoryRTV[i]));
+		ReleaseCOM(historyTex);
+	}
+
+	// The old history does not match the new size.
+	mHistoryValid = false;
 
 
 	// view saves a reference.
@@ -280,12 +747,25 @@ void Ssao::ReleaseTextureViews()
 {
 	ReleaseCOM(mNormalDepthRTV);
 	ReleaseCOM(mNormalDepthSRV);
+	ReleaseCOM(mPrevNormalDepthRTV);
+	ReleaseCOM(mPrevNormalDepthSRV);
 
 	ReleaseCOM(mAmbientRTV0);
 	ReleaseCOM(mAmbientSRV0);
+	ReleaseCOM(mAmbientUAV0);
 
 	ReleaseCOM(mAmbientRTV1);
 	ReleaseCOM(mAmbientSRV1);
+	ReleaseCOM(mAmbientUAV1);
+
+	ReleaseCOM(mUpsampledRTV);
+	ReleaseCOM(mUpsampledSRV);
+
+	for(int i = 0; i < 2; ++i)
+	{
+		ReleaseCOM(mHistoryRTV[i]);
+		ReleaseCOM(mHistorySRV[i]);
+	}
 }
 
 void Ssao::BuildRandomVectorTexture()
@@ -306,18 +786,18 @@ void Ssao::BuildRandomVectorTexture()
 	D3D11_SUBRESOURCE_DATA initData = {0};
 	initData.SysMemPitch = 256*sizeof(XMCOLOR);
 
-	XMCOLOR color[256*256];
+	mRandomVectors.resize(256*256);
 	for(int i = 0; i < 256; ++i)
 	{
 		for(int j = 0; j < 256; ++j)
 		{
 			XMFLOAT3 v(MathHelper::RandF(), MathHelper::RandF(), MathHelper::RandF());
 
-			color[i*256+j] = XMCOLOR(v.x, v.y, v.z, 0.0f);
+			mRandomVectors[i*256+j] = XMCOLOR(v.x, v.y, v.z, 0.0f);
 		}
 	}
 
-	initData.pSysMem = color;
+	initData.pSysMem = &mRandomVectors[0];
 	
 	ID3D11Texture2D* tex = 0;
 	HR(md3dDevice->CreateTexture2D(&texDesc, &initData, &tex));
@@ -330,6 +810,25 @@ void Ssao::BuildRandomVectorTexture()
 
 void Ssao::BuildOffsetVectors()
 {
+	if( mSettings.SampleCount != 14 )
+	{
+		// Any other count takes the first SampleCount points of a Halton sequence
+		// mapped to the sphere, which stay spread out for every count.  Lengths
+		// run over [0.25, 1.0] with a third base so they do not line up with the
+		// directions.
+		for(UINT i = 0; i < mSettings.SampleCount; ++i)
+		{
+			float z = 1.0f - 2.0f*RadicalInverse(i+1, 2);
+			float phi = 2.0f*MathHelper::Pi*RadicalInverse(i+1, 3);
+			float r = sqrtf(1.0f - z*z);
+			float s = 0.25f + 0.75f*RadicalInverse(i+1, 5);
+
+			mOffsets[i] = XMFLOAT4(s*r*cosf(phi), s*r*sinf(phi), s*z, 0.0f);
+		}
+
+		return;
+	}
+
     // Start with 14 uniformly distributed vectors.  We choose the 8 corners of the cube
 	// and the 6 center points along each cube face.  We always alternate the points on 
 	// opposites sides of the cubes.  This way we still get the vectors spread out even
@@ -8,14 +8,47 @@
 #define SSAO_H
 
 #include "d3dUtil.h"
- 
- // Should we render AO at half resolution?
- 
+#include "SsaoReference.h"
+#include "SsaoTemporalReference.h"
+#include "GpuTimer.h"
+
 class Camera;
 
 class Ssao
 {
 public:
+	enum { MaxSampleCount = 32 };
+
+	// Cost against quality.  HighQuality is what Ssao has always done.
+	struct Settings
+	{
+		Settings();
+
+		// The ambient map is computed at 1/ResolutionScale of the render target
+		// size: 1, 2 or 4.  Below full resolution it is brought back up with a
+		// depth aware upsample after the blur.
+		UINT ResolutionScale;
+
+		// Offset vectors per pixel, from 4 to MaxSampleCount.
+		UINT SampleCount;
+
+		// Taps on each side of the blur, from 1 to 5.
+		int BlurRadius;
+
+		// Horizontal and vertical blur iterations BlurAmbientMap() does.
+		int BlurCount;
+	};
+
+	enum QualityTier
+	{
+		LowQuality,
+		MediumQuality,
+		HighQuality,
+		UltraQuality
+	};
+
+	static Settings TierSettings(QualityTier tier);
+
 	Ssao(ID3D11Device* device, ID3D11DeviceContext* dc, int width, int height, float fovy, float farZ);
 	~Ssao();
 
@@ -26,6 +59,13 @@ public:
 	/// Call when the backbuffer is resized.  
 	///</summary>
 	void OnSize(int width, int height, float fovy, float farZ);
+
+	///<summary>
+	/// Values are clamped to their ranges.  Changing the resolution scale
+	/// recreates the ambient maps.
+	///</summary>
+	void SetSettings(const Settings& settings);
+	const Settings& GetSettings()const;
  
 	///<summary>
 	/// Changes the render target to the NormalDepth render target.  Pass the 
@@ -43,6 +83,36 @@ public:
 	///</summary>
 	void ComputeSsao(const Camera& camera);
 
+	///<summary>
+	/// Computes the ambient map with the compute shader in SsaoCS.fx instead of
+	/// drawing a quad.  Off by default.
+	///</summary>
+	void SetUseComputeShader(bool enable);
+
+	///<summary>
+	/// Takes 4 samples per pixel instead of SampleCount, moving on to the next offset
+	/// vectors every frame, and blends the result with the previous frames'
+	/// ambient map reprojected to this frame.  Off by default.
+	///</summary>
+	void SetTemporal(bool enable);
+
+	///<summary>
+	/// Fills in the matrices and thresholds of the next temporal pass for this
+	/// camera, for checking the reprojection with SsaoTemporalReference.
+	///</summary>
+	void GetTemporalReferenceParams(const Camera& camera, SsaoTemporalReference::Params& params)const;
+
+	///<summary>
+	/// Fills in the inputs SsaoReference needs to repeat the compute shader on
+	/// the CPU for this camera.
+	///</summary>
+	void GetReferenceParams(const Camera& camera, SsaoReference::Params& params)const;
+
+	///<summary>
+	/// The random vector texture as the GPU reads it: 256x256 RGBA8 texels.
+	///</summary>
+	const unsigned char* RandomVectorData()const;
+
 	///<summary>
 	/// Blurs the ambient map to smooth out the noise caused by only taking a
 	/// few random samples per pixel.  We use an edge preserving blur so that 
@@ -50,12 +120,44 @@ public:
 	///</summary>
 	void BlurAmbientMap(int blurCount);
 
+	///<summary>
+	/// Blurs Settings::BlurCount times.
+	///</summary>
+	void BlurAmbientMap();
+
+	///<summary>
+	/// Blurs with the compute shaders in SsaoBlurCS.fx instead of drawing quads.
+	/// Off by default.
+	///</summary>
+	void SetUseComputeBlur(bool enable);
+
+	///<summary>
+	/// GPU time of the last ComputeSsao and BlurAmbientMap the queries have come
+	/// back for, a few frames behind.
+	///</summary>
+	float GpuMilliseconds()const;
+
 private:
 	Ssao(const Ssao& rhs);
 	Ssao& operator=(const Ssao& rhs);
 
 	void BlurAmbientMap(ID3D11ShaderResourceView* inputSRV, ID3D11RenderTargetView* outputRTV, bool horzBlur);
 
+	void UpsampleAmbientMap();
+
+	void DrawSsao(const Camera& camera, ID3D11RenderTargetView* outputRTV, ID3DX11EffectTechnique* tech);
+
+	void ComputeSsaoCS(const Camera& camera);
+
+	void ComputeSsaoTemporal(const Camera& camera);
+	void BuildTemporalMatrices(const Camera& camera, XMFLOAT4X4& viewToPrevView, XMFLOAT4X4& prevViewToTex)const;
+
+	void BlurAmbientMapCS(int blurCount);
+	void BlurAmbientMapCS(ID3D11ShaderResourceView* inputSRV, ID3D11UnorderedAccessView* outputUAV,
+		ID3DX11EffectTechnique* tech, UINT groupsX, UINT groupsY);
+
+	static XMMATRIX ViewToTexSpace(CXMMATRIX proj);
+
 	void BuildFrustumFarCorners(float fovy, float farZ);
 
 	void BuildFullScreenQuad();
@@ -66,6 +168,7 @@ private:
 	void BuildRandomVectorTexture();
 
 	void BuildOffsetVectors();
+	void BindFullScreenQuad();
 
 	void DrawFullScreenQuad();
 
@@ -78,25 +181,61 @@ private:
 
 	ID3D11ShaderResourceView* mRandomVectorSRV;
 
+	// Kept for the CPU reference.
+	std::vector<XMCOLOR> mRandomVectors;
+
 	ID3D11RenderTargetView* mNormalDepthRTV;
 	ID3D11ShaderResourceView* mNormalDepthSRV;
 
+	// The temporal mode swaps the normal/depth maps every frame so the previous
+	// one is still around.
+	ID3D11RenderTargetView* mPrevNormalDepthRTV;
+	ID3D11ShaderResourceView* mPrevNormalDepthSRV;
+
+	// Accumulated ambient maps, before blurring.  One is read while the other
+	// is written.
+	ID3D11RenderTargetView* mHistoryRTV[2];
+	ID3D11ShaderResourceView* mHistorySRV[2];
+	UINT mHistoryIndex;
+
 	// Need two for ping-ponging during blur.
 	ID3D11RenderTargetView* mAmbientRTV0;
 	ID3D11ShaderResourceView* mAmbientSRV0;
+	ID3D11UnorderedAccessView* mAmbientUAV0;
 
 	ID3D11RenderTargetView* mAmbientRTV1;
 	ID3D11ShaderResourceView* mAmbientSRV1;
+	ID3D11UnorderedAccessView* mAmbientUAV1;
 
+	// Full resolution ambient map, when it is computed below full resolution.
+	ID3D11RenderTargetView* mUpsampledRTV;
+	ID3D11ShaderResourceView* mUpsampledSRV;
 
 	UINT mRenderTargetWidth;
 	UINT mRenderTargetHeight;
 
 	XMFLOAT4 mFrustumFarCorner[4];
 
-	XMFLOAT4 mOffsets[14];
+	XMFLOAT4 mOffsets[MaxSampleCount];
 
 	D3D11_VIEWPORT mAmbientMapViewport;
+	D3D11_VIEWPORT mUpsampledViewport;
+
+	Settings mSettings;
+
+	bool mUseComputeShader;
+	bool mUseComputeBlur;
+
+	bool mTemporal;
+	bool mHistoryValid;
+	UINT mTemporalFrame;
+
+	// Camera of the frame the history was made with.
+	XMFLOAT4X4 mPrevView;
+	XMFLOAT4X4 mPrevProj;
+
+	GpuTimer mSsaoTimer;
+	GpuTimer mBlurTimer;
 };
 
 #endif // SSAO_H
\ No newline at end of file
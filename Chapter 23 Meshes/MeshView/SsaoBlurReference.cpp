@@ -0,0 +1,248 @@
+//***************************************************************************************
+// SsaoBlurReference.cpp
+//***************************************************************************************
+
+#include "SsaoBlurReference.h"
+#include <cassert>
+#include <cmath>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#define SSAOBLUR_SSE2 1
+#include <emmintrin.h>
+#else
+#define SSAOBLUR_SSE2 0
+#endif
+
+const float SsaoBlurReference::Weights[2*MaxBlurRadius + 1] =
+{
+	0.05f, 0.05f, 0.1f, 0.1f, 0.1f, 0.2f, 0.1f, 0.1f, 0.1f, 0.05f, 0.05f
+};
+
+namespace
+{
+	// Same surface tests as the shader.
+	const float MinNormalDot = 0.8f;
+	const float MaxDepthDelta = 0.2f;
+
+	int Clamp(int x, int low, int high)
+	{
+		return x < low ? low : (x > high ? high : x);
+	}
+}
+
+SsaoBlurReference::SsaoBlurReference()
+	: mWidth(0), mHeight(0), mBlurRadius(MaxBlurRadius), mStride(0)
+{
+}
+
+void SsaoBlurReference::SetBlurRadius(int radius)
+{
+	mBlurRadius = Clamp(radius, 1, MaxBlurRadius);
+}
+
+bool SsaoBlurReference::SimdAvailable()
+{
+	return SSAOBLUR_SSE2 != 0;
+}
+
+unsigned int SsaoBlurReference::PaddedIndex(int x, int y)const
+{
+	return (y + MaxBlurRadius)*mStride + (x + MaxBlurRadius);
+}
+
+void SsaoBlurReference::SetNormalDepth(const float* normalDepth, unsigned int width, unsigned int height, int resolutionScale)
+{
+	mWidth = width / resolutionScale;
+	mHeight = height / resolutionScale;
+	mStride = MaxBlurRadius + ((mWidth + 3) & ~3u) + MaxBlurRadius;
+
+	unsigned int planeSize = mStride*(mHeight + 2*MaxBlurRadius);
+
+	mNormalX.assign(planeSize, 0.0f);
+	mNormalY.assign(planeSize, 0.0f);
+	mNormalZ.assign(planeSize, 0.0f);
+	mDepth.assign(planeSize, 0.0f);
+
+	mPaddedInput.assign(planeSize, 0.0f);
+	mPassOutput.assign(mWidth*mHeight, 0.0f);
+
+	float* planes[4] = { &mNormalX[0], &mNormalY[0], &mNormalZ[0], &mDepth[0] };
+
+	for(unsigned int y = 0; y < mHeight; ++y)
+	{
+		for(unsigned int x = 0; x < mWidth; ++x)
+		{
+			unsigned int i = PaddedIndex(x, y);
+
+			if( resolutionScale == 1 )
+			{
+				const float* t = normalDepth + 4*((size_t)y*width + x);
+				for(int c = 0; c < 4; ++c)
+					planes[c][i] = t[c];
+				continue;
+			}
+
+			// The 2x2 texels around the center of the ambient texel, summed in the
+			// shader's order.
+			unsigned int base = resolutionScale/2 - 1;
+			const float* t00 = normalDepth + 4*((size_t)(resolutionScale*y + base)*width + resolutionScale*x + base);
+			const float* t10 = t00 + 4;
+			const float* t01 = t00 + 4*width;
+			const float* t11 = t01 + 4;
+
+			for(int c = 0; c < 4; ++c)
+				planes[c][i] = 0.25f*(((t00[c] + t10[c]) + t01[c]) + t11[c]);
+		}
+	}
+
+	FillApron(mNormalX);
+	FillApron(mNormalY);
+	FillApron(mNormalZ);
+	FillApron(mDepth);
+}
+
+void SsaoBlurReference::FillApron(std::vector<float>& plane)
+{
+	int paddedHeight = (int)mHeight + 2*MaxBlurRadius;
+
+	for(int py = 0; py < paddedHeight; ++py)
+	{
+		int y = py - MaxBlurRadius;
+		for(int px = 0; px < (int)mStride; ++px)
+		{
+			int x = px - MaxBlurRadius;
+			if( x >= 0 && x < (int)mWidth && y >= 0 && y < (int)mHeight )
+				continue;
+
+			plane[py*mStride + px] = plane[PaddedIndex(Clamp(x, 0, mWidth-1), Clamp(y, 0, mHeight-1))];
+		}
+	}
+}
+
+void SsaoBlurReference::PadInput(const float* input)
+{
+	for(unsigned int y = 0; y < mHeight; ++y)
+	{
+		for(unsigned int x = 0; x < mWidth; ++x)
+			mPaddedInput[PaddedIndex(x, y)] = input[y*mWidth + x];
+	}
+
+	FillApron(mPaddedInput);
+}
+
+void SsaoBlurReference::Blur(std::vector<float>& ambient, int blurCount, bool useSimd)
+{
+	assert( ambient.size() == mWidth*mHeight );
+
+	if( ambient.empty() )
+		return;
+
+	for(int i = 0; i < blurCount; ++i)
+	{
+		BlurPass(&ambient[0], &mPassOutput[0], true, useSimd);
+		BlurPass(&mPassOutput[0], &ambient[0], false, useSimd);
+	}
+}
+
+void SsaoBlurReference::BlurPass(const float* input, float* output, bool horzBlur, bool useSimd)
+{
+	PadInput(input);
+
+	// Distance between neighboring taps in the padded planes.
+	int step = horzBlur ? 1 : (int)mStride;
+
+	for(unsigned int y = 0; y < mHeight; ++y)
+	{
+		if( useSimd && SSAOBLUR_SSE2 )
+			BlurRowSimd(y, step, output);
+		else
+			BlurRowScalar(y, step, output);
+	}
+}
+
+void SsaoBlurReference::BlurRowScalar(unsigned int y, int step, float* output)const
+{
+	for(unsigned int x = 0; x < mWidth; ++x)
+	{
+		int c = (int)PaddedIndex(x, y);
+
+		// The center value always contributes to the sum.
+		float color       = Weights[MaxBlurRadius]*mPaddedInput[c];
+		float totalWeight = Weights[MaxBlurRadius];
+
+		for(int i = -mBlurRadius; i <= mBlurRadius; ++i)
+		{
+			if( i == 0 )
+				continue;
+
+			int n = c + i*step;
+
+			float dot = mNormalX[n]*mNormalX[c] + mNormalY[n]*mNormalY[c] + mNormalZ[n]*mNormalZ[c];
+
+			if( dot >= MinNormalDot && std::fabs(mDepth[n] - mDepth[c]) <= MaxDepthDelta )
+			{
+				float weight = Weights[i + MaxBlurRadius];
+
+				color += weight*mPaddedInput[n];
+				totalWeight += weight;
+			}
+		}
+
+		output[y*mWidth + x] = color / totalWeight;
+	}
+}
+
+void SsaoBlurReference::BlurRowSimd(unsigned int y, int step, float* output)const
+{
+#if SSAOBLUR_SSE2
+	const __m128 minNormalDot = _mm_set1_ps(MinNormalDot);
+	const __m128 maxDepthDelta = _mm_set1_ps(MaxDepthDelta);
+	const __m128 signBit = _mm_set1_ps(-0.0f);
+
+	// Four texels at a time.  Lanes past the width read the apron and are not
+	// stored.
+	for(unsigned int x = 0; x < mWidth; x += 4)
+	{
+		int c = (int)PaddedIndex(x, y);
+
+		__m128 centerX = _mm_loadu_ps(&mNormalX[c]);
+		__m128 centerY = _mm_loadu_ps(&mNormalY[c]);
+		__m128 centerZ = _mm_loadu_ps(&mNormalZ[c]);
+		__m128 centerDepth = _mm_loadu_ps(&mDepth[c]);
+
+		__m128 color       = _mm_mul_ps(_mm_set1_ps(Weights[MaxBlurRadius]), _mm_loadu_ps(&mPaddedInput[c]));
+		__m128 totalWeight = _mm_set1_ps(Weights[MaxBlurRadius]);
+
+		for(int i = -mBlurRadius; i <= mBlurRadius; ++i)
+		{
+			if( i == 0 )
+				continue;
+
+			int n = c + i*step;
+
+			__m128 dot = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&mNormalX[n]), centerX), _mm_mul_ps(_mm_loadu_ps(&mNormalY[n]), centerY)),
+				_mm_mul_ps(_mm_loadu_ps(&mNormalZ[n]), centerZ));
+
+			__m128 depthDelta = _mm_andnot_ps(signBit, _mm_sub_ps(_mm_loadu_ps(&mDepth[n]), centerDepth));
+
+			__m128 sameSurface = _mm_and_ps(_mm_cmpge_ps(dot, minNormalDot), _mm_cmple_ps(depthDelta, maxDepthDelta));
+
+			// Adding zero for the rejected taps leaves the sums as the scalar path has them.
+			__m128 weight = _mm_set1_ps(Weights[i + MaxBlurRadius]);
+
+			color       = _mm_add_ps(color, _mm_and_ps(sameSurface, _mm_mul_ps(weight, _mm_loadu_ps(&mPaddedInput[n]))));
+			totalWeight = _mm_add_ps(totalWeight, _mm_and_ps(sameSurface, weight));
+		}
+
+		float result[4];
+		_mm_storeu_ps(result, _mm_div_ps(color, totalWeight));
+
+		unsigned int count = mWidth - x < 4 ? mWidth - x : 4;
+		for(unsigned int k = 0; k < count; ++k)
+			output[y*mWidth + x + k] = result[k];
+	}
+#else
+	BlurRowScalar(y, step, output);
+#endif
+}
@@ -0,0 +1,81 @@
+//***************************************************************************************
+// SsaoBlurReference.h
+//
+// CPU version of the bilateral blur in FX/SsaoBlurCS.fx, for checking the GPU
+// result and for timing a CPU fallback.
+//   -The normal/depth map is reduced to the ambient map's resolution once, by
+//    averaging 2x2 texels as the shader does, and kept as separate planes of x,
+//    y, z and depth.
+//   -Each plane has an apron of MaxBlurRadius texels holding copies of the edge
+//    texels, like the groupshared tiles of the shader.  A row can then be blurred
+//    four texels at a time with no clamping in the inner loop.
+//   -The SSE path and the scalar path do the same operations in the same order,
+//    so they give the same bits.  Without SSE2 only the scalar path exists.
+// The horizontal result is kept as a float, as in the shader's fused pass.
+// Uses only the standard library and SSE2 intrinsics.
+//***************************************************************************************
+
+#ifndef SSAOBLURREFERENCE_H
+#define SSAOBLURREFERENCE_H
+
+#include <vector>
+
+class SsaoBlurReference
+{
+public:
+	enum { MaxBlurRadius = 5 };
+
+	// Smaller radii use the middle of the table.
+	static const float Weights[2*MaxBlurRadius + 1];
+
+	SsaoBlurReference();
+
+	// normalDepth holds width*height texels of (view space normal, view depth).
+	// The ambient map to blur is (width/resolutionScale) x (height/resolutionScale).
+	void SetNormalDepth(const float* normalDepth, unsigned int width, unsigned int height, int resolutionScale = 2);
+
+	// Taps on each side, from 1 to MaxBlurRadius.
+	void SetBlurRadius(int radius);
+
+	// One horizontal and one vertical pass per iteration, as Ssao::BlurAmbientMap.
+	void Blur(std::vector<float>& ambient, int blurCount, bool useSimd = true);
+
+	// One pass.  input and output hold an ambient map each and may not overlap.
+	void BlurPass(const float* input, float* output, bool horzBlur, bool useSimd = true);
+
+	// True if the SSE path was compiled in.
+	static bool SimdAvailable();
+
+private:
+	SsaoBlurReference(const SsaoBlurReference& rhs);
+	SsaoBlurReference& operator=(const SsaoBlurReference& rhs);
+
+	// Index of ambient texel (x, y) in a padded plane.
+	unsigned int PaddedIndex(int x, int y)const;
+
+	// Copies the ambient map into mPaddedInput and fills the apron.
+	void PadInput(const float* input);
+	void FillApron(std::vector<float>& plane);
+
+	void BlurRowScalar(unsigned int y, int step, float* output)const;
+	void BlurRowSimd(unsigned int y, int step, float* output)const;
+
+private:
+	unsigned int mWidth;
+	unsigned int mHeight;
+	int mBlurRadius;
+
+	// Row length of the padded planes: the apron on both sides plus the width
+	// rounded up to a multiple of four.
+	unsigned int mStride;
+
+	std::vector<float> mNormalX;
+	std::vector<float> mNormalY;
+	std::vector<float> mNormalZ;
+	std::vector<float> mDepth;
+
+	std::vector<float> mPaddedInput;
+	std::vector<float> mPassOutput;
+};
+
+#endif // SSAOBLURREFERENCE_H
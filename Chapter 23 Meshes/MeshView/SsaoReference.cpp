@@ -0,0 +1,227 @@
+//***************************************************************************************
+// SsaoReference.cpp
+//
+// Each helper matches an HLSL intrinsic, including what it does with NaN where
+// that differs from the obvious C++ (max and saturate return the other operand
+// or 0).  Keep the order of the operations the same as the shader's.
+//***************************************************************************************
+
+#include "SsaoReference.h"
+#include <cmath>
+
+const float SsaoReference::FarDepth = 1e5f;
+
+namespace
+{
+	struct Float3
+	{
+		float x, y, z;
+	};
+
+	Float3 MakeFloat3(float x, float y, float z)
+	{
+		Float3 v = { x, y, z };
+		return v;
+	}
+
+	float Dot(const Float3& a, const Float3& b)
+	{
+		return a.x*b.x + a.y*b.y + a.z*b.z;
+	}
+
+	Float3 Scale(float s, const Float3& v)
+	{
+		return MakeFloat3(s*v.x, s*v.y, s*v.z);
+	}
+
+	Float3 Add(const Float3& a, const Float3& b)
+	{
+		return MakeFloat3(a.x + b.x, a.y + b.y, a.z + b.z);
+	}
+
+	Float3 Subtract(const Float3& a, const Float3& b)
+	{
+		return MakeFloat3(a.x - b.x, a.y - b.y, a.z - b.z);
+	}
+
+	// reflect(i, n) = i - 2*n*dot(i, n)
+	Float3 Reflect(const Float3& i, const Float3& n)
+	{
+		return Subtract(i, Scale(2.0f*Dot(i, n), n));
+	}
+
+	Float3 Normalize(const Float3& v)
+	{
+		return Scale(1.0f / std::sqrt(Dot(v, v)), v);
+	}
+
+	float Sign(float x)
+	{
+		return (float)((x > 0.0f) - (x < 0.0f));
+	}
+
+	float Max(float a, float b)
+	{
+		return a > b ? a : (b > a ? b : (a == a ? a : b));
+	}
+
+	float Saturate(float x)
+	{
+		return x > 0.0f ? (x < 1.0f ? x : 1.0f) : 0.0f;
+	}
+
+	struct Texel
+	{
+		float Normal[3];
+		float Depth;
+	};
+
+	Texel LoadNormalDepth(const float* normalDepth, unsigned int width, int scale, int sizeX, int sizeY, int x, int y)
+	{
+		Texel t;
+		if( x < 0 || y < 0 || x >= sizeX || y >= sizeY )
+		{
+			t.Normal[0] = t.Normal[1] = t.Normal[2] = 0.0f;
+			t.Depth = SsaoReference::FarDepth;
+			return t;
+		}
+
+		const float* src = normalDepth + 4*((size_t)(scale*y)*width + scale*x);
+		t.Normal[0] = src[0];
+		t.Normal[1] = src[1];
+		t.Normal[2] = src[2];
+		t.Depth = src[3];
+		return t;
+	}
+
+	float OcclusionFunction(const SsaoReference::Params& params, float distZ)
+	{
+		float occlusion = 0.0f;
+		if( distZ > params.SurfaceEpsilon )
+		{
+			float fadeLength = params.OcclusionFadeEnd - params.OcclusionFadeStart;
+			occlusion = Saturate( (params.OcclusionFadeEnd - distZ)/fadeLength );
+		}
+
+		return occlusion;
+	}
+
+	// floor of the clamped coordinate times the size, as the shader converts it.
+	int ToTexel(float coord, int size)
+	{
+		float c = coord < -1.0f ? -1.0f : (coord > 2.0f ? 2.0f : coord);
+		return (int)std::floor(c*(float)size);
+	}
+}
+
+SsaoReference::Params::Params()
+	: SampleCount(14), ResolutionScale(2),
+	  OcclusionRadius(0.5f), OcclusionFadeStart(0.2f), OcclusionFadeEnd(2.0f), SurfaceEpsilon(0.05f)
+{
+	for(int i = 0; i < 4; ++i)
+	{
+		for(int j = 0; j < 4; ++j)
+		{
+			ViewToTexSpace[i][j] = i == j ? 1.0f : 0.0f;
+			FrustumCorners[i][j] = 0.0f;
+		}
+	}
+
+	for(int i = 0; i < MaxSampleCount; ++i)
+	{
+		for(int j = 0; j < 4; ++j)
+			OffsetVectors[i][j] = 0.0f;
+	}
+}
+
+void SsaoReference::Compute(const Params& params, const float* normalDepth, unsigned int width, unsigned int height,
+	const unsigned char* randomVectors, std::vector<float>& ambient)
+{
+	unsigned int ambientWidth = width / params.ResolutionScale;
+	unsigned int ambientHeight = height / params.ResolutionScale;
+
+	ambient.resize(ambientWidth*ambientHeight);
+
+	for(unsigned int y = 0; y < ambientHeight; ++y)
+	{
+		for(unsigned int x = 0; x < ambientWidth; ++x)
+			ambient[y*ambientWidth + x] = ComputeTexel(params, normalDepth, width, height, randomVectors, x, y);
+	}
+}
+
+float SsaoReference::ComputeTexel(const Params& params, const float* normalDepth, unsigned int width, unsigned int height,
+	const unsigned char* randomVectors, int x, int y)
+{
+	const int scale = params.ResolutionScale;
+	const int sizeX = (int)width / scale;
+	const int sizeY = (int)height / scale;
+
+	Texel center = LoadNormalDepth(normalDepth, width, scale, sizeX, sizeY, x, y);
+
+	Float3 n = MakeFloat3(center.Normal[0], center.Normal[1], center.Normal[2]);
+	float pz = center.Depth;
+
+	float texX = ((float)x + 0.5f) / (float)sizeX;
+	float texY = ((float)y + 0.5f) / (float)sizeY;
+
+	const float (*corners)[4] = params.FrustumCorners;
+
+	Float3 toFarPlane;
+	toFarPlane.x = corners[0][0] + (corners[2][0] - corners[0][0])*texX;
+	toFarPlane.y = corners[1][1] + (corners[0][1] - corners[1][1])*texY;
+	toFarPlane.z = corners[0][2];
+
+	Float3 p = Scale(pz/toFarPlane.z, toFarPlane);
+
+	int randX = ((x*1024 + 512) / sizeX) & (RandomVectorSize - 1);
+	int randY = ((y*1024 + 512) / sizeY) & (RandomVectorSize - 1);
+
+	const unsigned char* rgba = randomVectors + 4*(randY*RandomVectorSize + randX);
+	Float3 randVec = MakeFloat3(
+		2.0f*(rgba[0] / 255.0f) - 1.0f,
+		2.0f*(rgba[1] / 255.0f) - 1.0f,
+		2.0f*(rgba[2] / 255.0f) - 1.0f);
+
+	const float (*m)[4] = params.ViewToTexSpace;
+
+	float occlusionSum = 0.0f;
+
+	for(int i = 0; i < params.SampleCount; ++i)
+	{
+		Float3 offsetVector = MakeFloat3(params.OffsetVectors[i][0], params.OffsetVectors[i][1], params.OffsetVectors[i][2]);
+		Float3 offset = Reflect(offsetVector, randVec);
+
+		float flip = Sign(Dot(offset, n));
+
+		Float3 q = Add(p, Scale(flip * params.OcclusionRadius, offset));
+
+		// mul(float4(q, 1), gViewToTexSpace), then the divide by w.
+		float projX = q.x*m[0][0] + q.y*m[1][0] + q.z*m[2][0] + m[3][0];
+		float projY = q.x*m[0][1] + q.y*m[1][1] + q.z*m[2][1] + m[3][1];
+		float projW = q.x*m[0][3] + q.y*m[1][3] + q.z*m[2][3] + m[3][3];
+		projX /= projW;
+		projY /= projW;
+
+		int rx = ToTexel(projX, sizeX);
+		int ry = ToTexel(projY, sizeY);
+
+		// The shader reads this from its groupshared cache when it is near the
+		// tile; the value is the same either way.
+		float rz = LoadNormalDepth(normalDepth, width, scale, sizeX, sizeY, rx, ry).Depth;
+
+		Float3 r = Scale(rz / q.z, q);
+
+		float distZ = p.z - r.z;
+		float dp = Max(Dot(n, Normalize(Subtract(r, p))), 0.0f);
+		float occlusion = dp * OcclusionFunction(params, distZ);
+
+		occlusionSum += occlusion;
+	}
+
+	occlusionSum /= params.SampleCount;
+
+	float access = 1.0f - occlusionSum;
+	float access2 = access*access;
+
+	return Saturate(access2*access2);
+}
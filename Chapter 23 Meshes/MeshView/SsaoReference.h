@@ -0,0 +1,66 @@
+//***************************************************************************************
+// SsaoReference.h
+//
+// Scalar CPU version of the compute shader in FX/SsaoCS.fx.  It takes the same
+// inputs (the normal/depth map, the offset vectors and the 256x256 random vector
+// table of the Ssao class) and repeats the shader's steps in the same order with
+// floats, so its output can be checked against saved results without a GPU.
+//
+// The GPU result agrees to within a small tolerance rather than to the bit, since
+// GPU division, square roots and multiply-adds are not required to round the way
+// the CPU does.  CPU builds agree with the values saved in
+// Tests/SsaoReferenceTest.cpp to within 1e-3.
+// Uses only the standard library.
+//***************************************************************************************
+
+#ifndef SSAOREFERENCE_H
+#define SSAOREFERENCE_H
+
+#include <vector>
+
+class SsaoReference
+{
+public:
+	enum
+	{
+		MaxSampleCount = 32,
+		RandomVectorSize = 256
+	};
+
+	struct Params
+	{
+		Params();
+
+		// Row vectors, laid out like XMFLOAT4X4.
+		float ViewToTexSpace[4][4];
+		float OffsetVectors[MaxSampleCount][4];
+		float FrustumCorners[4][4];
+
+		// How many of OffsetVectors are used.
+		int SampleCount;
+
+		// Size of the normal/depth map over the size of the ambient map.
+		int ResolutionScale;
+
+		// Coordinates given in view space.
+		float OcclusionRadius;
+		float OcclusionFadeStart;
+		float OcclusionFadeEnd;
+		float SurfaceEpsilon;
+	};
+
+	// normalDepth holds width*height texels of (view space normal, view depth).
+	// randomVectors holds RandomVectorSize^2 RGBA8 texels in memory order.  The
+	// ambient map is (width/ResolutionScale) x (height/ResolutionScale).
+	static void Compute(const Params& params, const float* normalDepth, unsigned int width, unsigned int height,
+		const unsigned char* randomVectors, std::vector<float>& ambient);
+
+	// One texel of the ambient map.
+	static float ComputeTexel(const Params& params, const float* normalDepth, unsigned int width, unsigned int height,
+		const unsigned char* randomVectors, int x, int y);
+
+	// Depth the shader uses for texels off the map.
+	static const float FarDepth;
+};
+
+#endif // SSAOREFERENCE_H
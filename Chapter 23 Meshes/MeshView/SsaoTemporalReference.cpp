@@ -0,0 +1,65 @@
+//***************************************************************************************
+// SsaoTemporalReference.cpp
+//***************************************************************************************
+
+#include "SsaoTemporalReference.h"
+#include <cmath>
+
+SsaoTemporalReference::Params::Params()
+	: HistoryWeight(0.8f), DepthTolerance(0.05f), NormalThreshold(0.9f)
+{
+	for(int i = 0; i < 4; ++i)
+	{
+		for(int j = 0; j < 4; ++j)
+		{
+			ViewToPrevView[i][j] = i == j ? 1.0f : 0.0f;
+			PrevViewToTex[i][j] = i == j ? 1.0f : 0.0f;
+		}
+	}
+}
+
+void SsaoTemporalReference::ReconstructViewPos(const float toFarPlane[3], float depth, float p[3])
+{
+	float t = depth / toFarPlane[2];
+
+	p[0] = t*toFarPlane[0];
+	p[1] = t*toFarPlane[1];
+	p[2] = t*toFarPlane[2];
+}
+
+bool SsaoTemporalReference::Reproject(const Params& params, const float p[3], const float n[3],
+	float prevP[3], float prevN[3], float prevTex[2])
+{
+	const float (*m)[4] = params.ViewToPrevView;
+
+	// mul(float4(p, 1), M) and mul(n, (float3x3)M).
+	for(int j = 0; j < 3; ++j)
+	{
+		prevP[j] = p[0]*m[0][j] + p[1]*m[1][j] + p[2]*m[2][j] + m[3][j];
+		prevN[j] = n[0]*m[0][j] + n[1]*m[1][j] + n[2]*m[2][j];
+	}
+
+	const float (*t)[4] = params.PrevViewToTex;
+
+	float w = prevP[0]*t[0][3] + prevP[1]*t[1][3] + prevP[2]*t[2][3] + t[3][3];
+	for(int j = 0; j < 2; ++j)
+		prevTex[j] = (prevP[0]*t[0][j] + prevP[1]*t[1][j] + prevP[2]*t[2][j] + t[3][j]) / w;
+
+	return prevTex[0] >= 0.0f && prevTex[1] >= 0.0f && prevTex[0] <= 1.0f && prevTex[1] <= 1.0f;
+}
+
+bool SsaoTemporalReference::SameSurface(const Params& params, const float prevP[3], const float prevN[3],
+	const float prevNormalDepth[4])
+{
+	float dot = prevN[0]*prevNormalDepth[0] + prevN[1]*prevNormalDepth[1] + prevN[2]*prevNormalDepth[2];
+
+	return std::fabs(prevNormalDepth[3] - prevP[2]) <= params.DepthTolerance*prevP[2] &&
+		dot >= params.NormalThreshold;
+}
+
+float SsaoTemporalReference::Accumulate(const Params& params, float current, float history, bool historyValid)
+{
+	float w = historyValid ? params.HistoryWeight : 0.0f;
+
+	return w > 0.0f ? current + w*(history - current) : current;
+}
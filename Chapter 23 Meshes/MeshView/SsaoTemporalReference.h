@@ -0,0 +1,47 @@
+//***************************************************************************************
+// SsaoTemporalReference.h
+//
+// The reprojection and history test of FX/SsaoTemporal.fx on the CPU, one pixel
+// at a time, so the math can be checked without a GPU.  Matrices are row vectors
+// laid out like XMFLOAT4X4, as the shader uses them.
+// Uses only the standard library.
+//***************************************************************************************
+
+#ifndef SSAOTEMPORALREFERENCE_H
+#define SSAOTEMPORALREFERENCE_H
+
+class SsaoTemporalReference
+{
+public:
+	struct Params
+	{
+		Params();
+
+		float ViewToPrevView[4][4]; // InvView*PrevView
+		float PrevViewToTex[4][4];  // PrevProj*Texture
+
+		float HistoryWeight;
+		float DepthTolerance;
+		float NormalThreshold;
+	};
+
+	// The view space position of a pixel, from the vector to the far plane and
+	// the depth in the normal/depth map.
+	static void ReconstructViewPos(const float toFarPlane[3], float depth, float p[3]);
+
+	// Moves the view space point p and normal n into the previous frame's view
+	// space, and finds the texture coordinates of p in the previous frame.
+	// Returns false if they are off the map.
+	static bool Reproject(const Params& params, const float p[3], const float n[3],
+		float prevP[3], float prevN[3], float prevTex[2]);
+
+	// True if the previous frame's normal/depth at prevTex belongs to the same
+	// surface as the reprojected point.
+	static bool SameSurface(const Params& params, const float prevP[3], const float prevN[3],
+		const float prevNormalDepth[4]);
+
+	// Exponential history: current + w*(history - current).
+	static float Accumulate(const Params& params, float current, float history, bool historyValid);
+};
+
+#endif // SSAOTEMPORALREFERENCE_H
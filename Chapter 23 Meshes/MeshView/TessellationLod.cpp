@@ -0,0 +1,153 @@
+//***************************************************************************************
+// TessellationLod.cpp
+//***************************************************************************************
+
+#include "TessellationLod.h"
+#include "Camera.h"
+#include "Effects.h"
+
+namespace
+{
+	template<typename TEffect>
+	void ApplyConstants(TEffect* fx, const TessellationReference::Constants& c)
+	{
+		fx->SetMaxTessDistance(c.MaxTessDistance);
+		fx->SetMinTessDistance(c.MinTessDistance);
+		fx->SetMinTessFactor(c.MinTessFactor);
+		fx->SetMaxTessFactor(c.MaxTessFactor);
+		fx->SetTessEdgeLength(c.EdgeLength);
+		fx->SetTessProjScale(c.ProjScale);
+		fx->SetHeightScale(c.HeightScale);
+		fx->SetTessBackfaceSlack(c.BackfaceSlack);
+		fx->SetTessCullPlanes(reinterpret_cast<const XMFLOAT4*>(c.CullPlanes));
+		fx->SetTessCullView(*reinterpret_cast<const XMFLOAT4*>(c.CullView));
+	}
+
+	void NormalizePlanes(XMFLOAT4 planes[6])
+	{
+		for(int i = 0; i < 6; ++i)
+			XMStoreFloat4(&planes[i], XMPlaneNormalize(XMLoadFloat4(&planes[i])));
+	}
+}
+
+TessellationSettings::TessellationSettings()
+	: Enabled(false),
+	  MaxTessDistance(1.0f),
+	  MinTessDistance(25.0f),
+	  MinTessFactor(1.0f),
+	  MaxTessFactor(5.0f),
+	  EdgeLength(0.0f),
+	  HeightScale(0.07f)
+{
+}
+
+TessellationLod::TessellationLod()
+	: mEyePosW(0.0f, 0.0f, 0.0f), mProjScale(1.0f), mBackfaceSlack(0.25f)
+{
+	// Until SetEye, nothing is outside.
+	for(int i = 0; i < 6; ++i)
+		mFrustumPlanes[i] = XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f);
+}
+
+void TessellationLod::SetEye(const Camera& camera, float viewportHeight)
+{
+	mEyePosW = camera.GetPosition();
+
+	// Height in pixels of one unit at unit distance.
+	mProjScale = 0.5f*viewportHeight / tanf(0.5f*camera.GetFovY());
+
+	ExtractFrustumPlanes(mFrustumPlanes, camera.ViewProj());
+	NormalizePlanes(mFrustumPlanes);
+}
+
+const XMFLOAT3& TessellationLod::EyePosW()const
+{
+	return mEyePosW;
+}
+
+void TessellationLod::SetBackfaceSlack(float slack)
+{
+	mBackfaceSlack = slack;
+}
+
+TessellationReference::Constants TessellationLod::ScenePass()const
+{
+	TessellationReference::Constants c;
+	SetMaterial(TessellationSettings(), c);
+	SetEyeConstants(c);
+
+	for(int i = 0; i < 6; ++i)
+	{
+		c.CullPlanes[i][0] = mFrustumPlanes[i].x;
+		c.CullPlanes[i][1] = mFrustumPlanes[i].y;
+		c.CullPlanes[i][2] = mFrustumPlanes[i].z;
+		c.CullPlanes[i][3] = mFrustumPlanes[i].w;
+	}
+
+	c.CullView[0] = mEyePosW.x;
+	c.CullView[1] = mEyePosW.y;
+	c.CullView[2] = mEyePosW.z;
+	c.CullView[3] = 1.0f;
+
+	return c;
+}
+
+TessellationReference::Constants TessellationLod::ShadowPass(CXMMATRIX lightView, CXMMATRIX lightProj)const
+{
+	TessellationReference::Constants c;
+	SetMaterial(TessellationSettings(), c);
+	SetEyeConstants(c);
+
+	XMFLOAT4 planes[6];
+	ExtractFrustumPlanes(planes, lightView*lightProj);
+	NormalizePlanes(planes);
+
+	// No near plane.
+	planes[4] = XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f);
+
+	for(int i = 0; i < 6; ++i)
+	{
+		c.CullPlanes[i][0] = planes[i].x;
+		c.CullPlanes[i][1] = planes[i].y;
+		c.CullPlanes[i][2] = planes[i].z;
+		c.CullPlanes[i][3] = planes[i].w;
+	}
+
+	// The light looks down the view space z axis, which is the third column of
+	// the view matrix.
+	XMFLOAT4X4 V;
+	XMStoreFloat4x4(&V, lightView);
+
+	c.CullView[0] = V(0,2);
+	c.CullView[1] = V(1,2);
+	c.CullView[2] = V(2,2);
+	c.CullView[3] = 0.0f;
+
+	return c;
+}
+
+void TessellationLod::SetMaterial(const TessellationSettings& settings, TessellationReference::Constants& c)
+{
+	c.MaxTessDistance = settings.MaxTessDistance;
+	c.MinTessDistance = settings.MinTessDistance;
+	c.MinTessFactor   = settings.MinTessFactor;
+	c.MaxTessFactor   = settings.MaxTessFactor;
+	c.EdgeLength      = settings.EdgeLength;
+	c.HeightScale     = settings.HeightScale;
+}
+
+void TessellationLod::SetEyeConstants(TessellationReference::Constants& c)const
+{
+	c.ProjScale = mProjScale;
+	c.BackfaceSlack = mBackfaceSlack;
+}
+
+void TessellationLod::Apply(NormalMapEffect* fx, const TessellationReference::Constants& c)
+{
+	ApplyConstants(fx, c);
+}
+
+void TessellationLod::Apply(BuildShadowMapEffect* fx, const TessellationReference::Constants& c)
+{
+	ApplyConstants(fx, c);
+}
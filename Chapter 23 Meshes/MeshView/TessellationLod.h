@@ -0,0 +1,92 @@
+//***************************************************************************************
+// TessellationLod.h
+//
+// Sets up the displacement mapped techniques of NormalMap.fx and BuildShadowMap.fx
+// (see FX/Tessellation.fx) from the CPU.
+//   -TessellationSettings holds the tessellation range of one material; each
+//    BasicModel subset has one.
+//   -The level of detail is chosen for one eye, set with SetEye, in every pass,
+//    so the shadow maps hold the same surface the eye sees.  Edges are split
+//    either by distance or to a target length in pixels on the eye's screen.
+//   -Each pass culls the patches it cannot see: the scene pass those outside the
+//    camera frustum or facing away from the eye, a shadow pass those outside the
+//    light's volume or facing away from the light.  Culled patches get factors of
+//    zero and are never tessellated.
+// The constants are a TessellationReference::Constants, so a setup can be checked
+// on the CPU.
+//***************************************************************************************
+
+#ifndef TESSELLATIONLOD_H
+#define TESSELLATIONLOD_H
+
+#include "d3dUtil.h"
+#include "TessellationReference.h"
+
+class Camera;
+class NormalMapEffect;
+class BuildShadowMapEffect;
+
+struct TessellationSettings
+{
+	TessellationSettings();
+
+	// Off by default, since the techniques need a height map in the alpha
+	// channel of the normal map.
+	bool Enabled;
+
+	// The factor runs from MaxTessFactor at MaxTessDistance and nearer down to
+	// MinTessFactor at MinTessDistance and farther.
+	float MaxTessDistance;
+	float MinTessDistance;
+	float MinTessFactor;
+	float MaxTessFactor;
+
+	// Target edge length in pixels.  Above zero, it replaces the distances and
+	// the factor is only clamped to [MinTessFactor, MaxTessFactor].
+	float EdgeLength;
+
+	float HeightScale;
+};
+
+class TessellationLod
+{
+public:
+	TessellationLod();
+
+	// The camera the level of detail is chosen for, and the height in pixels of
+	// its viewport.  Call when either changes, before building constants.
+	void SetEye(const Camera& camera, float viewportHeight);
+
+	const XMFLOAT3& EyePosW()const;
+
+	// Cosine of how far past edge on a patch may face away before it is culled.
+	// Raise it for materials with deep displacement.  0.25 by default.
+	void SetBackfaceSlack(float slack);
+
+	// Culling for the scene pass, without a material.
+	TessellationReference::Constants ScenePass()const;
+
+	// Culling for a shadow pass with the light's view and orthographic
+	// projection.  The volume has no near plane, since a patch between the light
+	// and the volume still casts a shadow into it.
+	TessellationReference::Constants ShadowPass(CXMMATRIX lightView, CXMMATRIX lightProj)const;
+
+	// Fills in the material part of a pass's constants.
+	static void SetMaterial(const TessellationSettings& settings, TessellationReference::Constants& c);
+
+	static void Apply(NormalMapEffect* fx, const TessellationReference::Constants& c);
+	static void Apply(BuildShadowMapEffect* fx, const TessellationReference::Constants& c);
+
+private:
+	void SetEyeConstants(TessellationReference::Constants& c)const;
+
+private:
+	XMFLOAT3 mEyePosW;
+	float mProjScale;
+	float mBackfaceSlack;
+
+	// Inward facing, normalized world space planes of the eye's frustum.
+	XMFLOAT4 mFrustumPlanes[6];
+};
+
+#endif // TESSELLATIONLOD_H
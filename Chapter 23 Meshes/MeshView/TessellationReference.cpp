@@ -0,0 +1,113 @@
+//***************************************************************************************
+// TessellationReference.cpp
+//***************************************************************************************
+
+#include "TessellationReference.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	float Distance(const float a[3], const float b[3])
+	{
+		float dx = a[0] - b[0];
+		float dy = a[1] - b[1];
+		float dz = a[2] - b[2];
+
+		return sqrtf(dx*dx + dy*dy + dz*dz);
+	}
+
+	float Saturate(float x)
+	{
+		return std::min(std::max(x, 0.0f), 1.0f);
+	}
+
+	float PlaneDot(const float plane[4], const float p[3])
+	{
+		return plane[0]*p[0] + plane[1]*p[1] + plane[2]*p[2] + plane[3];
+	}
+}
+
+float TessellationReference::VertexFactor(const Constants& c, const float eyePosW[3], const float posW[3])
+{
+	float d = Distance(posW, eyePosW);
+
+	float tess = Saturate( (c.MinTessDistance - d) / (c.MinTessDistance - c.MaxTessDistance) );
+
+	return c.MinTessFactor + tess*(c.MaxTessFactor - c.MinTessFactor);
+}
+
+float TessellationReference::EdgeFactor(const Constants& c, const float eyePosW[3], const float p0[3], const float p1[3])
+{
+	if( c.EdgeLength <= 0.0f )
+		return 0.5f*(VertexFactor(c, eyePosW, p0) + VertexFactor(c, eyePosW, p1));
+
+	float center[3] =
+	{
+		0.5f*(p0[0] + p1[0]),
+		0.5f*(p0[1] + p1[1]),
+		0.5f*(p0[2] + p1[2])
+	};
+
+	float d = std::max(Distance(center, eyePosW), 0.0001f);
+	float pixels = Distance(p0, p1)*c.ProjScale / d;
+
+	return std::min(std::max(pixels / c.EdgeLength, c.MinTessFactor), c.MaxTessFactor);
+}
+
+bool TessellationReference::PatchCulled(const Constants& c, const float p0[3], const float p1[3], const float p2[3])
+{
+	for(int i = 0; i < 6; ++i)
+	{
+		if( PlaneDot(c.CullPlanes[i], p0) < -c.HeightScale &&
+			PlaneDot(c.CullPlanes[i], p1) < -c.HeightScale &&
+			PlaneDot(c.CullPlanes[i], p2) < -c.HeightScale )
+		{
+			return true;
+		}
+	}
+
+	if( c.CullView[3] >= 0.0f )
+	{
+		float e0[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+		float e1[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+
+		float n[3] =
+		{
+			e0[1]*e1[2] - e0[2]*e1[1],
+			e0[2]*e1[0] - e0[0]*e1[2],
+			e0[0]*e1[1] - e0[1]*e1[0]
+		};
+
+		float toPatch[3];
+		for(int i = 0; i < 3; ++i)
+			toPatch[i] = c.CullView[3] > 0.0f ? p0[i] - c.CullView[i] : c.CullView[i];
+
+		float zero[3] = { 0.0f, 0.0f, 0.0f };
+		float lengths = Distance(n, zero)*Distance(toPatch, zero);
+		float d = n[0]*toPatch[0] + n[1]*toPatch[1] + n[2]*toPatch[2];
+
+		if( lengths > 0.0f && d > c.BackfaceSlack*lengths )
+			return true;
+	}
+
+	return false;
+}
+
+bool TessellationReference::PatchFactors(const Constants& c, const float eyePosW[3],
+	const float p0[3], const float p1[3], const float p2[3], float edge[3], float& inside)
+{
+	if( PatchCulled(c, p0, p1, p2) )
+	{
+		edge[0] = edge[1] = edge[2] = 0.0f;
+		inside = 0.0f;
+		return false;
+	}
+
+	edge[0] = EdgeFactor(c, eyePosW, p1, p2);
+	edge[1] = EdgeFactor(c, eyePosW, p2, p0);
+	edge[2] = EdgeFactor(c, eyePosW, p0, p1);
+	inside = (edge[0] + edge[1] + edge[2]) / 3.0f;
+
+	return true;
+}
@@ -0,0 +1,53 @@
+//***************************************************************************************
+// TessellationReference.h
+//
+// CPU version of the tessellation factors and patch culling in FX/Tessellation.fx,
+// for checking a level of detail setup without the GPU.  Constants holds the
+// same values as cbTessellation, and TessellationLod fills one for each pass.
+// Uses only the standard library.
+//***************************************************************************************
+
+#ifndef TESSELLATIONREFERENCE_H
+#define TESSELLATIONREFERENCE_H
+
+class TessellationReference
+{
+public:
+	// Mirrors cbTessellation.
+	struct Constants
+	{
+		float MaxTessDistance;
+		float MinTessDistance;
+		float MinTessFactor;
+		float MaxTessFactor;
+
+		// Screen space mode when above zero.
+		float EdgeLength;
+		float ProjScale;
+
+		float HeightScale;
+		float BackfaceSlack;
+
+		float CullPlanes[6][4];
+		float CullView[4];
+	};
+
+	// Distance mode factor of a vertex.
+	static float VertexFactor(const Constants& c, const float eyePosW[3], const float posW[3]);
+
+	// Factor of the edge from p0 to p1.
+	static float EdgeFactor(const Constants& c, const float eyePosW[3], const float p0[3], const float p1[3]);
+
+	// True if the patch gets factors of zero.
+	static bool PatchCulled(const Constants& c, const float p0[3], const float p1[3], const float p2[3]);
+
+	// Factors of a patch as PatchHS returns them; edge i is opposite vertex i.
+	// Returns false, with every factor zero, if the patch is culled.
+	static bool PatchFactors(const Constants& c, const float eyePosW[3],
+		const float p0[3], const float p1[3], const float p2[3], float edge[3], float& inside);
+
+private:
+	TessellationReference();
+};
+
+#endif // TESSELLATIONREFERENCE_H
@@ -0,0 +1,388 @@
+//***************************************************************************************
+// TriangleBvh.cpp
+//***************************************************************************************
+
+#include "TriangleBvh.h"
+#include "xnacollision.h"
+
+namespace
+{
+	const UINT SahBinCount = 16;
+
+	struct SahBin
+	{
+		XMVECTOR Min;
+		XMVECTOR Max;
+		UINT Count;
+	};
+
+	struct BuildEntry
+	{
+		UINT First;
+		UINT Count;
+	};
+
+	// Per triangle data only needed while building.
+	struct BuildTriangle
+	{
+		XMFLOAT3 Min;
+		XMFLOAT3 Max;
+		XMFLOAT3 Centroid;
+	};
+
+	float GetAxis(const XMFLOAT3& v, UINT axis)
+	{
+		return (&v.x)[axis];
+	}
+
+	UINT GetBin(float c, float lo, float scale)
+	{
+		UINT bin = static_cast<UINT>((c - lo)*scale);
+		return MathHelper::Min(bin, SahBinCount-1);
+	}
+
+	float BoxArea(FXMVECTOR vMin, FXMVECTOR vMax)
+	{
+		XMFLOAT3 d;
+		XMStoreFloat3(&d, vMax - vMin);
+		return 2.0f*(d.x*d.y + d.y*d.z + d.z*d.x);
+	}
+
+	// Reorders order[0, count) and returns the number of triangles that go to the
+	// left child.  Never returns 0 or count.
+	UINT PartitionSah(const std::vector<BuildTriangle>& tris, UINT* order, UINT count)
+	{
+		XMVECTOR cMin = XMVectorReplicate(+MathHelper::Infinity);
+		XMVECTOR cMax = XMVectorReplicate(-MathHelper::Infinity);
+
+		for(UINT i = 0; i < count; ++i)
+		{
+			XMVECTOR c = XMLoadFloat3(&tris[order[i]].Centroid);
+			cMin = XMVectorMin(cMin, c);
+			cMax = XMVectorMax(cMax, c);
+		}
+
+		XMFLOAT3 lo;
+		XMFLOAT3 extent;
+		XMStoreFloat3(&lo, cMin);
+		XMStoreFloat3(&extent, cMax - cMin);
+
+		UINT axis = 0;
+		if( extent.y > GetAxis(extent, axis) ) axis = 1;
+		if( extent.z > GetAxis(extent, axis) ) axis = 2;
+
+		// All the centroids coincide, so any split is as good as another.
+		if( GetAxis(extent, axis) <= 0.0f )
+			return count / 2;
+
+		float axisLo = GetAxis(lo, axis);
+		float scale  = SahBinCount / GetAxis(extent, axis);
+
+		SahBin bins[SahBinCount];
+		for(UINT b = 0; b < SahBinCount; ++b)
+		{
+			bins[b].Min = XMVectorReplicate(+MathHelper::Infinity);
+			bins[b].Max = XMVectorReplicate(-MathHelper::Infinity);
+			bins[b].Count = 0;
+		}
+
+		for(UINT i = 0; i < count; ++i)
+		{
+			const BuildTriangle& tri = tris[order[i]];
+
+			SahBin& bin = bins[GetBin(GetAxis(tri.Centroid, axis), axisLo, scale)];
+			bin.Min = XMVectorMin(bin.Min, XMLoadFloat3(&tri.Min));
+			bin.Max = XMVectorMax(bin.Max, XMLoadFloat3(&tri.Max));
+			bin.Count++;
+		}
+
+		// Split plane b puts bins [0, b) on the left.
+		float rightArea[SahBinCount];
+		UINT rightCount[SahBinCount];
+
+		XMVECTOR accMin = XMVectorReplicate(+MathHelper::Infinity);
+		XMVECTOR accMax = XMVectorReplicate(-MathHelper::Infinity);
+		UINT accCount = 0;
+
+		for(UINT b = SahBinCount-1; b > 0; --b)
+		{
+			accMin = XMVectorMin(accMin, bins[b].Min);
+			accMax = XMVectorMax(accMax, bins[b].Max);
+			accCount += bins[b].Count;
+
+			rightArea[b]  = accCount > 0 ? BoxArea(accMin, accMax) : 0.0f;
+			rightCount[b] = accCount;
+		}
+
+		accMin = XMVectorReplicate(+MathHelper::Infinity);
+		accMax = XMVectorReplicate(-MathHelper::Infinity);
+		accCount = 0;
+
+		float bestCost = MathHelper::Infinity;
+		UINT bestSplit = 0;
+
+		for(UINT b = 1; b < SahBinCount; ++b)
+		{
+			accMin = XMVectorMin(accMin, bins[b-1].Min);
+			accMax = XMVectorMax(accMax, bins[b-1].Max);
+			accCount += bins[b-1].Count;
+
+			if( accCount == 0 || rightCount[b] == 0 )
+				continue;
+
+			float cost = BoxArea(accMin, accMax)*accCount + rightArea[b]*rightCount[b];
+			if( cost < bestCost )
+			{
+				bestCost  = cost;
+				bestSplit = b;
+			}
+		}
+
+		// Every centroid landed in the same bin; fall back to a median split.
+		if( bestSplit == 0 )
+		{
+			std::nth_element(order, order + count/2, order + count,
+				[&](UINT a, UINT b) { return GetAxis(tris[a].Centroid, axis) < GetAxis(tris[b].Centroid, axis); });
+
+			return count / 2;
+		}
+
+		UINT* mid = std::partition(order, order + count,
+			[&](UINT i) { return GetBin(GetAxis(tris[i].Centroid, axis), axisLo, scale) < bestSplit; });
+
+		return static_cast<UINT>(mid - order);
+	}
+}
+
+TriangleBvh::TriangleBvh()
+{
+}
+
+TriangleBvh::~TriangleBvh()
+{
+}
+
+UINT TriangleBvh::NodeCount()const
+{
+	return mNodes.size();
+}
+
+UINT TriangleBvh::TriangleCount()const
+{
+	return mTriIds.size();
+}
+
+void TriangleBvh::Build(const XMFLOAT3* positions, UINT vertexStride, const USHORT* indices, UINT triangleCount)
+{
+	mNodes.clear();
+	mTriVertices.clear();
+	mTriIds.clear();
+
+	if( triangleCount == 0 )
+		return;
+
+	const BYTE* base = reinterpret_cast<const BYTE*>(positions);
+
+	std::vector<BuildTriangle> tris(triangleCount);
+	std::vector<UINT> order(triangleCount);
+
+	for(UINT i = 0; i < triangleCount; ++i)
+	{
+		XMVECTOR v0 = XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(base + indices[i*3+0]*vertexStride));
+		XMVECTOR v1 = XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(base + indices[i*3+1]*vertexStride));
+		XMVECTOR v2 = XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(base + indices[i*3+2]*vertexStride));
+
+		XMVECTOR vMin = XMVectorMin(XMVectorMin(v0, v1), v2);
+		XMVECTOR vMax = XMVectorMax(XMVectorMax(v0, v1), v2);
+
+		XMStoreFloat3(&tris[i].Min, vMin);
+		XMStoreFloat3(&tris[i].Max, vMax);
+		XMStoreFloat3(&tris[i].Centroid, (vMin + vMax)*0.5f);
+
+		order[i] = i;
+	}
+
+	//
+	// Emit the nodes in depth first order by always popping the left child first.
+	//
+
+	mNodes.reserve(2*triangleCount/MaxLeafSize + 1);
+
+	std::vector<BuildEntry> stack;
+	BuildEntry rootEntry = { 0, triangleCount };
+	stack.push_back(rootEntry);
+
+	while( !stack.empty() )
+	{
+		BuildEntry e = stack.back();
+		stack.pop_back();
+
+		XMVECTOR vMin = XMVectorReplicate(+MathHelper::Infinity);
+		XMVECTOR vMax = XMVectorReplicate(-MathHelper::Infinity);
+
+		for(UINT i = e.First; i < e.First + e.Count; ++i)
+		{
+			vMin = XMVectorMin(vMin, XMLoadFloat3(&tris[order[i]].Min));
+			vMax = XMVectorMax(vMax, XMLoadFloat3(&tris[order[i]].Max));
+		}
+
+		Node node;
+		XMStoreFloat3(&node.Min, vMin);
+		XMStoreFloat3(&node.Max, vMax);
+		node.Skip = 0;
+
+		if( e.Count <= MaxLeafSize )
+		{
+			node.Leaf = (e.First << 4) | e.Count;
+		}
+		else
+		{
+			node.Leaf = 0;
+
+			UINT leftCount = PartitionSah(tris, &order[e.First], e.Count);
+
+			BuildEntry right = { e.First + leftCount, e.Count - leftCount };
+			BuildEntry left  = { e.First, leftCount };
+
+			stack.push_back(right);
+			stack.push_back(left);
+		}
+
+		mNodes.push_back(node);
+	}
+
+	//
+	// Link every node to the node that follows its subtree.  Children come after
+	// their parent, so walking backwards sizes both children before the parent.
+	//
+
+	std::vector<UINT> subtreeSize(mNodes.size());
+
+	for(UINT i = mNodes.size(); i-- > 0; )
+	{
+		if( mNodes[i].Leaf != 0 )
+		{
+			subtreeSize[i] = 1;
+		}
+		else
+		{
+			UINT leftSize  = subtreeSize[i + 1];
+			UINT rightSize = subtreeSize[i + 1 + leftSize];
+			subtreeSize[i] = 1 + leftSize + rightSize;
+		}
+
+		mNodes[i].Skip = i + subtreeSize[i];
+	}
+
+	//
+	// Copy the triangles in leaf order.
+	//
+
+	mTriVertices.resize(3*triangleCount);
+	mTriIds.resize(triangleCount);
+
+	for(UINT i = 0; i < triangleCount; ++i)
+	{
+		UINT tri = order[i];
+
+		for(UINT j = 0; j < 3; ++j)
+			mTriVertices[3*i + j] = *reinterpret_cast<const XMFLOAT3*>(base + indices[tri*3+j]*vertexStride);
+
+		mTriIds[i] = tri;
+	}
+}
+
+template<bool AnyHit>
+bool TriangleBvh::Traverse(FXMVECTOR origin, FXMVECTOR dir, float maxDist, UINT& triangle, float& dist)const
+{
+	if( mNodes.empty() )
+		return false;
+
+	// An axis aligned ray has zero direction components, whose reciprocals of
+	// +-inf make 0*inf = NaN in the slab test when the origin lies on a slab
+	// plane, and the box is missed.  A tiny value of the same sign keeps every
+	// t finite and still puts the slabs out of reach.
+	const XMVECTOR tiny = XMVectorReplicate(1.0e-20f);
+	XMVECTOR nearZero = XMVectorLess(XMVectorAbs(dir), tiny);
+	XMVECTOR signedTiny = XMVectorOrInt(XMVectorAndInt(dir, g_XMNegativeZero.v), tiny);
+	XMVECTOR invDir = XMVectorReciprocal(XMVectorSelect(dir, signedTiny, nearZero));
+
+	float best = maxDist;
+	bool found = false;
+
+	UINT i = 0;
+	UINT nodeCount = mNodes.size();
+
+	while( i < nodeCount )
+	{
+		const Node& node = mNodes[i];
+
+		// Slab test against all three axes at once.
+		XMVECTOR t1 = (XMLoadFloat3(&node.Min) - origin)*invDir;
+		XMVECTOR t2 = (XMLoadFloat3(&node.Max) - origin)*invDir;
+
+		XMVECTOR tNear = XMVectorMin(t1, t2);
+		XMVECTOR tFar  = XMVectorMax(t1, t2);
+
+		tNear = XMVectorMax(tNear, XMVectorSplatY(tNear));
+		tNear = XMVectorMax(tNear, XMVectorSplatZ(tNear));
+		tFar  = XMVectorMin(tFar, XMVectorSplatY(tFar));
+		tFar  = XMVectorMin(tFar, XMVectorSplatZ(tFar));
+
+		float tn = XMVectorGetX(tNear);
+		float tf = XMVectorGetX(tFar);
+
+		// Missed the box, the box is behind the ray, or the box is farther away
+		// than the nearest hit so far.
+		if( tn > tf || tf < 0.0f || tn > best )
+		{
+			i = node.Skip;
+			continue;
+		}
+
+		if( node.Leaf == 0 )
+		{
+			++i;
+			continue;
+		}
+
+		UINT first = node.Leaf >> 4;
+		UINT count = node.Leaf & 0xf;
+
+		for(UINT k = first; k < first + count; ++k)
+		{
+			const XMFLOAT3* v = &mTriVertices[3*k];
+
+			float t;
+			if( XNA::IntersectRayTriangle(origin, dir, XMLoadFloat3(&v[0]), XMLoadFloat3(&v[1]), XMLoadFloat3(&v[2]), &t) &&
+				t <= best )
+			{
+				if( AnyHit )
+					return true;
+
+				best = t;
+				triangle = mTriIds[k];
+				found = true;
+			}
+		}
+
+		i = node.Skip;
+	}
+
+	if( found )
+		dist = best;
+
+	return found;
+}
+
+bool TriangleBvh::IntersectClosest(FXMVECTOR origin, FXMVECTOR dir, float maxDist, UINT& triangle, float& dist)const
+{
+	return Traverse<false>(origin, dir, maxDist, triangle, dist);
+}
+
+bool TriangleBvh::IntersectAny(FXMVECTOR origin, FXMVECTOR dir, float maxDist)const
+{
+	UINT triangle;
+	float dist;
+	return Traverse<true>(origin, dir, maxDist, triangle, dist);
+}
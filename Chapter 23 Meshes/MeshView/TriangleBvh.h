@@ -0,0 +1,64 @@
+//***************************************************************************************
+// TriangleBvh.h
+//
+// Bounding volume hierarchy over the triangles of a mesh for exact ray picking.
+// The tree is stored depth first with skip links so it can be traversed without a
+// stack, and the triangle vertices are copied in leaf order so a leaf reads one
+// contiguous block of memory.  Rays are in the model space of the mesh.
+//***************************************************************************************
+
+#ifndef TRIANGLEBVH_H
+#define TRIANGLEBVH_H
+
+#include "d3dUtil.h"
+
+class TriangleBvh
+{
+public:
+	TriangleBvh();
+	~TriangleBvh();
+
+	// Builds the tree with the surface area heuristic.  positions points at the
+	// position of the first vertex and vertexStride is the size of a whole vertex.
+	void Build(const XMFLOAT3* positions, UINT vertexStride, const USHORT* indices, UINT triangleCount);
+
+	// Finds the nearest triangle hit by the ray no farther than maxDist.  The
+	// direction must be normalized.  triangle receives the index of the triangle in
+	// the index buffer the tree was built from.
+	bool IntersectClosest(FXMVECTOR origin, FXMVECTOR dir, float maxDist, UINT& triangle, float& dist)const;
+
+	// Returns true as soon as any triangle is hit no farther than maxDist.
+	bool IntersectAny(FXMVECTOR origin, FXMVECTOR dir, float maxDist)const;
+
+	UINT NodeCount()const;
+	UINT TriangleCount()const;
+
+	static const UINT MaxLeafSize = 4;
+
+private:
+	TriangleBvh(const TriangleBvh& rhs);
+	TriangleBvh& operator=(const TriangleBvh& rhs);
+
+	// 32 bytes so two nodes share a cache line.
+	struct Node
+	{
+		XMFLOAT3 Min;
+		UINT Skip; // Node to continue with once this subtree is done or missed.
+		XMFLOAT3 Max;
+		UINT Leaf; // 0 for interior nodes, else (first triangle << 4) | triangle count.
+	};
+
+	template<bool AnyHit>
+	bool Traverse(FXMVECTOR origin, FXMVECTOR dir, float maxDist, UINT& triangle, float& dist)const;
+
+private:
+	std::vector<Node> mNodes;
+
+	// Three vertices per triangle, in leaf order.
+	std::vector<XMFLOAT3> mTriVertices;
+
+	// Index of each triangle in the source index buffer, in leaf order.
+	std::vector<UINT> mTriIds;
+};
+
+#endif // TRIANGLEBVH_H
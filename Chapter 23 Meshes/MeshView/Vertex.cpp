@@ -23,6 +23,22 @@ const D3D11_INPUT_ELEMENT_DESC InputLayoutDesc::PosNormalTexTan[4] =
 	{"TANGENT",  0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 32, D3D11_INPUT_PER_VERTEX_DATA, 0}
 };
 
+const D3D11_INPUT_ELEMENT_DESC InputLayoutDesc::InstancedPosNormalTexTan[12] = 
+{
+	{"POSITION",          0, DXGI_FORMAT_R32G32B32_FLOAT,    0, 0,   D3D11_INPUT_PER_VERTEX_DATA,   0},
+	{"NORMAL",            0, DXGI_FORMAT_R32G32B32_FLOAT,    0, 12,  D3D11_INPUT_PER_VERTEX_DATA,   0},
+	{"TEXCOORD",          0, DXGI_FORMAT_R32G32_FLOAT,       0, 24,  D3D11_INPUT_PER_VERTEX_DATA,   0},
+	{"TANGENT",           0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 32,  D3D11_INPUT_PER_VERTEX_DATA,   0},
+	{"WORLD",             0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 0,   D3D11_INPUT_PER_INSTANCE_DATA, 1},
+	{"WORLD",             1, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 16,  D3D11_INPUT_PER_INSTANCE_DATA, 1},
+	{"WORLD",             2, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 32,  D3D11_INPUT_PER_INSTANCE_DATA, 1},
+	{"WORLD",             3, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 48,  D3D11_INPUT_PER_INSTANCE_DATA, 1},
+	{"WORLDINVTRANSPOSE", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 64,  D3D11_INPUT_PER_INSTANCE_DATA, 1},
+	{"WORLDINVTRANSPOSE", 1, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 80,  D3D11_INPUT_PER_INSTANCE_DATA, 1},
+	{"WORLDINVTRANSPOSE", 2, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 96,  D3D11_INPUT_PER_INSTANCE_DATA, 1},
+	{"WORLDINVTRANSPOSE", 3, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 112, D3D11_INPUT_PER_INSTANCE_DATA, 1}
+};
+
 #pragma endregion
 
 #pragma region InputLayouts
@@ -30,6 +46,7 @@ const D3D11_INPUT_ELEMENT_DESC InputLayoutDesc::PosNormalTexTan[4] =
 ID3D11InputLayout* InputLayouts::Pos = 0;
 ID3D11InputLayout* InputLayouts::Basic32 = 0;
 ID3D11InputLayout* InputLayouts::PosNormalTexTan = 0;
+ID3D11InputLayout* InputLayouts::InstancedPosNormalTexTan = 0;
 
 void InputLayouts::InitAll(ID3D11Device* device)
 {
@@ -47,7 +64,7 @@ void InputLayouts::InitAll(ID3D11Device* device)
 	// Basic32
 	//
 
-	Effects::BasicFX->Light1Tech->GetPassByIndex(0)->GetDesc(&passDesc);
+	Effects::BasicFX->Technique(LitFeatures())->GetPassByIndex(0)->GetDesc(&passDesc);
 	HR(device->CreateInputLayout(InputLayoutDesc::Basic32, 3, passDesc.pIAInputSignature, 
 		passDesc.IAInputSignatureSize, &Basic32));
 
@@ -55,9 +72,21 @@ void InputLayouts::InitAll(ID3D11Device* device)
 	// NormalMap
 	//
 
-	Effects::NormalMapFX->Light1Tech->GetPassByIndex(0)->GetDesc(&passDesc);
+	Effects::NormalMapFX->Technique(LitFeatures())->GetPassByIndex(0)->GetDesc(&passDesc);
 	HR(device->CreateInputLayout(InputLayoutDesc::PosNormalTexTan, 4, passDesc.pIAInputSignature, 
 		passDesc.IAInputSignatureSize, &PosNormalTexTan));
+
+	//
+	// Instanced NormalMap.  The Basic instanced permutations read a subset of
+	// these elements, so they share the layout.
+	//
+
+	LitFeatures instanced;
+	instanced.Instanced = true;
+
+	Effects::NormalMapFX->Technique(instanced)->GetPassByIndex(0)->GetDesc(&passDesc);
+	HR(device->CreateInputLayout(InputLayoutDesc::InstancedPosNormalTexTan, 12, passDesc.pIAInputSignature, 
+		passDesc.IAInputSignatureSize, &InstancedPosNormalTexTan));
 }
 
 void InputLayouts::DestroyAll()
@@ -65,6 +94,7 @@ void InputLayouts::DestroyAll()
 	ReleaseCOM(Pos);
 	ReleaseCOM(Basic32);
 	ReleaseCOM(PosNormalTexTan);
+	ReleaseCOM(InstancedPosNormalTexTan);
 }
 
 #pragma endregion
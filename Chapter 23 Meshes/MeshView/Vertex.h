@@ -26,6 +26,13 @@ namespace Vertex
 		XMFLOAT2 Tex;
 		XMFLOAT4 TangentU;
 	};
+
+	// Per-instance data streamed from slot 1 by the instanced techniques.
+	struct InstancedData
+	{
+		XMFLOAT4X4 World;
+		XMFLOAT4X4 WorldInvTranspose;
+	};
 }
 
 class InputLayoutDesc
@@ -35,6 +42,7 @@ public:
 	static const D3D11_INPUT_ELEMENT_DESC Pos[1];
 	static const D3D11_INPUT_ELEMENT_DESC Basic32[3];
 	static const D3D11_INPUT_ELEMENT_DESC PosNormalTexTan[4];
+	static const D3D11_INPUT_ELEMENT_DESC InstancedPosNormalTexTan[12];
 };
 
 class InputLayouts
@@ -46,6 +54,7 @@ public:
 	static ID3D11InputLayout* Pos;
 	static ID3D11InputLayout* Basic32;
 	static ID3D11InputLayout* PosNormalTexTan;
+	static ID3D11InputLayout* InstancedPosNormalTexTan;
 };
 
 #endif // VERTEX_H
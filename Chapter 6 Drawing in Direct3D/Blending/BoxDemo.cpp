@@ -160,13 +160,13 @@ void BoxApp::OnResize()
 
 void BoxApp::UpdateScene(float dt)
 {
-	if (GetAsyncKeyState('1') & 0x8000)
+	if (IsKeyDown('1'))
 		testBlend = 0;
 
-	if (GetAsyncKeyState('2') & 0x8000)
+	if (IsKeyDown('2'))
 		testBlend = 1;
 
-	if (GetAsyncKeyState('3') & 0x8000)
+	if (IsKeyDown('3'))
 		testBlend = 2;
 
 	// Convert Spherical to Cartesian coordinates.
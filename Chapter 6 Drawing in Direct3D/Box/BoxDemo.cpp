@@ -161,11 +161,11 @@ void BoxApp::OnResize()
 
 void BoxApp::UpdateScene(float dt)
 {
-	if (GetAsyncKeyState('1') & 0x8000)
+	if (IsKeyDown('1'))
 		mTessFactor->SetFloat(1);
-	if (GetAsyncKeyState('2') & 0x8000)
+	if (IsKeyDown('2'))
 		mTessFactor->SetFloat(2);
-	if (GetAsyncKeyState('3') & 0x8000)
+	if (IsKeyDown('3'))
 		mTessFactor->SetFloat(3);
 
 	// Convert Spherical to Cartesian coordinates.
@@ -14,6 +14,7 @@
 #include "MathHelper.h"
 #include "LightHelper.h"
 #include "Waves.h"
+#include "DoubleBuffer.h"
 
 struct Vertex
 {
@@ -21,6 +22,17 @@ struct Vertex
 	XMFLOAT3 Normal;
 };
 
+// Everything DrawScene needs from an update.  UpdateScene runs on the update
+// thread and fills in the back copy; DrawScene reads the front one.
+struct SceneState
+{
+	XMFLOAT4X4 View;
+	XMFLOAT3 EyePosW;
+	PointLight Point;
+	SpotLight Spot;
+	std::vector<Vertex> WaveVertices;
+};
+
 class LightingApp : public D3DApp
 {
 public:
@@ -31,6 +43,7 @@ public:
 	void OnResize();
 	void UpdateScene(float dt);
 	void DrawScene(); 
+	void SwapSceneState();
 
 	void OnMouseDown(WPARAM btnState, int x, int y);
 	void OnMouseUp(WPARAM btnState, int x, int y);
@@ -82,6 +95,8 @@ private:
 
 	XMFLOAT3 mEyePosW;
 
+	DoubleBuffer<SceneState> mState;
+
 	float mTheta;
 	float mPhi;
 	float mRadius;
@@ -114,6 +129,7 @@ LightingApp::LightingApp(HINSTANCE hInstance)
   mInputLayout(0), mEyePosW(0.0f, 0.0f, 0.0f), mTheta(1.5f*MathHelper::Pi), mPhi(0.1f*MathHelper::Pi), mRadius(80.0f)
 {
 	mMainWndCaption = L"Lighting Demo";
+	mPipelinedUpdate = true;
 	
 	mLastMousePos.x = 0;
 	mLastMousePos.y = 0;
@@ -194,30 +210,30 @@ void LightingApp::OnResize()
 void LightingApp::UpdateScene(float dt)
 {
 
-	if (GetAsyncKeyState('1') & 0x8000)
+	if (IsKeyDown('1'))
 		mSpotLight.Spot += 2.0f;
 
-	if (GetAsyncKeyState('2') & 0x8000)
+	if (IsKeyDown('2'))
 		mSpotLight.Spot -= 2.0f;
 
-	if (GetAsyncKeyState('R') & 0x8000) {
+	if (IsKeyDown('R')) {
 		mPointLight.Ambient = XMFLOAT4(1.0f, 0.0f, 0.0f, 1.0f);
 		mPointLight.Diffuse = XMFLOAT4(1.0f, 0.0f, 0.0f, 1.0f);
 		mPointLight.Specular = XMFLOAT4(1.0f, 0.0f, 0.0f, 1.0f);
 	}
-	if (GetAsyncKeyState('G') & 0x8000) {
+	if (IsKeyDown('G')) {
 		mPointLight.Ambient = XMFLOAT4(0.0f, 1.0f, 0.0f, 1.0f);
 		mPointLight.Diffuse = XMFLOAT4(0.0f, 1.0f, 0.0f, 1.0f);
 		mPointLight.Specular = XMFLOAT4(0.0f, 1.0f, 0.0f, 1.0f);
 	}
 
-	if (GetAsyncKeyState('B') & 0x8000) {
+	if (IsKeyDown('B')) {
 		mPointLight.Ambient = XMFLOAT4(0.0f, 0.0f, 1.0f, 1.0f);
 		mPointLight.Diffuse = XMFLOAT4(0.0f, 0.0f, 1.0f, 1.0f);
 		mPointLight.Specular = XMFLOAT4(0.0f, 0.0f, 1.0f, 1.0f);
 	}
 
-	if (GetAsyncKeyState('W') & 0x8000) {
+	if (IsKeyDown('W')) {
 		mPointLight.Ambient  = XMFLOAT4(0.3f, 0.3f, 0.3f, 1.0f);
 		mPointLight.Diffuse  = XMFLOAT4(0.7f, 0.7f, 0.7f, 1.0f);
 		mPointLight.Specular = XMFLOAT4(0.7f, 0.7f, 0.7f, 1.0f);
@@ -241,7 +257,7 @@ void LightingApp::UpdateScene(float dt)
 	// Every quarter second, generate a random wave.
 	//
 	static float t_base = 0.0f;
-	if( (mTimer.TotalTime() - t_base) >= 0.25f )
+	if( (SimulationTime() - t_base) >= 0.25f )
 	{
 		t_base += 0.25f;
  
@@ -255,29 +271,13 @@ void LightingApp::UpdateScene(float dt)
 
 	mWaves.Update(dt);
 
-	//
-	// Update the wave vertex buffer with the new solution.
-	//
-	
-	D3D11_MAPPED_SUBRESOURCE mappedData;
-	HR(md3dImmediateContext->Map(mWavesVB, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedData));
-
-	Vertex* v = reinterpret_cast<Vertex*>(mappedData.pData);
-	for(UINT i = 0; i < mWaves.VertexCount(); ++i)
-	{
-		v[i].Pos    = mWaves[i];
-		v[i].Normal = mWaves.Normal(i);
-	}
-
-	md3dImmediateContext->Unmap(mWavesVB, 0);
-
 	//
 	// Animate the lights.
 	//
 
 	// Circle light over the land surface.
-	mPointLight.Position.x = 70.0f*cosf( 0.2f*mTimer.TotalTime() );
-	mPointLight.Position.z = 70.0f*sinf( 0.2f*mTimer.TotalTime() );
+	mPointLight.Position.x = 70.0f*cosf( 0.2f*SimulationTime() );
+	mPointLight.Position.z = 70.0f*sinf( 0.2f*SimulationTime() );
 	mPointLight.Position.y = MathHelper::Max(GetHillHeight(mPointLight.Position.x, 
 		mPointLight.Position.z), -3.0f) + 10.0f;
 
@@ -287,10 +287,49 @@ void LightingApp::UpdateScene(float dt)
 	// like we are holding a flashlight.
 	mSpotLight.Position = mEyePosW;
 	XMStoreFloat3(&mSpotLight.Direction, XMVector3Normalize(target - pos));
+
+	//
+	// Publish what DrawScene needs.  The wave solution is copied out here since
+	// the vertex buffer can only be written on the render thread.
+	//
+
+	SceneState& state = mState.Back();
+	state.View    = mView;
+	state.EyePosW = mEyePosW;
+	state.Point   = mPointLight;
+	state.Spot    = mSpotLight;
+
+	state.WaveVertices.resize(mWaves.VertexCount());
+	for(UINT i = 0; i < mWaves.VertexCount(); ++i)
+	{
+		state.WaveVertices[i].Pos    = mWaves[i];
+		state.WaveVertices[i].Normal = mWaves.Normal(i);
+	}
+}
+
+void LightingApp::SwapSceneState()
+{
+	mState.Swap();
 }
 
 void LightingApp::DrawScene()
 {
+	const SceneState& state = mState.Front();
+
+	//
+	// Update the wave vertex buffer with the published solution.
+	//
+
+	if( !state.WaveVertices.empty() )
+	{
+		D3D11_MAPPED_SUBRESOURCE mappedData;
+		HR(md3dImmediateContext->Map(mWavesVB, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedData));
+
+		memcpy(mappedData.pData, &state.WaveVertices[0], sizeof(Vertex)*state.WaveVertices.size());
+
+		md3dImmediateContext->Unmap(mWavesVB, 0);
+	}
+
 	md3dImmediateContext->ClearRenderTargetView(mRenderTargetView, reinterpret_cast<const float*>(&Colors::LightSteelBlue));
 	md3dImmediateContext->ClearDepthStencilView(mDepthStencilView, D3D11_CLEAR_DEPTH|D3D11_CLEAR_STENCIL, 1.0f, 0);
 
@@ -300,15 +339,15 @@ void LightingApp::DrawScene()
 	UINT stride = sizeof(Vertex);
     UINT offset = 0;
 
-	XMMATRIX view  = XMLoadFloat4x4(&mView);
+	XMMATRIX view  = XMLoadFloat4x4(&state.View);
 	XMMATRIX proj  = XMLoadFloat4x4(&mProj);
 	XMMATRIX viewProj = view*proj;
 
 	// Set per frame constants.
 	mfxDirLight->SetRawValue(&mDirLight, 0, sizeof(mDirLight));
-	mfxPointLight->SetRawValue(&mPointLight, 0, sizeof(mPointLight));
-	mfxSpotLight->SetRawValue(&mSpotLight, 0, sizeof(mSpotLight));
-	mfxEyePosW->SetRawValue(&mEyePosW, 0, sizeof(mEyePosW));
+	mfxPointLight->SetRawValue(&state.Point, 0, sizeof(state.Point));
+	mfxSpotLight->SetRawValue(&state.Spot, 0, sizeof(state.Spot));
+	mfxEyePosW->SetRawValue(&state.EyePosW, 0, sizeof(state.EyePosW));
  
     D3DX11_TECHNIQUE_DESC techDesc;
     mTech->GetDesc( &techDesc );
@@ -16,8 +16,9 @@
 #include "LightHelper.h"
 #include "Effects.h"
 #include "Vertex.h"
+#include "RenderQueue.h"
 
-class CrateApp : public D3DApp
+class CrateApp : public D3DApp, private RenderQueue::Target
 {
 public:
 	CrateApp(HINSTANCE hInstance);
@@ -33,8 +34,26 @@ public:
 	void OnMouseUp(WPARAM btnState, int x, int y);
 	void OnMouseMove(WPARAM btnState, int x, int y);
 
+	void AppendFrameStats(std::wostream& outs);
+
 private:
 	void BuildGeometryBuffers();
+	void BuildScreenParts();
+
+	// RenderQueue::Target
+	void SetState(RenderQueue::StateType type, unsigned int id);
+	void Draw(const RenderQueue::Packet& packet);
+
+	// The pieces of the phone drawn by DrawScreen, in drawing order.
+	enum { ScreenPartCount = 4 };
+
+	struct ScreenPart
+	{
+		ID3D11ShaderResourceView* Texture;
+		UINT IndexCount;
+		UINT StartIndex;
+		INT BaseVertex;
+	};
 
 private:
 	ID3D11Buffer* mBoxVB;
@@ -72,6 +91,10 @@ private:
 	float mRadius;
 
 	POINT mLastMousePos;
+
+	ScreenPart mScreenParts[ScreenPartCount];
+	RenderQueue mScreenQueue;
+	ID3DX11EffectTechnique* mScreenTech;
 };
 
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance,
@@ -93,7 +116,7 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance,
 
 CrateApp::CrateApp(HINSTANCE hInstance)
 : D3DApp(hInstance), mBoxVB(0), mBoxIB(0), mDiffuseMapSRV(0), mEyePosW(0.0f, 0.0f, 0.0f), 
-  mTheta(1.3f*MathHelper::Pi), mPhi(0.4f*MathHelper::Pi), mRadius(2.5f)
+  mTheta(1.3f*MathHelper::Pi), mPhi(0.4f*MathHelper::Pi), mRadius(2.5f), mScreenTech(0)
 {
 	mMainWndCaption = L"Crate Demo";
 	
@@ -208,6 +231,7 @@ bool CrateApp::Init()
 		L"Textures/backiphone.png", 0, 0, &mBackIphone, 0 ));
 
 	BuildGeometryBuffers();
+	BuildScreenParts();
 
 	return true;
 }
@@ -271,61 +295,120 @@ void CrateApp::DrawScreen()
 	UINT stride = sizeof(Vertex::Basic32);
 	UINT offset = 0;
 
-	float blendFactor[] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	md3dImmediateContext->IASetVertexBuffers(0, 1, &mBoxVB, &stride, &offset);
+	md3dImmediateContext->IASetIndexBuffer(mBoxIB, DXGI_FORMAT_R32_UINT, 0);
 
 	XMMATRIX view = XMLoadFloat4x4(&mView);
 	XMMATRIX proj = XMLoadFloat4x4(&mProj);
-	XMMATRIX viewProj = view*proj;
 
 	// Set per frame constants.
 	Effects::BasicFX->SetDirLights(mDirLights);
 	Effects::BasicFX->SetEyePosW(mEyePosW);
 
-	ID3DX11EffectTechnique* activeTech = Effects::BasicFX->Light2TexTech;
+	// Every part shares the box transform.
+	XMMATRIX world = XMLoadFloat4x4(&mBoxWorld);
+	XMMATRIX worldInvTranspose = MathHelper::InverseTranspose(world);
+	XMMATRIX worldViewProj = world*view*proj;
 
-	D3DX11_TECHNIQUE_DESC techDesc;
-	activeTech->GetDesc(&techDesc);
-	for (UINT p = 0; p < techDesc.Passes; ++p)
+	Effects::BasicFX->SetWorld(world);
+	Effects::BasicFX->SetWorldInvTranspose(worldInvTranspose);
+	Effects::BasicFX->SetWorldViewProj(worldViewProj);
+	Effects::BasicFX->SetTexTransform(XMLoadFloat4x4(&mTexTransform));
+
+	// The parts blend over each other, so each goes in its own pass to keep them
+	// in order.  The queue still drops the technique, rasterizer, blend and
+	// material changes they have in common.
+	for(UINT i = 0; i < ScreenPartCount; ++i)
 	{
-		md3dImmediateContext->IASetVertexBuffers(0, 1, &mBoxVB, &stride, &offset);
-		md3dImmediateContext->IASetIndexBuffer(mBoxIB, DXGI_FORMAT_R32_UINT, 0);
+		UINT state[RenderQueue::StateTypeCount];
+		state[RenderQueue::TechniqueState]  = 0;
+		state[RenderQueue::RasterizerState] = 1;
+		state[RenderQueue::BlendState]      = 1;
+		state[RenderQueue::TextureState]    = i;
+		state[RenderQueue::MaterialState]   = 0;
+
+		mScreenQueue.Submit(i, state, 0.0f, i);
+	}
 
-		// Draw the box.
-		XMMATRIX world = XMLoadFloat4x4(&mBoxWorld);
-		XMMATRIX worldInvTranspose = MathHelper::InverseTranspose(world);
-		XMMATRIX worldViewProj = world*view*proj;
+	mScreenQueue.Execute(*this);
+}
 
-		Effects::BasicFX->SetWorld(world);
-		Effects::BasicFX->SetWorldInvTranspose(worldInvTranspose);
-		Effects::BasicFX->SetWorldViewProj(worldViewProj);
-		Effects::BasicFX->SetTexTransform(XMLoadFloat4x4(&mTexTransform));
+void CrateApp::BuildScreenParts()
+{
+	// Front of the phone.
+	mScreenParts[0].Texture    = mDiffuseMapSRV;
+	mScreenParts[0].IndexCount = 6;
+	mScreenParts[0].StartIndex = 0;
+	mScreenParts[0].BaseVertex = 0;
+
+	// Screen, showing the scene rendered off screen.
+	mScreenParts[1].Texture    = mOffscreenSRV;
+	mScreenParts[1].IndexCount = 6;
+	mScreenParts[1].StartIndex = 0;
+	mScreenParts[1].BaseVertex = 4;
+
+	// Back of the phone.
+	mScreenParts[2].Texture    = mBackIphone;
+	mScreenParts[2].IndexCount = 6;
+	mScreenParts[2].StartIndex = 12;
+	mScreenParts[2].BaseVertex = 8;
+
+	// Box.
+	mScreenParts[3].Texture    = mScreen;
+	mScreenParts[3].IndexCount = mBoxIndexCount;
+	mScreenParts[3].StartIndex = mBoxIndexOffset;
+	mScreenParts[3].BaseVertex = mBoxVertexOffset;
+}
+
+void CrateApp::SetState(RenderQueue::StateType type, unsigned int id)
+{
+	float blendFactor[] = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+	switch( type )
+	{
+	case RenderQueue::TechniqueState:
+		mScreenTech = Effects::BasicFX->Light2TexTech;
+		break;
+
+	case RenderQueue::RasterizerState:
+		md3dImmediateContext->RSSetState(id ? NoCullRS : 0);
+		break;
+
+	case RenderQueue::BlendState:
+		md3dImmediateContext->OMSetBlendState(id ? TransparentBS : 0, blendFactor, 0xffffffff);
+		break;
+
+	case RenderQueue::TextureState:
+		Effects::BasicFX->SetDiffuseMap(mScreenParts[id].Texture);
+		break;
+
+	case RenderQueue::MaterialState:
 		Effects::BasicFX->SetMaterial(mBoxMat);
+		break;
+	}
+}
 
-		//Front phone
-		Effects::BasicFX->SetDiffuseMap(mDiffuseMapSRV);
-		md3dImmediateContext->RSSetState(NoCullRS);
-		md3dImmediateContext->OMSetBlendState(TransparentBS, blendFactor, 0xffffffff);
-		activeTech->GetPassByIndex(p)->Apply(0, md3dImmediateContext);
-		md3dImmediateContext->DrawIndexed(6, 0, 0);
-		
-		//Screen 
-		Effects::BasicFX->SetDiffuseMap(mOffscreenSRV);
-		activeTech->GetPassByIndex(p)->Apply(0, md3dImmediateContext);
-		md3dImmediateContext->DrawIndexed(6, 0, 4);
+void CrateApp::Draw(const RenderQueue::Packet& packet)
+{
+	const ScreenPart& part = mScreenParts[packet.Draw];
 
-		//Back phone
-		Effects::BasicFX->SetDiffuseMap(mBackIphone);
-		activeTech->GetPassByIndex(p)->Apply(0, md3dImmediateContext);
-		md3dImmediateContext->DrawIndexed(6, 12, 8);
-		
-		//Box
-		Effects::BasicFX->SetDiffuseMap(mScreen);
-		activeTech->GetPassByIndex(p)->Apply(0, md3dImmediateContext);
-		md3dImmediateContext->DrawIndexed(mBoxIndexCount, mBoxIndexOffset, mBoxVertexOffset);
+	D3DX11_TECHNIQUE_DESC techDesc;
+	mScreenTech->GetDesc(&techDesc);
+	for(UINT p = 0; p < techDesc.Passes; ++p)
+	{
+		mScreenTech->GetPassByIndex(p)->Apply(0, md3dImmediateContext);
+		md3dImmediateContext->DrawIndexed(part.IndexCount, part.StartIndex, part.BaseVertex);
 	}
+}
 
+void CrateApp::AppendFrameStats(std::wostream& outs)
+{
+	const RenderQueue::FrameStats& stats = mScreenQueue.Stats();
 
+	outs << L"    State changes: " << stats.UnfilteredChanges
+		 << L" -> " << stats.StateChanges;
 }
+
 void CrateApp::DrawSceneNormal()
 {
 	md3dImmediateContext->IASetInputLayout(InputLayouts::Basic32);
@@ -0,0 +1,294 @@
+//***************************************************************************************
+// BroadPhase.cpp
+//***************************************************************************************
+
+#include "BroadPhase.h"
+
+BroadPhase::BroadPhase()
+	: mSweepAxis(0)
+{
+}
+
+BroadPhase::~BroadPhase()
+{
+}
+
+UINT BroadPhase::BodyCount()const
+{
+	return mMin[0].size();
+}
+
+void BroadPhase::Update(const XNA::AxisAlignedBox* bounds, UINT count)
+{
+	bool resized = count != mMin[0].size();
+
+	for(UINT axis = 0; axis < 3; ++axis)
+	{
+		mMin[axis].resize(count);
+		mMax[axis].resize(count);
+	}
+
+	// Track the spread of the centers to pick the sweep axis.
+	float sum[3]   = { 0.0f, 0.0f, 0.0f };
+	float sumSq[3] = { 0.0f, 0.0f, 0.0f };
+
+	for(UINT i = 0; i < count; ++i)
+	{
+		const float* c = &bounds[i].Center.x;
+		const float* e = &bounds[i].Extents.x;
+
+		for(UINT axis = 0; axis < 3; ++axis)
+		{
+			mMin[axis][i] = c[axis] - e[axis];
+			mMax[axis][i] = c[axis] + e[axis];
+
+			sum[axis]   += c[axis];
+			sumSq[axis] += c[axis]*c[axis];
+		}
+	}
+
+	UINT oldSweepAxis = mSweepAxis;
+	if( count > 0 )
+	{
+		float variance[3];
+		for(UINT axis = 0; axis < 3; ++axis)
+			variance[axis] = sumSq[axis] - sum[axis]*sum[axis]/count;
+
+		// Only switch axes for a clearly better spread, so two axes that are
+		// about even do not trade places, and full sorts, every update.
+		UINT best = 0;
+		if( variance[1] > variance[best] ) best = 1;
+		if( variance[2] > variance[best] ) best = 2;
+
+		if( variance[best] > 1.25f*variance[mSweepAxis] )
+			mSweepAxis = best;
+	}
+
+	// Only the sweep axis is ever swept, so it is the only one kept sorted.
+	if( resized || mSweepAxis != oldSweepAxis )
+	{
+		// The old order means nothing now, so do a full sort instead of an
+		// insertion sort that could go quadratic.
+		mOrder.resize(count);
+		for(UINT i = 0; i < count; ++i)
+			mOrder[i] = i;
+
+		const std::vector<float>& mins = mMin[mSweepAxis];
+		std::sort(mOrder.begin(), mOrder.end(), [&](UINT a, UINT b) { return mins[a] < mins[b]; });
+	}
+	else
+	{
+		SortSweepAxis();
+	}
+}
+
+void BroadPhase::SortSweepAxis()
+{
+	std::vector<UINT>& order = mOrder;
+	const std::vector<float>& mins = mMin[mSweepAxis];
+
+	// Insertion sort; each body only moves past the bodies it crossed since the
+	// last update.
+	for(UINT i = 1; i < order.size(); ++i)
+	{
+		UINT body = order[i];
+		float key = mins[body];
+
+		UINT j = i;
+		while( j > 0 && mins[order[j-1]] > key )
+		{
+			order[j] = order[j-1];
+			--j;
+		}
+
+		order[j] = body;
+	}
+}
+
+bool BroadPhase::Overlap(UINT a, UINT b)const
+{
+	for(UINT axis = 0; axis < 3; ++axis)
+	{
+		if( mMin[axis][a] > mMax[axis][b] || mMin[axis][b] > mMax[axis][a] )
+			return false;
+	}
+
+	return true;
+}
+
+void BroadPhase::FindPairsSweepAndPrune(std::vector<Pair>& pairs)
+{
+	pairs.clear();
+
+	const std::vector<UINT>& order = mOrder;
+	UINT count = order.size();
+
+	// Gather the boxes in sweep order so the inner loop walks memory linearly.
+	mSweepBoxes.resize(count);
+	for(UINT i = 0; i < count; ++i)
+	{
+		UINT body = order[i];
+		SweepBox& box = mSweepBoxes[i];
+
+		for(UINT axis = 0; axis < 3; ++axis)
+		{
+			box.Min[axis] = mMin[axis][body];
+			box.Max[axis] = mMax[axis][body];
+		}
+
+		box.Body = body;
+	}
+
+	UINT axis0 = mSweepAxis;
+	UINT axis1 = (mSweepAxis + 1) % 3;
+	UINT axis2 = (mSweepAxis + 2) % 3;
+
+	for(UINT i = 0; i < count; ++i)
+	{
+		const SweepBox& a = mSweepBoxes[i];
+
+		for(UINT j = i + 1; j < count; ++j)
+		{
+			const SweepBox& b = mSweepBoxes[j];
+
+			// Everything from here on starts past the end of a.
+			if( b.Min[axis0] > a.Max[axis0] )
+				break;
+
+			if( b.Min[axis1] > a.Max[axis1] || a.Min[axis1] > b.Max[axis1] ||
+				b.Min[axis2] > a.Max[axis2] || a.Min[axis2] > b.Max[axis2] )
+				continue;
+
+			Pair p;
+			p.A = MathHelper::Min(a.Body, b.Body);
+			p.B = MathHelper::Max(a.Body, b.Body);
+			pairs.push_back(p);
+		}
+	}
+}
+
+UINT64 BroadPhase::CellKey(int x, int y, int z)
+{
+	// 21 bits per axis, offset so negative cells pack as well.
+	const int Bias = 1 << 20;
+	const UINT64 Mask = (1 << 21) - 1;
+
+	return  ((UINT64)(x + Bias) & Mask)        |
+		   (((UINT64)(y + Bias) & Mask) << 21) |
+		   (((UINT64)(z + Bias) & Mask) << 42);
+}
+
+void BroadPhase::FindPairsGrid(float cellSize, std::vector<Pair>& pairs)
+{
+	pairs.clear();
+
+	float invCellSize = 1.0f / cellSize;
+	UINT count = BodyCount();
+
+	mCellEntries.clear();
+	mOversize.clear();
+	mIsOversize.assign(count, false);
+
+	for(UINT i = 0; i < count; ++i)
+	{
+		// Counted in floats, so a huge box cannot overflow the cell indices.
+		float cells = 1.0f;
+		for(UINT axis = 0; axis < 3; ++axis)
+			cells *= floorf(mMax[axis][i]*invCellSize) - floorf(mMin[axis][i]*invCellSize) + 1.0f;
+
+		// One huge box would flood the hash with its cells and pair with
+		// everything in them anyway, so test it against every body instead.
+		if( cells > (float)MaxCellsPerBody )
+		{
+			mOversize.push_back(i);
+			mIsOversize[i] = true;
+			continue;
+		}
+
+		int lo[3];
+		int hi[3];
+		for(UINT axis = 0; axis < 3; ++axis)
+		{
+			lo[axis] = static_cast<int>(floorf(mMin[axis][i]*invCellSize));
+			hi[axis] = static_cast<int>(floorf(mMax[axis][i]*invCellSize));
+		}
+
+		for(int z = lo[2]; z <= hi[2]; ++z)
+		{
+			for(int y = lo[1]; y <= hi[1]; ++y)
+			{
+				for(int x = lo[0]; x <= hi[0]; ++x)
+				{
+					CellEntry entry = { CellKey(x, y, z), i };
+					mCellEntries.push_back(entry);
+				}
+			}
+		}
+	}
+
+	// Sorting by key brings the bodies in the same cell next to each other.
+	std::sort(mCellEntries.begin(), mCellEntries.end());
+
+	UINT entryCount = mCellEntries.size();
+	UINT runStart = 0;
+
+	while( runStart < entryCount )
+	{
+		UINT64 key = mCellEntries[runStart].Key;
+
+		UINT runEnd = runStart + 1;
+		while( runEnd < entryCount && mCellEntries[runEnd].Key == key )
+			++runEnd;
+
+		for(UINT p = runStart; p < runEnd; ++p)
+		{
+			for(UINT q = p + 1; q < runEnd; ++q)
+			{
+				UINT a = mCellEntries[p].Body;
+				UINT b = mCellEntries[q].Body;
+
+				if( !Overlap(a, b) )
+					continue;
+
+				// Two bodies can share many cells.  Only report the pair from the
+				// cell holding the minimum corner of their overlap.
+				int owner[3];
+				for(UINT axis = 0; axis < 3; ++axis)
+				{
+					float overlapMin = MathHelper::Max(mMin[axis][a], mMin[axis][b]);
+					owner[axis] = static_cast<int>(floorf(overlapMin*invCellSize));
+				}
+
+				if( CellKey(owner[0], owner[1], owner[2]) != key )
+					continue;
+
+				Pair pair;
+				pair.A = MathHelper::Min(a, b);
+				pair.B = MathHelper::Max(a, b);
+				pairs.push_back(pair);
+			}
+		}
+
+		runStart = runEnd;
+	}
+
+	for(UINT k = 0; k < mOversize.size(); ++k)
+	{
+		UINT a = mOversize[k];
+
+		for(UINT b = 0; b < count; ++b)
+		{
+			// Two oversize bodies pair once, from the lower index.
+			if( b == a || (mIsOversize[b] && b < a) )
+				continue;
+
+			if( !Overlap(a, b) )
+				continue;
+
+			Pair pair;
+			pair.A = MathHelper::Min(a, b);
+			pair.B = MathHelper::Max(a, b);
+			pairs.push_back(pair);
+		}
+	}
+}
@@ -0,0 +1,140 @@
+//***************************************************************************************
+// BroadPhase.h
+//
+// Finds the pairs of bodies whose axis aligned boxes overlap so that only those pairs
+// need to go through the exact XNA::Intersect* tests.  Two methods are offered:
+//   -Sweep and prune keeps the bodies sorted along the axis their centers are
+//    most spread out on.  Bodies move little from frame to frame, so the previous
+//    order is nearly sorted and an insertion sort brings it up to date in close
+//    to linear time.
+//   -A hashed uniform grid that buckets the bodies by the cells they touch, which
+//    copes better with large numbers of bodies clustered along every axis.
+//    Bodies too large for the grid are tested against every body instead.
+//***************************************************************************************
+
+#ifndef BROADPHASE_H
+#define BROADPHASE_H
+
+#include "d3dUtil.h"
+#include "xnacollision.h"
+#include <thread>
+
+class BroadPhase
+{
+public:
+	// A candidate pair of body indices with A < B.
+	struct Pair
+	{
+		UINT A;
+		UINT B;
+	};
+
+	BroadPhase();
+	~BroadPhase();
+
+	// Sets the bounds of every body.  Body i should be the same object from one call
+	// to the next so the sorted order stays nearly sorted.  Changing the count or
+	// the sweep axis starts the order over from scratch.
+	void Update(const XNA::AxisAlignedBox* bounds, UINT count);
+
+	// Replaces pairs with the overlapping pairs found by sweeping along the axis the
+	// body centers are most spread out on.
+	void FindPairsSweepAndPrune(std::vector<Pair>& pairs);
+
+	// Replaces pairs with the overlapping pairs found by bucketing the bodies in a
+	// grid of cubic cells.  cellSize should be about the size of a typical body; a
+	// body covering more than MaxCellsPerBody cells is kept out of the grid and
+	// tested against every other body.
+	void FindPairsGrid(float cellSize, std::vector<Pair>& pairs);
+
+	UINT BodyCount()const;
+
+	// Runs test(a, b) on every candidate pair across the hardware threads and
+	// replaces contacts with the pairs it returned true for, in candidate order.
+	// test is called concurrently, so it must only read shared data.
+	template<typename NarrowTest>
+	static void TestPairs(const std::vector<Pair>& candidates, const NarrowTest& test, std::vector<Pair>& contacts);
+
+	static const UINT MaxCellsPerBody = 64;
+
+private:
+	BroadPhase(const BroadPhase& rhs);
+	BroadPhase& operator=(const BroadPhase& rhs);
+
+	// Body bounds laid out contiguously in sweep order.
+	struct SweepBox
+	{
+		float Min[3];
+		float Max[3];
+		UINT Body;
+	};
+
+	struct CellEntry
+	{
+		UINT64 Key;
+		UINT Body;
+
+		bool operator<(const CellEntry& rhs)const { return Key < rhs.Key; }
+	};
+
+	void SortSweepAxis();
+	bool Overlap(UINT a, UINT b)const;
+
+	static UINT64 CellKey(int x, int y, int z);
+
+	static const UINT MinPairsPerThread = 1024;
+
+private:
+	std::vector<float> mMin[3];
+	std::vector<float> mMax[3];
+
+	// Body indices sorted by their minimum along the sweep axis.
+	std::vector<UINT> mOrder;
+
+	UINT mSweepAxis;
+
+	std::vector<SweepBox> mSweepBoxes;
+	std::vector<CellEntry> mCellEntries;
+
+	// Bodies left out of the grid, and a flag per body saying which.
+	std::vector<UINT> mOversize;
+	std::vector<bool> mIsOversize;
+};
+
+template<typename NarrowTest>
+void BroadPhase::TestPairs(const std::vector<Pair>& candidates, const NarrowTest& test, std::vector<Pair>& contacts)
+{
+	contacts.clear();
+
+	UINT threadCount = MathHelper::Min<UINT>(std::thread::hardware_concurrency(), candidates.size() / MinPairsPerThread);
+	threadCount = MathHelper::Max<UINT>(threadCount, 1);
+
+	// Each thread keeps its own list so no locking is needed.
+	std::vector< std::vector<Pair> > results(threadCount);
+
+	auto work = [&](UINT t)
+	{
+		UINT first = static_cast<UINT>( (UINT64)candidates.size() * t / threadCount );
+		UINT last  = static_cast<UINT>( (UINT64)candidates.size() * (t + 1) / threadCount );
+
+		for(UINT i = first; i < last; ++i)
+		{
+			if( test(candidates[i].A, candidates[i].B) )
+				results[t].push_back(candidates[i]);
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for(UINT t = 1; t < threadCount; ++t)
+		threads.push_back(std::thread(work, t));
+
+	work(0);
+
+	for(UINT t = 0; t < threads.size(); ++t)
+		threads[t].join();
+
+	for(UINT t = 0; t < threadCount; ++t)
+		contacts.insert(contacts.end(), results[t].begin(), results[t].end());
+}
+
+#endif // BROADPHASE_H
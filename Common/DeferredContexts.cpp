@@ -0,0 +1,86 @@
+//***************************************************************************************
+// DeferredContexts.cpp
+//***************************************************************************************
+
+#include "DeferredContexts.h"
+
+DeferredContexts::DeferredContexts(ID3D11Device* device, ID3D11DeviceContext* immediateContext, UINT contextCount)
+	: mImmediateContext(immediateContext), mDepthStencil(0), mViewportCount(0)
+{
+	ZeroMemory(mRenderTargets, sizeof(mRenderTargets));
+
+	mContexts.resize(contextCount > 0 ? contextCount : 1, 0);
+	mCommandLists.resize(mContexts.size(), 0);
+
+	for(size_t i = 0; i < mContexts.size(); ++i)
+	{
+		HR(device->CreateDeferredContext(0, &mContexts[i]));
+	}
+}
+
+DeferredContexts::~DeferredContexts()
+{
+	ReleaseTargets();
+
+	for(size_t i = 0; i < mContexts.size(); ++i)
+	{
+		ReleaseCOM(mCommandLists[i]);
+		ReleaseCOM(mContexts[i]);
+	}
+}
+
+ID3D11DeviceContext* DeferredContexts::Context(UINT i)
+{
+	return mContexts[i];
+}
+
+UINT DeferredContexts::ContextCount()const
+{
+	return (UINT)mContexts.size();
+}
+
+void DeferredContexts::BeginPass()
+{
+	ReleaseTargets();
+
+	mImmediateContext->OMGetRenderTargets(D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT, mRenderTargets, &mDepthStencil);
+
+	mViewportCount = D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE;
+	mImmediateContext->RSGetViewports(&mViewportCount, mViewports);
+}
+
+void DeferredContexts::EndPass()
+{
+	ReleaseTargets();
+}
+
+void DeferredContexts::BeginChunk(UINT context)
+{
+	ID3D11DeviceContext* dc = mContexts[context];
+
+	dc->OMSetRenderTargets(D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT, mRenderTargets, mDepthStencil);
+	dc->RSSetViewports(mViewportCount, mViewports);
+}
+
+void DeferredContexts::FinishChunk(UINT context)
+{
+	// FALSE: the deferred context goes back to the default state for the next pass.
+	HR(mContexts[context]->FinishCommandList(FALSE, &mCommandLists[context]));
+}
+
+void DeferredContexts::ExecuteChunk(UINT context)
+{
+	mImmediateContext->ExecuteCommandList(mCommandLists[context], TRUE);
+	ReleaseCOM(mCommandLists[context]);
+}
+
+void DeferredContexts::ReleaseTargets()
+{
+	for(UINT i = 0; i < D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT; ++i)
+	{
+		ReleaseCOM(mRenderTargets[i]);
+	}
+
+	ReleaseCOM(mDepthStencil);
+	mViewportCount = 0;
+}
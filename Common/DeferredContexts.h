@@ -0,0 +1,55 @@
+//***************************************************************************************
+// DeferredContexts.h
+//
+// PassRecorder target that records each chunk on a Direct3D deferred context and 
+// plays the command lists back on the immediate context.
+//   -A deferred context starts from the default pipeline state, so the render
+//    targets, depth buffer and viewports bound on the immediate context when the
+//    pass begins are bound on every deferred context before it records.  Any
+//    other state the pass needs must be set by the record function.
+//   -The immediate context state is restored after each command list executes.
+//   -Effects are not thread safe; each context needs its own effect instances.
+//***************************************************************************************
+
+#ifndef DEFERREDCONTEXTS_H
+#define DEFERREDCONTEXTS_H
+
+#include "d3dUtil.h"
+#include "PassRecorder.h"
+
+class DeferredContexts : public PassRecorder::Target
+{
+public:
+	DeferredContexts(ID3D11Device* device, ID3D11DeviceContext* immediateContext, UINT contextCount);
+	~DeferredContexts();
+
+	ID3D11DeviceContext* Context(UINT i);
+
+	UINT ContextCount()const;
+
+	void BeginPass();
+	void EndPass();
+	void BeginChunk(UINT context);
+	void FinishChunk(UINT context);
+	void ExecuteChunk(UINT context);
+
+private:
+	DeferredContexts(const DeferredContexts& rhs);
+	DeferredContexts& operator=(const DeferredContexts& rhs);
+
+	void ReleaseTargets();
+
+private:
+	ID3D11DeviceContext* mImmediateContext;
+
+	std::vector<ID3D11DeviceContext*> mContexts;
+	std::vector<ID3D11CommandList*> mCommandLists;
+
+	// Output state captured from the immediate context at the start of a pass.
+	ID3D11RenderTargetView* mRenderTargets[D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT];
+	ID3D11DepthStencilView* mDepthStencil;
+	D3D11_VIEWPORT mViewports[D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE];
+	UINT mViewportCount;
+};
+
+#endif // DEFERREDCONTEXTS_H
@@ -0,0 +1,28 @@
+//***************************************************************************************
+// DoubleBuffer.h
+//
+// Two copies of a piece of state: the back copy is written by the update while the
+// front copy is read by the draw.  Swap() publishes the back copy and must only be
+// called while neither side is using the buffers.
+//***************************************************************************************
+
+#ifndef DOUBLEBUFFER_H
+#define DOUBLEBUFFER_H
+
+template<typename T>
+class DoubleBuffer
+{
+public:
+	DoubleBuffer() : mFront(0) { }
+
+	T& Back()             { return mBuffers[1 - mFront]; }
+	const T& Front()const { return mBuffers[mFront]; }
+
+	void Swap() { mFront = 1 - mFront; }
+
+private:
+	T mBuffers[2];
+	unsigned int mFront;
+};
+
+#endif // DOUBLEBUFFER_H
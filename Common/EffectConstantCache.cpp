@@ -0,0 +1,249 @@
+//***************************************************************************************
+// EffectConstantCache.cpp
+//***************************************************************************************
+
+#include "EffectConstantCache.h"
+
+EffectConstantCache::EffectConstantCache()
+{
+	ResetStats();
+}
+
+EffectConstantCache::~EffectConstantCache()
+{
+	// The effect holds its own reference to the buffers it was given, and may
+	// already be gone, so it is not told to switch back.
+	for(size_t i = 0; i < mBuffers.size(); ++i)
+		ReleaseCOM(mBuffers[i].DeviceBuffer);
+}
+
+void EffectConstantCache::Init(ID3D11Device* device, ID3DX11Effect* fx, const char* const bufferNames[], UINT bufferCount)
+{
+	for(UINT i = 0; i < bufferCount; ++i)
+	{
+		ID3DX11EffectConstantBuffer* effectBuffer = fx->GetConstantBufferByName(bufferNames[i]);
+		if( !effectBuffer->IsValid() )
+			continue;
+
+		// Match the size of the buffer the effect made.
+		ID3D11Buffer* original = 0;
+		HR(effectBuffer->GetConstantBuffer(&original));
+
+		D3D11_BUFFER_DESC bd;
+		original->GetDesc(&bd);
+		ReleaseCOM(original);
+
+		bd.Usage = D3D11_USAGE_DYNAMIC;
+		bd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+		bd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		bd.MiscFlags = 0;
+		bd.StructureByteStride = 0;
+
+		Buffer buffer;
+		buffer.EffectBuffer = effectBuffer;
+		buffer.DeviceBuffer = 0;
+		buffer.Shadow.resize(bd.ByteWidth, 0);
+		buffer.Dirty = true;
+
+		HR(device->CreateBuffer(&bd, 0, &buffer.DeviceBuffer));
+		HR(effectBuffer->SetConstantBuffer(buffer.DeviceBuffer));
+
+		mBuffers.push_back(buffer);
+	}
+
+	// Start the shadows from the values in the effect file.
+	D3DX11_EFFECT_DESC fxDesc;
+	HR(fx->GetDesc(&fxDesc));
+
+	for(UINT i = 0; i < fxDesc.GlobalVariables; ++i)
+	{
+		ID3DX11EffectVariable* var = fx->GetVariableByIndex(i);
+
+		const Variable& v = FindVariable(var);
+		if( v.Buffer != NotManaged )
+			var->GetRawValue(&mBuffers[v.Buffer].Shadow[v.Offset], 0, v.Size);
+	}
+}
+
+void EffectConstantCache::Share(ID3DX11Effect* fx)
+{
+	for(size_t i = 0; i < mBuffers.size(); ++i)
+	{
+		D3DX11_EFFECT_VARIABLE_DESC desc;
+		HR(mBuffers[i].EffectBuffer->GetDesc(&desc));
+
+		ID3DX11EffectConstantBuffer* effectBuffer = fx->GetConstantBufferByName(desc.Name);
+		if( effectBuffer->IsValid() )
+			HR(effectBuffer->SetConstantBuffer(mBuffers[i].DeviceBuffer));
+	}
+}
+
+const EffectConstantCache::Variable& EffectConstantCache::FindVariable(ID3DX11EffectVariable* var)
+{
+	std::map<ID3DX11EffectVariable*, Variable>::iterator it = mVariables.find(var);
+	if( it == mVariables.end() )
+		it = mVariables.insert(std::make_pair(var, DescribeVariable(var))).first;
+
+	return it->second;
+}
+
+EffectConstantCache::Variable EffectConstantCache::DescribeVariable(ID3DX11EffectVariable* var)
+{
+	Variable v;
+	v.Buffer = NotManaged;
+	v.Offset = 0;
+	v.Size = 0;
+	v.ColumnMajor = false;
+
+	ID3DX11EffectConstantBuffer* parent = var->GetParentConstantBuffer();
+	for(UINT i = 0; i < mBuffers.size(); ++i)
+	{
+		if( mBuffers[i].EffectBuffer == parent )
+		{
+			v.Buffer = i;
+			break;
+		}
+	}
+
+	if( v.Buffer == NotManaged )
+		return v;
+
+	D3DX11_EFFECT_VARIABLE_DESC varDesc;
+	D3DX11_EFFECT_TYPE_DESC typeDesc;
+	HR(var->GetDesc(&varDesc));
+	HR(var->GetType()->GetDesc(&typeDesc));
+
+	v.Offset = varDesc.BufferOffset;
+	v.Size = typeDesc.UnpackedSize;
+	v.ColumnMajor = typeDesc.Class == D3D_SVC_MATRIX_COLUMNS;
+
+	assert( v.Offset + v.Size <= mBuffers[v.Buffer].Shadow.size() );
+
+	return v;
+}
+
+bool EffectConstantCache::Write(const Variable& v, const void* data, UINT byteCount)
+{
+	assert( byteCount <= v.Size );
+
+	BYTE* dst = &mBuffers[v.Buffer].Shadow[v.Offset];
+	if( memcmp(dst, data, byteCount) == 0 )
+	{
+		mStats.SkippedWrites++;
+		return false;
+	}
+
+	memcpy(dst, data, byteCount);
+	mBuffers[v.Buffer].Dirty = true;
+	mStats.Writes++;
+
+	return true;
+}
+
+bool EffectConstantCache::SetRawValue(ID3DX11EffectVariable* var, const void* data, UINT byteCount)
+{
+	const Variable& v = FindVariable(var);
+	if( v.Buffer == NotManaged )
+	{
+		HR(var->SetRawValue(data, 0, byteCount));
+		return true;
+	}
+
+	return Write(v, data, byteCount);
+}
+
+bool EffectConstantCache::SetMatrix(ID3DX11EffectMatrixVariable* var, CXMMATRIX M)
+{
+	const Variable& v = FindVariable(var);
+	if( v.Buffer == NotManaged )
+	{
+		HR(var->SetMatrix(reinterpret_cast<const float*>(&M)));
+		return true;
+	}
+
+	// Stored the way the shader reads it, as the effect would store it.
+	XMFLOAT4X4 stored;
+	XMStoreFloat4x4(&stored, v.ColumnMajor ? XMMatrixTranspose(M) : M);
+
+	return Write(v, &stored, sizeof(XMFLOAT4X4));
+}
+
+bool EffectConstantCache::SetMatrixArray(ID3DX11EffectMatrixVariable* var, const XMFLOAT4X4* M, UINT count)
+{
+	const Variable& v = FindVariable(var);
+	if( v.Buffer == NotManaged )
+	{
+		HR(var->SetMatrixArray(reinterpret_cast<const float*>(M), 0, count));
+		return true;
+	}
+
+	// Each element is a whole number of registers, so the array packs as is.
+	std::vector<XMFLOAT4X4> stored(M, M + count);
+	if( v.ColumnMajor )
+	{
+		for(UINT i = 0; i < count; ++i)
+			XMStoreFloat4x4(&stored[i], XMMatrixTranspose(XMLoadFloat4x4(&M[i])));
+	}
+
+	return Write(v, &stored[0], count*sizeof(XMFLOAT4X4));
+}
+
+bool EffectConstantCache::SetFloatVector(ID3DX11EffectVectorVariable* var, FXMVECTOR v)
+{
+	const Variable& desc = FindVariable(var);
+	if( desc.Buffer == NotManaged )
+	{
+		HR(var->SetFloatVector(reinterpret_cast<const float*>(&v)));
+		return true;
+	}
+
+	XMFLOAT4 stored;
+	XMStoreFloat4(&stored, v);
+
+	return Write(desc, &stored, desc.Size < sizeof(XMFLOAT4) ? desc.Size : sizeof(XMFLOAT4));
+}
+
+bool EffectConstantCache::SetFloat(ID3DX11EffectScalarVariable* var, float f)
+{
+	const Variable& v = FindVariable(var);
+	if( v.Buffer == NotManaged )
+	{
+		HR(var->SetFloat(f));
+		return true;
+	}
+
+	return Write(v, &f, sizeof(float));
+}
+
+void EffectConstantCache::Upload(ID3D11DeviceContext* dc)
+{
+	for(size_t i = 0; i < mBuffers.size(); ++i)
+	{
+		Buffer& buffer = mBuffers[i];
+		if( !buffer.Dirty )
+			continue;
+
+		D3D11_MAPPED_SUBRESOURCE mappedData;
+		HR(dc->Map(buffer.DeviceBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedData));
+		memcpy(mappedData.pData, &buffer.Shadow[0], buffer.Shadow.size());
+		dc->Unmap(buffer.DeviceBuffer, 0);
+
+		buffer.Dirty = false;
+
+		mStats.Uploads++;
+		mStats.BytesUploaded += (UINT)buffer.Shadow.size();
+	}
+}
+
+const EffectConstantCache::Stats& EffectConstantCache::GetStats()const
+{
+	return mStats;
+}
+
+void EffectConstantCache::ResetStats()
+{
+	mStats.Writes = 0;
+	mStats.SkippedWrites = 0;
+	mStats.Uploads = 0;
+	mStats.BytesUploaded = 0;
+}
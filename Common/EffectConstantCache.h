@@ -0,0 +1,93 @@
+//***************************************************************************************
+// EffectConstantCache.h
+//
+// Takes over some constant buffers of an effect so that setting a variable to the
+// value it already has costs nothing.
+//   -Each managed buffer keeps a shadow copy of its contents.  A setter compares
+//    the new value with the shadow and only writes it, and marks the buffer dirty,
+//    when it differs.
+//   -The effect is given a dynamic buffer of ours in place of its own, and Upload
+//    writes each dirty buffer with a single Map/Unmap before a pass is applied.
+//    Clean buffers are left alone, where the effect would update every buffer
+//    touched since the last Apply.
+//   -Variables outside the managed buffers are passed on to the effect.
+//***************************************************************************************
+
+#ifndef EFFECTCONSTANTCACHE_H
+#define EFFECTCONSTANTCACHE_H
+
+#include "d3dUtil.h"
+#include <map>
+
+class EffectConstantCache
+{
+public:
+	struct Stats
+	{
+		UINT Writes;        // Sets that changed a value.
+		UINT SkippedWrites; // Sets that matched the shadow copy.
+		UINT Uploads;       // Buffers written by Upload.
+		UINT BytesUploaded;
+	};
+
+	EffectConstantCache();
+	~EffectConstantCache();
+
+	// Manages the named constant buffers of the effect.  The shadow copies start
+	// out with the initial values from the effect file.
+	void Init(ID3D11Device* device, ID3DX11Effect* fx, const char* const bufferNames[], UINT bufferCount);
+
+	// Gives another effect, compiled from the same source with other defines,
+	// the managed buffers in place of its own buffers of the same names, so the
+	// values set here reach both.
+	void Share(ID3DX11Effect* fx);
+
+	// Each returns true if the value changed.
+	bool SetRawValue(ID3DX11EffectVariable* var, const void* data, UINT byteCount);
+	bool SetMatrix(ID3DX11EffectMatrixVariable* var, CXMMATRIX M);
+	bool SetMatrixArray(ID3DX11EffectMatrixVariable* var, const XMFLOAT4X4* M, UINT count);
+	bool SetFloatVector(ID3DX11EffectVectorVariable* var, FXMVECTOR v);
+	bool SetFloat(ID3DX11EffectScalarVariable* var, float f);
+
+	// Writes the buffers changed since the last call.  Call before applying a pass.
+	void Upload(ID3D11DeviceContext* dc);
+
+	const Stats& GetStats()const;
+	void ResetStats();
+
+private:
+	EffectConstantCache(const EffectConstantCache& rhs);
+	EffectConstantCache& operator=(const EffectConstantCache& rhs);
+
+	struct Buffer
+	{
+		ID3DX11EffectConstantBuffer* EffectBuffer;
+		ID3D11Buffer* DeviceBuffer;
+		std::vector<BYTE> Shadow;
+		bool Dirty;
+	};
+
+	struct Variable
+	{
+		UINT Buffer;      // Index into mBuffers, or NotManaged.
+		UINT Offset;
+		UINT Size;
+		bool ColumnMajor; // Matrices stored transposed.
+	};
+
+	enum { NotManaged = 0xffffffff };
+
+	const Variable& FindVariable(ID3DX11EffectVariable* var);
+	Variable DescribeVariable(ID3DX11EffectVariable* var);
+
+	// Copies the bytes into the shadow at the variable's offset if they differ.
+	bool Write(const Variable& v, const void* data, UINT byteCount);
+
+private:
+	std::vector<Buffer> mBuffers;
+	std::map<ID3DX11EffectVariable*, Variable> mVariables;
+
+	Stats mStats;
+};
+
+#endif // EFFECTCONSTANTCACHE_H
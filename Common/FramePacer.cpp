@@ -0,0 +1,141 @@
+//***************************************************************************************
+// FramePacer.cpp
+//***************************************************************************************
+
+#include "FramePacer.h"
+#include <thread>
+#include <chrono>
+#include <cmath>
+
+double FramePacer::SystemClock::Now()
+{
+	return mClock.Now()*mClock.SecondsPerCount();
+}
+
+void FramePacer::SystemClock::Sleep(double seconds)
+{
+	std::this_thread::sleep_for(std::chrono::microseconds(static_cast<long long>(seconds*1.0e6)));
+}
+
+void FramePacer::SystemClock::Spin()
+{
+	std::this_thread::yield();
+}
+
+FramePacer::FramePacer(Clock* clock)
+	: mClock(clock ? clock : &mSystemClock),
+	  mTargetFrameRate(0.0f), mPeriod(0.0), mSpinThreshold(0.002),
+	  mNextDeadline(0.0), mLastFrameStart(0.0), mScheduled(false)
+{
+	ResetStats();
+}
+
+void FramePacer::SetTargetFrameRate(float framesPerSecond)
+{
+	mTargetFrameRate = framesPerSecond > 0.0f ? framesPerSecond : 0.0f;
+	mPeriod = mTargetFrameRate > 0.0f ? 1.0 / mTargetFrameRate : 0.0;
+
+	Reset();
+}
+
+float FramePacer::TargetFrameRate()const
+{
+	return mTargetFrameRate;
+}
+
+void FramePacer::SetSpinThreshold(double seconds)
+{
+	mSpinThreshold = seconds;
+}
+
+void FramePacer::Reset()
+{
+	mScheduled = false;
+}
+
+double FramePacer::WaitForNextFrame()
+{
+	double now = mClock->Now();
+
+	if( !mScheduled )
+	{
+		// The first frame after a reset starts right away.
+		mNextDeadline = now + mPeriod;
+		mLastFrameStart = now;
+		mScheduled = true;
+		return 0.0;
+	}
+
+	if( mPeriod <= 0.0 )
+	{
+		RecordFrame(now);
+		return 0.0;
+	}
+
+	if( now > mNextDeadline )
+	{
+		mStats.MissedDeadlines++;
+
+		// More than a whole period behind: start over from now instead of running
+		// a burst of short frames to catch up.
+		if( now > mNextDeadline + mPeriod )
+			mNextDeadline = now;
+	}
+
+	double waitStart = now;
+
+	if( mNextDeadline - now > mSpinThreshold )
+	{
+		mClock->Sleep(mNextDeadline - now - mSpinThreshold);
+		now = mClock->Now();
+	}
+
+	while( now < mNextDeadline )
+	{
+		mClock->Spin();
+		now = mClock->Now();
+	}
+
+	RecordFrame(now);
+
+	// Keep the deadlines on a fixed grid so waking late one frame does not push
+	// every later frame back.
+	mNextDeadline += mPeriod;
+
+	return now - waitStart;
+}
+
+void FramePacer::RecordFrame(double frameStart)
+{
+	double interval = frameStart - mLastFrameStart;
+	mLastFrameStart = frameStart;
+
+	mStats.Frames++;
+
+	double delta = interval - mStats.MeanInterval;
+	mStats.MeanInterval += delta / mStats.Frames;
+	mIntervalM2 += delta*(interval - mStats.MeanInterval);
+	mStats.StdDevInterval = mStats.Frames > 1 ? std::sqrt(mIntervalM2 / (mStats.Frames - 1)) : 0.0;
+
+	if( mPeriod > 0.0 )
+	{
+		double deviation = std::fabs(interval - mPeriod);
+		if( deviation > mStats.MaxDeviation )
+			mStats.MaxDeviation = deviation;
+	}
+}
+
+const FramePacer::JitterStats& FramePacer::Stats()const
+{
+	return mStats;
+}
+
+void FramePacer::ResetStats()
+{
+	mStats.Frames = 0;
+	mStats.MissedDeadlines = 0;
+	mStats.MeanInterval = 0.0;
+	mStats.StdDevInterval = 0.0;
+	mStats.MaxDeviation = 0.0;
+	mIntervalM2 = 0.0;
+}
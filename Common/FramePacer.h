@@ -0,0 +1,98 @@
+//***************************************************************************************
+// FramePacer.h
+//
+// Holds the main loop to a target frame rate.  Each frame has a deadline one period
+// after the previous one; the wait sleeps until shortly before the deadline and spins
+// for the rest, since a sleep can overshoot by a millisecond or more.  The interval
+// between frames is tracked so the jitter can be reported.
+//
+// The clock is an interface so the pacing can be driven by a fake clock.
+//***************************************************************************************
+
+#ifndef FRAMEPACER_H
+#define FRAMEPACER_H
+
+#include "HighResClock.h"
+
+class FramePacer
+{
+public:
+	class Clock
+	{
+	public:
+		virtual ~Clock() { }
+
+		// Seconds from an arbitrary fixed point.
+		virtual double Now() = 0;
+
+		// Coarse wait that may overshoot.
+		virtual void Sleep(double seconds) = 0;
+
+		// Called on each pass of the spin wait.
+		virtual void Spin() { }
+	};
+
+	// HighResClock for the time, std::this_thread for the waits.
+	class SystemClock : public Clock
+	{
+	public:
+		double Now();
+		void Sleep(double seconds);
+		void Spin();
+
+	private:
+		HighResClock mClock;
+	};
+
+	struct JitterStats
+	{
+		unsigned int Frames;
+		unsigned int MissedDeadlines; // Frames whose work ran past the deadline.
+		double MeanInterval;          // Seconds between frames.
+		double StdDevInterval;
+		double MaxDeviation;          // Largest |interval - period|.
+	};
+
+	// Uses the system clock if clock is null.  The clock must outlive the pacer.
+	explicit FramePacer(Clock* clock = 0);
+
+	// 0 turns pacing off; WaitForNextFrame then returns at once.
+	void SetTargetFrameRate(float framesPerSecond);
+	float TargetFrameRate()const;
+
+	// How long before the deadline to stop sleeping and start spinning.  Should be
+	// a little more than the sleep granularity of the OS.
+	void SetSpinThreshold(double seconds);
+
+	// Starts a new schedule from the current time, e.g. after a pause.
+	void Reset();
+
+	// Waits for the next deadline.  Returns the seconds spent waiting.
+	double WaitForNextFrame();
+
+	const JitterStats& Stats()const;
+	void ResetStats();
+
+private:
+	FramePacer(const FramePacer& rhs);
+	FramePacer& operator=(const FramePacer& rhs);
+
+	void RecordFrame(double frameStart);
+
+private:
+	SystemClock mSystemClock;
+	Clock* mClock;
+
+	float mTargetFrameRate;
+	double mPeriod;
+	double mSpinThreshold;
+
+	double mNextDeadline;
+	double mLastFrameStart;
+	bool mScheduled;
+
+	JitterStats mStats;
+	double mIntervalM2; // Sum of squared deviations from the mean (Welford).
+};
+
+#endif // FRAMEPACER_H
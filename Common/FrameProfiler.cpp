@@ -0,0 +1,187 @@
+//***************************************************************************************
+// FrameProfiler.cpp
+//***************************************************************************************
+
+#include "FrameProfiler.h"
+#include <algorithm>
+#include <fstream>
+#include <cmath>
+
+namespace
+{
+	// Lower bound of the first histogram bucket in milliseconds.
+	const float MinBucketTime = 0.125f;
+
+	// Nearest rank percentile of sorted times; p in [0, 1].
+	float Percentile(const std::vector<float>& sorted, float p)
+	{
+		unsigned int n = static_cast<unsigned int>(sorted.size());
+		unsigned int rank = static_cast<unsigned int>(std::ceil(p*n));
+
+		rank = std::max(rank, 1u);
+		rank = std::min(rank, n);
+
+		return sorted[rank-1];
+	}
+}
+
+FrameProfiler::FrameProfiler(unsigned int capacity)
+	: mCapacity(capacity > 0 ? capacity : 1), mNext(0), mTotalFrames(0)
+{
+	mFrames.reserve(mCapacity);
+	Reset();
+}
+
+void FrameProfiler::Reset()
+{
+	mFrames.clear();
+	mNext = 0;
+	mTotalFrames = 0;
+
+	for(unsigned int i = 0; i < HistogramBuckets; ++i)
+		mHistogram[i] = 0;
+}
+
+void FrameProfiler::AddFrame(float seconds)
+{
+	float ms = seconds*1000.0f;
+
+	// Fill the buffer up to capacity, then overwrite the oldest frame.
+	if( mFrames.size() < mCapacity )
+	{
+		mFrames.push_back(ms);
+	}
+	else
+	{
+		mFrames[mNext] = ms;
+		mNext = (mNext + 1) % mFrames.size();
+	}
+
+	mHistogram[BucketIndex(ms)]++;
+	mTotalFrames++;
+}
+
+unsigned int FrameProfiler::FrameCount()const
+{
+	return static_cast<unsigned int>(mFrames.size());
+}
+
+unsigned long long FrameProfiler::TotalFrames()const
+{
+	return mTotalFrames;
+}
+
+float FrameProfiler::FrameTime(unsigned int i)const
+{
+	// mNext is the oldest frame once the buffer has wrapped, and 0 before.
+	return mFrames[(mNext + i) % mFrames.size()];
+}
+
+FrameProfiler::Stats FrameProfiler::ComputeStats()const
+{
+	Stats stats = { 0, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+
+	if( mFrames.empty() )
+		return stats;
+
+	mSorted.assign(mFrames.begin(), mFrames.end());
+	std::sort(mSorted.begin(), mSorted.end());
+
+	double sum = 0.0;
+	for(unsigned int i = 0; i < mSorted.size(); ++i)
+		sum += mSorted[i];
+
+	stats.Frames = FrameCount();
+	stats.Mean = static_cast<float>(sum / mSorted.size());
+	stats.Min  = mSorted.front();
+	stats.P50  = Percentile(mSorted, 0.50f);
+	stats.P95  = Percentile(mSorted, 0.95f);
+	stats.P99  = Percentile(mSorted, 0.99f);
+	stats.Max  = mSorted.back();
+
+	return stats;
+}
+
+unsigned long long FrameProfiler::BucketCount(unsigned int bucket)const
+{
+	return mHistogram[bucket];
+}
+
+float FrameProfiler::BucketLowerBound(unsigned int bucket)
+{
+	return MinBucketTime*std::pow(2.0f, static_cast<float>(bucket) / BucketsPerDoubling);
+}
+
+unsigned int FrameProfiler::BucketIndex(float milliseconds)
+{
+	if( !(milliseconds > MinBucketTime) )
+		return 0;
+
+	float index = std::floor(BucketsPerDoubling*std::log(milliseconds / MinBucketTime) / std::log(2.0f));
+
+	if( index >= HistogramBuckets - 1 )
+		return HistogramBuckets - 1;
+
+	return static_cast<unsigned int>(index);
+}
+
+void FrameProfiler::WriteCsv(std::ostream& os)const
+{
+	os << "frame,ms\n";
+
+	// Number the frames so the last one is TotalFrames-1.
+	unsigned long long firstFrame = mTotalFrames - mFrames.size();
+
+	for(unsigned int i = 0; i < FrameCount(); ++i)
+		os << firstFrame + i << "," << FrameTime(i) << "\n";
+}
+
+void FrameProfiler::WriteJson(std::ostream& os)const
+{
+	Stats stats = ComputeStats();
+
+	os << "{\n";
+	os << "  \"totalFrames\": " << mTotalFrames << ",\n";
+	os << "  \"frames\": " << stats.Frames << ",\n";
+	os << "  \"meanMs\": " << stats.Mean << ",\n";
+	os << "  \"minMs\": " << stats.Min << ",\n";
+	os << "  \"p50Ms\": " << stats.P50 << ",\n";
+	os << "  \"p95Ms\": " << stats.P95 << ",\n";
+	os << "  \"p99Ms\": " << stats.P99 << ",\n";
+	os << "  \"maxMs\": " << stats.Max << ",\n";
+	os << "  \"histogram\": [";
+
+	bool first = true;
+	for(unsigned int i = 0; i < HistogramBuckets; ++i)
+	{
+		if( mHistogram[i] == 0 )
+			continue;
+
+		os << (first ? "\n" : ",\n");
+		os << "    { \"fromMs\": " << BucketLowerBound(i) << ", \"count\": " << mHistogram[i] << " }";
+		first = false;
+	}
+
+	os << (first ? "]\n" : "\n  ]\n");
+	os << "}\n";
+}
+
+bool FrameProfiler::SaveCsv(const std::string& filename)const
+{
+	std::ofstream fout(filename.c_str());
+	if( !fout )
+		return false;
+
+	WriteCsv(fout);
+	return true;
+}
+
+bool FrameProfiler::SaveJson(const std::string& filename)const
+{
+	std::ofstream fout(filename.c_str());
+	if( !fout )
+		return false;
+
+	WriteJson(fout);
+	return true;
+}
@@ -0,0 +1,80 @@
+//***************************************************************************************
+// FrameProfiler.h
+//
+// Records the time of every frame so hitches show up in the statistics instead of
+// being averaged away.
+//   -The most recent frames are kept in a ring buffer for percentiles and dumps.
+//   -Every frame since the last Reset is counted in a histogram with logarithmic
+//    buckets, four per doubling of the frame time.
+// Uses only the standard library so it can be exercised without a window or device.
+//***************************************************************************************
+
+#ifndef FRAMEPROFILER_H
+#define FRAMEPROFILER_H
+
+#include <vector>
+#include <string>
+#include <ostream>
+
+class FrameProfiler
+{
+public:
+	struct Stats
+	{
+		unsigned int Frames; // Frames in the ring buffer the stats were computed from.
+		float Mean; // All times in milliseconds.
+		float Min;
+		float P50;
+		float P95;
+		float P99;
+		float Max;
+	};
+
+	explicit FrameProfiler(unsigned int capacity = 4096);
+
+	void AddFrame(float seconds);
+	void Reset();
+
+	// Number of frames held in the ring buffer.
+	unsigned int FrameCount()const;
+
+	// Number of frames added since the last Reset.
+	unsigned long long TotalFrames()const;
+
+	// Frame time in milliseconds of the i-th oldest frame in the ring buffer.
+	float FrameTime(unsigned int i)const;
+
+	Stats ComputeStats()const;
+
+	static const unsigned int HistogramBuckets = 48;
+	static const unsigned int BucketsPerDoubling = 4;
+
+	unsigned long long BucketCount(unsigned int bucket)const;
+
+	// Lower bound of a bucket in milliseconds.  The first bucket also holds
+	// everything faster and the last everything slower.
+	static float BucketLowerBound(unsigned int bucket);
+	static unsigned int BucketIndex(float milliseconds);
+
+	// Frame index and time for every frame in the ring buffer.
+	void WriteCsv(std::ostream& os)const;
+
+	// The stats plus the non empty histogram buckets.
+	void WriteJson(std::ostream& os)const;
+
+	bool SaveCsv(const std::string& filename)const;
+	bool SaveJson(const std::string& filename)const;
+
+private:
+	std::vector<float> mFrames; // Milliseconds.
+	unsigned int mCapacity;
+	unsigned int mNext;
+	unsigned long long mTotalFrames;
+
+	unsigned long long mHistogram[HistogramBuckets];
+
+	// Scratch copy for the percentile selection.
+	mutable std::vector<float> mSorted;
+};
+
+#endif // FRAMEPROFILER_H
@@ -2,16 +2,13 @@
 // GameTimer.cpp by Frank Luna (C) 2011 All Rights Reserved.
 //***************************************************************************************
 
-#include <windows.h>
 #include "GameTimer.h"
 
-GameTimer::GameTimer()
-: mSecondsPerCount(0.0), mDeltaTime(-1.0), mBaseTime(0), 
+GameTimer::GameTimer(HighResClock::Source source)
+: mClock(source), mSecondsPerCount(0.0), mDeltaTime(-1.0), mBaseTime(0), 
   mPausedTime(0), mPrevTime(0), mCurrTime(0), mStopped(false)
 {
-	__int64 countsPerSec;
-	QueryPerformanceFrequency((LARGE_INTEGER*)&countsPerSec);
-	mSecondsPerCount = 1.0 / (double)countsPerSec;
+	mSecondsPerCount = mClock.SecondsPerCount();
 }
 
 // Returns the total time elapsed since Reset() was called, NOT counting any
@@ -48,6 +45,18 @@ float GameTimer::TotalTime()const
 	}
 }
 
+double GameTimer::PreciseTotalTime()const
+{
+	long long endTime = mStopped ? mStopTime : mCurrTime;
+
+	return ((endTime - mPausedTime)-mBaseTime)*mSecondsPerCount;
+}
+
+const HighResClock& GameTimer::Clock()const
+{
+	return mClock;
+}
+
 float GameTimer::DeltaTime()const
 {
 	return (float)mDeltaTime;
@@ -55,19 +64,18 @@ float GameTimer::DeltaTime()const
 
 void GameTimer::Reset()
 {
-	__int64 currTime;
-	QueryPerformanceCounter((LARGE_INTEGER*)&currTime);
+	long long currTime = mClock.Now();
 
 	mBaseTime = currTime;
 	mPrevTime = currTime;
+	mCurrTime = currTime;
 	mStopTime = 0;
 	mStopped  = false;
 }
 
 void GameTimer::Start()
 {
-	__int64 startTime;
-	QueryPerformanceCounter((LARGE_INTEGER*)&startTime);
+	long long startTime = mClock.Now();
 
 
 	// Accumulate the time elapsed between stop and start pairs.
@@ -90,8 +98,7 @@ void GameTimer::Stop()
 {
 	if( !mStopped )
 	{
-		__int64 currTime;
-		QueryPerformanceCounter((LARGE_INTEGER*)&currTime);
+		long long currTime = mClock.Now();
 
 		mStopTime = currTime;
 		mStopped  = true;
@@ -106,8 +113,7 @@ void GameTimer::Tick()
 		return;
 	}
 
-	__int64 currTime;
-	QueryPerformanceCounter((LARGE_INTEGER*)&currTime);
+	long long currTime = mClock.Now();
 	mCurrTime = currTime;
 
 	// Time difference between this frame and the previous.
@@ -5,10 +5,12 @@
 #ifndef GAMETIMER_H
 #define GAMETIMER_H
 
+#include "HighResClock.h"
+
 class GameTimer
 {
 public:
-	GameTimer();
+	explicit GameTimer(HighResClock::Source source = HighResClock::Default);
 
 	float TotalTime()const;  // in seconds
 	float DeltaTime()const; // in seconds
@@ -18,15 +20,22 @@ public:
 	void Stop();  // Call when paused.
 	void Tick();  // Call every frame.
 
+	// Seconds since Reset() at full clock resolution, NOT counting paused time.
+	double PreciseTotalTime()const;
+
+	const HighResClock& Clock()const;
+
 private:
+	HighResClock mClock;
+
 	double mSecondsPerCount;
 	double mDeltaTime;
 
-	__int64 mBaseTime;
-	__int64 mPausedTime;
-	__int64 mStopTime;
-	__int64 mPrevTime;
-	__int64 mCurrTime;
+	long long mBaseTime;
+	long long mPausedTime;
+	long long mStopTime;
+	long long mPrevTime;
+	long long mCurrTime;
 
 	bool mStopped;
 };
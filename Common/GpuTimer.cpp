@@ -0,0 +1,100 @@
+//***************************************************************************************
+// GpuTimer.cpp
+//***************************************************************************************
+
+#include "GpuTimer.h"
+
+GpuTimer::GpuTimer()
+	: mCurrent(0), mInBegin(false), mMilliseconds(0.0f)
+{
+	for(UINT i = 0; i < FrameLatency; ++i)
+	{
+		mQueries[i].Disjoint = 0;
+		mQueries[i].Start = 0;
+		mQueries[i].Stop = 0;
+		mQueries[i].Pending = false;
+	}
+}
+
+GpuTimer::~GpuTimer()
+{
+	for(UINT i = 0; i < FrameLatency; ++i)
+	{
+		ReleaseCOM(mQueries[i].Disjoint);
+		ReleaseCOM(mQueries[i].Start);
+		ReleaseCOM(mQueries[i].Stop);
+	}
+}
+
+void GpuTimer::Init(ID3D11Device* device)
+{
+	D3D11_QUERY_DESC disjointDesc;
+	disjointDesc.Query = D3D11_QUERY_TIMESTAMP_DISJOINT;
+	disjointDesc.MiscFlags = 0;
+
+	D3D11_QUERY_DESC timestampDesc;
+	timestampDesc.Query = D3D11_QUERY_TIMESTAMP;
+	timestampDesc.MiscFlags = 0;
+
+	for(UINT i = 0; i < FrameLatency; ++i)
+	{
+		HR(device->CreateQuery(&disjointDesc, &mQueries[i].Disjoint));
+		HR(device->CreateQuery(&timestampDesc, &mQueries[i].Start));
+		HR(device->CreateQuery(&timestampDesc, &mQueries[i].Stop));
+	}
+}
+
+void GpuTimer::Begin(ID3D11DeviceContext* dc)
+{
+	assert( !mInBegin );
+
+	QuerySet& set = mQueries[mCurrent];
+	if( set.Pending )
+		Collect(dc, mCurrent);
+
+	dc->Begin(set.Disjoint);
+	dc->End(set.Start);
+
+	mInBegin = true;
+}
+
+void GpuTimer::End(ID3D11DeviceContext* dc)
+{
+	assert( mInBegin );
+
+	QuerySet& set = mQueries[mCurrent];
+
+	dc->End(set.Stop);
+	dc->End(set.Disjoint);
+	set.Pending = true;
+
+	mCurrent = (mCurrent + 1) % FrameLatency;
+	mInBegin = false;
+}
+
+float GpuTimer::Milliseconds()const
+{
+	return mMilliseconds;
+}
+
+void GpuTimer::Collect(ID3D11DeviceContext* dc, UINT index)
+{
+	QuerySet& set = mQueries[index];
+	set.Pending = false;
+
+	D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjoint;
+	if( dc->GetData(set.Disjoint, &disjoint, sizeof(disjoint), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK )
+		return;
+
+	// The clock changed speed during the frame; the timestamps mean nothing.
+	if( disjoint.Disjoint )
+		return;
+
+	UINT64 start = 0;
+	UINT64 stop = 0;
+	if( dc->GetData(set.Start, &start, sizeof(start), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK ||
+		dc->GetData(set.Stop, &stop, sizeof(stop), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK )
+		return;
+
+	mMilliseconds = (float)((double)(stop - start) * 1000.0 / (double)disjoint.Frequency);
+}
@@ -0,0 +1,55 @@
+//***************************************************************************************
+// GpuTimer.h
+//
+// Measures how long the GPU takes for the commands between Begin and End, with
+// timestamp queries.  Results arrive a few frames late: each Begin/End pair uses
+// the next of FrameLatency query sets, and the set is read back, without waiting,
+// the next time it comes around.  A result that is still not ready is dropped.
+//***************************************************************************************
+
+#ifndef GPUTIMER_H
+#define GPUTIMER_H
+
+#include "d3dUtil.h"
+
+class GpuTimer
+{
+public:
+	GpuTimer();
+	~GpuTimer();
+
+	void Init(ID3D11Device* device);
+
+	// Once per frame, around the commands to time.
+	void Begin(ID3D11DeviceContext* dc);
+	void End(ID3D11DeviceContext* dc);
+
+	// The latest result, or 0 if there is none yet.
+	float Milliseconds()const;
+
+private:
+	GpuTimer(const GpuTimer& rhs);
+	GpuTimer& operator=(const GpuTimer& rhs);
+
+	// Reads the set back if the GPU is done with it.
+	void Collect(ID3D11DeviceContext* dc, UINT index);
+
+private:
+	enum { FrameLatency = 4 };
+
+	struct QuerySet
+	{
+		ID3D11Query* Disjoint;
+		ID3D11Query* Start;
+		ID3D11Query* Stop;
+		bool Pending;
+	};
+
+	QuerySet mQueries[FrameLatency];
+	UINT mCurrent;
+	bool mInBegin;
+
+	float mMilliseconds;
+};
+
+#endif // GPUTIMER_H
@@ -0,0 +1,204 @@
+//***************************************************************************************
+// HighResClock.cpp
+//***************************************************************************************
+
+#include "HighResClock.h"
+#include <chrono>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__i386__) || defined(__x86_64__)
+#include <x86intrin.h>
+#include <cpuid.h>
+#endif
+
+#if defined(_MSC_VER) || defined(__i386__) || defined(__x86_64__)
+#define HIGHRESCLOCK_HAS_TSC 1
+#else
+#define HIGHRESCLOCK_HAS_TSC 0
+#endif
+
+namespace
+{
+#if HIGHRESCLOCK_HAS_TSC
+	// CPUID 0x80000007 EDX bit 8: the TSC runs at a constant rate across power
+	// states and does not stop in deep sleep.
+	bool HasInvariantTsc()
+	{
+#if defined(_MSC_VER)
+		int regs[4];
+		__cpuid(regs, 0x80000000);
+		if( static_cast<unsigned int>(regs[0]) < 0x80000007 )
+			return false;
+
+		__cpuid(regs, 0x80000007);
+		return (regs[3] & (1 << 8)) != 0;
+#else
+		unsigned int eax, ebx, ecx, edx;
+		if( !__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) )
+			return false;
+
+		return (edx & (1 << 8)) != 0;
+#endif
+	}
+#endif
+}
+
+HighResClock::HighResClock(Source source)
+	: mSource(Resolve(source)), mSecondsPerCount(0.0)
+{
+	if( mSource == Tsc )
+		mSecondsPerCount = CalibrateTsc();
+	else
+		mSecondsPerCount = ReadSecondsPerCount(mSource);
+}
+
+long long HighResClock::Now()const
+{
+	return Read(mSource);
+}
+
+double HighResClock::SecondsPerCount()const
+{
+	return mSecondsPerCount;
+}
+
+HighResClock::Source HighResClock::GetSource()const
+{
+	return mSource;
+}
+
+bool HighResClock::IsAvailable(Source source)
+{
+	switch( source )
+	{
+	case Default:
+	case SteadyClock:
+		return true;
+
+	case PerformanceCounter:
+#if defined(_WIN32)
+		return true;
+#else
+		return false;
+#endif
+
+	case MonotonicRaw:
+#if defined(__linux__)
+		return true;
+#else
+		return false;
+#endif
+
+	case Tsc:
+#if HIGHRESCLOCK_HAS_TSC
+		return HasInvariantTsc();
+#else
+		return false;
+#endif
+	}
+
+	return false;
+}
+
+HighResClock::Source HighResClock::Resolve(Source source)
+{
+	if( !IsAvailable(source) )
+		source = Default;
+
+	if( source == Default )
+	{
+#if defined(_WIN32)
+		source = PerformanceCounter;
+#elif defined(__linux__)
+		source = MonotonicRaw;
+#else
+		source = SteadyClock;
+#endif
+	}
+
+#if defined(_MSC_VER) && _MSC_VER < 1900
+	if( source == SteadyClock )
+		source = PerformanceCounter;
+#endif
+
+	return source;
+}
+
+long long HighResClock::Read(Source source)
+{
+	switch( source )
+	{
+#if defined(_WIN32)
+	case PerformanceCounter:
+		{
+			LARGE_INTEGER counts;
+			QueryPerformanceCounter(&counts);
+			return counts.QuadPart;
+		}
+#endif
+
+#if defined(__linux__)
+	case MonotonicRaw:
+		{
+			timespec ts;
+			clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+			return static_cast<long long>(ts.tv_sec)*1000000000LL + ts.tv_nsec;
+		}
+#endif
+
+#if HIGHRESCLOCK_HAS_TSC
+	case Tsc:
+		return static_cast<long long>(__rdtsc());
+#endif
+
+	default:
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+}
+
+double HighResClock::ReadSecondsPerCount(Source source)
+{
+#if defined(_WIN32)
+	if( source == PerformanceCounter )
+	{
+		LARGE_INTEGER countsPerSec;
+		QueryPerformanceFrequency(&countsPerSec);
+		return 1.0 / (double)countsPerSec.QuadPart;
+	}
+#else
+	(void)source;
+#endif
+
+	// The other sources count nanoseconds.
+	return 1.0e-9;
+}
+
+double HighResClock::CalibrateTsc()
+{
+	// Count TSC ticks over 20 ms of the default source.  Spinning rather than
+	// sleeping keeps the two reads of each pair close together.
+	Source reference = Resolve(Default);
+	double referenceSecondsPerCount = ReadSecondsPerCount(reference);
+
+	long long referenceStart = Read(reference);
+	long long tscStart = Read(Tsc);
+
+	long long referenceEnd;
+	do
+	{
+		referenceEnd = Read(reference);
+	}
+	while( (referenceEnd - referenceStart)*referenceSecondsPerCount < 0.02 );
+
+	long long tscEnd = Read(Tsc);
+
+	return (referenceEnd - referenceStart)*referenceSecondsPerCount / (double)(tscEnd - tscStart);
+}
@@ -0,0 +1,51 @@
+//***************************************************************************************
+// HighResClock.h
+//
+// Monotonic tick counters behind GameTimer, so the timer builds and runs off Windows.
+//   -PerformanceCounter: QueryPerformanceCounter.  Windows only.
+//   -SteadyClock: std::chrono::steady_clock.  Under Visual Studio 2013 steady_clock
+//    only ticks at the system clock rate, so there it uses the performance counter.
+//   -MonotonicRaw: clock_gettime(CLOCK_MONOTONIC_RAW), which is not slewed by NTP.
+//    Linux only.
+//   -Tsc: the CPU timestamp counter, calibrated against the default source when the
+//    clock is created.  Only used on CPUs whose TSC runs at a constant rate.
+// A source that is not available falls back to Default.
+//***************************************************************************************
+
+#ifndef HIGHRESCLOCK_H
+#define HIGHRESCLOCK_H
+
+class HighResClock
+{
+public:
+	enum Source
+	{
+		Default,
+		PerformanceCounter,
+		SteadyClock,
+		MonotonicRaw,
+		Tsc
+	};
+
+	explicit HighResClock(Source source = Default);
+
+	long long Now()const;
+	double SecondsPerCount()const;
+
+	// The source actually in use after any fallback.
+	Source GetSource()const;
+
+	static bool IsAvailable(Source source);
+
+private:
+	static Source Resolve(Source source);
+	static long long Read(Source source);
+	static double ReadSecondsPerCount(Source source);
+	static double CalibrateTsc();
+
+private:
+	Source mSource;
+	double mSecondsPerCount;
+};
+
+#endif // HIGHRESCLOCK_H
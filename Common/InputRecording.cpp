@@ -0,0 +1,162 @@
+//***************************************************************************************
+// InputRecording.cpp
+//***************************************************************************************
+
+#include "InputRecording.h"
+#include <fstream>
+#include <cassert>
+
+namespace
+{
+	const char* FileTag = "InputRecording";
+	const int FileVersion = 1;
+}
+
+InputRecording::InputRecording()
+	: mSeed(0), mTimeStep(0.0f), mTickCount(0)
+{
+}
+
+void InputRecording::Clear()
+{
+	mSeed = 0;
+	mTimeStep = 0.0f;
+	mTickCount = 0;
+	mEvents.clear();
+}
+
+void InputRecording::SetSeed(unsigned int seed)
+{
+	mSeed = seed;
+}
+
+unsigned int InputRecording::Seed()const
+{
+	return mSeed;
+}
+
+void InputRecording::SetTimeStep(float seconds)
+{
+	mTimeStep = seconds;
+}
+
+float InputRecording::TimeStep()const
+{
+	return mTimeStep;
+}
+
+void InputRecording::SetTickCount(unsigned int ticks)
+{
+	mTickCount = ticks;
+}
+
+unsigned int InputRecording::TickCount()const
+{
+	return mTickCount;
+}
+
+void InputRecording::AddEvent(unsigned int tick, EventType type, unsigned int param, int x, int y)
+{
+	assert( mEvents.empty() || mEvents.back().Tick <= tick );
+
+	Event e;
+	e.Tick  = tick;
+	e.Type  = type;
+	e.Param = param;
+	e.X     = x;
+	e.Y     = y;
+
+	mEvents.push_back(e);
+}
+
+unsigned int InputRecording::EventCount()const
+{
+	return (unsigned int)mEvents.size();
+}
+
+const InputRecording::Event& InputRecording::GetEvent(unsigned int i)const
+{
+	return mEvents[i];
+}
+
+void InputRecording::Write(std::ostream& os)const
+{
+	// Nine significant digits round trip a float exactly, so the replay steps by
+	// the very same amount.
+	std::streamsize oldPrecision = os.precision(9);
+
+	os << FileTag << " " << FileVersion << "\n";
+	os << "Seed " << mSeed << "\n";
+	os << "TimeStep " << mTimeStep << "\n";
+	os << "Ticks " << mTickCount << "\n";
+	os << "Events " << mEvents.size() << "\n";
+
+	for(size_t i = 0; i < mEvents.size(); ++i)
+	{
+		const Event& e = mEvents[i];
+		os << e.Tick << " " << (int)e.Type << " " << e.Param << " " << e.X << " " << e.Y << "\n";
+	}
+
+	os.precision(oldPrecision);
+}
+
+bool InputRecording::Read(std::istream& is)
+{
+	Clear();
+
+	std::string ignore;
+	int version = 0;
+	is >> ignore >> version;
+	if( !is || ignore != FileTag || version != FileVersion )
+		return false;
+
+	size_t eventCount = 0;
+	is >> ignore >> mSeed;
+	is >> ignore >> mTimeStep;
+	is >> ignore >> mTickCount;
+	is >> ignore >> eventCount;
+	if( !is )
+	{
+		Clear();
+		return false;
+	}
+
+	mEvents.reserve(eventCount);
+	for(size_t i = 0; i < eventCount; ++i)
+	{
+		Event e;
+		int type = 0;
+		is >> e.Tick >> type >> e.Param >> e.X >> e.Y;
+
+		if( !is || type < KeyDown || type > MouseMove ||
+			(!mEvents.empty() && e.Tick < mEvents.back().Tick) )
+		{
+			Clear();
+			return false;
+		}
+
+		e.Type = (EventType)type;
+		mEvents.push_back(e);
+	}
+
+	return true;
+}
+
+bool InputRecording::Save(const std::string& filename)const
+{
+	std::ofstream fout(filename.c_str());
+	if( !fout )
+		return false;
+
+	Write(fout);
+	return fout.good();
+}
+
+bool InputRecording::Load(const std::string& filename)
+{
+	std::ifstream fin(filename.c_str());
+	if( !fin )
+		return false;
+
+	return Read(fin);
+}
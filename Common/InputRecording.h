@@ -0,0 +1,76 @@
+//***************************************************************************************
+// InputRecording.h
+//
+// Input captured against simulation ticks, so a session can be replayed exactly.
+//   -Each event is tagged with the tick it is applied before.  Played back at the
+//    same fixed time step and random seed, the simulation goes through the same
+//    states no matter how fast frames are drawn.
+//   -Keys are stored as changes in state, the mouse as the raw button messages
+//    and moves.
+//   -The file is plain text, one event per line.
+// Uses only the standard library so it can be exercised without a window or device.
+//***************************************************************************************
+
+#ifndef INPUTRECORDING_H
+#define INPUTRECORDING_H
+
+#include <vector>
+#include <string>
+#include <istream>
+#include <ostream>
+
+class InputRecording
+{
+public:
+	enum EventType
+	{
+		KeyDown,
+		KeyUp,
+		MouseDown,
+		MouseUp,
+		MouseMove
+	};
+
+	struct Event
+	{
+		unsigned int Tick;
+		EventType Type;
+		unsigned int Param; // Virtual key for key events, button state for the mouse.
+		int X;
+		int Y;
+	};
+
+	InputRecording();
+
+	void Clear();
+
+	void SetSeed(unsigned int seed);
+	unsigned int Seed()const;
+
+	void SetTimeStep(float seconds);
+	float TimeStep()const;
+
+	// Ticks simulated while recording.  Replay stops after this many.
+	void SetTickCount(unsigned int ticks);
+	unsigned int TickCount()const;
+
+	// Events must be added in tick order.
+	void AddEvent(unsigned int tick, EventType type, unsigned int param, int x = 0, int y = 0);
+
+	unsigned int EventCount()const;
+	const Event& GetEvent(unsigned int i)const;
+
+	void Write(std::ostream& os)const;
+	bool Read(std::istream& is);
+
+	bool Save(const std::string& filename)const;
+	bool Load(const std::string& filename);
+
+private:
+	unsigned int mSeed;
+	float mTimeStep;
+	unsigned int mTickCount;
+	std::vector<Event> mEvents;
+};
+
+#endif // INPUTRECORDING_H
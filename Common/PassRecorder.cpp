@@ -0,0 +1,101 @@
+//***************************************************************************************
+// PassRecorder.cpp
+//***************************************************************************************
+
+#include "PassRecorder.h"
+#include "ScopeProfiler.h"
+#include <algorithm>
+
+PassRecorder::PassRecorder(Target& target)
+	: mTarget(target), mMinItemsPerChunk(16)
+{
+}
+
+PassRecorder::~PassRecorder()
+{
+}
+
+void PassRecorder::SetMinItemsPerChunk(unsigned int count)
+{
+	mMinItemsPerChunk = std::max(count, 1u);
+}
+
+const std::vector<PassRecorder::Range>& PassRecorder::Chunks()const
+{
+	return mChunks;
+}
+
+void PassRecorder::Partition(unsigned int itemCount, unsigned int maxChunks, unsigned int minItemsPerChunk,
+	std::vector<Range>& chunks)
+{
+	chunks.clear();
+
+	if( itemCount == 0 )
+		return;
+
+	minItemsPerChunk = std::max(minItemsPerChunk, 1u);
+
+	unsigned int chunkCount = std::min(std::max(maxChunks, 1u), 
+		std::max(itemCount / minItemsPerChunk, 1u));
+
+	// Spread the remainder over the first chunks so no two differ by more than one.
+	unsigned int baseSize = itemCount / chunkCount;
+	unsigned int remainder = itemCount % chunkCount;
+
+	unsigned int begin = 0;
+	for(unsigned int i = 0; i < chunkCount; ++i)
+	{
+		Range r;
+		r.Begin = begin;
+		r.End = begin + baseSize + (i < remainder ? 1 : 0);
+		chunks.push_back(r);
+
+		begin = r.End;
+	}
+}
+
+void PassRecorder::Record(unsigned int itemCount, const RecordFunc& record)
+{
+	Partition(itemCount, mTarget.ContextCount(), mMinItemsPerChunk, mChunks);
+
+	if( mChunks.empty() )
+		return;
+
+	mTarget.BeginPass();
+
+	// One worker per chunk after the first, created the first time they are needed.
+	while( mWorkers.size() + 1 < mChunks.size() )
+		mWorkers.push_back(std::unique_ptr<WorkerThread>(new WorkerThread("Record")));
+
+	for(unsigned int i = 1; i < (unsigned int)mChunks.size(); ++i)
+	{
+		Range chunk = mChunks[i];
+		mWorkers[i-1]->Start([this, &record, chunk, i]()
+		{
+			PROFILE_SCOPE("PassRecorder::RecordChunk");
+
+			mTarget.BeginChunk(i);
+			record(i, chunk.Begin, chunk.End);
+			mTarget.FinishChunk(i);
+		});
+	}
+
+	{
+		PROFILE_SCOPE("PassRecorder::RecordChunk");
+
+		mTarget.BeginChunk(0);
+		record(0, mChunks[0].Begin, mChunks[0].End);
+		mTarget.FinishChunk(0);
+	}
+
+	// Execute in item order.  Chunk i can only go once its worker is done, but
+	// the earlier chunks can be submitted while the later ones still record.
+	mTarget.ExecuteChunk(0);
+	for(unsigned int i = 1; i < (unsigned int)mChunks.size(); ++i)
+	{
+		mWorkers[i-1]->Wait();
+		mTarget.ExecuteChunk(i);
+	}
+
+	mTarget.EndPass();
+}
@@ -0,0 +1,88 @@
+//***************************************************************************************
+// PassRecorder.h
+//
+// Records one render pass on several threads.  The items of the pass (usually model
+// instances) are split into contiguous chunks, each chunk is recorded on its own
+// context by its own thread, and the recorded chunks are executed in item order, so
+// the result is the same as drawing every item in turn.
+//   -The calling thread records the first chunk; worker threads record the rest.
+//   -How a context records and executes is behind the Target interface.  The
+//    Direct3D implementation uses deferred contexts and command lists; a mock can
+//    stand in to check the partitioning and ordering without a device.
+// Uses only the standard library.
+//***************************************************************************************
+
+#ifndef PASSRECORDER_H
+#define PASSRECORDER_H
+
+#include "WorkerThread.h"
+#include <vector>
+#include <memory>
+#include <functional>
+
+class PassRecorder
+{
+public:
+	struct Range
+	{
+		unsigned int Begin;
+		unsigned int End;
+	};
+
+	class Target
+	{
+	public:
+		virtual ~Target() { }
+
+		// Most chunks a pass is split into; one per context.
+		virtual unsigned int ContextCount()const = 0;
+
+		// Called on the calling thread around the whole pass.
+		virtual void BeginPass() { }
+		virtual void EndPass() { }
+
+		// Called on the thread that records the chunk, before and after the items
+		// are recorded on the context.
+		virtual void BeginChunk(unsigned int /*context*/) { }
+		virtual void FinishChunk(unsigned int context) = 0;
+
+		// Called on the calling thread once per chunk, in item order.
+		virtual void ExecuteChunk(unsigned int context) = 0;
+	};
+
+	// Records items [begin, end) on the given context.  Called concurrently for
+	// different contexts.
+	typedef std::function<void(unsigned int context, unsigned int begin, unsigned int end)> RecordFunc;
+
+	// The target must outlive the recorder.
+	explicit PassRecorder(Target& target);
+	~PassRecorder();
+
+	// A pass is not split into chunks smaller than this.  Recording a chunk has
+	// a fixed cost, so small passes are cheaper on one context.
+	void SetMinItemsPerChunk(unsigned int count);
+
+	void Record(unsigned int itemCount, const RecordFunc& record);
+
+	// The chunks of the last pass.
+	const std::vector<Range>& Chunks()const;
+
+	// Splits [0, itemCount) into at most maxChunks contiguous ranges of at least
+	// minItemsPerChunk items each (except when there are fewer items than that),
+	// with sizes differing by at most one.
+	static void Partition(unsigned int itemCount, unsigned int maxChunks, unsigned int minItemsPerChunk,
+		std::vector<Range>& chunks);
+
+private:
+	PassRecorder(const PassRecorder& rhs);
+	PassRecorder& operator=(const PassRecorder& rhs);
+
+private:
+	Target& mTarget;
+	unsigned int mMinItemsPerChunk;
+
+	std::vector<Range> mChunks;
+	std::vector<std::unique_ptr<WorkerThread> > mWorkers;
+};
+
+#endif // PASSRECORDER_H
@@ -0,0 +1,185 @@
+//***************************************************************************************
+// RenderQueue.cpp
+//***************************************************************************************
+
+#include "RenderQueue.h"
+#include <cstring>
+#include <algorithm>
+
+namespace
+{
+	unsigned long long Field(unsigned int value, unsigned int bits)
+	{
+		return value & ((1ULL << bits) - 1);
+	}
+}
+
+RenderQueue::RenderQueue()
+{
+	std::memset(&mStats, 0, sizeof(mStats));
+}
+
+unsigned long long RenderQueue::MakeKey(unsigned int pass, unsigned int technique, unsigned int texture,
+	unsigned int material, float depth, bool backToFront)
+{
+	const unsigned int maxDepth = (1u << DepthBits) - 1;
+
+	if( !(depth > 0.0f) )
+		depth = 0.0f;
+	if( depth > 1.0f )
+		depth = 1.0f;
+
+	// In double: maxDepth does not fit a float's mantissa, and rounding it up to
+	// 2^24 would carry depth 1 into the material field.
+	unsigned int quantizedDepth = (unsigned int)(depth*(double)maxDepth + 0.5);
+	if( backToFront )
+		quantizedDepth = maxDepth - quantizedDepth;
+
+	unsigned long long key = Field(pass, PassBits);
+	key = (key << TechniqueBits) | Field(technique, TechniqueBits);
+	key = (key << TextureBits)   | Field(texture, TextureBits);
+	key = (key << MaterialBits)  | Field(material, MaterialBits);
+	key = (key << DepthBits)     | quantizedDepth;
+
+	return key;
+}
+
+void RenderQueue::Submit(const Packet& packet)
+{
+	mPackets.push_back(packet);
+}
+
+void RenderQueue::Submit(unsigned int pass, const unsigned int state[StateTypeCount], float depth,
+	unsigned int draw, bool backToFront)
+{
+	Packet packet;
+	packet.Key = MakeKey(pass, state[TechniqueState], state[TextureState], state[MaterialState], depth, backToFront);
+	for(int i = 0; i < StateTypeCount; ++i)
+		packet.State[i] = state[i];
+	packet.Draw = draw;
+
+	mPackets.push_back(packet);
+}
+
+unsigned int RenderQueue::PacketCount()const
+{
+	return (unsigned int)mPackets.size();
+}
+
+const RenderQueue::FrameStats& RenderQueue::Stats()const
+{
+	return mStats;
+}
+
+void RenderQueue::Execute(Target& target)
+{
+	std::memset(&mStats, 0, sizeof(mStats));
+
+	mStats.Packets = (unsigned int)mPackets.size();
+	mStats.UnfilteredChanges = mStats.Packets*StateTypeCount;
+	mStats.SubmissionOrderChanges = CountStateChanges(mPackets);
+
+	RadixSort(mPackets, mScratch);
+
+	bool bound[StateTypeCount] = { false };
+	unsigned int current[StateTypeCount] = { 0 };
+
+	for(size_t i = 0; i < mPackets.size(); ++i)
+	{
+		const Packet& packet = mPackets[i];
+
+		for(int type = 0; type < StateTypeCount; ++type)
+		{
+			if( bound[type] && current[type] == packet.State[type] )
+				continue;
+
+			target.SetState((StateType)type, packet.State[type]);
+
+			bound[type] = true;
+			current[type] = packet.State[type];
+			mStats.Changes[type]++;
+			mStats.StateChanges++;
+		}
+
+		target.Draw(packet);
+	}
+
+	mPackets.clear();
+}
+
+void RenderQueue::RadixSort(std::vector<Packet>& packets, std::vector<Packet>& scratch)
+{
+	const size_t count = packets.size();
+	if( count < 2 )
+		return;
+
+	scratch.resize(count);
+
+	// Histograms of all eight bytes in one pass over the keys.
+	unsigned int histograms[8][256];
+	std::memset(histograms, 0, sizeof(histograms));
+
+	for(size_t i = 0; i < count; ++i)
+	{
+		unsigned long long key = packets[i].Key;
+		for(int b = 0; b < 8; ++b)
+			histograms[b][(key >> (8*b)) & 0xff]++;
+	}
+
+	std::vector<Packet>* src = &packets;
+	std::vector<Packet>* dst = &scratch;
+
+	for(int b = 0; b < 8; ++b)
+	{
+		unsigned int* histogram = histograms[b];
+
+		// Every key has the same byte here, so this pass would not move anything.
+		if( histogram[((*src)[0].Key >> (8*b)) & 0xff] == count )
+			continue;
+
+		unsigned int offset = 0;
+		for(int d = 0; d < 256; ++d)
+		{
+			unsigned int n = histogram[d];
+			histogram[d] = offset;
+			offset += n;
+		}
+
+		for(size_t i = 0; i < count; ++i)
+		{
+			const Packet& packet = (*src)[i];
+			(*dst)[histogram[(packet.Key >> (8*b)) & 0xff]++] = packet;
+		}
+
+		std::swap(src, dst);
+	}
+
+	if( src != &packets )
+		packets.swap(scratch);
+}
+
+unsigned int RenderQueue::CountStateChanges(const std::vector<Packet>& packets, unsigned int* changes)
+{
+	unsigned int perType[StateTypeCount] = { 0 };
+	unsigned int total = 0;
+
+	for(size_t i = 0; i < packets.size(); ++i)
+	{
+		for(int type = 0; type < StateTypeCount; ++type)
+		{
+			if( i == 0 || packets[i].State[type] != packets[i - 1].State[type] )
+			{
+				perType[type]++;
+				total++;
+			}
+		}
+	}
+
+	if( changes )
+	{
+		for(int type = 0; type < StateTypeCount; ++type)
+			changes[type] = perType[type];
+	}
+
+	return total;
+}
@@ -0,0 +1,118 @@
+//***************************************************************************************
+// RenderQueue.h
+//
+// Collects the draws of a frame as packets, sorts them by a 64-bit key and issues
+// them with redundant state changes filtered out.
+//   -The key holds, from most to least significant bits, the pass, technique,
+//    texture, material and depth of the draw, so draws sharing expensive state end
+//    up next to each other.  Depth sorts near to far unless asked otherwise.
+//   -Packets are sorted with an LSD radix sort on the key, which is stable, so
+//    draws with equal keys keep their submission order.
+//   -Each packet also carries the ids of the state it needs.  A state is only
+//    passed to the target when it differs from the one last set.
+//   -How state is set and draws issued is behind the Target interface, so the
+//    sorting and filtering can be exercised without a device.
+// Uses only the standard library.
+//***************************************************************************************
+
+#ifndef RENDERQUEUE_H
+#define RENDERQUEUE_H
+
+#include <vector>
+
+class RenderQueue
+{
+public:
+	// The state a packet sets, in the order the target is told about changes.
+	enum StateType
+	{
+		TechniqueState,
+		RasterizerState,
+		BlendState,
+		TextureState,
+		MaterialState,
+		StateTypeCount
+	};
+
+	// Bits of each key field.
+	enum
+	{
+		PassBits      = 4,
+		TechniqueBits = 8,
+		TextureBits   = 16,
+		MaterialBits  = 12,
+		DepthBits     = 24
+	};
+
+	struct Packet
+	{
+		unsigned long long Key;
+		unsigned int State[StateTypeCount]; // Ids handed to Target::SetState.
+		unsigned int Draw;                  // Tells the target what to draw.
+	};
+
+	class Target
+	{
+	public:
+		virtual ~Target() { }
+
+		// Called only when the id differs from the last one set for the type.
+		virtual void SetState(StateType type, unsigned int id) = 0;
+
+		// Called once per packet, after its state has been set.
+		virtual void Draw(const Packet& packet) = 0;
+	};
+
+	struct FrameStats
+	{
+		unsigned int Packets;
+		unsigned int UnfilteredChanges;      // Every state of every packet, as setting all of it per draw.
+		unsigned int SubmissionOrderChanges; // Changes needed to draw in submission order.
+		unsigned int StateChanges;           // Changes actually made after sorting.
+		unsigned int Changes[StateTypeCount];
+	};
+
+	RenderQueue();
+
+	// Packs the fields into a key.  Ids are truncated to the field widths and depth,
+	// expected in [0, 1], is clamped and quantized.  Back to front inverts the depth
+	// order, for blended draws.
+	static unsigned long long MakeKey(unsigned int pass, unsigned int technique, unsigned int texture,
+		unsigned int material, float depth, bool backToFront = false);
+
+	void Submit(const Packet& packet);
+
+	// Submits a packet whose key is built from the technique, texture and material
+	// state ids.
+	void Submit(unsigned int pass, const unsigned int state[StateTypeCount], float depth,
+		unsigned int draw, bool backToFront = false);
+
+	// Sorts the packets and issues them to the target, then empties the queue.
+	// State set by an earlier Execute is not assumed to still be bound.
+	void Execute(Target& target);
+
+	unsigned int PacketCount()const;
+
+	// Statistics of the last Execute.
+	const FrameStats& Stats()const;
+
+	// Stable ascending sort of the packets by key.  Byte positions where every
+	// key is the same are skipped.  scratch is resized as needed.
+	static void RadixSort(std::vector<Packet>& packets, std::vector<Packet>& scratch);
+
+	// State changes needed to draw the packets in the given order, starting with
+	// nothing bound.  changes, if not null, receives the count per state type.
+	static unsigned int CountStateChanges(const std::vector<Packet>& packets, unsigned int* changes = 0);
+
+private:
+	RenderQueue(const RenderQueue& rhs);
+	RenderQueue& operator=(const RenderQueue& rhs);
+
+private:
+	std::vector<Packet> mPackets;
+	std::vector<Packet> mScratch;
+
+	FrameStats mStats;
+};
+
+#endif // RENDERQUEUE_H
@@ -0,0 +1,199 @@
+//***************************************************************************************
+// ScopeProfiler.cpp
+//***************************************************************************************
+
+#include "ScopeProfiler.h"
+#include "HighResClock.h"
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <fstream>
+#include <chrono>
+
+#if defined(_WIN32)
+#include <windows.h>
+#endif
+
+#if defined(_MSC_VER)
+#define PROFILER_THREAD_LOCAL __declspec(thread)
+#else
+#define PROFILER_THREAD_LOCAL thread_local
+#endif
+
+// Without the invariant TSC bit the tick rate can change under load or stop in
+// sleep states, and ticks would not convert to time with a single rate.  Defined
+// ahead of gOrigin, whose readings go through Now().
+bool ScopeProfiler::UseTsc = HighResClock::IsAvailable(HighResClock::Tsc);
+
+namespace
+{
+	struct Event
+	{
+		const char* Name;
+		ScopeProfiler::Ticks Start;
+		ScopeProfiler::Ticks End;
+	};
+
+	// Only the owning thread writes Events and Written.  Written is published with
+	// release order so a reader that acquires it sees the events before it.
+	struct ThreadBuffer
+	{
+		std::vector<Event> Events;
+		std::atomic<unsigned int> Written;
+		unsigned int ThreadId;
+		const char* Name;
+	};
+
+	// Buffers are never freed so a thread that has exited still shows in the trace.
+	std::mutex gBufferMutex;
+	std::vector<ThreadBuffer*> gBuffers;
+
+	PROFILER_THREAD_LOCAL ThreadBuffer* gThreadBuffer = 0;
+
+	// A wall clock used to convert ticks to microseconds.
+	double WallMicroseconds()
+	{
+#if defined(_WIN32)
+		LARGE_INTEGER counts;
+		LARGE_INTEGER countsPerSec;
+		QueryPerformanceCounter(&counts);
+		QueryPerformanceFrequency(&countsPerSec);
+		return counts.QuadPart * (1.0e6 / countsPerSec.QuadPart);
+#else
+		return std::chrono::duration_cast<std::chrono::duration<double, std::micro> >(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+	}
+
+	// The clock Now() reads when UseTsc is false.
+	const HighResClock gClock;
+
+	// Tick and wall clock readings taken at startup.  Comparing them with fresh
+	// readings at output time gives the tick rate without a calibration pause.
+	struct Origin
+	{
+		Origin() : StartTicks(ScopeProfiler::Now()), StartMicroseconds(WallMicroseconds()) { }
+
+		ScopeProfiler::Ticks StartTicks;
+		double StartMicroseconds;
+	};
+
+	const Origin gOrigin;
+
+	ThreadBuffer* RegisterThread()
+	{
+		ThreadBuffer* buffer = new ThreadBuffer;
+		buffer->Events.resize(ScopeProfiler::EventsPerThread);
+		buffer->Written = 0;
+		buffer->Name = 0;
+
+		std::lock_guard<std::mutex> lock(gBufferMutex);
+		buffer->ThreadId = static_cast<unsigned int>(gBuffers.size());
+		gBuffers.push_back(buffer);
+
+		gThreadBuffer = buffer;
+		return buffer;
+	}
+
+	void WriteJsonString(std::ostream& os, const char* s)
+	{
+		os << '"';
+		for( ; *s; ++s)
+		{
+			if( *s == '"' || *s == '\\' )
+				os << '\\';
+			os << *s;
+		}
+		os << '"';
+	}
+}
+
+ScopeProfiler::Ticks ScopeProfiler::ClockNow()
+{
+	return static_cast<Ticks>(gClock.Now());
+}
+
+void ScopeProfiler::Record(const char* name, Ticks start, Ticks end)
+{
+	ThreadBuffer* buffer = gThreadBuffer;
+	if( !buffer )
+		buffer = RegisterThread();
+
+	unsigned int written = buffer->Written.load(std::memory_order_relaxed);
+
+	Event& e = buffer->Events[written & (EventsPerThread - 1)];
+	e.Name  = name;
+	e.Start = start;
+	e.End   = end;
+
+	buffer->Written.store(written + 1, std::memory_order_release);
+}
+
+void ScopeProfiler::SetThreadName(const char* name)
+{
+	ThreadBuffer* buffer = gThreadBuffer;
+	if( !buffer )
+		buffer = RegisterThread();
+
+	buffer->Name = name;
+}
+
+void ScopeProfiler::WriteChromeTrace(std::ostream& os)
+{
+	double elapsedUs = WallMicroseconds() - gOrigin.StartMicroseconds;
+	Ticks elapsedTicks = Now() - gOrigin.StartTicks;
+
+	double usPerTick = elapsedTicks > 0 ? elapsedUs / elapsedTicks : 0.0;
+
+	std::lock_guard<std::mutex> lock(gBufferMutex);
+
+	os << "{\"traceEvents\":[";
+
+	bool first = true;
+	for(size_t b = 0; b < gBuffers.size(); ++b)
+	{
+		const ThreadBuffer* buffer = gBuffers[b];
+
+		if( buffer->Name )
+		{
+			os << (first ? "\n" : ",\n");
+			os << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << buffer->ThreadId
+			   << ",\"args\":{\"name\":";
+			WriteJsonString(os, buffer->Name);
+			os << "}}";
+			first = false;
+		}
+
+		unsigned int written = buffer->Written.load(std::memory_order_acquire);
+		unsigned int count = written < EventsPerThread ? written : EventsPerThread;
+
+		for(unsigned int i = written - count; i != written; ++i)
+		{
+			const Event& e = buffer->Events[i & (EventsPerThread - 1)];
+
+			// Times are relative to startup so the numbers stay small.
+			double ts  = static_cast<double>(static_cast<long long>(e.Start - gOrigin.StartTicks))*usPerTick;
+			double dur = static_cast<double>(e.End - e.Start)*usPerTick;
+
+			os << (first ? "\n" : ",\n");
+			os << "{\"name\":";
+			WriteJsonString(os, e.Name);
+			os << ",\"ph\":\"X\",\"pid\":0,\"tid\":" << buffer->ThreadId
+			   << ",\"ts\":" << ts << ",\"dur\":" << dur << "}";
+			first = false;
+		}
+	}
+
+	os << "\n]}\n";
+}
+
+bool ScopeProfiler::SaveChromeTrace(const std::string& filename)
+{
+	std::ofstream fout(filename.c_str());
+	if( !fout )
+		return false;
+
+	fout.precision(12);
+	WriteChromeTrace(fout);
+	return true;
+}
@@ -0,0 +1,105 @@
+//***************************************************************************************
+// ScopeProfiler.h
+//
+// Lightweight CPU instrumentation.  Put PROFILE_SCOPE("Name") at the top of a block and
+// the time spent in the block is recorded when it exits.
+//   -Each thread writes to its own ring buffer, so recording takes no locks.  Only the
+//    first event on a thread takes a lock, to register the buffer.
+//   -Timestamps are raw CPU ticks where the TSC runs at a constant rate, else
+//    readings of HighResClock's default source; either way they are converted to
+//    microseconds on output.
+//   -SaveChromeTrace writes JSON that chrome://tracing and Perfetto can open.  Nested
+//    scopes on a thread show up as a call hierarchy.
+// Define SCOPE_PROFILER_ENABLED as 0 in the project settings to compile every
+// PROFILE_SCOPE out.
+//***************************************************************************************
+
+#ifndef SCOPEPROFILER_H
+#define SCOPEPROFILER_H
+
+#ifndef SCOPE_PROFILER_ENABLED
+#define SCOPE_PROFILER_ENABLED 1
+#endif
+
+#include <string>
+#include <ostream>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__i386__) || defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+class ScopeProfiler
+{
+public:
+	typedef unsigned long long Ticks;
+
+	static Ticks Now()
+	{
+#if defined(_MSC_VER) || defined(__i386__) || defined(__x86_64__)
+		if( UseTsc )
+			return __rdtsc();
+#endif
+		return ClockNow();
+	}
+
+	// Appends a finished scope to the calling thread's buffer.  name must outlive the
+	// profiler; string literals are the intended use.
+	static void Record(const char* name, Ticks start, Ticks end);
+
+	// Labels the calling thread in the trace.
+	static void SetThreadName(const char* name);
+
+	// Writes every buffered event.  Best called while the other threads are idle,
+	// since a thread that wraps its buffer during the write overwrites events
+	// that are being read.
+	static void WriteChromeTrace(std::ostream& os);
+	static bool SaveChromeTrace(const std::string& filename);
+
+	// Events kept per thread before the oldest are overwritten.  Power of two.
+	static const unsigned int EventsPerThread = 1 << 16;
+
+private:
+	// Reads HighResClock's default source, for CPUs whose TSC rate follows the
+	// clock speed or stops in deep sleep.
+	static Ticks ClockNow();
+
+	// Decided once at startup, before the calibration readings are taken, from
+	// CPUID's invariant TSC bit.
+	static bool UseTsc;
+};
+
+class ProfileScope
+{
+public:
+	explicit ProfileScope(const char* name)
+		: mName(name), mStart(ScopeProfiler::Now())
+	{
+	}
+
+	~ProfileScope()
+	{
+		ScopeProfiler::Record(mName, mStart, ScopeProfiler::Now());
+	}
+
+private:
+	ProfileScope(const ProfileScope& rhs);
+	ProfileScope& operator=(const ProfileScope& rhs);
+
+private:
+	const char* mName;
+	ScopeProfiler::Ticks mStart;
+};
+
+#if SCOPE_PROFILER_ENABLED
+#define PROFILE_SCOPE_JOIN2(a, b) a##b
+#define PROFILE_SCOPE_JOIN(a, b) PROFILE_SCOPE_JOIN2(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_SCOPE_JOIN(profileScope, __LINE__)(name)
+#define PROFILE_THREAD_NAME(name) ScopeProfiler::SetThreadName(name)
+#else
+#define PROFILE_SCOPE(name) ((void)0)
+#define PROFILE_THREAD_NAME(name) ((void)0)
+#endif
+
+#endif // SCOPEPROFILER_H
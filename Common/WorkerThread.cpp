@@ -0,0 +1,77 @@
+//***************************************************************************************
+// WorkerThread.cpp
+//***************************************************************************************
+
+#include "WorkerThread.h"
+#include "ScopeProfiler.h"
+#include <cassert>
+
+WorkerThread::WorkerThread(const char* name)
+	: mName(name), mBusy(false), mQuit(false)
+{
+}
+
+WorkerThread::~WorkerThread()
+{
+	if( !mThread.joinable() )
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mQuit = true;
+	}
+	mJobReady.notify_one();
+
+	mThread.join();
+}
+
+void WorkerThread::Start(const std::function<void()>& job)
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		assert( !mBusy );
+
+		mJob = job;
+		mBusy = true;
+	}
+
+	if( !mThread.joinable() )
+		mThread = std::thread(&WorkerThread::ThreadMain, this);
+	else
+		mJobReady.notify_one();
+}
+
+void WorkerThread::Wait()
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	while( mBusy )
+		mJobDone.wait(lock);
+}
+
+void WorkerThread::ThreadMain()
+{
+	if( mName )
+		PROFILE_THREAD_NAME(mName);
+
+	std::unique_lock<std::mutex> lock(mMutex);
+
+	for(;;)
+	{
+		while( !mBusy && !mQuit )
+			mJobReady.wait(lock);
+
+		if( mQuit )
+			return;
+
+		// Run the job without the lock so Wait() can block on the condition.
+		std::function<void()> job;
+		job.swap(mJob);
+
+		lock.unlock();
+		job();
+		lock.lock();
+
+		mBusy = false;
+		mJobDone.notify_all();
+	}
+}
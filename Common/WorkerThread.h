@@ -0,0 +1,48 @@
+//***************************************************************************************
+// WorkerThread.h
+//
+// A thread that runs one job at a time for the thread that owns it.  Start() hands
+// the job over and returns right away; Wait() blocks until the job is done.  The
+// thread is created by the first Start() and lives until the object is destroyed,
+// so a job every frame does not pay for creating a thread every frame.
+//***************************************************************************************
+
+#ifndef WORKERTHREAD_H
+#define WORKERTHREAD_H
+
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+class WorkerThread
+{
+public:
+	// name labels the thread in the profiler trace and must outlive the worker.
+	explicit WorkerThread(const char* name = 0);
+	~WorkerThread();
+
+	// The previous job must have been waited for.
+	void Start(const std::function<void()>& job);
+	void Wait();
+
+private:
+	WorkerThread(const WorkerThread& rhs);
+	WorkerThread& operator=(const WorkerThread& rhs);
+
+	void ThreadMain();
+
+private:
+	const char* mName;
+
+	std::thread mThread;
+	std::mutex mMutex;
+	std::condition_variable mJobReady;
+	std::condition_variable mJobDone;
+
+	std::function<void()> mJob;
+	bool mBusy;
+	bool mQuit;
+};
+
+#endif // WORKERTHREAD_H
@@ -3,8 +3,16 @@
 //***************************************************************************************
 
 #include "d3dApp.h"
+#include "ScopeProfiler.h"
 #include <WindowsX.h>
+#include <MMSystem.h>
+#include <ShellAPI.h>
 #include <sstream>
+#include <fstream>
+#include <cmath>
+
+#pragma comment( lib, "winmm.lib" )
+#pragma comment( lib, "shell32.lib" )
 
 namespace
 {
@@ -35,15 +43,35 @@ D3DApp::D3DApp(HINSTANCE hInstance)
 	mMaximized(false),
 	mResizing(false),
 	m4xMsaaQuality(0),
+	mStatsFrameCount(0),
+	mStatsTimeElapsed(0.0f),
+	mOverlapUpdate(false),
+	mPipelinedUpdate(false),
+	mFixedTimeStep(0.0f),
+	mMaxStepsPerFrame(8),
  
 	md3dDevice(0),
 	md3dImmediateContext(0),
 	mSwapChain(0),
 	mDepthStencilBuffer(0),
 	mRenderTargetView(0),
-	mDepthStencilView(0)
+	mDepthStencilView(0),
+
+	mSimulationTime(0.0),
+	mTickAccumulator(0.0),
+	mInterpolationAlpha(1.0f),
+	mTickIndex(0),
+	mInputMode(InputLive),
+	mReplayEvent(0),
+	mReplayMouseEvent(0),
+	mReplayTickLimit(UINT_MAX),
+	mUpdateWorker("Update")
 {
 	ZeroMemory(&mScreenViewport, sizeof(D3D11_VIEWPORT));
+	ZeroMemory(mKeyState, sizeof(mKeyState));
+	ZeroMemory(mLiveKeyState, sizeof(mLiveKeyState));
+
+	mFramePacer.SetTargetFrameRate(60.0f);
 
 	// Get a pointer to the application object so we can forward 
 	// Windows messages to the object's window procedure through
@@ -86,6 +114,23 @@ int D3DApp::Run()
 	MSG msg = {0};
  
 	mTimer.Reset();
+	mFramePacer.Reset();
+
+	StartInputCapture();
+
+	// Ask for 1 ms timer resolution so the pacer's sleeps wake close to when
+	// they should and leave less time to spin.
+	timeBeginPeriod(1);
+
+	PROFILE_THREAD_NAME("Main");
+
+	// Set when the scene has already been updated for the next frame.
+	bool sceneUpdated = false;
+
+	// Pipelined mode only: whether SwapSceneState() has published any state yet,
+	// and the interpolation alpha that goes with it.
+	bool scenePublished = false;
+	float drawAlpha = 1.0f;
 
 	while(msg.message != WM_QUIT)
 	{
@@ -102,17 +147,129 @@ int D3DApp::Run()
 
 			if( !mAppPaused )
 			{
+				PROFILE_SCOPE("Frame");
+
 				CalculateFrameStats();
-				UpdateScene(mTimer.DeltaTime());	
-				DrawScene();
+
+				PollKeyboard();
+				ReplayMouseInput();
+
+				if( mPipelinedUpdate )
+				{
+					// Frame N+1 is simulated on the worker while frame N, published
+					// by the last swap, is drawn here.  Until the first tick has been
+					// published there is nothing to draw, so those frames only wait
+					// for the update.
+					if( scenePublished )
+					{
+						UINT ticks = 0;
+						mUpdateWorker.Start([this, &ticks]()
+						{
+							PROFILE_SCOPE("UpdateScene");
+							ticks = UpdateSimulation();
+						});
+						{
+							PROFILE_SCOPE("DrawScene");
+							DrawScene(drawAlpha);
+						}
+						{
+							PROFILE_SCOPE("WaitForUpdate");
+							mUpdateWorker.Wait();
+						}
+
+						if( ticks > 0 )
+							SwapSceneState();
+					}
+					else
+					{
+						// Still on the worker, so every tick draws from the same
+						// thread's rand() state.
+						UINT ticks = 0;
+						mUpdateWorker.Start([this, &ticks]()
+						{
+							PROFILE_SCOPE("UpdateScene");
+							ticks = UpdateSimulation();
+						});
+						mUpdateWorker.Wait();
+
+						if( ticks > 0 )
+						{
+							SwapSceneState();
+							scenePublished = true;
+						}
+					}
+
+					// The front state is always the latest tick, so the alpha that
+					// goes with it is the current one.
+					drawAlpha = mInterpolationAlpha;
+					{
+						PROFILE_SCOPE("WaitForNextFrame");
+						mFramePacer.WaitForNextFrame();
+					}
+				}
+				else if( mOverlapUpdate )
+				{
+					// The scene was updated at the end of the last frame, so drawing
+					// starts right at the deadline, and the update for the next frame
+					// overlaps the GPU working on this one.  The first frame, with
+					// nothing updated yet, updates before drawing instead; its delta
+					// is then used up, so the update after drawing waits a frame.
+					if( !sceneUpdated )
+					{
+						PROFILE_SCOPE("UpdateScene");
+						if( UpdateSimulation() > 0 )
+							SwapSceneState();
+					}
+					{
+						PROFILE_SCOPE("WaitForNextFrame");
+						mFramePacer.WaitForNextFrame();
+					}
+					{
+						PROFILE_SCOPE("DrawScene");
+						DrawScene(mInterpolationAlpha);
+					}
+					if( sceneUpdated )
+					{
+						PROFILE_SCOPE("UpdateScene");
+						if( UpdateSimulation() > 0 )
+							SwapSceneState();
+					}
+
+					sceneUpdated = true;
+				}
+				else
+				{
+					{
+						PROFILE_SCOPE("UpdateScene");
+						if( UpdateSimulation() > 0 )
+							SwapSceneState();
+					}
+					{
+						PROFILE_SCOPE("DrawScene");
+						DrawScene(mInterpolationAlpha);
+					}
+					{
+						PROFILE_SCOPE("WaitForNextFrame");
+						mFramePacer.WaitForNextFrame();
+					}
+				}
 			}
 			else
 			{
-				Sleep(100);
+				// Nothing to draw, so block until a message arrives instead of 
+				// polling, and start a fresh schedule once unpaused.
+				WaitMessage();
+				mFramePacer.Reset();
+				sceneUpdated = false;
 			}
         }
     }
 
+	timeEndPeriod(1);
+
+	FinishInputCapture();
+	SaveFrameStats();
+
 	return (int)msg.wParam;
 }
 
@@ -124,8 +281,15 @@ bool D3DApp::Init()
 	if(!InitDirect3D())
 		return false;
 
+	ParseCommandLine();
+
 	return true;
 }
+
+void D3DApp::DrawScene(float alpha)
+{
+	DrawScene();
+}
  
 void D3DApp::OnResize()
 {
@@ -308,19 +472,42 @@ LRESULT D3DApp::MsgProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
 		((MINMAXINFO*)lParam)->ptMinTrackSize.y = 200; 
 		return 0;
 
+	// A replay feeds the recorded mouse input from ReplayMouseInput() and ignores
+	// the real mouse.  A recording notes each message against the tick it precedes.
 	case WM_LBUTTONDOWN:
 	case WM_MBUTTONDOWN:
 	case WM_RBUTTONDOWN:
+		if( mInputMode == InputReplay )
+			return 0;
+		if( mInputMode == InputRecord )
+			mInputRecording.AddEvent(mTickIndex, InputRecording::MouseDown, (UINT)wParam, GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam));
 		OnMouseDown(wParam, GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam));
 		return 0;
 	case WM_LBUTTONUP:
 	case WM_MBUTTONUP:
 	case WM_RBUTTONUP:
+		if( mInputMode == InputReplay )
+			return 0;
+		if( mInputMode == InputRecord )
+			mInputRecording.AddEvent(mTickIndex, InputRecording::MouseUp, (UINT)wParam, GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam));
 		OnMouseUp(wParam, GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam));
 		return 0;
 	case WM_MOUSEMOVE:
+		if( mInputMode == InputReplay )
+			return 0;
+		if( mInputMode == InputRecord )
+			mInputRecording.AddEvent(mTickIndex, InputRecording::MouseMove, (UINT)wParam, GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam));
 		OnMouseMove(wParam, GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam));
 		return 0;
+
+	// F11 saves the frame statistics; every other key goes on to DefWindowProc.
+	case WM_KEYUP:
+		if( wParam == VK_F11 )
+		{
+			SaveFrameStats();
+			return 0;
+		}
+		break;
 	}
 
 	return DefWindowProc(hwnd, msg, wParam, lParam);
@@ -470,32 +657,301 @@ bool D3DApp::InitDirect3D()
 
 void D3DApp::CalculateFrameStats()
 {
-	// Code computes the average frames per second, and also the 
-	// average time it takes to render one frame.  These stats 
-	// are appended to the window caption bar.
+	// Every frame time goes to the profiler.  Once a second the average 
+	// frames per second, the average frame time, and the slow frames
+	// from the profiler are appended to the window caption bar.
 
-	static int frameCnt = 0;
-	static float timeElapsed = 0.0f;
+	mFrameProfiler.AddFrame(mTimer.DeltaTime());
 
-	frameCnt++;
+	mStatsFrameCount++;
 
 	// Compute averages over one second period.
-	if( (mTimer.TotalTime() - timeElapsed) >= 1.0f )
+	if( (mTimer.TotalTime() - mStatsTimeElapsed) >= 1.0f )
 	{
-		float fps = (float)frameCnt; // fps = frameCnt / 1
+		float fps = (float)mStatsFrameCount; // fps = frameCnt / 1
 		float mspf = 1000.0f / fps;
 
+		FrameProfiler::Stats stats = mFrameProfiler.ComputeStats();
+
 		std::wostringstream outs;   
 		outs.precision(6);
 		outs << mMainWndCaption << L"    "
 			 << L"FPS: " << fps << L"    " 
-			 << L"Frame Time: " << mspf << L" (ms)";
+			 << L"Frame Time: " << mspf << L" (ms)    "
+			 << L"p99: " << stats.P99 << L"  Max: " << stats.Max << L" (ms)";
+
+		if( mFramePacer.TargetFrameRate() > 0.0f )
+		{
+			outs << L"    Jitter: " << mFramePacer.Stats().StdDevInterval*1000.0 << L" (ms)";
+			mFramePacer.ResetStats();
+		}
+
+		AppendFrameStats(outs);
+
 		SetWindowText(mhMainWnd, outs.str().c_str());
 		
 		// Reset for next average.
-		frameCnt = 0;
-		timeElapsed += 1.0f;
+		mStatsFrameCount = 0;
+		mStatsTimeElapsed += 1.0f;
+	}
+}
+
+void D3DApp::SaveFrameStats()
+{
+	if( mFrameProfiler.TotalFrames() == 0 )
+		return;
+
+	mFrameProfiler.SaveCsv("FrameStats.csv");
+	mFrameProfiler.SaveJson("FrameStats.json");
+
+#if SCOPE_PROFILER_ENABLED
+	ScopeProfiler::SaveChromeTrace("Trace.json");
+#endif
+}
+
+bool D3DApp::IsKeyDown(int vkey)const
+{
+	return (mKeyState[vkey & 0xff] & 0x80) != 0;
+}
+
+float D3DApp::SimulationTime()const
+{
+	return (float)mSimulationTime;
+}
+
+UINT D3DApp::UpdateSimulation()
+{
+	if( mFixedTimeStep <= 0.0f )
+	{
+		BeginTick();
+		mSimulationTime = mTimer.PreciseTotalTime();
+		UpdateScene(mTimer.DeltaTime());
+		++mTickIndex;
+
+		mInterpolationAlpha = 1.0f;
+		return 1;
 	}
+
+	mTickAccumulator += mTimer.DeltaTime();
+
+	UINT steps = 0;
+	while( mTickAccumulator >= mFixedTimeStep && steps < mMaxStepsPerFrame &&
+		   mTickIndex < mReplayTickLimit )
+	{
+		BeginTick();
+		UpdateScene(mFixedTimeStep);
+		++mTickIndex;
+		++steps;
+
+		mSimulationTime  += mFixedTimeStep;
+		mTickAccumulator -= mFixedTimeStep;
+	}
+
+	// Hit the step limit: let go of the whole ticks still owed rather than carry
+	// them into the next frames, which would only hit the limit again.  Ticks
+	// held back by mReplayTickLimit are kept for the next frame instead.
+	if( steps == mMaxStepsPerFrame && mTickAccumulator >= mFixedTimeStep )
+		mTickAccumulator = std::fmod(mTickAccumulator, (double)mFixedTimeStep);
+
+	mInterpolationAlpha = (float)(mTickAccumulator / mFixedTimeStep);
+
+	return steps;
 }
 
+void D3DApp::PollKeyboard()
+{
+	if( mInputMode == InputReplay )
+		return;
 
+	// GetKeyboardState follows the keyboard messages this thread has handled, so
+	// the keys only count while the window has the focus.
+	BYTE keys[256];
+	if( !GetKeyboardState(keys) )
+		return;
+
+	for(int i = 0; i < 256; ++i)
+		mLiveKeyState[i] = keys[i] & 0x80;
+}
+
+void D3DApp::ReplayMouseInput()
+{
+	if( mInputMode != InputReplay )
+		return;
+
+	while( mReplayMouseEvent < mInputRecording.EventCount() )
+	{
+		const InputRecording::Event& e = mInputRecording.GetEvent(mReplayMouseEvent);
+
+		if( e.Type == InputRecording::KeyDown || e.Type == InputRecording::KeyUp )
+		{
+			++mReplayMouseEvent;
+			continue;
+		}
+
+		// The first mouse event still to come ends the coming update just before
+		// its tick, so it reaches the handlers between the same ticks as it did
+		// when recorded, whatever the frame times of this run.
+		if( e.Tick > mTickIndex )
+		{
+			mReplayTickLimit = e.Tick;
+			return;
+		}
+
+		switch( e.Type )
+		{
+		case InputRecording::MouseDown: OnMouseDown(e.Param, e.X, e.Y); break;
+		case InputRecording::MouseUp:   OnMouseUp(e.Param, e.X, e.Y); break;
+		case InputRecording::MouseMove: OnMouseMove(e.Param, e.X, e.Y); break;
+		default: break;
+		}
+
+		++mReplayMouseEvent;
+	}
+
+	mReplayTickLimit = UINT_MAX;
+}
+
+void D3DApp::BeginTick()
+{
+	if( mInputMode == InputReplay )
+	{
+		if( mTickIndex >= mInputRecording.TickCount() )
+		{
+			// Out of input.  Keep the keys as they were and close once.
+			if( mTickIndex == mInputRecording.TickCount() )
+				PostMessage(mhMainWnd, WM_CLOSE, 0, 0);
+			return;
+		}
+
+		// Events are sorted by tick, so everything for this tick is next in line.
+		// The mouse events were already handed out by ReplayMouseInput().
+		while( mReplayEvent < mInputRecording.EventCount() &&
+			   mInputRecording.GetEvent(mReplayEvent).Tick <= mTickIndex )
+		{
+			const InputRecording::Event& e = mInputRecording.GetEvent(mReplayEvent++);
+
+			switch( e.Type )
+			{
+			case InputRecording::KeyDown: mKeyState[e.Param & 0xff] = 0x80; break;
+			case InputRecording::KeyUp:   mKeyState[e.Param & 0xff] = 0; break;
+			default: break;
+			}
+		}
+		return;
+	}
+
+	for(int i = 0; i < 256; ++i)
+	{
+		BYTE down = mLiveKeyState[i];
+
+		if( mInputMode == InputRecord && down != mKeyState[i] )
+		{
+			mInputRecording.AddEvent(mTickIndex, 
+				down ? InputRecording::KeyDown : InputRecording::KeyUp, i);
+		}
+
+		mKeyState[i] = down;
+	}
+}
+
+void D3DApp::RecordInput(const std::wstring& filename)
+{
+	mInputMode = InputRecord;
+	mRecordFilename = filename;
+	mInputRecording.Clear();
+}
+
+bool D3DApp::ReplayInput(const std::wstring& filename)
+{
+	std::ifstream fin(filename.c_str());
+	if( !fin || !mInputRecording.Read(fin) || mInputRecording.TimeStep() <= 0.0f )
+	{
+		mInputRecording.Clear();
+		mInputMode = InputLive;
+		return false;
+	}
+
+	mInputMode = InputReplay;
+	mRecordFilename.clear();
+	return true;
+}
+
+void D3DApp::ParseCommandLine()
+{
+	int argc = 0;
+	LPWSTR* argv = CommandLineToArgvW(GetCommandLineW(), &argc);
+	if( !argv )
+		return;
+
+	for(int i = 1; i + 1 < argc; ++i)
+	{
+		std::wstring option = argv[i];
+
+		if( option == L"-record" )
+		{
+			RecordInput(argv[++i]);
+		}
+		else if( option == L"-replay" )
+		{
+			if( !ReplayInput(argv[++i]) )
+			{
+				std::wstring message = L"Could not load the input recording " + std::wstring(argv[i]) + L".";
+				MessageBox(mhMainWnd, message.c_str(), 0, 0);
+			}
+		}
+	}
+
+	LocalFree(argv);
+}
+
+void D3DApp::StartInputCapture()
+{
+	mSimulationTime = 0.0;
+	mTickAccumulator = 0.0;
+	mInterpolationAlpha = 1.0f;
+	mTickIndex = 0;
+	mReplayEvent = 0;
+	mReplayMouseEvent = 0;
+	mReplayTickLimit = UINT_MAX;
+	ZeroMemory(mKeyState, sizeof(mKeyState));
+	ZeroMemory(mLiveKeyState, sizeof(mLiveKeyState));
+
+	if( mInputMode == InputRecord )
+	{
+		// Only fixed ticks can be replayed tick for tick.
+		if( mFixedTimeStep <= 0.0f )
+			mFixedTimeStep = 1.0f / 60.0f;
+
+		mInputRecording.Clear();
+		mInputRecording.SetSeed(GetTickCount());
+		mInputRecording.SetTimeStep(mFixedTimeStep);
+	}
+	else if( mInputMode == InputReplay )
+	{
+		mFixedTimeStep = mInputRecording.TimeStep();
+	}
+
+	// Scene code draws its random numbers from rand(), so start both runs from
+	// the same seed.  The CRT keeps a rand() state per thread, and pipelined
+	// updates run on mUpdateWorker, so seed that thread too.
+	if( mInputMode != InputLive )
+	{
+		unsigned int seed = mInputRecording.Seed();
+		srand(seed);
+
+		mUpdateWorker.Start([seed]() { srand(seed); });
+		mUpdateWorker.Wait();
+	}
+}
+
+void D3DApp::FinishInputCapture()
+{
+	if( mInputMode != InputRecord )
+		return;
+
+	mInputRecording.SetTickCount(mTickIndex);
+
+	std::ofstream fout(mRecordFilename.c_str());
+	if( fout )
+		mInputRecording.Write(fout);
+}
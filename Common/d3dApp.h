@@ -13,6 +13,10 @@
 
 #include "d3dUtil.h"
 #include "GameTimer.h"
+#include "FrameProfiler.h"
+#include "FramePacer.h"
+#include "InputRecording.h"
+#include "WorkerThread.h"
 #include <string>
 
 class D3DApp
@@ -26,6 +30,12 @@ public:
 	float     AspectRatio()const;
 	
 	int Run();
+
+	// Input capture for deterministic replay.  Call before Run(), or start the
+	// application with "-record <file>" or "-replay <file>".  The recording is
+	// saved when Run() returns; a replay closes the window after its last tick.
+	void RecordInput(const std::wstring& filename);
+	bool ReplayInput(const std::wstring& filename);
  
 	// Framework methods.  Derived client class overrides these methods to 
 	// implement specific application requirements.
@@ -34,6 +44,18 @@ public:
 	virtual void OnResize(); 
 	virtual void UpdateScene(float dt)=0;
 	virtual void DrawScene()=0; 
+
+	// Called by Run() in place of DrawScene().  alpha is how far the frame lies
+	// between the last simulation tick and the next one, in [0, 1), so a derived
+	// class can blend the previous and current state.  Always 1 when the scene is
+	// updated with the variable frame time.
+	virtual void DrawScene(float alpha);
+
+	// Called by Run() after the updates for a frame, while nothing else touches the
+	// scene.  A derived class that keeps what DrawScene reads in a DoubleBuffer
+	// swaps it here.
+	virtual void SwapSceneState() { }
+
 	virtual LRESULT MsgProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam);
 
 	// Convenience overrides for handling mouse input.
@@ -41,12 +63,28 @@ public:
 	virtual void OnMouseUp(WPARAM btnState, int x, int y)  { }
 	virtual void OnMouseMove(WPARAM btnState, int x, int y){ }
 
+	// Called once a second when the frame statistics are written to the caption,
+	// so a demo can add its own counters.
+	virtual void AppendFrameStats(std::wostream& outs) { }
+
 protected:
 	bool InitMainWindow();
 	bool InitDirect3D();
 
 	void CalculateFrameStats();
 
+	// Whether a key was down at the start of the current simulation tick.  Use this
+	// instead of GetAsyncKeyState so the key presses are recorded and replayed.
+	bool IsKeyDown(int vkey)const;
+
+	// Seconds of simulated time.  Advances by whole ticks with a fixed time step.
+	float SimulationTime()const;
+
+	// Writes the recorded frame times to FrameStats.csv and FrameStats.json, and the
+	// profiled scopes to Trace.json.  Called when the message loop exits and when F11
+	// is released.
+	void SaveFrameStats();
+
 protected:
 
 	HINSTANCE mhAppInst;
@@ -59,6 +97,32 @@ protected:
 
 	GameTimer mTimer;
 
+	FrameProfiler mFrameProfiler;
+	int mStatsFrameCount;
+	float mStatsTimeElapsed;
+
+	// Paces Run() to 60 frames per second by default.  Derived class can change the
+	// target, or set it to 0 to run as fast as possible.
+	FramePacer mFramePacer;
+
+	// When set, Run() draws each frame as soon as its deadline comes up and then
+	// updates the scene for the next frame, so the update overlaps the GPU work.
+	bool mOverlapUpdate;
+
+	// When set, Run() updates the scene for the next frame on a worker thread while
+	// DrawScene records the current one, and mOverlapUpdate is ignored.  UpdateScene
+	// then must not use the device context, and DrawScene must only read the state
+	// published by SwapSceneState().  Mouse and key handlers run on the main thread
+	// while the worker is idle, in a replay too.
+	bool mPipelinedUpdate;
+
+	// Seconds per simulation tick.  0 updates the scene once per frame with the
+	// frame time; otherwise UpdateScene is called with this step as many times as
+	// the elapsed time allows, but at most mMaxStepsPerFrame times per frame so a
+	// slow update cannot fall further and further behind.
+	float mFixedTimeStep;
+	UINT mMaxStepsPerFrame;
+
 	ID3D11Device* md3dDevice;
 	ID3D11DeviceContext* md3dImmediateContext;
 	IDXGISwapChain* mSwapChain;
@@ -73,6 +137,53 @@ protected:
 	int mClientWidth;
 	int mClientHeight;
 	bool mEnable4xMsaa;
+
+private:
+	// Runs UpdateScene for as many ticks as the elapsed time covers.  Returns the
+	// number of ticks.
+	UINT UpdateSimulation();
+
+	// Reads the keyboard for the ticks of the coming update.  GetKeyboardState 
+	// works per thread, so this runs on the main thread even when the update
+	// does not.
+	void PollKeyboard();
+
+	// Hands the replayed mouse events due by the next tick to the mouse handlers,
+	// on the main thread, and stops the coming update at the tick of the next
+	// one.  Does nothing unless replaying.
+	void ReplayMouseInput();
+
+	// Latches the keys for the next tick, from the keyboard or the replay.
+	void BeginTick();
+
+	void ParseCommandLine();
+	void StartInputCapture();
+	void FinishInputCapture();
+
+private:
+	double mSimulationTime;
+	double mTickAccumulator;
+	float mInterpolationAlpha;
+	UINT mTickIndex;
+
+	BYTE mKeyState[256];
+	BYTE mLiveKeyState[256];
+
+	WorkerThread mUpdateWorker;
+
+	enum InputMode
+	{
+		InputLive,
+		InputRecord,
+		InputReplay
+	};
+
+	InputMode mInputMode;
+	std::wstring mRecordFilename;
+	InputRecording mInputRecording;
+	UINT mReplayEvent;
+	UINT mReplayMouseEvent;
+	UINT mReplayTickLimit;
 };
 
 #endif // D3DAPP_H
\ No newline at end of file
@@ -10,6 +10,7 @@
 //#include "DXUT.h"
 #include <Windows.h>
 #include <cfloat>
+#include <thread>
 #include "xnacollision.h"
 
 namespace XNA
@@ -164,26 +165,29 @@ static inline XMVECTOR PointOnPlaneInsideTriangle( FXMVECTOR P, FXMVECTOR V0, FX
 
 
 //-----------------------------------------------------------------------------
-// Find the approximate smallest enclosing bounding sphere for a set of 
-// points. Exact computation of the smallest enclosing bounding sphere is 
-// possible but is slower and requires a more complex algorithm.
-// The algorithm is based on  Jack Ritter, "An Efficient Bounding Sphere", 
-// Graphics Gems.
+// Return the address of point i of an array of points Stride bytes apart.
 //-----------------------------------------------------------------------------
-VOID ComputeBoundingSphereFromPoints( Sphere* pOut, UINT Count, const XMFLOAT3* pPoints, UINT Stride )
+static inline const XMFLOAT3* GetStridedPoint( const XMFLOAT3* pPoints, UINT i, UINT Stride )
 {
-    XMASSERT( pOut );
-    XMASSERT( Count > 0 );
-    XMASSERT( pPoints );
+    return ( const XMFLOAT3* )( ( const BYTE* )pPoints + ( SIZE_T )i * Stride );
+}
 
-    // Find the points with minimum and maximum x, y, and z
+
+
+//-----------------------------------------------------------------------------
+// Find the points with the minimum and maximum x, y, and z among Count points
+// starting at First. pExtremes receives MinX, MaxX, MinY, MaxY, MinZ, MaxZ.
+//-----------------------------------------------------------------------------
+static inline VOID ComputeExtremePoints( const XMFLOAT3* pPoints, UINT First, UINT Count, UINT Stride,
+                                         XMVECTOR* pExtremes )
+{
     XMVECTOR MinX, MaxX, MinY, MaxY, MinZ, MaxZ;
 
-    MinX = MaxX = MinY = MaxY = MinZ = MaxZ = XMLoadFloat3( pPoints );
+    MinX = MaxX = MinY = MaxY = MinZ = MaxZ = XMLoadFloat3( GetStridedPoint( pPoints, First, Stride ) );
 
-    for( UINT i = 1; i < Count; i++ )
+    for( UINT i = First + 1; i < First + Count; i++ )
     {
-        XMVECTOR Point = XMLoadFloat3( ( XMFLOAT3* )( ( BYTE* )pPoints + i * Stride ) );
+        XMVECTOR Point = XMLoadFloat3( GetStridedPoint( pPoints, i, Stride ) );
 
         float px = XMVectorGetX( Point );
         float py = XMVectorGetY( Point );
@@ -208,7 +212,25 @@ VOID ComputeBoundingSphereFromPoints( Sphere* pOut, UINT Count, const XMFLOAT3*
             MaxZ = Point;
     }
 
-    // Use the min/max pair that are farthest apart to form the initial sphere.
+    pExtremes[0] = MinX;
+    pExtremes[1] = MaxX;
+    pExtremes[2] = MinY;
+    pExtremes[3] = MaxY;
+    pExtremes[4] = MinZ;
+    pExtremes[5] = MaxZ;
+}
+
+
+
+//-----------------------------------------------------------------------------
+// Use the min/max pair that are farthest apart to form the initial sphere.
+//-----------------------------------------------------------------------------
+static inline VOID ComputeSphereFromExtremePoints( const XMVECTOR* pExtremes, XMVECTOR* pCenter, XMVECTOR* pRadius )
+{
+    XMVECTOR MinX = pExtremes[0], MaxX = pExtremes[1];
+    XMVECTOR MinY = pExtremes[2], MaxY = pExtremes[3];
+    XMVECTOR MinZ = pExtremes[4], MaxZ = pExtremes[5];
+
     XMVECTOR DeltaX = MaxX - MinX;
     XMVECTOR DistX = XMVector3Length( DeltaX );
 
@@ -218,22 +240,19 @@ VOID ComputeBoundingSphereFromPoints( Sphere* pOut, UINT Count, const XMFLOAT3*
     XMVECTOR DeltaZ = MaxZ - MinZ;
     XMVECTOR DistZ = XMVector3Length( DeltaZ );
 
-    XMVECTOR Center;
-    XMVECTOR Radius;
-
     if( XMVector3Greater( DistX, DistY ) )
     {
         if( XMVector3Greater( DistX, DistZ ) )
         {
             // Use min/max x.
-            Center = ( MaxX + MinX ) * 0.5f;
-            Radius = DistX * 0.5f;
+            *pCenter = ( MaxX + MinX ) * 0.5f;
+            *pRadius = DistX * 0.5f;
         }
         else
         {
             // Use min/max z.
-            Center = ( MaxZ + MinZ ) * 0.5f;
-            Radius = DistZ * 0.5f;
+            *pCenter = ( MaxZ + MinZ ) * 0.5f;
+            *pRadius = DistZ * 0.5f;
         }
     }
     else // Y >= X
@@ -241,21 +260,33 @@ VOID ComputeBoundingSphereFromPoints( Sphere* pOut, UINT Count, const XMFLOAT3*
         if( XMVector3Greater( DistY, DistZ ) )
         {
             // Use min/max y.
-            Center = ( MaxY + MinY ) * 0.5f;
-            Radius = DistY * 0.5f;
+            *pCenter = ( MaxY + MinY ) * 0.5f;
+            *pRadius = DistY * 0.5f;
         }
         else
         {
             // Use min/max z.
-            Center = ( MaxZ + MinZ ) * 0.5f;
-            Radius = DistZ * 0.5f;
+            *pCenter = ( MaxZ + MinZ ) * 0.5f;
+            *pRadius = DistZ * 0.5f;
         }
     }
+}
 
-    // Add any points not inside the sphere.
-    for( UINT i = 0; i < Count; i++ )
+
+
+//-----------------------------------------------------------------------------
+// Grow the sphere to include any of the Count points starting at First that 
+// are not inside it.
+//-----------------------------------------------------------------------------
+static inline VOID GrowSphereToPoints( const XMFLOAT3* pPoints, UINT First, UINT Count, UINT Stride,
+                                       XMVECTOR* pCenter, XMVECTOR* pRadius )
+{
+    XMVECTOR Center = *pCenter;
+    XMVECTOR Radius = *pRadius;
+
+    for( UINT i = First; i < First + Count; i++ )
     {
-        XMVECTOR Point = XMLoadFloat3( ( XMFLOAT3* )( ( BYTE* )pPoints + i * Stride ) );
+        XMVECTOR Point = XMLoadFloat3( GetStridedPoint( pPoints, i, Stride ) );
 
         XMVECTOR Delta = Point - Center;
 
@@ -269,6 +300,75 @@ VOID ComputeBoundingSphereFromPoints( Sphere* pOut, UINT Count, const XMFLOAT3*
         }
     }
 
+    *pCenter = Center;
+    *pRadius = Radius;
+}
+
+
+
+//-----------------------------------------------------------------------------
+// Find the minimum and maximum x, y, and z of Count points starting at First.
+// Two sets of accumulators are used so that consecutive points do not wait on
+// each other's min/max.
+//-----------------------------------------------------------------------------
+static inline VOID ComputePointsMinMax( const XMFLOAT3* pPoints, UINT First, UINT Count, UINT Stride,
+                                        XMVECTOR* pMin, XMVECTOR* pMax )
+{
+    XMVECTOR vMin0, vMax0, vMin1, vMax1;
+
+    vMin0 = vMax0 = vMin1 = vMax1 = XMLoadFloat3( GetStridedPoint( pPoints, First, Stride ) );
+
+    UINT i = First + 1;
+
+    for( ; i + 1 < First + Count; i += 2 )
+    {
+        XMVECTOR Point0 = XMLoadFloat3( GetStridedPoint( pPoints, i, Stride ) );
+        XMVECTOR Point1 = XMLoadFloat3( GetStridedPoint( pPoints, i + 1, Stride ) );
+
+        vMin0 = XMVectorMin( vMin0, Point0 );
+        vMax0 = XMVectorMax( vMax0, Point0 );
+        vMin1 = XMVectorMin( vMin1, Point1 );
+        vMax1 = XMVectorMax( vMax1, Point1 );
+    }
+
+    if( i < First + Count )
+    {
+        XMVECTOR Point = XMLoadFloat3( GetStridedPoint( pPoints, i, Stride ) );
+
+        vMin0 = XMVectorMin( vMin0, Point );
+        vMax0 = XMVectorMax( vMax0, Point );
+    }
+
+    *pMin = XMVectorMin( vMin0, vMin1 );
+    *pMax = XMVectorMax( vMax0, vMax1 );
+}
+
+
+
+//-----------------------------------------------------------------------------
+// Find the approximate smallest enclosing bounding sphere for a set of 
+// points. Exact computation of the smallest enclosing bounding sphere is 
+// possible but is slower and requires a more complex algorithm.
+// The algorithm is based on  Jack Ritter, "An Efficient Bounding Sphere", 
+// Graphics Gems.
+//-----------------------------------------------------------------------------
+VOID ComputeBoundingSphereFromPoints( Sphere* pOut, UINT Count, const XMFLOAT3* pPoints, UINT Stride )
+{
+    XMASSERT( pOut );
+    XMASSERT( Count > 0 );
+    XMASSERT( pPoints );
+
+    // Find the points with minimum and maximum x, y, and z
+    XMVECTOR Extremes[6];
+    ComputeExtremePoints( pPoints, 0, Count, Stride, Extremes );
+
+    XMVECTOR Center;
+    XMVECTOR Radius;
+    ComputeSphereFromExtremePoints( Extremes, &Center, &Radius );
+
+    // Add any points not inside the sphere.
+    GrowSphereToPoints( pPoints, 0, Count, Stride, &Center, &Radius );
+
     XMStoreFloat3( &pOut->Center, Center );
     XMStoreFloat( &pOut->Radius, Radius );
 
@@ -288,16 +388,7 @@ VOID ComputeBoundingAxisAlignedBoxFromPoints( AxisAlignedBox* pOut, UINT Count,
 
     // Find the minimum and maximum x, y, and z
     XMVECTOR vMin, vMax;
-
-    vMin = vMax = XMLoadFloat3( pPoints );
-
-    for( UINT i = 1; i < Count; i++ )
-    {
-        XMVECTOR Point = XMLoadFloat3( ( XMFLOAT3* )( ( BYTE* )pPoints + i * Stride ) );
-
-        vMin = XMVectorMin( vMin, Point );
-        vMax = XMVectorMax( vMax, Point );
-    }
+    ComputePointsMinMax( pPoints, 0, Count, Stride, &vMin, &vMax );
 
     // Store center and extents.
     XMStoreFloat3( &pOut->Center, ( vMin + vMax ) * 0.5f );
@@ -549,17 +640,29 @@ static inline BOOL CalculateEigenVectorsFromCovarianceMatrix( FLOAT Cxx, FLOAT C
 
 
 //-----------------------------------------------------------------------------
-// Find the approximate minimum oriented bounding box containing a set of 
-// points.  Exact computation of minimum oriented bounding box is possible but 
-// is slower and requires a more complex algorithm.
-// The algorithm works by computing the inertia tensor of the points and then
-// using the eigenvectors of the intertia tensor as the axes of the box.
-// Computing the intertia tensor of the convex hull of the points will usually 
-// result in better bounding box but the computation is more complex. 
-// Exact computation of the minimum oriented bounding box is possible but the
-// best know algorithm is O(N^3) and is significanly more complex to implement.
+// Return the sum of Count points starting at First.
 //-----------------------------------------------------------------------------
-VOID ComputeBoundingOrientedBoxFromPoints( OrientedBox* pOut, UINT Count, const XMFLOAT3* pPoints, UINT Stride )
+static inline XMVECTOR SumPoints( const XMFLOAT3* pPoints, UINT First, UINT Count, UINT Stride )
+{
+    XMVECTOR Sum = XMVectorZero();
+
+    for( UINT i = First; i < First + Count; i++ )
+    {
+        Sum += XMLoadFloat3( GetStridedPoint( pPoints, i, Stride ) );
+    }
+
+    return Sum;
+}
+
+
+
+//-----------------------------------------------------------------------------
+// Accumulate the inertia tensor of Count points starting at First around the
+// center of mass. The diagonal goes to XX_YY_ZZ and the off diagonal terms to
+// XY_XZ_YZ.
+//-----------------------------------------------------------------------------
+static inline VOID ComputePointsCovariance( const XMFLOAT3* pPoints, UINT First, UINT Count, UINT Stride,
+                                            FXMVECTOR CenterOfMass, XMVECTOR* pXX_YY_ZZ, XMVECTOR* pXY_XZ_YZ )
 {
     static CONST XMVECTORI32 PermuteXXY =
                  {
@@ -570,31 +673,12 @@ VOID ComputeBoundingOrientedBoxFromPoints( OrientedBox* pOut, UINT Count, const
                     XM_PERMUTE_0Y, XM_PERMUTE_0Z, XM_PERMUTE_0Z, XM_PERMUTE_0W
                  };
 
-    XMASSERT( pOut );
-    XMASSERT( Count > 0 );
-    XMASSERT( pPoints );
-
-    XMVECTOR CenterOfMass = XMVectorZero();
-
-    // Compute the center of mass and inertia tensor of the points.
-    for( UINT i = 0; i < Count; i++ )
-    {
-        XMVECTOR Point = XMLoadFloat3( ( XMFLOAT3* )( ( BYTE* )pPoints + i * Stride ) );
-
-        CenterOfMass += Point;
-    }
-
-    CenterOfMass *= XMVectorReciprocal( XMVectorReplicate( FLOAT( Count ) ) );
-
-    // Compute the inertia tensor of the points around the center of mass.
-    // Using the center of mass is not strictly necessary, but will hopefully
-    // improve the stability of finding the eigenvectors.
     XMVECTOR XX_YY_ZZ = XMVectorZero();
     XMVECTOR XY_XZ_YZ = XMVectorZero();
 
-    for( UINT i = 0; i < Count; i++ )
+    for( UINT i = First; i < First + Count; i++ )
     {
-        XMVECTOR Point = XMLoadFloat3( ( XMFLOAT3* )( ( BYTE* )pPoints + i * Stride ) ) - CenterOfMass;
+        XMVECTOR Point = XMLoadFloat3( GetStridedPoint( pPoints, i, Stride ) ) - CenterOfMass;
 
         XX_YY_ZZ += Point * Point;
 
@@ -604,6 +688,19 @@ VOID ComputeBoundingOrientedBoxFromPoints( OrientedBox* pOut, UINT Count, const
         XY_XZ_YZ += XXY * YZZ;
     }
 
+    *pXX_YY_ZZ = XX_YY_ZZ;
+    *pXY_XZ_YZ = XY_XZ_YZ;
+}
+
+
+
+//-----------------------------------------------------------------------------
+// Build the rotation of an oriented box from the eigenvectors of the inertia 
+// tensor of its points. Returns the rotation matrix (box -> world) and the
+// matching unit quaternion in pOrientation.
+//-----------------------------------------------------------------------------
+static inline XMMATRIX ComputeRotationFromCovariance( FXMVECTOR XX_YY_ZZ, FXMVECTOR XY_XZ_YZ, XMVECTOR* pOrientation )
+{
     XMVECTOR v1, v2, v3;
 
     // Compute the eigenvectors of the inertia tensor.
@@ -645,26 +742,389 @@ VOID ComputeBoundingOrientedBoxFromPoints( OrientedBox* pOut, UINT Count, const
     // Make sure it is normal (in case the vectors are slightly non-orthogonal).
     Orientation = XMQuaternionNormalize( Orientation );
 
+    *pOrientation = Orientation;
+
     // Rebuild the rotation matrix from the quaternion.
-    R = XMMatrixRotationQuaternion( Orientation );
+    return XMMatrixRotationQuaternion( Orientation );
+}
 
-    // Build the rotation into the rotated space.
-    XMMATRIX InverseR = XMMatrixTranspose( R );
 
-    // Find the minimum OBB using the eigenvectors as the axes.
+
+//-----------------------------------------------------------------------------
+// Find the minimum and maximum x, y, and z of Count points starting at First
+// after rotating them by InverseR.
+//-----------------------------------------------------------------------------
+static inline VOID ComputeRotatedPointsMinMax( const XMFLOAT3* pPoints, UINT First, UINT Count, UINT Stride,
+                                               CXMMATRIX InverseR, XMVECTOR* pMin, XMVECTOR* pMax )
+{
     XMVECTOR vMin, vMax;
 
-    vMin = vMax = XMVector3TransformNormal( XMLoadFloat3( pPoints ), InverseR );
+    vMin = vMax = XMVector3TransformNormal( XMLoadFloat3( GetStridedPoint( pPoints, First, Stride ) ), InverseR );
 
-    for( UINT i = 1; i < Count; i++ )
+    for( UINT i = First + 1; i < First + Count; i++ )
     {
-        XMVECTOR Point = XMVector3TransformNormal( XMLoadFloat3( ( XMFLOAT3* )( ( BYTE* )pPoints + i * Stride ) ),
+        XMVECTOR Point = XMVector3TransformNormal( XMLoadFloat3( GetStridedPoint( pPoints, i, Stride ) ),
                                                    InverseR );
 
         vMin = XMVectorMin( vMin, Point );
         vMax = XMVectorMax( vMax, Point );
     }
 
+    *pMin = vMin;
+    *pMax = vMax;
+}
+
+
+
+//-----------------------------------------------------------------------------
+// Find the approximate minimum oriented bounding box containing a set of 
+// points.  Exact computation of minimum oriented bounding box is possible but 
+// is slower and requires a more complex algorithm.
+// The algorithm works by computing the inertia tensor of the points and then
+// using the eigenvectors of the intertia tensor as the axes of the box.
+// Computing the intertia tensor of the convex hull of the points will usually 
+// result in better bounding box but the computation is more complex. 
+// Exact computation of the minimum oriented bounding box is possible but the
+// best know algorithm is O(N^3) and is significanly more complex to implement.
+//-----------------------------------------------------------------------------
+VOID ComputeBoundingOrientedBoxFromPoints( OrientedBox* pOut, UINT Count, const XMFLOAT3* pPoints, UINT Stride )
+{
+    XMASSERT( pOut );
+    XMASSERT( Count > 0 );
+    XMASSERT( pPoints );
+
+    // Compute the center of mass and inertia tensor of the points.
+    XMVECTOR CenterOfMass = SumPoints( pPoints, 0, Count, Stride );
+
+    CenterOfMass *= XMVectorReciprocal( XMVectorReplicate( FLOAT( Count ) ) );
+
+    // Compute the inertia tensor of the points around the center of mass.
+    // Using the center of mass is not strictly necessary, but will hopefully
+    // improve the stability of finding the eigenvectors.
+    XMVECTOR XX_YY_ZZ, XY_XZ_YZ;
+    ComputePointsCovariance( pPoints, 0, Count, Stride, CenterOfMass, &XX_YY_ZZ, &XY_XZ_YZ );
+
+    XMVECTOR Orientation;
+    XMMATRIX R = ComputeRotationFromCovariance( XX_YY_ZZ, XY_XZ_YZ, &Orientation );
+
+    // Build the rotation into the rotated space.
+    XMMATRIX InverseR = XMMatrixTranspose( R );
+
+    // Find the minimum OBB using the eigenvectors as the axes.
+    XMVECTOR vMin, vMax;
+    ComputeRotatedPointsMinMax( pPoints, 0, Count, Stride, InverseR, &vMin, &vMax );
+
+    // Rotate the center into world space.
+    XMVECTOR Center = ( vMin + vMax ) * 0.5f;
+    Center = XMVector3TransformNormal( Center, R );
+
+    // Store center, extents, and orientation.
+    XMStoreFloat3( &pOut->Center, Center );
+    XMStoreFloat3( &pOut->Extents, ( vMax - vMin ) * 0.5f );
+    XMStoreFloat4( &pOut->Orientation, Orientation );
+
+    return;
+}
+
+
+
+//-----------------------------------------------------------------------------
+// Work splitting for the parallel bounding volume routines. Every chunk gets
+// at least ParallelBoundsMinPoints points and there is at most one chunk
+// per hardware thread. Chunk 0 runs on the calling thread.
+//-----------------------------------------------------------------------------
+static const UINT ParallelBoundsMaxChunks = 32;
+
+static inline UINT GetParallelBoundsChunkCount( UINT Count )
+{
+    UINT Threads = std::thread::hardware_concurrency();
+    UINT Chunks = Count / ParallelBoundsMinPoints;
+
+    if( Chunks > Threads )
+        Chunks = Threads;
+
+    if( Chunks > ParallelBoundsMaxChunks )
+        Chunks = ParallelBoundsMaxChunks;
+
+    return ( Chunks > 1 ) ? Chunks : 1;
+}
+
+static inline UINT GetParallelBoundsChunkStart( UINT Chunk, UINT ChunkCount, UINT Count )
+{
+    return ( UINT )( ( UINT64 )Count * Chunk / ChunkCount );
+}
+
+template<typename ChunkFunc>
+static inline VOID RunParallelBoundsChunks( UINT ChunkCount, UINT Count, ChunkFunc& Func )
+{
+    std::thread Workers[ParallelBoundsMaxChunks];
+
+    for( UINT c = 1; c < ChunkCount; c++ )
+    {
+        UINT First = GetParallelBoundsChunkStart( c, ChunkCount, Count );
+        UINT Size = GetParallelBoundsChunkStart( c + 1, ChunkCount, Count ) - First;
+
+        Workers[c] = std::thread( [&Func, c, First, Size]() { Func( c, First, Size ); } );
+    }
+
+    Func( 0, 0, GetParallelBoundsChunkStart( 1, ChunkCount, Count ) );
+
+    for( UINT c = 1; c < ChunkCount; c++ )
+    {
+        Workers[c].join();
+    }
+}
+
+
+
+//-----------------------------------------------------------------------------
+// Parallel version of ComputeBoundingSphereFromPoints. The extreme points are
+// found exactly as in the serial version; each chunk then grows its own copy
+// of the initial sphere and the chunk spheres are merged.
+//-----------------------------------------------------------------------------
+VOID ComputeBoundingSphereFromPointsParallel( Sphere* pOut, UINT Count, const XMFLOAT3* pPoints, UINT Stride )
+{
+    XMASSERT( pOut );
+    XMASSERT( Count > 0 );
+    XMASSERT( pPoints );
+
+    UINT ChunkCount = GetParallelBoundsChunkCount( Count );
+
+    if( ChunkCount == 1 )
+    {
+        ComputeBoundingSphereFromPoints( pOut, Count, pPoints, Stride );
+        return;
+    }
+
+    XMFLOAT3 ChunkExtremes[ParallelBoundsMaxChunks][6];
+
+    auto ExtremesChunk = [&]( UINT Chunk, UINT First, UINT Size )
+    {
+        XMVECTOR Extremes[6];
+        ComputeExtremePoints( pPoints, First, Size, Stride, Extremes );
+
+        for( UINT i = 0; i < 6; i++ )
+            XMStoreFloat3( &ChunkExtremes[Chunk][i], Extremes[i] );
+    };
+
+    RunParallelBoundsChunks( ChunkCount, Count, ExtremesChunk );
+
+    // Merge in chunk order so ties pick the same point as the serial version.
+    XMFLOAT3 Extremes[6];
+
+    for( UINT i = 0; i < 6; i++ )
+        Extremes[i] = ChunkExtremes[0][i];
+
+    for( UINT c = 1; c < ChunkCount; c++ )
+    {
+        for( UINT Axis = 0; Axis < 3; Axis++ )
+        {
+            const XMFLOAT3& MinPoint = ChunkExtremes[c][Axis * 2];
+            const XMFLOAT3& MaxPoint = ChunkExtremes[c][Axis * 2 + 1];
+
+            if( ( &MinPoint.x )[Axis] < ( &Extremes[Axis * 2].x )[Axis] )
+                Extremes[Axis * 2] = MinPoint;
+
+            if( ( &MaxPoint.x )[Axis] > ( &Extremes[Axis * 2 + 1].x )[Axis] )
+                Extremes[Axis * 2 + 1] = MaxPoint;
+        }
+    }
+
+    XMVECTOR ExtremePoints[6];
+
+    for( UINT i = 0; i < 6; i++ )
+        ExtremePoints[i] = XMLoadFloat3( &Extremes[i] );
+
+    XMVECTOR InitialCenter;
+    XMVECTOR InitialRadius;
+    ComputeSphereFromExtremePoints( ExtremePoints, &InitialCenter, &InitialRadius );
+
+    Sphere ChunkSpheres[ParallelBoundsMaxChunks];
+
+    auto GrowChunk = [&]( UINT Chunk, UINT First, UINT Size )
+    {
+        XMVECTOR Center = InitialCenter;
+        XMVECTOR Radius = InitialRadius;
+        GrowSphereToPoints( pPoints, First, Size, Stride, &Center, &Radius );
+
+        XMStoreFloat3( &ChunkSpheres[Chunk].Center, Center );
+        XMStoreFloat( &ChunkSpheres[Chunk].Radius, Radius );
+    };
+
+    RunParallelBoundsChunks( ChunkCount, Count, GrowChunk );
+
+    // Every chunk sphere contains the initial sphere, so merging them only ever
+    // grows it a little.
+    XMVECTOR Center = XMLoadFloat3( &ChunkSpheres[0].Center );
+    XMVECTOR Radius = XMVectorReplicate( ChunkSpheres[0].Radius );
+
+    for( UINT c = 1; c < ChunkCount; c++ )
+    {
+        XMVECTOR ChunkCenter = XMLoadFloat3( &ChunkSpheres[c].Center );
+        XMVECTOR ChunkRadius = XMVectorReplicate( ChunkSpheres[c].Radius );
+
+        XMVECTOR Delta = ChunkCenter - Center;
+        XMVECTOR Dist = XMVector3Length( Delta );
+
+        // Chunk sphere is already inside.
+        if( XMVector3LessOrEqual( Dist + ChunkRadius, Radius ) )
+            continue;
+
+        // Chunk sphere contains the merged sphere.
+        if( XMVector3LessOrEqual( Dist + Radius, ChunkRadius ) )
+        {
+            Center = ChunkCenter;
+            Radius = ChunkRadius;
+            continue;
+        }
+
+        XMVECTOR NewRadius = ( Radius + ChunkRadius + Dist ) * 0.5f;
+        Center += Delta * ( ( NewRadius - Radius ) * XMVectorReciprocal( Dist ) );
+        Radius = NewRadius;
+    }
+
+    XMStoreFloat3( &pOut->Center, Center );
+    XMStoreFloat( &pOut->Radius, Radius );
+
+    return;
+}
+
+
+
+//-----------------------------------------------------------------------------
+// Parallel version of ComputeBoundingAxisAlignedBoxFromPoints.
+//-----------------------------------------------------------------------------
+VOID ComputeBoundingAxisAlignedBoxFromPointsParallel( AxisAlignedBox* pOut, UINT Count, const XMFLOAT3* pPoints,
+                                                      UINT Stride )
+{
+    XMASSERT( pOut );
+    XMASSERT( Count > 0 );
+    XMASSERT( pPoints );
+
+    UINT ChunkCount = GetParallelBoundsChunkCount( Count );
+
+    if( ChunkCount == 1 )
+    {
+        ComputeBoundingAxisAlignedBoxFromPoints( pOut, Count, pPoints, Stride );
+        return;
+    }
+
+    XMFLOAT3 ChunkMin[ParallelBoundsMaxChunks];
+    XMFLOAT3 ChunkMax[ParallelBoundsMaxChunks];
+
+    auto MinMaxChunk = [&]( UINT Chunk, UINT First, UINT Size )
+    {
+        XMVECTOR vMin, vMax;
+        ComputePointsMinMax( pPoints, First, Size, Stride, &vMin, &vMax );
+
+        XMStoreFloat3( &ChunkMin[Chunk], vMin );
+        XMStoreFloat3( &ChunkMax[Chunk], vMax );
+    };
+
+    RunParallelBoundsChunks( ChunkCount, Count, MinMaxChunk );
+
+    XMVECTOR vMin = XMLoadFloat3( &ChunkMin[0] );
+    XMVECTOR vMax = XMLoadFloat3( &ChunkMax[0] );
+
+    for( UINT c = 1; c < ChunkCount; c++ )
+    {
+        vMin = XMVectorMin( vMin, XMLoadFloat3( &ChunkMin[c] ) );
+        vMax = XMVectorMax( vMax, XMLoadFloat3( &ChunkMax[c] ) );
+    }
+
+    // Store center and extents.
+    XMStoreFloat3( &pOut->Center, ( vMin + vMax ) * 0.5f );
+    XMStoreFloat3( &pOut->Extents, ( vMax - vMin ) * 0.5f );
+
+    return;
+}
+
+
+
+//-----------------------------------------------------------------------------
+// Parallel version of ComputeBoundingOrientedBoxFromPoints. The center of
+// mass, the inertia tensor and the extents along the eigenvectors are each
+// reduced across the chunks; only the eigen solve runs on one thread.
+//-----------------------------------------------------------------------------
+VOID ComputeBoundingOrientedBoxFromPointsParallel( OrientedBox* pOut, UINT Count, const XMFLOAT3* pPoints, UINT Stride )
+{
+    XMASSERT( pOut );
+    XMASSERT( Count > 0 );
+    XMASSERT( pPoints );
+
+    UINT ChunkCount = GetParallelBoundsChunkCount( Count );
+
+    if( ChunkCount == 1 )
+    {
+        ComputeBoundingOrientedBoxFromPoints( pOut, Count, pPoints, Stride );
+        return;
+    }
+
+    XMFLOAT3 ChunkA[ParallelBoundsMaxChunks];
+    XMFLOAT3 ChunkB[ParallelBoundsMaxChunks];
+
+    // Center of mass.
+    auto SumChunk = [&]( UINT Chunk, UINT First, UINT Size )
+    {
+        XMStoreFloat3( &ChunkA[Chunk], SumPoints( pPoints, First, Size, Stride ) );
+    };
+
+    RunParallelBoundsChunks( ChunkCount, Count, SumChunk );
+
+    XMVECTOR CenterOfMass = XMVectorZero();
+
+    for( UINT c = 0; c < ChunkCount; c++ )
+        CenterOfMass += XMLoadFloat3( &ChunkA[c] );
+
+    CenterOfMass *= XMVectorReciprocal( XMVectorReplicate( FLOAT( Count ) ) );
+
+    // Inertia tensor around the center of mass.
+    auto CovarianceChunk = [&]( UINT Chunk, UINT First, UINT Size )
+    {
+        XMVECTOR XX_YY_ZZ, XY_XZ_YZ;
+        ComputePointsCovariance( pPoints, First, Size, Stride, CenterOfMass, &XX_YY_ZZ, &XY_XZ_YZ );
+
+        XMStoreFloat3( &ChunkA[Chunk], XX_YY_ZZ );
+        XMStoreFloat3( &ChunkB[Chunk], XY_XZ_YZ );
+    };
+
+    RunParallelBoundsChunks( ChunkCount, Count, CovarianceChunk );
+
+    XMVECTOR XX_YY_ZZ = XMVectorZero();
+    XMVECTOR XY_XZ_YZ = XMVectorZero();
+
+    for( UINT c = 0; c < ChunkCount; c++ )
+    {
+        XX_YY_ZZ += XMLoadFloat3( &ChunkA[c] );
+        XY_XZ_YZ += XMLoadFloat3( &ChunkB[c] );
+    }
+
+    XMVECTOR Orientation;
+    XMMATRIX R = ComputeRotationFromCovariance( XX_YY_ZZ, XY_XZ_YZ, &Orientation );
+
+    XMMATRIX InverseR = XMMatrixTranspose( R );
+
+    // Extents along the eigenvectors.
+    auto MinMaxChunk = [&]( UINT Chunk, UINT First, UINT Size )
+    {
+        XMVECTOR vMin, vMax;
+        ComputeRotatedPointsMinMax( pPoints, First, Size, Stride, InverseR, &vMin, &vMax );
+
+        XMStoreFloat3( &ChunkA[Chunk], vMin );
+        XMStoreFloat3( &ChunkB[Chunk], vMax );
+    };
+
+    RunParallelBoundsChunks( ChunkCount, Count, MinMaxChunk );
+
+    XMVECTOR vMin = XMLoadFloat3( &ChunkA[0] );
+    XMVECTOR vMax = XMLoadFloat3( &ChunkB[0] );
+
+    for( UINT c = 1; c < ChunkCount; c++ )
+    {
+        vMin = XMVectorMin( vMin, XMLoadFloat3( &ChunkA[c] ) );
+        vMax = XMVectorMax( vMax, XMLoadFloat3( &ChunkB[c] ) );
+    }
+
     // Rotate the center into world space.
     XMVECTOR Center = ( vMin + vMax ) * 0.5f;
     Center = XMVector3TransformNormal( Center, R );
@@ -3646,6 +4106,274 @@ INT IntersectFrustum6Planes( const Frustum* pVolume, FXMVECTOR Plane0, FXMVECTOR
 
 
 
+//-----------------------------------------------------------------------------
+// Gather the sign bits of the four elements of a comparison result into the
+// low four bits of an integer (element 0 in bit 0).
+//-----------------------------------------------------------------------------
+static inline UINT XMVectorSignMask( FXMVECTOR V )
+{
+#if defined(_XM_SSE_INTRINSICS_) && !defined(_XM_NO_INTRINSICS_)
+    return ( UINT )_mm_movemask_ps( V );
+#else
+    UINT Lanes[4];
+    XMStoreInt4( Lanes, V );
+
+    return ( Lanes[0] >> 31 ) | ( ( Lanes[1] >> 31 ) << 1 ) | ( ( Lanes[2] >> 31 ) << 2 ) | ( ( Lanes[3] >> 31 ) << 3 );
+#endif
+}
+
+
+
+//-----------------------------------------------------------------------------
+// Load up to four consecutive floats, replicating the last valid element into
+// the unused lanes so partial groups at the end of an array are well defined.
+//-----------------------------------------------------------------------------
+static inline XMVECTOR LoadFloatGroup( const FLOAT* pSource, UINT Count )
+{
+    if( Count >= 4 )
+        return XMLoadFloat4( ( const XMFLOAT4* )pSource );
+
+    XMFLOAT4 Group;
+    Group.x = pSource[0];
+    Group.y = pSource[( Count > 1 ) ? 1 : 0];
+    Group.z = pSource[( Count > 2 ) ? 2 : 0];
+    Group.w = pSource[0];
+
+    return XMLoadFloat4( &Group );
+}
+
+
+
+//-----------------------------------------------------------------------------
+// Write the visibility bits for a group of four volumes starting at Index to
+// the optional bit mask and index list. Returns the number of visible volumes
+// in the group.
+//-----------------------------------------------------------------------------
+static inline UINT EmitVisibleGroup( UINT Index, UINT Bits, UINT* pVisibleMask, UINT* pVisibleIndices, UINT Written )
+{
+    if( pVisibleMask )
+    {
+        // Groups are four aligned, so a group never straddles two words.
+        if( ( Index & 31 ) == 0 )
+            pVisibleMask[Index >> 5] = 0;
+
+        pVisibleMask[Index >> 5] |= Bits << ( Index & 31 );
+    }
+
+    UINT Visible = 0;
+
+    while( Bits )
+    {
+        if( Bits & 1 )
+        {
+            if( pVisibleIndices )
+                pVisibleIndices[Written + Visible] = Index;
+
+            Visible++;
+        }
+
+        Bits >>= 1;
+        Index++;
+    }
+
+    return Visible;
+}
+
+
+
+//-----------------------------------------------------------------------------
+// Test an array of spheres vs 6 planes (typically forming a frustum), four
+// spheres at a time.
+//-----------------------------------------------------------------------------
+UINT CullSpheres6Planes( UINT Count, const FLOAT* pCenterX, const FLOAT* pCenterY, const FLOAT* pCenterZ,
+                         const FLOAT* pRadius, const XMFLOAT4* pPlanes, UINT* pVisibleMask, UINT* pVisibleIndices )
+{
+    XMASSERT( pCenterX );
+    XMASSERT( pCenterY );
+    XMASSERT( pCenterZ );
+    XMASSERT( pRadius );
+    XMASSERT( pPlanes );
+
+    // Splat the plane components once so the inner loop works on whole groups.
+    XMVECTOR PlaneX[6], PlaneY[6], PlaneZ[6], PlaneW[6];
+
+    for( UINT p = 0; p < 6; p++ )
+    {
+        XMVECTOR Plane = XMLoadFloat4( &pPlanes[p] );
+
+        XMASSERT( XMPlaneIsUnit( Plane ) );
+
+        PlaneX[p] = XMVectorSplatX( Plane );
+        PlaneY[p] = XMVectorSplatY( Plane );
+        PlaneZ[p] = XMVectorSplatZ( Plane );
+        PlaneW[p] = XMVectorSplatW( Plane );
+    }
+
+    UINT Visible = 0;
+
+    for( UINT i = 0; i < Count; i += 4 )
+    {
+        UINT Remaining = Count - i;
+
+        // Load four spheres.
+        XMVECTOR CenterX = LoadFloatGroup( pCenterX + i, Remaining );
+        XMVECTOR CenterY = LoadFloatGroup( pCenterY + i, Remaining );
+        XMVECTOR CenterZ = LoadFloatGroup( pCenterZ + i, Remaining );
+        XMVECTOR Radius = LoadFloatGroup( pRadius + i, Remaining );
+
+        XMVECTOR AnyOutside = XMVectorFalseInt();
+
+        // Test against each plane.
+        for( UINT p = 0; p < 6; p++ )
+        {
+            XMVECTOR Dist = XMVectorMultiplyAdd( CenterX, PlaneX[p],
+                            XMVectorMultiplyAdd( CenterY, PlaneY[p],
+                            XMVectorMultiplyAdd( CenterZ, PlaneZ[p], PlaneW[p] ) ) );
+
+            AnyOutside = XMVectorOrInt( AnyOutside, XMVectorGreater( Dist, Radius ) );
+        }
+
+        // A sphere is visible unless it is outside one of the planes.
+        UINT Bits = ~XMVectorSignMask( AnyOutside ) & 0xf;
+
+        if( Remaining < 4 )
+            Bits &= ( 1u << Remaining ) - 1;
+
+        Visible += EmitVisibleGroup( i, Bits, pVisibleMask, pVisibleIndices, Visible );
+    }
+
+    return Visible;
+}
+
+
+
+//-----------------------------------------------------------------------------
+// Test an array of axis aligned boxes vs 6 planes (typically forming a 
+// frustum), four boxes at a time.
+//-----------------------------------------------------------------------------
+UINT CullAxisAlignedBoxes6Planes( UINT Count, const FLOAT* pCenterX, const FLOAT* pCenterY, const FLOAT* pCenterZ,
+                                  const FLOAT* pExtentsX, const FLOAT* pExtentsY, const FLOAT* pExtentsZ,
+                                  const XMFLOAT4* pPlanes, UINT* pVisibleMask, UINT* pVisibleIndices )
+{
+    XMASSERT( pCenterX );
+    XMASSERT( pCenterY );
+    XMASSERT( pCenterZ );
+    XMASSERT( pExtentsX );
+    XMASSERT( pExtentsY );
+    XMASSERT( pExtentsZ );
+    XMASSERT( pPlanes );
+
+    // Splat the plane components once so the inner loop works on whole groups.
+    // The box "radius" only needs the absolute value of the plane normal.
+    XMVECTOR PlaneX[6], PlaneY[6], PlaneZ[6], PlaneW[6];
+    XMVECTOR AbsPlaneX[6], AbsPlaneY[6], AbsPlaneZ[6];
+
+    for( UINT p = 0; p < 6; p++ )
+    {
+        XMVECTOR Plane = XMLoadFloat4( &pPlanes[p] );
+
+        XMASSERT( XMPlaneIsUnit( Plane ) );
+
+        PlaneX[p] = XMVectorSplatX( Plane );
+        PlaneY[p] = XMVectorSplatY( Plane );
+        PlaneZ[p] = XMVectorSplatZ( Plane );
+        PlaneW[p] = XMVectorSplatW( Plane );
+
+        AbsPlaneX[p] = XMVectorAbs( PlaneX[p] );
+        AbsPlaneY[p] = XMVectorAbs( PlaneY[p] );
+        AbsPlaneZ[p] = XMVectorAbs( PlaneZ[p] );
+    }
+
+    UINT Visible = 0;
+
+    for( UINT i = 0; i < Count; i += 4 )
+    {
+        UINT Remaining = Count - i;
+
+        // Load four boxes.
+        XMVECTOR CenterX = LoadFloatGroup( pCenterX + i, Remaining );
+        XMVECTOR CenterY = LoadFloatGroup( pCenterY + i, Remaining );
+        XMVECTOR CenterZ = LoadFloatGroup( pCenterZ + i, Remaining );
+        XMVECTOR ExtentsX = LoadFloatGroup( pExtentsX + i, Remaining );
+        XMVECTOR ExtentsY = LoadFloatGroup( pExtentsY + i, Remaining );
+        XMVECTOR ExtentsZ = LoadFloatGroup( pExtentsZ + i, Remaining );
+
+        XMVECTOR AnyOutside = XMVectorFalseInt();
+
+        // Test against each plane.
+        for( UINT p = 0; p < 6; p++ )
+        {
+            XMVECTOR Dist = XMVectorMultiplyAdd( CenterX, PlaneX[p],
+                            XMVectorMultiplyAdd( CenterY, PlaneY[p],
+                            XMVectorMultiplyAdd( CenterZ, PlaneZ[p], PlaneW[p] ) ) );
+
+            // Radius = h(x) * abs(n.x) + h(y) * abs(n.y) + h(z) * abs(n.z)
+            XMVECTOR Radius = XMVectorMultiplyAdd( ExtentsX, AbsPlaneX[p],
+                              XMVectorMultiplyAdd( ExtentsY, AbsPlaneY[p], ExtentsZ * AbsPlaneZ[p] ) );
+
+            AnyOutside = XMVectorOrInt( AnyOutside, XMVectorGreater( Dist, Radius ) );
+        }
+
+        // A box is visible unless it is outside one of the planes.
+        UINT Bits = ~XMVectorSignMask( AnyOutside ) & 0xf;
+
+        if( Remaining < 4 )
+            Bits &= ( 1u << Remaining ) - 1;
+
+        Visible += EmitVisibleGroup( i, Bits, pVisibleMask, pVisibleIndices, Visible );
+    }
+
+    return Visible;
+}
+
+
+
+//-----------------------------------------------------------------------------
+// Test an array of spheres vs a frustum.  The frustum is reduced to its six
+// planes once and the spheres are then tested with CullSpheres6Planes.
+//-----------------------------------------------------------------------------
+UINT CullSpheresFrustum( UINT Count, const FLOAT* pCenterX, const FLOAT* pCenterY, const FLOAT* pCenterZ,
+                         const FLOAT* pRadius, const Frustum* pVolume, UINT* pVisibleMask, UINT* pVisibleIndices )
+{
+    XMASSERT( pVolume );
+
+    XMVECTOR Planes[6];
+    ComputePlanesFromFrustum( pVolume, &Planes[0], &Planes[1], &Planes[2], &Planes[3], &Planes[4], &Planes[5] );
+
+    XMFLOAT4 StoredPlanes[6];
+    for( UINT p = 0; p < 6; p++ )
+        XMStoreFloat4( &StoredPlanes[p], Planes[p] );
+
+    return CullSpheres6Planes( Count, pCenterX, pCenterY, pCenterZ, pRadius, StoredPlanes,
+                               pVisibleMask, pVisibleIndices );
+}
+
+
+
+//-----------------------------------------------------------------------------
+// Test an array of axis aligned boxes vs a frustum.  The frustum is reduced to
+// its six planes once and the boxes are then tested with 
+// CullAxisAlignedBoxes6Planes.
+//-----------------------------------------------------------------------------
+UINT CullAxisAlignedBoxesFrustum( UINT Count, const FLOAT* pCenterX, const FLOAT* pCenterY, const FLOAT* pCenterZ,
+                                  const FLOAT* pExtentsX, const FLOAT* pExtentsY, const FLOAT* pExtentsZ,
+                                  const Frustum* pVolume, UINT* pVisibleMask, UINT* pVisibleIndices )
+{
+    XMASSERT( pVolume );
+
+    XMVECTOR Planes[6];
+    ComputePlanesFromFrustum( pVolume, &Planes[0], &Planes[1], &Planes[2], &Planes[3], &Planes[4], &Planes[5] );
+
+    XMFLOAT4 StoredPlanes[6];
+    for( UINT p = 0; p < 6; p++ )
+        XMStoreFloat4( &StoredPlanes[p], Planes[p] );
+
+    return CullAxisAlignedBoxes6Planes( Count, pCenterX, pCenterY, pCenterZ, pExtentsX, pExtentsY, pExtentsZ,
+                                        StoredPlanes, pVisibleMask, pVisibleIndices );
+}
+
+
+
 //-----------------------------------------------------------------------------
 INT IntersectTrianglePlane( FXMVECTOR V0, FXMVECTOR V1, FXMVECTOR V2, CXMVECTOR Plane )
 {
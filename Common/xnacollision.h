@@ -73,6 +73,24 @@ VOID ComputePlanesFromFrustum( const Frustum* pVolume, XMVECTOR* pPlane0, XMVECT
 
 
 
+//-----------------------------------------------------------------------------
+// Parallel bounding volume construction.
+//
+// Split the points across the hardware threads. Arrays with fewer than
+// 2 * ParallelBoundsMinPoints points are handled on the calling thread by the
+// serial versions above. The axis aligned box matches the serial result; the
+// sphere and oriented box can differ slightly because the points are reduced
+// in a different order, but still contain every point.
+//-----------------------------------------------------------------------------
+const UINT ParallelBoundsMinPoints = 16384;
+
+VOID ComputeBoundingSphereFromPointsParallel( Sphere* pOut, UINT Count, const XMFLOAT3* pPoints, UINT Stride );
+VOID ComputeBoundingAxisAlignedBoxFromPointsParallel( AxisAlignedBox* pOut, UINT Count, const XMFLOAT3* pPoints,
+                                                      UINT Stride );
+VOID ComputeBoundingOrientedBoxFromPointsParallel( OrientedBox* pOut, UINT Count, const XMFLOAT3* pPoints, UINT Stride );
+
+
+
 //-----------------------------------------------------------------------------
 // Bounding volume transforms.
 //-----------------------------------------------------------------------------
@@ -149,6 +167,31 @@ INT IntersectFrustum6Planes( const Frustum* pVolume, FXMVECTOR Plane0, FXMVECTOR
                              CXMVECTOR Plane3, CXMVECTOR Plane4, CXMVECTOR Plane5 );
 
 
+//-----------------------------------------------------------------------------
+// Batch culling routines.
+// These test arrays of volumes stored as structure-of-arrays (one array per
+// component) against six planes, four volumes per iteration. The planes use
+// the same convention as the 6 plane routines above (outside is the positive
+// side); planes returned by ExtractFrustumPlanes point inward and must be 
+// negated first.
+// pVisibleMask (optional) receives one bit per volume, set when the volume is
+// not outside any plane, and must hold (Count + 31) / 32 UINTs.
+// pVisibleIndices (optional) receives the indices of the visible volumes in
+// increasing order, and must hold Count UINTs.
+// Return value: the number of visible volumes.
+//-----------------------------------------------------------------------------
+UINT CullSpheres6Planes( UINT Count, const FLOAT* pCenterX, const FLOAT* pCenterY, const FLOAT* pCenterZ,
+                         const FLOAT* pRadius, const XMFLOAT4* pPlanes, UINT* pVisibleMask, UINT* pVisibleIndices );
+UINT CullAxisAlignedBoxes6Planes( UINT Count, const FLOAT* pCenterX, const FLOAT* pCenterY, const FLOAT* pCenterZ,
+                                  const FLOAT* pExtentsX, const FLOAT* pExtentsY, const FLOAT* pExtentsZ,
+                                  const XMFLOAT4* pPlanes, UINT* pVisibleMask, UINT* pVisibleIndices );
+UINT CullSpheresFrustum( UINT Count, const FLOAT* pCenterX, const FLOAT* pCenterY, const FLOAT* pCenterZ,
+                         const FLOAT* pRadius, const Frustum* pVolume, UINT* pVisibleMask, UINT* pVisibleIndices );
+UINT CullAxisAlignedBoxesFrustum( UINT Count, const FLOAT* pCenterX, const FLOAT* pCenterY, const FLOAT* pCenterZ,
+                                  const FLOAT* pExtentsX, const FLOAT* pExtentsY, const FLOAT* pExtentsZ,
+                                  const Frustum* pVolume, UINT* pVisibleMask, UINT* pVisibleIndices );
+
+
 //-----------------------------------------------------------------------------
 // Volume vs plane intersection testing routines.
 // Return values: 0 = volume is outside the plane (on the positive sideof the plane),
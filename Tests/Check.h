@@ -0,0 +1,43 @@
+//***************************************************************************************
+// Check.h
+//
+// The smallest test harness that does the job: CHECK records a failure and goes on,
+// and CheckResult() is what main returns.  The tests in this directory cover the
+// parts of the demos that use only the standard library, so they build and run
+// without Direct3D (see the Makefile).
+//***************************************************************************************
+
+#ifndef CHECK_H
+#define CHECK_H
+
+#include <cstdio>
+
+inline int& CheckFailures()
+{
+	static int failures = 0;
+	return failures;
+}
+
+#define CHECK(x) \
+	do \
+	{ \
+		if( !(x) ) \
+		{ \
+			std::printf("%s(%d): CHECK(%s) failed\n", __FILE__, __LINE__, #x); \
+			++CheckFailures(); \
+		} \
+	} \
+	while( 0 )
+
+// Prints a summary and gives the exit code.
+inline int CheckResult(const char* name)
+{
+	if( CheckFailures() == 0 )
+		std::printf("%s: passed\n", name);
+	else
+		std::printf("%s: %d failed\n", name, CheckFailures());
+
+	return CheckFailures() == 0 ? 0 : 1;
+}
+
+#endif // CHECK_H
@@ -0,0 +1,218 @@
+//***************************************************************************************
+// FramePacerTest.cpp
+//
+// FramePacer on a fake clock: how each wait splits into sleep and spin, that a
+// target of 0 never waits, and the jitter statistics.
+//***************************************************************************************
+
+#include "FramePacer.h"
+#include "Check.h"
+#include <cmath>
+
+namespace
+{
+	bool Near(double a, double b, double eps = 1.0e-9)
+	{
+		return std::fabs(a - b) <= eps;
+	}
+
+	// Time only moves when told to.  A sleep oversleeps by a set amount, as an OS
+	// sleep can, and each spin pass takes SpinStep.
+	class FakeClock : public FramePacer::Clock
+	{
+	public:
+		FakeClock() : mTime(0.0), mOversleep(0.0), mSleeps(0), mSpins(0), mLastSleep(0.0) { }
+
+		double Now() { return mTime; }
+
+		void Sleep(double seconds)
+		{
+			++mSleeps;
+			mLastSleep = seconds;
+			mTime += seconds + mOversleep;
+		}
+
+		void Spin()
+		{
+			++mSpins;
+			mTime += SpinStep;
+		}
+
+		void Advance(double seconds) { mTime += seconds; }
+		void SetOversleep(double seconds) { mOversleep = seconds; }
+
+		void ResetCounts()
+		{
+			mSleeps = 0;
+			mSpins = 0;
+			mLastSleep = 0.0;
+		}
+
+		unsigned int Sleeps()const { return mSleeps; }
+		unsigned int Spins()const { return mSpins; }
+		double LastSleep()const { return mLastSleep; }
+
+		static const double SpinStep;
+
+	private:
+		double mTime;
+		double mOversleep;
+		unsigned int mSleeps;
+		unsigned int mSpins;
+		double mLastSleep;
+	};
+
+	const double FakeClock::SpinStep = 1.0e-5;
+
+	void TestSleepSpinSplit()
+	{
+		const double period = 1.0 / 50.0;
+		const double threshold = 0.002;
+
+		FakeClock clock;
+		FramePacer pacer(&clock);
+		pacer.SetTargetFrameRate(50.0f);
+		pacer.SetSpinThreshold(threshold);
+
+		// The first frame after a reset starts at once.
+		CHECK(pacer.WaitForNextFrame() == 0.0);
+		CHECK(clock.Sleeps() == 0 && clock.Spins() == 0);
+
+		// Plenty of time left: sleep until the threshold before the deadline,
+		// then spin the rest, which the oversleep shortens.
+		clock.SetOversleep(0.0015);
+		clock.Advance(0.005);
+
+		double waited = pacer.WaitForNextFrame();
+		CHECK(clock.Sleeps() == 1);
+		CHECK(Near(clock.LastSleep(), period - 0.005 - threshold));
+		CHECK(clock.Spins() > 0);
+		CHECK(clock.Now() >= period && clock.Now() < period + FakeClock::SpinStep);
+		CHECK(Near(waited, clock.Now() - 0.005));
+
+		// Less than the threshold left: spin only.
+		clock.ResetCounts();
+		clock.Advance(period - 0.001);
+		pacer.WaitForNextFrame();
+		CHECK(clock.Sleeps() == 0);
+		CHECK(clock.Spins() > 0);
+		CHECK(clock.Now() >= 2.0*period && clock.Now() < 2.0*period + FakeClock::SpinStep);
+
+		// An oversleep past the deadline leaves nothing to spin for, and the next
+		// deadline stays on the grid.
+		clock.ResetCounts();
+		clock.SetOversleep(0.01);
+		clock.Advance(0.001);
+		pacer.WaitForNextFrame();
+		CHECK(clock.Sleeps() == 1 && clock.Spins() == 0);
+		CHECK(clock.Now() > 3.0*period);
+
+		clock.ResetCounts();
+		clock.SetOversleep(0.0);
+		pacer.WaitForNextFrame();
+		CHECK(clock.Now() >= 4.0*period && clock.Now() < 4.0*period + FakeClock::SpinStep);
+	}
+
+	void TestOff()
+	{
+		FakeClock clock;
+		FramePacer pacer(&clock);
+
+		// Off by default, and a negative rate means off too.
+		CHECK(pacer.TargetFrameRate() == 0.0f);
+		pacer.SetTargetFrameRate(-30.0f);
+		CHECK(pacer.TargetFrameRate() == 0.0f);
+
+		pacer.SetTargetFrameRate(60.0f);
+		pacer.SetTargetFrameRate(0.0f);
+		CHECK(pacer.TargetFrameRate() == 0.0f);
+
+		for(int i = 0; i < 10; ++i)
+		{
+			double before = clock.Now();
+			CHECK(pacer.WaitForNextFrame() == 0.0);
+			CHECK(clock.Now() == before);
+
+			clock.Advance(0.001);
+		}
+
+		CHECK(clock.Sleeps() == 0 && clock.Spins() == 0);
+		CHECK(pacer.Stats().MissedDeadlines == 0);
+	}
+
+	void TestStats()
+	{
+		FakeClock clock;
+		FramePacer pacer(&clock);
+
+		// Unpaced, the intervals are exactly the work: 10, 20 and 30 ms have a
+		// mean of 20 and a sample standard deviation of 10.
+		pacer.WaitForNextFrame();
+		clock.Advance(0.010);
+		pacer.WaitForNextFrame();
+		clock.Advance(0.020);
+		pacer.WaitForNextFrame();
+		clock.Advance(0.030);
+		pacer.WaitForNextFrame();
+
+		const FramePacer::JitterStats& stats = pacer.Stats();
+		CHECK(stats.Frames == 3);
+		CHECK(Near(stats.MeanInterval, 0.020));
+		CHECK(Near(stats.StdDevInterval, 0.010));
+		CHECK(stats.MaxDeviation == 0.0);
+		CHECK(stats.MissedDeadlines == 0);
+
+		pacer.ResetStats();
+		CHECK(stats.Frames == 0 && stats.MeanInterval == 0.0 && stats.StdDevInterval == 0.0);
+
+		// Paced, with frames that fit: every interval is a period to within a
+		// spin step.
+		const double period = 1.0 / 100.0;
+		pacer.SetTargetFrameRate(100.0f);
+		pacer.ResetStats();
+
+		pacer.WaitForNextFrame();
+		for(int i = 0; i < 20; ++i)
+		{
+			clock.Advance(0.004);
+			pacer.WaitForNextFrame();
+		}
+
+		CHECK(stats.Frames == 20);
+		CHECK(stats.MissedDeadlines == 0);
+		CHECK(Near(stats.MeanInterval, period, FakeClock::SpinStep));
+		CHECK(stats.StdDevInterval < FakeClock::SpinStep);
+		CHECK(stats.MaxDeviation < FakeClock::SpinStep);
+
+		// A frame half a period late misses its deadline, and the one after it
+		// catches up on the grid.
+		double start = clock.Now();
+		clock.Advance(1.5*period);
+		pacer.WaitForNextFrame();
+		CHECK(stats.MissedDeadlines == 1);
+		CHECK(Near(stats.MaxDeviation, 0.5*period, 1.0e-6));
+
+		pacer.WaitForNextFrame();
+		CHECK(clock.Now() >= start + 2.0*period - FakeClock::SpinStep &&
+		      clock.Now() < start + 2.0*period + FakeClock::SpinStep);
+
+		// More than a period late starts the schedule over instead.
+		clock.Advance(3.5*period);
+		pacer.WaitForNextFrame();
+		CHECK(stats.MissedDeadlines == 2);
+
+		double restart = clock.Now();
+		clock.Advance(0.001);
+		pacer.WaitForNextFrame();
+		CHECK(clock.Now() >= restart + period && clock.Now() < restart + period + FakeClock::SpinStep);
+	}
+}
+
+int main()
+{
+	TestSleepSpinSplit();
+	TestOff();
+	TestStats();
+
+	return CheckResult("FramePacerTest");
+}
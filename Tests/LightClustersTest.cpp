@@ -0,0 +1,208 @@
+//***************************************************************************************
+// LightClustersTest.cpp
+//
+// LightClusters::Bin against the brute force Touches() over every cluster, on the
+// calling thread alone and on all threads, and FindCluster at the slice boundaries
+// and screen edges.
+//***************************************************************************************
+
+#include "LightClusters.h"
+#include "Check.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	const float Pi = 3.1415926535f;
+
+	// A fixed sequence, so a failure repeats.
+	class Random
+	{
+	public:
+		explicit Random(unsigned int seed) : mState(seed) { }
+
+		float Next(float lo, float hi)
+		{
+			mState = mState*1664525u + 1013904223u;
+			return lo + (hi - lo)*((mState >> 8) / 16777216.0f);
+		}
+
+	private:
+		unsigned int mState;
+	};
+
+	// Lights spread over and around the frustum, some behind the camera or past
+	// the far plane, about half of them spot lights.
+	std::vector<LightClusters::Sphere> MakeLights(unsigned int count, float farZ, unsigned int seed)
+	{
+		Random random(seed);
+		std::vector<LightClusters::Sphere> lights;
+
+		for(unsigned int i = 0; i < count; ++i)
+		{
+			float z = random.Next(-0.05f*farZ, 1.1f*farZ);
+			float p[3] = { random.Next(-1.2f, 1.2f)*std::fabs(z), random.Next(-0.8f, 0.8f)*std::fabs(z), z };
+			float range = random.Next(0.5f, 0.1f*farZ);
+
+			if( i % 2 == 0 )
+			{
+				lights.push_back(LightClusters::PointBounds(p, range));
+			}
+			else
+			{
+				float d[3] = { random.Next(-1.0f, 1.0f), random.Next(-1.0f, 1.0f), random.Next(-1.0f, 1.0f) };
+				float length = std::sqrt(d[0]*d[0] + d[1]*d[1] + d[2]*d[2]) + 1.0e-6f;
+				d[0] /= length;
+				d[1] /= length;
+				d[2] /= length;
+
+				lights.push_back(LightClusters::SpotBounds(p, d, range, random.Next(0.0f, 64.0f)));
+			}
+		}
+
+		return lights;
+	}
+
+	// Every cluster holds exactly the lights Touches() says it does.
+	void CheckBin(LightClusters& clusters, const std::vector<LightClusters::Sphere>& lights)
+	{
+		clusters.Bin(lights.empty() ? 0 : &lights[0], (unsigned int)lights.size());
+
+		const std::vector<LightClusters::Cluster>& table = clusters.Clusters();
+		const std::vector<unsigned int>& indices = clusters.LightIndices();
+
+		CHECK(table.size() == clusters.ClusterCount());
+
+		unsigned int total = 0;
+		unsigned int mismatches = 0;
+		for(unsigned int c = 0; c < clusters.ClusterCount(); ++c)
+		{
+			const LightClusters::Cluster& cluster = table[c];
+			CHECK(cluster.Offset + cluster.Count <= indices.size());
+
+			std::vector<unsigned int> binned(indices.begin() + cluster.Offset,
+				indices.begin() + cluster.Offset + cluster.Count);
+			std::sort(binned.begin(), binned.end());
+
+			std::vector<unsigned int> expected;
+			for(unsigned int i = 0; i < lights.size(); ++i)
+			{
+				if( clusters.Touches(lights[i], c) )
+					expected.push_back(i);
+			}
+
+			if( binned != expected )
+				++mismatches;
+
+			total += cluster.Count;
+		}
+
+		CHECK(mismatches == 0);
+		CHECK(total == indices.size());
+		CHECK(lights.size() < 10 || total > 0);
+	}
+
+	void TestBin()
+	{
+		LightClusters clusters;
+		clusters.SetFrustum(0.25f*Pi, 16.0f/9.0f, 1.0f, 200.0f);
+
+		// Below MinThreadedLights, so one thread; then enough for all of them.
+		unsigned int counts[] = { 0, 1, LightClusters::MinThreadedLights - 1, LightClusters::MinThreadedLights, 500 };
+		for(int i = 0; i < 5; ++i)
+			CheckBin(clusters, MakeLights(counts[i], 200.0f, 17u + i));
+
+		// Columns that are not a multiple of four, and fewer slices than threads.
+		clusters.SetGrid(13, 7, 3);
+		CheckBin(clusters, MakeLights(10, 200.0f, 101u));
+		CheckBin(clusters, MakeLights(300, 200.0f, 102u));
+
+		// Binning again after a smaller batch leaves nothing of the old one.
+		clusters.SetGrid(16, 9, 24);
+		CheckBin(clusters, MakeLights(400, 200.0f, 103u));
+		CheckBin(clusters, MakeLights(5, 200.0f, 104u));
+	}
+
+	unsigned int SliceOf(const LightClusters& clusters, unsigned int cluster)
+	{
+		return cluster / (clusters.TilesX()*clusters.TilesY());
+	}
+
+	void TestFindCluster()
+	{
+		LightClusters clusters;
+		clusters.SetFrustum(0.25f*Pi, 16.0f/9.0f, 0.5f, 300.0f);
+
+		CHECK(clusters.SliceDepth(0) == 0.5f);
+		CHECK(clusters.SliceDepth(clusters.Slices()) == 300.0f);
+
+		// Either side of each slice boundary.
+		for(unsigned int k = 1; k < clusters.Slices(); ++k)
+		{
+			float z = clusters.SliceDepth(k);
+			CHECK(SliceOf(clusters, clusters.FindCluster(0.5f, 0.5f, z*1.001f)) == k);
+			CHECK(SliceOf(clusters, clusters.FindCluster(0.5f, 0.5f, z*0.999f)) == k - 1);
+
+			unsigned int at = SliceOf(clusters, clusters.FindCluster(0.5f, 0.5f, z));
+			CHECK(at == k || at == k - 1);
+		}
+
+		// Depths outside the frustum clamp to the first and last slices.
+		unsigned int last = clusters.Slices() - 1;
+		CHECK(SliceOf(clusters, clusters.FindCluster(0.5f, 0.5f, 0.5f)) == 0);
+		CHECK(SliceOf(clusters, clusters.FindCluster(0.5f, 0.5f, 0.1f)) == 0);
+		CHECK(SliceOf(clusters, clusters.FindCluster(0.5f, 0.5f, 0.0f)) == 0);
+		CHECK(SliceOf(clusters, clusters.FindCluster(0.5f, 0.5f, 299.9f)) == last);
+		CHECK(SliceOf(clusters, clusters.FindCluster(0.5f, 0.5f, 5000.0f)) == last);
+
+		// The screen's corners, and just past them.
+		unsigned int maxX = clusters.TilesX() - 1;
+		unsigned int maxY = clusters.TilesY() - 1;
+		CHECK(clusters.FindCluster(0.0f, 0.0f, 10.0f) == clusters.FindCluster(-0.1f, -0.1f, 10.0f));
+
+		unsigned int s = SliceOf(clusters, clusters.FindCluster(0.0f, 0.0f, 10.0f));
+		CHECK(clusters.FindCluster(0.0f, 0.0f, 10.0f) == clusters.ClusterIndex(0, 0, s));
+		CHECK(clusters.FindCluster(0.9999f, 0.0f, 10.0f) == clusters.ClusterIndex(maxX, 0, s));
+		CHECK(clusters.FindCluster(0.0f, 0.9999f, 10.0f) == clusters.ClusterIndex(0, maxY, s));
+		CHECK(clusters.FindCluster(0.9999f, 0.9999f, 10.0f) == clusters.ClusterIndex(maxX, maxY, s));
+		CHECK(clusters.FindCluster(1.0f, 1.0f, 10.0f) == clusters.ClusterIndex(maxX, maxY, s));
+		CHECK(clusters.FindCluster(1.5f, 1.5f, 10.0f) == clusters.ClusterIndex(maxX, maxY, s));
+
+		// Tile edges: u = x/TilesX starts tile x.
+		for(unsigned int x = 1; x < clusters.TilesX(); ++x)
+		{
+			float u = (float)x / clusters.TilesX();
+			CHECK(clusters.FindCluster(u + 1.0e-4f, 0.5f, 10.0f) % clusters.TilesX() == x);
+			CHECK(clusters.FindCluster(u - 1.0e-4f, 0.5f, 10.0f) % clusters.TilesX() == x - 1);
+		}
+
+		// A pixel's view space point lies in the cluster FindCluster gives it, as
+		// far as the binning test is concerned.
+		float tanY = std::tan(0.125f*Pi);
+		float tanX = tanY*16.0f/9.0f;
+		Random random(7u);
+		unsigned int misses = 0;
+		for(int i = 0; i < 2000; ++i)
+		{
+			float u = random.Next(0.0f, 1.0f);
+			float v = random.Next(0.0f, 1.0f);
+			float z = std::exp(random.Next(std::log(0.5f), std::log(300.0f)));
+
+			float p[3] = { (2.0f*u - 1.0f)*tanX*z, (1.0f - 2.0f*v)*tanY*z, z };
+			LightClusters::Sphere point = LightClusters::PointBounds(p, 1.0e-3f*z);
+
+			if( !clusters.Touches(point, clusters.FindCluster(u, v, z)) )
+				++misses;
+		}
+
+		CHECK(misses == 0);
+	}
+}
+
+int main()
+{
+	TestBin();
+	TestFindCluster();
+
+	return CheckResult("LightClustersTest");
+}
@@ -0,0 +1,195 @@
+//***************************************************************************************
+// PassRecorderTest.cpp
+//
+// PassRecorder with a mock Target: the partitioning, that every item is recorded
+// once on the context of its chunk, and that chunks execute in item order.
+//***************************************************************************************
+
+#include "PassRecorder.h"
+#include "Check.h"
+#include <mutex>
+
+namespace
+{
+	class MockTarget : public PassRecorder::Target
+	{
+	public:
+		explicit MockTarget(unsigned int contextCount)
+			: mContextCount(contextCount), Passes(0), PassOpen(false)
+		{
+		}
+
+		unsigned int ContextCount()const { return mContextCount; }
+
+		void BeginPass()
+		{
+			PassOpen = true;
+			Begun.clear();
+			Finished.clear();
+			Executed.clear();
+		}
+
+		void EndPass()
+		{
+			PassOpen = false;
+			++Passes;
+		}
+
+		void BeginChunk(unsigned int context)
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			Begun.push_back(context);
+		}
+
+		void FinishChunk(unsigned int context)
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			Finished.push_back(context);
+		}
+
+		void ExecuteChunk(unsigned int context)
+		{
+			// Only a finished chunk can be executed.
+			std::lock_guard<std::mutex> lock(mMutex);
+			bool finished = false;
+			for(size_t i = 0; i < Finished.size(); ++i)
+				finished = finished || Finished[i] == context;
+
+			CHECK(finished);
+			Executed.push_back(context);
+		}
+
+	private:
+		unsigned int mContextCount;
+		std::mutex mMutex;
+
+	public:
+		unsigned int Passes;
+		bool PassOpen;
+		std::vector<unsigned int> Begun;
+		std::vector<unsigned int> Finished;
+		std::vector<unsigned int> Executed;
+	};
+
+	void TestPartition()
+	{
+		std::vector<PassRecorder::Range> chunks;
+
+		PassRecorder::Partition(0, 4, 16, chunks);
+		CHECK(chunks.empty());
+
+		// Fewer items than the minimum still make one chunk.
+		PassRecorder::Partition(5, 4, 16, chunks);
+		CHECK(chunks.size() == 1);
+		CHECK(chunks[0].Begin == 0 && chunks[0].End == 5);
+
+		// The minimum chunk size limits the count before maxChunks does.
+		PassRecorder::Partition(40, 4, 16, chunks);
+		CHECK(chunks.size() == 2);
+
+		PassRecorder::Partition(10, 0, 0, chunks);
+		CHECK(chunks.size() == 1);
+
+		for(unsigned int items = 1; items < 300; items += 7)
+		{
+			for(unsigned int maxChunks = 1; maxChunks <= 8; ++maxChunks)
+			{
+				for(unsigned int minItems = 1; minItems <= 40; minItems += 13)
+				{
+					PassRecorder::Partition(items, maxChunks, minItems, chunks);
+
+					CHECK(!chunks.empty() && chunks.size() <= maxChunks);
+					CHECK(chunks.front().Begin == 0 && chunks.back().End == items);
+
+					unsigned int smallest = items;
+					unsigned int largest = 0;
+					for(size_t i = 0; i < chunks.size(); ++i)
+					{
+						unsigned int size = chunks[i].End - chunks[i].Begin;
+						smallest = size < smallest ? size : smallest;
+						largest = size > largest ? size : largest;
+
+						if( i > 0 )
+							CHECK(chunks[i].Begin == chunks[i-1].End);
+					}
+
+					CHECK(largest - smallest <= 1);
+					CHECK(chunks.size() == 1 || smallest >= minItems);
+				}
+			}
+		}
+	}
+
+	void TestRecord(unsigned int contextCount, unsigned int itemCount)
+	{
+		MockTarget target(contextCount);
+		PassRecorder recorder(target);
+		recorder.SetMinItemsPerChunk(4);
+
+		std::vector<int> recordedOn(itemCount, -1);
+		std::vector<int> timesRecorded(itemCount, 0);
+
+		// Two passes, so the second reuses the workers of the first.
+		for(int pass = 0; pass < 2; ++pass)
+		{
+			for(unsigned int i = 0; i < itemCount; ++i)
+			{
+				recordedOn[i] = -1;
+				timesRecorded[i] = 0;
+			}
+
+			// Each call writes only its own items, so no lock is needed.
+			recorder.Record(itemCount, [&](unsigned int context, unsigned int begin, unsigned int end)
+			{
+				for(unsigned int i = begin; i < end; ++i)
+				{
+					recordedOn[i] = (int)context;
+					++timesRecorded[i];
+				}
+			});
+
+			const std::vector<PassRecorder::Range>& chunks = recorder.Chunks();
+
+			if( itemCount == 0 )
+			{
+				CHECK(chunks.empty());
+				CHECK(target.Passes == 0);
+				continue;
+			}
+
+			CHECK(target.Passes == (unsigned int)pass + 1);
+			CHECK(!target.PassOpen);
+			CHECK(chunks.size() <= contextCount);
+			CHECK(target.Begun.size() == chunks.size());
+			CHECK(target.Finished.size() == chunks.size());
+
+			// Chunk c is recorded on context c and executed c-th.
+			CHECK(target.Executed.size() == chunks.size());
+			for(size_t c = 0; c < target.Executed.size(); ++c)
+				CHECK(target.Executed[c] == c);
+
+			for(size_t c = 0; c < chunks.size(); ++c)
+			{
+				for(unsigned int i = chunks[c].Begin; i < chunks[c].End; ++i)
+					CHECK(recordedOn[i] == (int)c);
+			}
+
+			for(unsigned int i = 0; i < itemCount; ++i)
+				CHECK(timesRecorded[i] == 1);
+		}
+	}
+}
+
+int main()
+{
+	TestPartition();
+
+	TestRecord(1, 100);
+	TestRecord(4, 0);
+	TestRecord(4, 3);
+	TestRecord(4, 10);
+	TestRecord(4, 1000);
+	TestRecord(8, 37);
+
+	return CheckResult("PassRecorderTest");
+}
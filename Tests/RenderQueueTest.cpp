@@ -0,0 +1,280 @@
+//***************************************************************************************
+// RenderQueueTest.cpp
+//
+// RenderQueue with a mock Target: the key layout, that the radix sort is stable, and
+// that only real state changes reach the target and are counted.
+//***************************************************************************************
+
+#include "RenderQueue.h"
+#include "Check.h"
+#include <algorithm>
+
+namespace
+{
+	typedef RenderQueue::Packet Packet;
+
+	// Records what the queue asks of it.
+	class MockTarget : public RenderQueue::Target
+	{
+	public:
+		MockTarget() : Redundant(0)
+		{
+			for(int i = 0; i < RenderQueue::StateTypeCount; ++i)
+			{
+				Bound[i] = false;
+				Current[i] = 0;
+				Sets[i] = 0;
+			}
+		}
+
+		void SetState(RenderQueue::StateType type, unsigned int id)
+		{
+			if( Bound[type] && Current[type] == id )
+				++Redundant;
+
+			Bound[type] = true;
+			Current[type] = id;
+			++Sets[type];
+		}
+
+		void Draw(const Packet& packet)
+		{
+			// Everything the packet needs is bound when it is drawn.
+			for(int i = 0; i < RenderQueue::StateTypeCount; ++i)
+				CHECK(Bound[i] && Current[i] == packet.State[i]);
+
+			Draws.push_back(packet.Draw);
+		}
+
+		bool Bound[RenderQueue::StateTypeCount];
+		unsigned int Current[RenderQueue::StateTypeCount];
+		unsigned int Sets[RenderQueue::StateTypeCount];
+		unsigned int Redundant;
+		std::vector<unsigned int> Draws;
+	};
+
+	// A fixed sequence, so a failure repeats.
+	class Random
+	{
+	public:
+		explicit Random(unsigned int seed) : mState(seed) { }
+
+		unsigned int Next(unsigned int n)
+		{
+			mState = mState*1664525u + 1013904223u;
+			return (mState >> 8) % n;
+		}
+
+	private:
+		unsigned int mState;
+	};
+
+	unsigned long long Bits(unsigned long long key, unsigned int shift, unsigned int bits)
+	{
+		return (key >> shift) & ((1ULL << bits) - 1);
+	}
+
+	void TestMakeKey()
+	{
+		CHECK(RenderQueue::PassBits + RenderQueue::TechniqueBits + RenderQueue::TextureBits +
+			RenderQueue::MaterialBits + RenderQueue::DepthBits == 64);
+
+		const unsigned int depthShift     = 0;
+		const unsigned int materialShift  = depthShift + RenderQueue::DepthBits;
+		const unsigned int textureShift   = materialShift + RenderQueue::MaterialBits;
+		const unsigned int techniqueShift = textureShift + RenderQueue::TextureBits;
+		const unsigned int passShift      = techniqueShift + RenderQueue::TechniqueBits;
+		const unsigned int maxDepth       = (1u << RenderQueue::DepthBits) - 1;
+
+		// Each field lands in its own bits.
+		unsigned long long key = RenderQueue::MakeKey(0x9, 0xa5, 0xbeef, 0x123, 1.0f);
+		CHECK(Bits(key, passShift, RenderQueue::PassBits) == 0x9);
+		CHECK(Bits(key, techniqueShift, RenderQueue::TechniqueBits) == 0xa5);
+		CHECK(Bits(key, textureShift, RenderQueue::TextureBits) == 0xbeef);
+		CHECK(Bits(key, materialShift, RenderQueue::MaterialBits) == 0x123);
+		CHECK(Bits(key, depthShift, RenderQueue::DepthBits) == maxDepth);
+
+		// Ids wider than their field are truncated, not spilled into the next.
+		key = RenderQueue::MakeKey(0x13, 0x1ff, 0x1ffff, 0x1fff, 0.0f);
+		CHECK(Bits(key, passShift, RenderQueue::PassBits) == 0x3);
+		CHECK(Bits(key, techniqueShift, RenderQueue::TechniqueBits) == 0xff);
+		CHECK(Bits(key, textureShift, RenderQueue::TextureBits) == 0xffff);
+		CHECK(Bits(key, materialShift, RenderQueue::MaterialBits) == 0xfff);
+		CHECK(Bits(key, depthShift, RenderQueue::DepthBits) == 0);
+
+		CHECK(RenderQueue::MakeKey(0, 0, 0, 0, 0.0f) == 0);
+		CHECK(RenderQueue::MakeKey(1, 0, 0, 0, 0.0f) == 1ULL << passShift);
+		CHECK(RenderQueue::MakeKey(0, 1, 0, 0, 0.0f) == 1ULL << techniqueShift);
+		CHECK(RenderQueue::MakeKey(0, 0, 1, 0, 0.0f) == 1ULL << textureShift);
+		CHECK(RenderQueue::MakeKey(0, 0, 0, 1, 0.0f) == 1ULL << materialShift);
+
+		// Depth is clamped to [0, 1] and quantized; 1 is the largest depth, not a
+		// carry into the material.
+		CHECK(RenderQueue::MakeKey(0, 0, 0, 0, -3.0f) == 0);
+		CHECK(RenderQueue::MakeKey(0, 0, 0, 0, 7.0f) == maxDepth);
+		CHECK(RenderQueue::MakeKey(0, 0, 0, 0, 0.5f) == (maxDepth + 1)/2);
+
+		// Near to far by default; back to front inverts only the depth.
+		CHECK(RenderQueue::MakeKey(2, 3, 4, 5, 0.25f) < RenderQueue::MakeKey(2, 3, 4, 5, 0.75f));
+		CHECK(RenderQueue::MakeKey(2, 3, 4, 5, 0.25f, true) > RenderQueue::MakeKey(2, 3, 4, 5, 0.75f, true));
+		CHECK(Bits(RenderQueue::MakeKey(2, 3, 4, 5, 0.0f, true), depthShift, RenderQueue::DepthBits) == maxDepth);
+		CHECK(Bits(RenderQueue::MakeKey(2, 3, 4, 5, 1.0f, true), depthShift, RenderQueue::DepthBits) == 0);
+		CHECK(RenderQueue::MakeKey(2, 3, 4, 5, 0.25f, true) >> RenderQueue::DepthBits ==
+			RenderQueue::MakeKey(2, 3, 4, 5, 0.25f) >> RenderQueue::DepthBits);
+
+		// The pass outranks everything below it.
+		CHECK(RenderQueue::MakeKey(1, 0, 0, 0, 0.0f) > RenderQueue::MakeKey(0, 0xff, 0xffff, 0xfff, 1.0f));
+	}
+
+	bool KeyLess(const Packet& a, const Packet& b)
+	{
+		return a.Key < b.Key;
+	}
+
+	void TestRadixSort()
+	{
+		std::vector<Packet> packets, scratch;
+
+		RenderQueue::RadixSort(packets, scratch);
+		CHECK(packets.empty());
+
+		// Few distinct keys, spread over every byte, so there are many ties.
+		// Draw holds the submission index.
+		Random random(5u);
+		const unsigned int count = 5000;
+		for(unsigned int i = 0; i < count; ++i)
+		{
+			Packet p = Packet();
+			p.Key = RenderQueue::MakeKey(random.Next(3), random.Next(4)*0x31, random.Next(3)*0x1011,
+				random.Next(2)*0x101, random.Next(3)*0.5f);
+			p.Draw = i;
+			packets.push_back(p);
+		}
+
+		std::vector<Packet> expected = packets;
+		std::stable_sort(expected.begin(), expected.end(), KeyLess);
+
+		RenderQueue::RadixSort(packets, scratch);
+		CHECK(packets.size() == count);
+
+		unsigned int mismatches = 0;
+		for(unsigned int i = 0; i < count; ++i)
+		{
+			if( packets[i].Key != expected[i].Key || packets[i].Draw != expected[i].Draw )
+				++mismatches;
+		}
+		CHECK(mismatches == 0);
+
+		// All keys equal: every byte pass is skipped and the order is untouched.
+		for(unsigned int i = 0; i < count; ++i)
+			packets[count - 1 - i].Key = 42;
+		for(unsigned int i = 0; i < count; ++i)
+			packets[i].Draw = i;
+
+		RenderQueue::RadixSort(packets, scratch);
+		bool inOrder = true;
+		for(unsigned int i = 0; i < count; ++i)
+			inOrder = inOrder && packets[i].Draw == i;
+		CHECK(inOrder);
+
+		// An odd number of byte passes leaves the result in scratch before the
+		// swap back.
+		packets.resize(3);
+		packets[0].Key = 0x0300; packets[0].Draw = 0;
+		packets[1].Key = 0x0100; packets[1].Draw = 1;
+		packets[2].Key = 0x0200; packets[2].Draw = 2;
+		RenderQueue::RadixSort(packets, scratch);
+		CHECK(packets[0].Draw == 1 && packets[1].Draw == 2 && packets[2].Draw == 0);
+	}
+
+	void Submit(RenderQueue& queue, unsigned int technique, unsigned int texture, unsigned int material,
+		float depth, unsigned int draw)
+	{
+		unsigned int state[RenderQueue::StateTypeCount];
+		state[RenderQueue::TechniqueState]  = technique;
+		state[RenderQueue::RasterizerState] = 0;
+		state[RenderQueue::BlendState]      = 0;
+		state[RenderQueue::TextureState]    = texture;
+		state[RenderQueue::MaterialState]   = material;
+
+		queue.Submit(0, state, depth, draw);
+	}
+
+	void TestExecute()
+	{
+		RenderQueue queue;
+
+		// Two techniques, submitted alternately.
+		Submit(queue, 1, 5, 2, 0.1f, 0);
+		Submit(queue, 2, 6, 2, 0.2f, 1);
+		Submit(queue, 1, 5, 2, 0.3f, 2);
+		Submit(queue, 2, 6, 3, 0.4f, 3);
+		CHECK(queue.PacketCount() == 4);
+
+		MockTarget target;
+		queue.Execute(target);
+
+		const RenderQueue::FrameStats& stats = queue.Stats();
+		CHECK(stats.Packets == 4);
+		CHECK(stats.UnfilteredChanges == 4*RenderQueue::StateTypeCount);
+
+		// In submission order: all five, then technique and texture twice, then
+		// technique, texture and material.
+		CHECK(stats.SubmissionOrderChanges == 5 + 2 + 2 + 3);
+
+		// Sorted: 0 and 2 share everything; 1 changes technique and texture; 3
+		// only the material.
+		CHECK(stats.StateChanges == 5 + 0 + 2 + 1);
+		CHECK(stats.Changes[RenderQueue::TechniqueState] == 2);
+		CHECK(stats.Changes[RenderQueue::RasterizerState] == 1);
+		CHECK(stats.Changes[RenderQueue::BlendState] == 1);
+		CHECK(stats.Changes[RenderQueue::TextureState] == 2);
+		CHECK(stats.Changes[RenderQueue::MaterialState] == 2);
+
+		// The target saw exactly the counted changes, none of them redundant.
+		CHECK(target.Redundant == 0);
+		unsigned int sets = 0;
+		for(int i = 0; i < RenderQueue::StateTypeCount; ++i)
+		{
+			CHECK(target.Sets[i] == stats.Changes[i]);
+			sets += target.Sets[i];
+		}
+		CHECK(sets == stats.StateChanges);
+
+		CHECK(target.Draws.size() == 4);
+		CHECK(target.Draws[0] == 0 && target.Draws[1] == 2 && target.Draws[2] == 1 && target.Draws[3] == 3);
+
+		// The queue is empty after Execute, and the next one binds everything again.
+		CHECK(queue.PacketCount() == 0);
+
+		Submit(queue, 2, 6, 3, 0.5f, 4);
+		MockTarget next;
+		queue.Execute(next);
+		CHECK(queue.Stats().StateChanges == RenderQueue::StateTypeCount);
+		CHECK(queue.Stats().SubmissionOrderChanges == RenderQueue::StateTypeCount);
+
+		// CountStateChanges on its own.
+		std::vector<Packet> packets;
+		CHECK(RenderQueue::CountStateChanges(packets) == 0);
+
+		Packet p = Packet();
+		packets.push_back(p);
+		packets.push_back(p);
+		p.State[RenderQueue::BlendState] = 1;
+		packets.push_back(p);
+
+		unsigned int changes[RenderQueue::StateTypeCount];
+		CHECK(RenderQueue::CountStateChanges(packets, changes) == RenderQueue::StateTypeCount + 1);
+		CHECK(changes[RenderQueue::BlendState] == 2);
+		CHECK(changes[RenderQueue::TechniqueState] == 1);
+	}
+}
+
+int main()
+{
+	TestMakeKey();
+	TestRadixSort();
+	TestExecute();
+
+	return CheckResult("RenderQueueTest");
+}
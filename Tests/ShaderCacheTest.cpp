@@ -0,0 +1,203 @@
+//***************************************************************************************
+// ShaderCacheTest.cpp
+//
+// ShaderCache keys and entries with a fake compiler, and the LitFeatures bits and
+// defines the cache is keyed with.  Writes its files to the working directory.
+//***************************************************************************************
+
+#include "ShaderCache.h"
+#include "LitFeatures.h"
+#include "Check.h"
+#include <cstdio>
+#include <fstream>
+
+namespace
+{
+	void WriteText(const char* path, const char* text)
+	{
+		std::ofstream fout(path, std::ios::binary | std::ios::trunc);
+		fout << text;
+	}
+
+	// Bytecode is the path and defines, so a load shows what was compiled.
+	struct FakeCompiler
+	{
+		FakeCompiler() : Calls(0), Fail(false) { }
+
+		bool operator()(const std::string& sourcePath, const ShaderDefines& defines,
+			std::vector<char>& bytecode, std::string& errors)
+		{
+			++Calls;
+			if( Fail )
+			{
+				errors = "error X3000: syntax error";
+				return false;
+			}
+
+			std::string s = sourcePath + "#" + defines.ToString();
+			bytecode.assign(s.begin(), s.end());
+			return true;
+		}
+
+		int Calls;
+		bool Fail;
+	};
+
+	std::string Text(const std::vector<char>& v)
+	{
+		return std::string(v.begin(), v.end());
+	}
+
+	void TestDefines()
+	{
+		ShaderDefines a;
+		a.Set("B", 2);
+		a.Set("A", "x");
+		a.Set("B", 3);
+		CHECK(a.ToString() == "A=x;B=3");
+
+		ShaderDefines b;
+		b.Set("A", "x");
+		b.Merge(a);
+		CHECK(b.ToString() == a.ToString());
+	}
+
+	void TestLitFeatures()
+	{
+		// Every combination has its own bits.
+		std::vector<bool> seen(256, false);
+		unsigned int distinct = 0;
+		for(int lights = 0; lights < 4; ++lights)
+		{
+			for(int m = 0; m < 64; ++m)
+			{
+				LitFeatures f(lights, (m & 1) != 0, (m & 2) != 0);
+				f.Fog = (m & 4) != 0;
+				f.Reflection = (m & 8) != 0;
+				f.Instanced = (m & 16) != 0;
+				f.Tessellated = (m & 32) != 0;
+
+				CHECK(f.Bits() < 256);
+				if( !seen[f.Bits()] )
+				{
+					seen[f.Bits()] = true;
+					++distinct;
+				}
+			}
+		}
+		CHECK(distinct == 256);
+
+		// Counts past the shaders' three lights clamp, in the bits and the
+		// defines alike.
+		LitFeatures four(4, true);
+		LitFeatures three(3, true);
+		CHECK(four.LightCount == 3);
+		CHECK(four.Bits() == three.Bits());
+		CHECK(four.Defines().ToString() == three.Defines().ToString());
+
+		LitFeatures changed(1, true);
+		changed.LightCount = 7;
+		CHECK(changed.Bits() == three.Bits());
+		CHECK(changed.Defines().ToString() == three.Defines().ToString());
+
+		CHECK(LitFeatures(-1).Bits() == LitFeatures(0).Bits());
+	}
+
+	void TestCache()
+	{
+		WriteText("ShaderCacheTest_Main.fx", "#include \"ShaderCacheTest_A.fx\"\n  #  include \"ShaderCacheTest_B.fx\"\n#include <system.fx>\nmain\n");
+		WriteText("ShaderCacheTest_A.fx", "a\n#include \"ShaderCacheTest_Main.fx\"\n");
+		WriteText("ShaderCacheTest_B.fx", "b\n");
+
+		const std::string source = "ShaderCacheTest_Main.fx";
+
+		FakeCompiler compiler;
+		ShaderCache::Compiler compile = std::ref(compiler);
+
+		LitFeatures features(3, true);
+		features.Fog = true;
+		ShaderDefines defines = features.Defines();
+		defines.Set("SHADOW_FILTER", "SHADOW_FILTER_PCF3X3");
+
+		// Clear out entries of an earlier run.
+		ShaderCache cache("", "fx_5_0", compile);
+		std::remove(cache.EntryPath(source, cache.Key(source, defines)).c_str());
+
+		std::vector<char> bytecode;
+		CHECK(cache.Load(source, defines, bytecode));
+		CHECK(compiler.Calls == 1);
+		CHECK(Text(bytecode) == source + "#" + defines.ToString());
+
+		// The second load comes from disk.
+		CHECK(cache.Load(source, defines, bytecode));
+		CHECK(compiler.Calls == 1);
+		CHECK(cache.GetStats().DiskHits == 1);
+
+		// The order defines were set in does not matter.
+		ShaderDefines reordered;
+		reordered.Set("SHADOW_FILTER", "SHADOW_FILTER_PCF3X3");
+		reordered.Merge(features.Defines());
+		CHECK(cache.Key(source, reordered) == cache.Key(source, defines));
+
+		// Another features set is another key.
+		CHECK(cache.Key(source, LitFeatures(3, true).Defines()) != cache.Key(source, features.Defines()));
+
+		// A new cache, as in the next run, finds the entry.
+		ShaderCache nextRun("", "fx_5_0", compile);
+		CHECK(nextRun.Load(source, defines, bytecode));
+		CHECK(compiler.Calls == 1);
+
+		// Other compiler flags do not.
+		ShaderCache debug("", "fx_5_0 debug", compile);
+		std::remove(debug.EntryPath(source, debug.Key(source, defines)).c_str());
+		CHECK(debug.Load(source, defines, bytecode));
+		CHECK(compiler.Calls == 2);
+
+		// Editing an included file changes the key once the sources are read
+		// again.
+		unsigned long long before = cache.Key(source, defines);
+		WriteText("ShaderCacheTest_B.fx", "b edited\n");
+		CHECK(cache.Key(source, defines) == before);
+		cache.ForgetSources();
+		CHECK(cache.Key(source, defines) != before);
+		std::remove(cache.EntryPath(source, cache.Key(source, defines)).c_str());
+		CHECK(cache.Load(source, defines, bytecode));
+		CHECK(compiler.Calls == 3);
+
+		// A damaged entry is compiled again and rewritten.
+		std::string entry = cache.EntryPath(source, cache.Key(source, defines));
+		{
+			std::fstream f(entry.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+			f.seekp(0);
+			f.write("XXXX", 4);
+		}
+		CHECK(cache.Load(source, defines, bytecode));
+		CHECK(compiler.Calls == 4);
+		CHECK(cache.Load(source, defines, bytecode));
+		CHECK(compiler.Calls == 4);
+
+		// A failed compile reports its errors and stores nothing.
+		ShaderDefines broken;
+		broken.Set("BROKEN", 1);
+		std::remove(cache.EntryPath(source, cache.Key(source, broken)).c_str());
+
+		compiler.Fail = true;
+		std::string errors;
+		CHECK(!cache.Load(source, broken, bytecode, &errors));
+		CHECK(errors == "error X3000: syntax error");
+		CHECK(cache.GetStats().Failures == 1);
+
+		compiler.Fail = false;
+		CHECK(cache.Load(source, broken, bytecode));
+		CHECK(compiler.Calls == 6);
+	}
+}
+
+int main()
+{
+	TestDefines();
+	TestLitFeatures();
+	TestCache();
+
+	return CheckResult("ShaderCacheTest");
+}
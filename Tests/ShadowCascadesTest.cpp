@@ -0,0 +1,314 @@
+//***************************************************************************************
+// ShadowCascadesTest.cpp
+//
+// ShadowCascades: the split distances, that each cascade box holds its slice of the
+// frustum, and that the boxes neither change size as the camera turns nor move by
+// less than a shadow map texel.
+//***************************************************************************************
+
+#include "ShadowCascades.h"
+#include "Check.h"
+#include <cfloat>
+#include <cmath>
+
+namespace
+{
+	const float Pi = 3.1415926535f;
+
+	void Cross(const float a[3], const float b[3], float out[3])
+	{
+		out[0] = a[1]*b[2] - a[2]*b[1];
+		out[1] = a[2]*b[0] - a[0]*b[2];
+		out[2] = a[0]*b[1] - a[1]*b[0];
+	}
+
+	void Normalize(float v[3])
+	{
+		float length = std::sqrt(v[0]*v[0] + v[1]*v[1] + v[2]*v[2]);
+		for(int i = 0; i < 3; ++i)
+			v[i] /= length;
+	}
+
+	// Right, up and look of a left handed frame looking along look.
+	void Basis(const float look[3], float right[3], float up[3], float l[3])
+	{
+		const float worldUp[3] = { 0.0f, 1.0f, 0.0f };
+
+		for(int i = 0; i < 3; ++i)
+			l[i] = look[i];
+		Normalize(l);
+
+		Cross(worldUp, l, right);
+		Normalize(right);
+		Cross(l, right, up);
+	}
+
+	// A camera at (x, y, z) with the demo's lens, turned by yaw about y and pitched
+	// by pitch.
+	ShadowCascades::Frustum MakeCamera(float x, float y, float z, float yaw, float pitch)
+	{
+		float look[3] = { std::sin(yaw)*std::cos(pitch), -std::sin(pitch), std::cos(yaw)*std::cos(pitch) };
+
+		ShadowCascades::Frustum f;
+		f.Position[0] = x;
+		f.Position[1] = y;
+		f.Position[2] = z;
+		Basis(look, f.Right, f.Up, f.Look);
+
+		f.FovY   = 0.25f*Pi;
+		f.Aspect = 16.0f/9.0f;
+		f.NearZ  = 1.0f;
+		f.FarZ   = 300.0f;
+
+		return f;
+	}
+
+	// As XMMatrixLookToLH: the light at the origin looking along dir.
+	void LightView(const float dir[3], float view[4][4])
+	{
+		float r[3], u[3], l[3];
+		Basis(dir, r, u, l);
+
+		for(int i = 0; i < 3; ++i)
+		{
+			view[i][0] = r[i];
+			view[i][1] = u[i];
+			view[i][2] = l[i];
+			view[i][3] = 0.0f;
+		}
+
+		view[3][0] = view[3][1] = view[3][2] = 0.0f;
+		view[3][3] = 1.0f;
+	}
+
+	void ToLight(const float view[4][4], const float p[3], float out[3])
+	{
+		for(int j = 0; j < 3; ++j)
+			out[j] = p[0]*view[0][j] + p[1]*view[1][j] + p[2]*view[2][j] + view[3][j];
+	}
+
+	// Corner (sx, sy) of the frustum at depth z, in world space.
+	void Corner(const ShadowCascades::Frustum& f, float z, float sx, float sy, float out[3])
+	{
+		float tanY = std::tan(0.5f*f.FovY);
+		float tanX = f.Aspect*tanY;
+
+		for(int i = 0; i < 3; ++i)
+			out[i] = f.Position[i] + z*(f.Look[i] + sx*tanX*f.Right[i] + sy*tanY*f.Up[i]);
+	}
+
+	bool Inside(const ShadowCascades::Box& box, const float p[3])
+	{
+		const float eps = 1.0e-3f;
+		return p[0] >= box.Left - eps && p[0] <= box.Right + eps &&
+		       p[1] >= box.Bottom - eps && p[1] <= box.Top + eps &&
+		       p[2] >= box.Near - eps && p[2] <= box.Far + eps;
+	}
+
+	bool WholeNumber(float x)
+	{
+		return std::fabs(x - std::floor(x + 0.5f)) < 1.0e-2f;
+	}
+
+	void TestSplits()
+	{
+		float splits[ShadowCascades::MaxCascades + 1];
+
+		for(int count = 1; count <= ShadowCascades::MaxCascades; ++count)
+		{
+			for(int l = 0; l <= 4; ++l)
+			{
+				float lambda = 0.25f*l;
+				ShadowCascades::ComputeSplits(1.0f, 300.0f, count, lambda, splits);
+
+				CHECK(splits[0] == 1.0f);
+				CHECK(splits[count] == 300.0f);
+				for(int i = 1; i <= count; ++i)
+					CHECK(splits[i] > splits[i-1]);
+			}
+		}
+
+		// The ends of the blend: uniform and logarithmic.
+		ShadowCascades::ComputeSplits(10.0f, 1000.0f, 2, 0.0f, splits);
+		CHECK(std::fabs(splits[1] - 505.0f) < 1.0e-2f);
+		ShadowCascades::ComputeSplits(10.0f, 1000.0f, 2, 1.0f, splits);
+		CHECK(std::fabs(splits[1] - 100.0f) < 1.0e-2f);
+
+		// As Fit leaves them, and as the shaders get them.
+		ShadowCascades cascades;
+		cascades.SetCascadeCount(2);
+		cascades.Fit(MakeCamera(0.0f, 5.0f, 0.0f, 0.0f, 0.0f));
+
+		CHECK(cascades.SplitDistance(0) == 1.0f);
+		CHECK(cascades.SplitDistance(1) > 1.0f && cascades.SplitDistance(1) < 300.0f);
+		CHECK(cascades.SplitDistance(2) == 300.0f);
+
+		float ends[ShadowCascades::MaxCascades];
+		cascades.CascadeEnds(ends);
+		CHECK(ends[0] == cascades.SplitDistance(1));
+		CHECK(ends[1] == 300.0f);
+		CHECK(ends[2] == FLT_MAX && ends[3] == FLT_MAX);
+
+		// Fewer cascades after more leaves nothing of the old ones.
+		cascades.SetCascadeCount(4);
+		cascades.Fit(MakeCamera(0.0f, 5.0f, 0.0f, 0.0f, 0.0f));
+		cascades.SetCascadeCount(1);
+		cascades.Fit(MakeCamera(0.0f, 5.0f, 0.0f, 0.0f, 0.0f));
+		cascades.CascadeEnds(ends);
+		CHECK(ends[0] == 300.0f);
+		CHECK(ends[1] == FLT_MAX && ends[2] == FLT_MAX && ends[3] == FLT_MAX);
+	}
+
+	void TestContainsSlices()
+	{
+		const float dir[3] = { 0.57735f, -0.57735f, 0.57735f };
+		float view[4][4];
+		LightView(dir, view);
+
+		ShadowCascades cascades;
+		cascades.SetLightView(view);
+		cascades.SetShadowMapSize(1024);
+
+		const float cameras[][5] =
+		{
+			{ 0.0f, 5.0f, 0.0f, 0.0f, 0.0f },
+			{ 30.0f, 2.0f, -40.0f, 1.3f, 0.4f },
+			{ -12.0f, 50.0f, 7.0f, -2.5f, -0.9f },
+		};
+
+		for(int k = 0; k < 3; ++k)
+		{
+			const float* c = cameras[k];
+			ShadowCascades::Frustum f = MakeCamera(c[0], c[1], c[2], c[3], c[4]);
+			cascades.Fit(f);
+
+			unsigned int outside = 0;
+			for(int i = 0; i < cascades.CascadeCount(); ++i)
+			{
+				const ShadowCascades::Box& box = cascades.CascadeBox(i);
+
+				for(int corner = 0; corner < 8; ++corner)
+				{
+					float z = (corner & 4) ? cascades.SplitDistance(i+1) : cascades.SplitDistance(i);
+					float sx = (corner & 1) ? 1.0f : -1.0f;
+					float sy = (corner & 2) ? 1.0f : -1.0f;
+
+					float w[3], p[3];
+					Corner(f, z, sx, sy, w);
+					ToLight(view, w, p);
+
+					if( !Inside(box, p) )
+						++outside;
+				}
+			}
+
+			CHECK(outside == 0);
+		}
+
+		// Scene bounds pull the near side back toward the light, and only that.
+		ShadowCascades::Frustum f = MakeCamera(0.0f, 5.0f, 0.0f, 0.0f, 0.0f);
+		cascades.Fit(f);
+		ShadowCascades::Box before = cascades.CascadeBox(0);
+
+		const float sceneCenter[3] = { 0.0f, 0.0f, 0.0f };
+		cascades.SetSceneBounds(sceneCenter, 500.0f);
+		cascades.Fit(f);
+		ShadowCascades::Box after = cascades.CascadeBox(0);
+
+		CHECK(after.Near < before.Near);
+		CHECK(after.Far == before.Far);
+		CHECK(after.Left == before.Left && after.Right == before.Right);
+	}
+
+	void TestStableSize()
+	{
+		const float dir[3] = { -0.3f, -1.0f, 0.2f };
+		float view[4][4];
+		LightView(dir, view);
+
+		ShadowCascades cascades;
+		cascades.SetLightView(view);
+
+		cascades.Fit(MakeCamera(3.0f, 5.0f, -2.0f, 0.0f, 0.0f));
+		ShadowCascades::Box first[ShadowCascades::MaxCascades];
+		for(int i = 0; i < cascades.CascadeCount(); ++i)
+			first[i] = cascades.CascadeBox(i);
+
+		// Turning the camera in place moves the boxes but keeps their size.
+		for(int k = 1; k < 16; ++k)
+		{
+			cascades.Fit(MakeCamera(3.0f, 5.0f, -2.0f, 0.4f*k, 0.1f*(k % 5) - 0.2f));
+
+			for(int i = 0; i < cascades.CascadeCount(); ++i)
+			{
+				const ShadowCascades::Box& box = cascades.CascadeBox(i);
+				float width = first[i].Right - first[i].Left;
+				float height = first[i].Top - first[i].Bottom;
+				float depth = first[i].Far - first[i].Near;
+
+				CHECK(std::fabs((box.Right - box.Left) - width) <= 1.0e-4f*width);
+				CHECK(std::fabs((box.Top - box.Bottom) - height) <= 1.0e-4f*height);
+				CHECK(std::fabs((box.Far - box.Near) - depth) <= 1.0e-4f*depth);
+			}
+		}
+
+		// Square, as the shadow map is.
+		float width = first[0].Right - first[0].Left;
+		CHECK(std::fabs((first[0].Top - first[0].Bottom) - width) <= 1.0e-4f*width);
+	}
+
+	void TestTexelSnap()
+	{
+		const float dir[3] = { 0.4f, -1.0f, 0.7f };
+		float view[4][4];
+		LightView(dir, view);
+
+		const unsigned int size = 512;
+		ShadowCascades cascades;
+		cascades.SetLightView(view);
+		cascades.SetShadowMapSize(size);
+
+		cascades.Fit(MakeCamera(0.0f, 5.0f, 0.0f, 0.3f, 0.1f));
+		ShadowCascades::Box first[ShadowCascades::MaxCascades];
+		for(int i = 0; i < cascades.CascadeCount(); ++i)
+			first[i] = cascades.CascadeBox(i);
+
+		// Walking the camera in small steps: each box moves in whole texels,
+		// and does move.
+		bool moved[ShadowCascades::MaxCascades] = { false };
+		unsigned int offGrid = 0;
+		for(int k = 1; k < 200; ++k)
+		{
+			cascades.Fit(MakeCamera(0.013f*k, 5.0f, 0.007f*k, 0.3f + 0.002f*k, 0.1f));
+
+			for(int i = 0; i < cascades.CascadeCount(); ++i)
+			{
+				const ShadowCascades::Box& box = cascades.CascadeBox(i);
+				float texel = (box.Right - box.Left) / size;
+
+				float dx = (box.Left - first[i].Left) / texel;
+				float dy = (box.Bottom - first[i].Bottom) / texel;
+
+				if( !WholeNumber(dx) || !WholeNumber(dy) )
+					++offGrid;
+
+				if( dx != 0.0f || dy != 0.0f )
+					moved[i] = true;
+			}
+		}
+
+		CHECK(offGrid == 0);
+		for(int i = 0; i < cascades.CascadeCount(); ++i)
+			CHECK(moved[i]);
+	}
+}
+
+int main()
+{
+	TestSplits();
+	TestContainsSlices();
+	TestStableSize();
+	TestTexelSnap();
+
+	return CheckResult("ShadowCascadesTest");
+}
@@ -0,0 +1,187 @@
+//***************************************************************************************
+// ShadowFilterReferenceTest.cpp
+//
+// ShadowFilterReference: the tap weights of each filter, the 9 tap PCF5x5 against
+// the 5x5 tent it stands for, and SampleCmp's comparison and border.
+//***************************************************************************************
+
+#include "ShadowFilterReference.h"
+#include "Check.h"
+#include <cmath>
+#include <vector>
+
+namespace
+{
+	typedef ShadowFilterReference Ref;
+
+	bool Near(float a, float b, float eps = 1.0e-5f)
+	{
+		return std::fabs(a - b) <= eps;
+	}
+
+	// A fixed sequence, so a failure repeats.
+	class Random
+	{
+	public:
+		explicit Random(unsigned int seed) : mState(seed) { }
+
+		float Next(float lo, float hi)
+		{
+			mState = mState*1664525u + 1013904223u;
+			return lo + (hi - lo)*((mState >> 8) / 16777216.0f);
+		}
+
+	private:
+		unsigned int mState;
+	};
+
+	void TestWeights()
+	{
+		const Ref::Filter filters[] = { Ref::OneTap, Ref::Pcf3x3, Ref::Pcf5x5, Ref::Poisson };
+		const int tapCounts[] = { 1, 9, 9, 16 };
+
+		Random random(3u);
+		for(int f = 0; f < 4; ++f)
+		{
+			for(int i = 0; i < 50; ++i)
+			{
+				Ref::Tap taps[Ref::MaxTaps];
+				int count = Ref::FilterTaps(random.Next(0.0f, 1.0f), random.Next(0.0f, 1.0f),
+					512, 256, filters[f], taps);
+				CHECK(count == tapCounts[f]);
+
+				float sum = 0.0f;
+				bool positive = true;
+				for(int t = 0; t < count; ++t)
+				{
+					sum += taps[t].Weight;
+					positive = positive && taps[t].Weight > 0.0f;
+				}
+
+				CHECK(Near(sum, 1.0f));
+				CHECK(positive);
+			}
+		}
+
+		// The 5x5 weights are products of per axis weights summing to 12.
+		Ref::Tap taps[Ref::MaxTaps];
+		for(int i = 0; i <= 8; ++i)
+		{
+			float u = (100.0f + i/8.0f) / 512.0f;
+			Ref::FilterTaps(u, u, 512, 512, Ref::Pcf5x5, taps);
+
+			float sum = 0.0f;
+			for(int t = 0; t < 9; ++t)
+				sum += taps[t].Weight*144.0f;
+			CHECK(Near(sum, 144.0f, 1.0e-3f));
+		}
+	}
+
+	// What the 9 taps stand for: 25 bilinear taps a texel apart, weighted by the
+	// tent 1 3 4 3 1 along each axis, 144 in all.
+	float BruteForcePcf5x5(const float* depthMap, unsigned int width, unsigned int height,
+		float u, float v, float depth)
+	{
+		const float tent[5] = { 1.0f, 3.0f, 4.0f, 3.0f, 1.0f };
+
+		float total = 0.0f;
+		float weights = 0.0f;
+		for(int j = 0; j < 5; ++j)
+		{
+			for(int i = 0; i < 5; ++i)
+			{
+				float w = tent[i]*tent[j];
+				total += w*Ref::SampleCmp(depthMap, width, height, u + (i - 2.0f)/width, v + (j - 2.0f)/height, depth);
+				weights += w;
+			}
+		}
+
+		CHECK(weights == 144.0f);
+		return total / weights;
+	}
+
+	void TestPcf5x5()
+	{
+		const unsigned int width = 64;
+		const unsigned int height = 48;
+
+		Random random(11u);
+		std::vector<float> depthMap(width*height);
+		for(size_t i = 0; i < depthMap.size(); ++i)
+			depthMap[i] = random.Next(0.0f, 1.0f);
+
+		unsigned int mismatches = 0;
+		for(int i = 0; i < 2000; ++i)
+		{
+			// Edges included, where taps read the border.
+			float u = random.Next(-0.02f, 1.02f);
+			float v = random.Next(-0.02f, 1.02f);
+			float depth = random.Next(0.0f, 1.0f);
+
+			float nine = Ref::ShadowFactor(&depthMap[0], width, height, u, v, depth, Ref::Pcf5x5);
+			float brute = BruteForcePcf5x5(&depthMap[0], width, height, u, v, depth);
+
+			if( !Near(nine, brute, 1.0e-4f) )
+				++mismatches;
+		}
+
+		CHECK(mismatches == 0);
+	}
+
+	void TestSampleCmp()
+	{
+		// 4x2, with depths 0.1 to 0.8.
+		const unsigned int width = 4;
+		const unsigned int height = 2;
+		const float depthMap[width*height] =
+		{
+			0.1f, 0.2f, 0.3f, 0.4f,
+			0.5f, 0.6f, 0.7f, 0.8f
+		};
+
+		// At a texel center, only that texel counts.
+		float u1 = 1.5f/width;
+		float v0 = 0.5f/height;
+		CHECK(Ref::SampleCmp(depthMap, width, height, u1, v0, 0.15f) == 1.0f);
+		CHECK(Ref::SampleCmp(depthMap, width, height, u1, v0, 0.25f) == 0.0f);
+
+		// LESS: a depth equal to the stored one is in shadow, as with
+		// D3D11_COMPARISON_LESS.
+		CHECK(Ref::SampleCmp(depthMap, width, height, u1, v0, 0.2f) == 0.0f);
+
+		// Halfway between two texel centers, each counts half.
+		float u12 = 2.0f/width;
+		CHECK(Near(Ref::SampleCmp(depthMap, width, height, u12, v0, 0.25f), 0.5f));
+
+		// Between four, a quarter each.
+		float v01 = 1.0f/height;
+		CHECK(Near(Ref::SampleCmp(depthMap, width, height, u12, v01, 0.55f), 0.5f));
+		CHECK(Near(Ref::SampleCmp(depthMap, width, height, u12, v01, 0.65f), 0.25f));
+
+		// Texels off the map read the border value of 0, which no depth in
+		// [0, 1] is less than.
+		CHECK(Near(Ref::SampleCmp(depthMap, width, height, 0.0f, v0, 0.05f), 0.5f));
+		CHECK(Near(Ref::SampleCmp(depthMap, width, height, 1.0f, v0, 0.05f), 0.5f));
+		CHECK(Near(Ref::SampleCmp(depthMap, width, height, 0.0f, 0.0f, 0.05f), 0.25f));
+		CHECK(Ref::SampleCmp(depthMap, width, height, -1.0f, v0, 0.0f) == 0.0f);
+		CHECK(Ref::SampleCmp(depthMap, width, height, u1, 2.0f, 0.0f) == 0.0f);
+
+		// A fully lit map is lit by every filter away from the border.
+		std::vector<float> lit(32*32, 1.0f);
+		const Ref::Filter filters[] = { Ref::OneTap, Ref::Pcf3x3, Ref::Pcf5x5, Ref::Poisson };
+		for(int f = 0; f < 4; ++f)
+		{
+			CHECK(Near(Ref::ShadowFactor(&lit[0], 32, 32, 0.5f, 0.5f, 0.5f, filters[f]), 1.0f));
+			CHECK(Near(Ref::ShadowFactor(&lit[0], 32, 32, 0.5f, 0.5f, 1.0f, filters[f]), 0.0f));
+		}
+	}
+}
+
+int main()
+{
+	TestWeights();
+	TestPcf5x5();
+	TestSampleCmp();
+
+	return CheckResult("ShadowFilterReferenceTest");
+}
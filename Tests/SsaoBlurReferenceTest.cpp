@@ -0,0 +1,198 @@
+//***************************************************************************************
+// SsaoBlurReferenceTest.cpp
+//
+// SsaoBlurReference: the SSE2 and scalar paths give the same bits, and the blur
+// does not cross a depth or normal discontinuity.
+//***************************************************************************************
+
+#include "SsaoBlurReference.h"
+#include "Check.h"
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+	// A fixed sequence, so a failure repeats.
+	class Random
+	{
+	public:
+		explicit Random(unsigned int seed) : mState(seed) { }
+
+		float Next(float lo, float hi)
+		{
+			mState = mState*1664525u + 1013904223u;
+			return lo + (hi - lo)*((mState >> 8) / 16777216.0f);
+		}
+
+	private:
+		unsigned int mState;
+	};
+
+	void SetTexel(std::vector<float>& normalDepth, unsigned int width, unsigned int x, unsigned int y,
+		float nx, float ny, float nz, float depth)
+	{
+		float* t = &normalDepth[4*(y*width + x)];
+		t[0] = nx;
+		t[1] = ny;
+		t[2] = nz;
+		t[3] = depth;
+	}
+
+	// Patches of a few normals at depths that mostly vary slowly but jump now
+	// and then, so some taps pass the same surface test and some do not.
+	std::vector<float> RandomNormalDepth(unsigned int width, unsigned int height, Random& random)
+	{
+		const float normals[4][3] =
+		{
+			{ 0.0f, 0.0f, -1.0f }, { 0.0f, 0.6f, -0.8f }, { 0.6f, 0.0f, -0.8f }, { 0.0f, 1.0f, 0.0f }
+		};
+
+		std::vector<float> normalDepth(4*width*height);
+		for(unsigned int y = 0; y < height; ++y)
+		{
+			for(unsigned int x = 0; x < width; ++x)
+			{
+				const float* n = normals[((x / 7) + (y / 5)) % 4];
+				float depth = 10.0f + 0.01f*x + 0.02f*y + (random.Next(0.0f, 1.0f) < 0.1f ? 0.5f : random.Next(0.0f, 0.05f));
+
+				SetTexel(normalDepth, width, x, y, n[0], n[1], n[2], depth);
+			}
+		}
+
+		return normalDepth;
+	}
+
+	void TestSimdMatchesScalar()
+	{
+		if( !SsaoBlurReference::SimdAvailable() )
+		{
+			std::printf("SsaoBlurReferenceTest: no SSE2 path to compare\n");
+			return;
+		}
+
+		Random random(13u);
+
+		// Widths that are and are not multiples of four.
+		const unsigned int sizes[][2] = { { 64, 48 }, { 70, 38 }, { 18, 22 }, { 2, 10 } };
+
+		unsigned int differing = 0;
+		for(int s = 0; s < 4; ++s)
+		{
+			unsigned int width = sizes[s][0];
+			unsigned int height = sizes[s][1];
+
+			std::vector<float> normalDepth = RandomNormalDepth(width, height, random);
+
+			SsaoBlurReference blur;
+			blur.SetNormalDepth(&normalDepth[0], width, height);
+
+			unsigned int ambientSize = (width/2)*(height/2);
+			std::vector<float> input(ambientSize);
+			for(unsigned int i = 0; i < ambientSize; ++i)
+				input[i] = random.Next(0.0f, 1.0f);
+
+			for(int radius = 1; radius <= SsaoBlurReference::MaxBlurRadius; ++radius)
+			{
+				blur.SetBlurRadius(radius);
+
+				for(int horz = 0; horz < 2; ++horz)
+				{
+					std::vector<float> simd(ambientSize), scalar(ambientSize);
+					blur.BlurPass(&input[0], &simd[0], horz != 0, true);
+					blur.BlurPass(&input[0], &scalar[0], horz != 0, false);
+
+					if( std::memcmp(&simd[0], &scalar[0], ambientSize*sizeof(float)) != 0 )
+						++differing;
+				}
+
+				// Several full iterations, where any difference would grow.
+				std::vector<float> simd = input, scalar = input;
+				blur.Blur(simd, 4, true);
+				blur.Blur(scalar, 4, false);
+
+				if( std::memcmp(&simd[0], &scalar[0], ambientSize*sizeof(float)) != 0 )
+					++differing;
+			}
+		}
+
+		CHECK(differing == 0);
+	}
+
+	// Two halves whose ambient values differ, split at column splitX of the
+	// ambient map; the halves differ in depth, or in normal, or not at all.
+	enum Split { DepthStep, NormalStep, NoStep };
+
+	void TestEdges(Split split, bool useSimd)
+	{
+		const unsigned int width = 40;
+		const unsigned int height = 24;
+		const unsigned int splitX = 9;
+
+		std::vector<float> normalDepth(4*width*height);
+		for(unsigned int y = 0; y < height; ++y)
+		{
+			for(unsigned int x = 0; x < width; ++x)
+			{
+				bool right = x/2 >= splitX;
+				float depth = (split == DepthStep && right) ? 12.0f : 10.0f;
+				float ny = (split == NormalStep && right) ? 1.0f : 0.0f;
+				float nz = (split == NormalStep && right) ? 0.0f : -1.0f;
+
+				SetTexel(normalDepth, width, x, y, 0.0f, ny, nz, depth);
+			}
+		}
+
+		SsaoBlurReference blur;
+		blur.SetNormalDepth(&normalDepth[0], width, height);
+
+		const unsigned int ambientWidth = width/2;
+		const unsigned int ambientHeight = height/2;
+		std::vector<float> ambient(ambientWidth*ambientHeight);
+		for(unsigned int y = 0; y < ambientHeight; ++y)
+			for(unsigned int x = 0; x < ambientWidth; ++x)
+				ambient[y*ambientWidth + x] = x >= splitX ? 1.0f : 0.25f;
+
+		blur.Blur(ambient, 4, useSimd);
+
+		// Either side of the split.
+		float left = ambient[5*ambientWidth + splitX - 1];
+		float right = ambient[5*ambientWidth + splitX];
+
+		if( split == NoStep )
+		{
+			// One surface: the values mix across the split.
+			CHECK(left > 0.3f && right < 0.95f);
+		}
+		else
+		{
+			// Every tap from the other side is rejected, so each side keeps
+			// its own value exactly.
+			unsigned int leaked = 0;
+			for(unsigned int y = 0; y < ambientHeight; ++y)
+			{
+				for(unsigned int x = 0; x < ambientWidth; ++x)
+				{
+					if( ambient[y*ambientWidth + x] != (x >= splitX ? 1.0f : 0.25f) )
+						++leaked;
+				}
+			}
+
+			CHECK(leaked == 0);
+		}
+	}
+}
+
+int main()
+{
+	TestSimdMatchesScalar();
+
+	for(int simd = 0; simd < 2; ++simd)
+	{
+		TestEdges(DepthStep, simd != 0);
+		TestEdges(NormalStep, simd != 0);
+		TestEdges(NoStep, simd != 0);
+	}
+
+	return CheckResult("SsaoBlurReferenceTest");
+}
@@ -0,0 +1,242 @@
+//***************************************************************************************
+// SsaoReferenceTest.cpp
+//
+// SsaoReference on synthetic normal/depth maps: planes are not occluded, and the
+// texels next to a step in depth match saved values.
+//***************************************************************************************
+
+#include "SsaoReference.h"
+#include "Check.h"
+#include <cmath>
+#include <vector>
+
+namespace
+{
+	const float Pi = 3.1415926535f;
+
+	const unsigned int Width  = 64;
+	const unsigned int Height = 48;
+
+	const float FovY   = 0.25f*Pi;
+	const float Aspect = (float)Width / Height;
+	const float FarZ   = 1000.0f;
+
+	// How far a run may be from the saved values, as SsaoReference.h gives it:
+	// another compiler or instruction set may round and contract multiply-adds
+	// differently.
+	const float SavedTolerance = 1.0e-3f;
+
+	// A fixed sequence, so the random vectors and offsets are the same every run.
+	class Random
+	{
+	public:
+		explicit Random(unsigned int seed) : mState(seed) { }
+
+		unsigned int Next()
+		{
+			mState = mState*1664525u + 1013904223u;
+			return mState >> 8;
+		}
+
+	private:
+		unsigned int mState;
+	};
+
+	// As Ssao sets them up, with fixed lengths in place of random ones.
+	SsaoReference::Params MakeParams()
+	{
+		SsaoReference::Params params;
+
+		float tanY = std::tan(0.5f*FovY);
+		float halfHeight = FarZ*tanY;
+		float halfWidth = Aspect*halfHeight;
+
+		const float corners[4][2] =
+		{
+			{ -halfWidth, -halfHeight }, { -halfWidth, +halfHeight },
+			{ +halfWidth, +halfHeight }, { +halfWidth, -halfHeight }
+		};
+
+		for(int i = 0; i < 4; ++i)
+		{
+			params.FrustumCorners[i][0] = corners[i][0];
+			params.FrustumCorners[i][1] = corners[i][1];
+			params.FrustumCorners[i][2] = FarZ;
+			params.FrustumCorners[i][3] = 0.0f;
+		}
+
+		// XMMatrixPerspectiveFovLH times the NDC to texture transform.
+		float h = 1.0f / tanY;
+		float w = h / Aspect;
+		float range = FarZ / (FarZ - 1.0f);
+
+		float (*m)[4] = params.ViewToTexSpace;
+		for(int i = 0; i < 4; ++i)
+			for(int j = 0; j < 4; ++j)
+				m[i][j] = 0.0f;
+
+		m[0][0] = 0.5f*w;
+		m[1][1] = -0.5f*h;
+		m[2][0] = 0.5f;
+		m[2][1] = 0.5f;
+		m[2][2] = range;
+		m[2][3] = 1.0f;
+		m[3][2] = -range;
+
+		// The 14 cube corner and face directions.
+		const float directions[14][3] =
+		{
+			{ +1, +1, +1 }, { -1, -1, -1 }, { -1, +1, +1 }, { +1, -1, -1 },
+			{ +1, +1, -1 }, { -1, -1, +1 }, { -1, +1, -1 }, { +1, -1, +1 },
+			{ -1, 0, 0 }, { +1, 0, 0 }, { 0, -1, 0 }, { 0, +1, 0 }, { 0, 0, -1 }, { 0, 0, +1 }
+		};
+
+		params.SampleCount = 14;
+		for(int i = 0; i < 14; ++i)
+		{
+			const float* d = directions[i];
+			float s = (0.25f + 0.75f*i/13.0f) / std::sqrt(d[0]*d[0] + d[1]*d[1] + d[2]*d[2]);
+
+			params.OffsetVectors[i][0] = s*d[0];
+			params.OffsetVectors[i][1] = s*d[1];
+			params.OffsetVectors[i][2] = s*d[2];
+			params.OffsetVectors[i][3] = 0.0f;
+		}
+
+		return params;
+	}
+
+	std::vector<unsigned char> MakeRandomVectors()
+	{
+		const unsigned int size = SsaoReference::RandomVectorSize;
+
+		Random random(29u);
+		std::vector<unsigned char> rgba(4*size*size);
+		for(size_t i = 0; i < rgba.size(); ++i)
+			rgba[i] = (i % 4 == 3) ? 0 : (unsigned char)(random.Next() & 0xff);
+
+		return rgba;
+	}
+
+	void SetTexel(std::vector<float>& normalDepth, unsigned int x, unsigned int y,
+		float nx, float ny, float nz, float depth)
+	{
+		float* t = &normalDepth[4*(y*Width + x)];
+		t[0] = nx;
+		t[1] = ny;
+		t[2] = nz;
+		t[3] = depth;
+	}
+
+	// The ray through the center of pixel (x, y), with z = 1.
+	void PixelRay(unsigned int x, unsigned int y, float ray[3])
+	{
+		float tanY = std::tan(0.5f*FovY);
+		ray[0] = (2.0f*(x + 0.5f)/Width - 1.0f)*Aspect*tanY;
+		ray[1] = (1.0f - 2.0f*(y + 0.5f)/Height)*tanY;
+		ray[2] = 1.0f;
+	}
+
+	void TestPlanes()
+	{
+		SsaoReference::Params params = MakeParams();
+		std::vector<unsigned char> randomVectors = MakeRandomVectors();
+		std::vector<float> normalDepth(4*Width*Height);
+		std::vector<float> ambient;
+
+		// A wall facing the camera.
+		for(unsigned int y = 0; y < Height; ++y)
+			for(unsigned int x = 0; x < Width; ++x)
+				SetTexel(normalDepth, x, y, 0.0f, 0.0f, -1.0f, 10.0f);
+
+		SsaoReference::Compute(params, &normalDepth[0], Width, Height, &randomVectors[0], ambient);
+		CHECK(ambient.size() == (Width/2)*(Height/2));
+
+		float lowest = 1.0f;
+		for(size_t i = 0; i < ambient.size(); ++i)
+			lowest = ambient[i] < lowest ? ambient[i] : lowest;
+		CHECK(lowest > 0.999f);
+
+		// A floor seen at a slant, with the sky above the horizon at the far
+		// plane.  Point sampling puts a sample's depth up to a texel off the
+		// plane, so a little occlusion shows, but none of note.
+		const float floorY = -2.0f;
+		for(unsigned int y = 0; y < Height; ++y)
+		{
+			for(unsigned int x = 0; x < Width; ++x)
+			{
+				float ray[3];
+				PixelRay(x, y, ray);
+
+				if( ray[1] < 0.0f && floorY/ray[1] < FarZ )
+					SetTexel(normalDepth, x, y, 0.0f, 1.0f, 0.0f, floorY/ray[1]);
+				else
+					SetTexel(normalDepth, x, y, 0.0f, 0.0f, -1.0f, FarZ);
+			}
+		}
+
+		SsaoReference::Compute(params, &normalDepth[0], Width, Height, &randomVectors[0], ambient);
+
+		float sum = 0.0f;
+		lowest = 1.0f;
+		for(size_t i = 0; i < ambient.size(); ++i)
+		{
+			sum += ambient[i];
+			lowest = ambient[i] < lowest ? ambient[i] : lowest;
+		}
+		CHECK(sum / ambient.size() > 0.98f);
+		CHECK(lowest > 0.9f);
+	}
+
+	void TestStep()
+	{
+		SsaoReference::Params params = MakeParams();
+		params.OcclusionRadius = 2.0f;
+
+		std::vector<unsigned char> randomVectors = MakeRandomVectors();
+		std::vector<float> normalDepth(4*Width*Height);
+		std::vector<float> ambient;
+
+		// A wall at depth 10 on the left and 9.5 on the right, so the near side
+		// occludes the far side along the step.  The larger radius reaches a few
+		// texels past it.
+		for(unsigned int y = 0; y < Height; ++y)
+			for(unsigned int x = 0; x < Width; ++x)
+				SetTexel(normalDepth, x, y, 0.0f, 0.0f, -1.0f, x < Width/2 ? 10.0f : 9.5f);
+
+		SsaoReference::Compute(params, &normalDepth[0], Width, Height, &randomVectors[0], ambient);
+
+		// Row 12 of the ambient map from x = 10 to 21; the step is between 15
+		// and 16.
+		const unsigned int ambientWidth = Width/2;
+		const unsigned int row = 12;
+		const float saved[12] =
+		{
+			0.8939f, 1.0000f, 0.9029f, 1.0000f, 0.8482f, 0.4449f,
+			1.0000f, 1.0000f, 1.0000f, 1.0000f, 1.0000f, 1.0000f
+		};
+
+		unsigned int mismatches = 0;
+		for(unsigned int i = 0; i < 12; ++i)
+		{
+			if( std::fabs(ambient[row*ambientWidth + 10 + i] - saved[i]) > SavedTolerance )
+				++mismatches;
+		}
+		CHECK(mismatches == 0);
+
+		// Away from the step and on its near side nothing is occluded; on the
+		// far side next to it, something is.
+		CHECK(ambient[row*ambientWidth + 2] == 1.0f);
+		CHECK(ambient[row*ambientWidth + 29] == 1.0f);
+		CHECK(ambient[row*ambientWidth + 16] == 1.0f);
+		CHECK(ambient[row*ambientWidth + 15] < 0.9f);
+	}
+}
+
+int main()
+{
+	TestPlanes();
+	TestStep();
+
+	return CheckResult("SsaoReferenceTest");
+}
@@ -0,0 +1,248 @@
+//***************************************************************************************
+// SsaoTemporalReferenceTest.cpp
+//
+// SsaoTemporalReference against points projected straight into the previous frame:
+// a camera that moves and turns between frames must find each point where the
+// previous frame drew it.
+//***************************************************************************************
+
+#include "SsaoTemporalReference.h"
+#include "Check.h"
+#include <cmath>
+
+namespace
+{
+	typedef float Matrix[4][4];
+
+	bool Near(float a, float b, float eps = 1.0e-4f)
+	{
+		return std::fabs(a - b) <= eps*(1.0f + std::fabs(b));
+	}
+
+	void Identity(Matrix m)
+	{
+		for(int i = 0; i < 4; ++i)
+			for(int j = 0; j < 4; ++j)
+				m[i][j] = i == j ? 1.0f : 0.0f;
+	}
+
+	void Multiply(const Matrix a, const Matrix b, Matrix out)
+	{
+		Matrix r;
+		for(int i = 0; i < 4; ++i)
+		{
+			for(int j = 0; j < 4; ++j)
+			{
+				r[i][j] = 0.0f;
+				for(int k = 0; k < 4; ++k)
+					r[i][j] += a[i][k]*b[k][j];
+			}
+		}
+
+		for(int i = 0; i < 4; ++i)
+			for(int j = 0; j < 4; ++j)
+				out[i][j] = r[i][j];
+	}
+
+	// A camera turned by yaw about y and placed at pos, as its world matrix
+	// (camera to world) and view matrix (world to camera).
+	void Camera(float yaw, float x, float y, float z, Matrix world, Matrix view)
+	{
+		float c = std::cos(yaw);
+		float s = std::sin(yaw);
+
+		Identity(world);
+		world[0][0] = c;  world[0][2] = -s;
+		world[2][0] = s;  world[2][2] = c;
+		world[3][0] = x;  world[3][1] = y;  world[3][2] = z;
+
+		// The inverse of a rotation then translation.
+		Identity(view);
+		for(int i = 0; i < 3; ++i)
+			for(int j = 0; j < 3; ++j)
+				view[i][j] = world[j][i];
+
+		for(int j = 0; j < 3; ++j)
+			view[3][j] = -(x*view[0][j] + y*view[1][j] + z*view[2][j]);
+	}
+
+	// XMMatrixPerspectiveFovLH followed by the NDC to texture transform the
+	// demo uses.
+	void ProjTex(float fovY, float aspect, float nearZ, float farZ, Matrix m)
+	{
+		float h = 1.0f / std::tan(0.5f*fovY);
+		float w = h / aspect;
+		float range = farZ / (farZ - nearZ);
+
+		Matrix proj;
+		Identity(proj);
+		proj[0][0] = w;
+		proj[1][1] = h;
+		proj[2][2] = range;
+		proj[2][3] = 1.0f;
+		proj[3][2] = -range*nearZ;
+		proj[3][3] = 0.0f;
+
+		Matrix tex;
+		Identity(tex);
+		tex[0][0] = 0.5f;
+		tex[1][1] = -0.5f;
+		tex[3][0] = 0.5f;
+		tex[3][1] = 0.5f;
+
+		Multiply(proj, tex, m);
+	}
+
+	void TransformPoint(const float p[3], const Matrix m, float out[4])
+	{
+		for(int j = 0; j < 4; ++j)
+			out[j] = p[0]*m[0][j] + p[1]*m[1][j] + p[2]*m[2][j] + m[3][j];
+	}
+
+	void TestReconstruct()
+	{
+		float toFar[3] = { 30.0f, -12.0f, 100.0f };
+		float p[3];
+
+		SsaoTemporalReference::ReconstructViewPos(toFar, 25.0f, p);
+		CHECK(Near(p[2], 25.0f));
+		CHECK(Near(p[0], 7.5f));
+		CHECK(Near(p[1], -3.0f));
+	}
+
+	void TestStillCamera()
+	{
+		SsaoTemporalReference::Params params;
+		ProjTex(0.25f*3.14159265f, 16.0f/9.0f, 1.0f, 1000.0f, params.PrevViewToTex);
+
+		// The center of the screen stays put.
+		float p[3] = { 0.0f, 0.0f, 10.0f };
+		float n[3] = { 0.0f, 0.0f, -1.0f };
+		float prevP[3], prevN[3], prevTex[2];
+
+		CHECK(SsaoTemporalReference::Reproject(params, p, n, prevP, prevN, prevTex));
+		CHECK(Near(prevP[0], p[0]) && Near(prevP[1], p[1]) && Near(prevP[2], p[2]));
+		CHECK(Near(prevN[2], -1.0f));
+		CHECK(Near(prevTex[0], 0.5f) && Near(prevTex[1], 0.5f));
+
+		// +y in view space is up the screen, which is toward v = 0.
+		float up[3] = { 0.0f, 2.0f, 10.0f };
+		CHECK(SsaoTemporalReference::Reproject(params, up, n, prevP, prevN, prevTex));
+		CHECK(prevTex[1] < 0.5f);
+	}
+
+	void TestMovingCamera()
+	{
+		Matrix prevWorld, prevView, world, view, projTex;
+		Camera(0.10f, 1.0f, 2.0f, -20.0f, prevWorld, prevView);
+		Camera(0.15f, 1.5f, 2.0f, -19.0f, world, view);
+		ProjTex(0.25f*3.14159265f, 16.0f/9.0f, 1.0f, 1000.0f, projTex);
+
+		SsaoTemporalReference::Params params;
+		Multiply(world, prevView, params.ViewToPrevView);
+		for(int i = 0; i < 4; ++i)
+			for(int j = 0; j < 4; ++j)
+				params.PrevViewToTex[i][j] = projTex[i][j];
+
+		// World points in front of both cameras.
+		const float points[][3] =
+		{
+			{ 0.0f, 0.0f, 0.0f },
+			{ 3.0f, 1.0f, 5.0f },
+			{ -4.0f, 3.5f, 10.0f },
+			{ 2.0f, -1.0f, -8.0f },
+		};
+
+		for(int i = 0; i < 4; ++i)
+		{
+			float v[4], expectP[4], expectH[4];
+			TransformPoint(points[i], view, v);
+			TransformPoint(points[i], prevView, expectP);
+			TransformPoint(expectP, projTex, expectH);
+
+			// The same point through a normal/depth map: rebuilt from the
+			// vector to the far plane and the view space depth.
+			float toFar[3] = { v[0]*1000.0f/v[2], v[1]*1000.0f/v[2], 1000.0f };
+			float p[3];
+			SsaoTemporalReference::ReconstructViewPos(toFar, v[2], p);
+
+			// The world up vector seen from the current camera.
+			float n[3] = { view[1][0], view[1][1], view[1][2] };
+
+			float prevP[3], prevN[3], prevTex[2];
+			bool onScreen = SsaoTemporalReference::Reproject(params, p, n, prevP, prevN, prevTex);
+
+			CHECK(Near(prevP[0], expectP[0], 1.0e-3f));
+			CHECK(Near(prevP[1], expectP[1], 1.0e-3f));
+			CHECK(Near(prevP[2], expectP[2], 1.0e-3f));
+			CHECK(Near(prevTex[0], expectH[0]/expectH[3], 1.0e-3f));
+			CHECK(Near(prevTex[1], expectH[1]/expectH[3], 1.0e-3f));
+
+			// The normal is still world up, now in the previous view.
+			CHECK(Near(prevN[0], prevView[1][0]) && Near(prevN[1], prevView[1][1]) && Near(prevN[2], prevView[1][2]));
+
+			float u = expectH[0]/expectH[3];
+			float t = expectH[1]/expectH[3];
+			CHECK(onScreen == (u >= 0.0f && u <= 1.0f && t >= 0.0f && t <= 1.0f));
+
+			// The previous frame stored this very surface there.
+			float prevNormalDepth[4] = { prevN[0], prevN[1], prevN[2], expectP[2] };
+			CHECK(SsaoTemporalReference::SameSurface(params, prevP, prevN, prevNormalDepth));
+		}
+
+		// Far off to the side of the previous camera.
+		float side[3] = { 500.0f, 0.0f, 10.0f };
+		float n[3] = { 0.0f, 1.0f, 0.0f };
+		float prevP[3], prevN[3], prevTex[2];
+		CHECK(!SsaoTemporalReference::Reproject(params, side, n, prevP, prevN, prevTex));
+	}
+
+	void TestSameSurface()
+	{
+		SsaoTemporalReference::Params params;
+
+		float prevP[3] = { 0.0f, 0.0f, 20.0f };
+		float prevN[3] = { 0.0f, 0.0f, -1.0f };
+
+		float same[4] = { 0.0f, 0.0f, -1.0f, 20.5f };
+		CHECK(SsaoTemporalReference::SameSurface(params, prevP, prevN, same));
+
+		// Depth off by more than the 5% tolerance: a disocclusion.
+		float behind[4] = { 0.0f, 0.0f, -1.0f, 22.0f };
+		CHECK(!SsaoTemporalReference::SameSurface(params, prevP, prevN, behind));
+
+		// Same depth, but the normal turned away: another surface.
+		float turned[4] = { 0.0f, 0.8f, -0.6f, 20.0f };
+		CHECK(!SsaoTemporalReference::SameSurface(params, prevP, prevN, turned));
+	}
+
+	void TestAccumulate()
+	{
+		SsaoTemporalReference::Params params;
+		params.HistoryWeight = 0.75f;
+
+		CHECK(Near(SsaoTemporalReference::Accumulate(params, 0.2f, 1.0f, false), 0.2f));
+		CHECK(Near(SsaoTemporalReference::Accumulate(params, 0.2f, 1.0f, true), 0.8f));
+
+		params.HistoryWeight = 0.0f;
+		CHECK(Near(SsaoTemporalReference::Accumulate(params, 0.2f, 1.0f, true), 0.2f));
+
+		// Converges on a steady input.
+		params.HistoryWeight = 0.9f;
+		float history = 1.0f;
+		for(int i = 0; i < 200; ++i)
+			history = SsaoTemporalReference::Accumulate(params, 0.3f, history, true);
+		CHECK(Near(history, 0.3f));
+	}
+}
+
+int main()
+{
+	TestReconstruct();
+	TestStillCamera();
+	TestMovingCamera();
+	TestSameSurface();
+	TestAccumulate();
+
+	return CheckResult("SsaoTemporalReferenceTest");
+}
@@ -0,0 +1,308 @@
+//***************************************************************************************
+// TessellationReferenceTest.cpp
+//
+// TessellationReference, the CPU copy of FX/Tessellation.fx: the distance and screen
+// space edge factors, and patch culling against the pass's planes and view.  The
+// pass constants are built here as TessellationLod builds them, which needs XNA
+// Math and so cannot be linked into this test.
+//***************************************************************************************
+
+#include "TessellationReference.h"
+#include "Check.h"
+#include <cmath>
+
+namespace
+{
+	typedef TessellationReference::Constants Constants;
+
+	bool Near(float a, float b, float eps = 1.0e-4f)
+	{
+		return std::fabs(a - b) <= eps*(1.0f + std::fabs(b));
+	}
+
+	void SetPlane(float plane[4], float a, float b, float c, float d)
+	{
+		plane[0] = a;
+		plane[1] = b;
+		plane[2] = c;
+		plane[3] = d;
+	}
+
+	// TessellationSettings' default distances and height scale, the factor range
+	// [1, 64], and no planes or view to cull against.
+	Constants MakeConstants()
+	{
+		Constants c;
+		c.MaxTessDistance = 1.0f;
+		c.MinTessDistance = 25.0f;
+		c.MinTessFactor   = 1.0f;
+		c.MaxTessFactor   = 64.0f;
+		c.EdgeLength      = 0.0f;
+		c.ProjScale       = 500.0f;
+		c.HeightScale     = 0.07f;
+		c.BackfaceSlack   = 0.25f;
+
+		for(int i = 0; i < 6; ++i)
+			SetPlane(c.CullPlanes[i], 0.0f, 0.0f, 0.0f, 1.0f);
+
+		SetPlane(c.CullView, 0.0f, 0.0f, 0.0f, -1.0f);
+
+		return c;
+	}
+
+	// A light at the origin looking down +z with an orthographic volume of
+	// x, y in [-10, 10] and z in [0, 50], its planes in ExtractFrustumPlanes'
+	// order.  As TessellationLod::ShadowPass, the near plane is dropped and the
+	// view is the light's direction with w = 0.
+	Constants ShadowConstants(bool keepNearPlane = false)
+	{
+		Constants c = MakeConstants();
+		SetPlane(c.CullPlanes[0],  1.0f,  0.0f,  0.0f, 10.0f);
+		SetPlane(c.CullPlanes[1], -1.0f,  0.0f,  0.0f, 10.0f);
+		SetPlane(c.CullPlanes[2],  0.0f,  1.0f,  0.0f, 10.0f);
+		SetPlane(c.CullPlanes[3],  0.0f, -1.0f,  0.0f, 10.0f);
+		SetPlane(c.CullPlanes[4],  0.0f,  0.0f,  1.0f,  0.0f);
+		SetPlane(c.CullPlanes[5],  0.0f,  0.0f, -1.0f, 50.0f);
+
+		if( !keepNearPlane )
+			SetPlane(c.CullPlanes[4], 0.0f, 0.0f, 0.0f, 1.0f);
+
+		SetPlane(c.CullView, 0.0f, 0.0f, 1.0f, 0.0f);
+
+		return c;
+	}
+
+	// A patch around center whose clockwise normal, cross(p1-p0, p2-p0), is
+	// along n.
+	void MakePatch(const float center[3], const float n[3], float p[3][3])
+	{
+		// Any vector not along n, then two tangents with cross(t, b) = n.
+		float up[3] = { 0.0f, 1.0f, 0.0f };
+		if( std::fabs(n[1]) > 0.9f )
+		{
+			up[0] = 1.0f;
+			up[1] = 0.0f;
+		}
+
+		float t[3] = { up[1]*n[2] - up[2]*n[1], up[2]*n[0] - up[0]*n[2], up[0]*n[1] - up[1]*n[0] };
+		float length = std::sqrt(t[0]*t[0] + t[1]*t[1] + t[2]*t[2]);
+		for(int i = 0; i < 3; ++i)
+			t[i] /= length;
+
+		float b[3] = { n[1]*t[2] - n[2]*t[1], n[2]*t[0] - n[0]*t[2], n[0]*t[1] - n[1]*t[0] };
+
+		for(int i = 0; i < 3; ++i)
+		{
+			p[0][i] = center[i];
+			p[1][i] = center[i] + t[i];
+			p[2][i] = center[i] + b[i];
+		}
+	}
+
+	bool Culled(const Constants& c, const float center[3], const float n[3])
+	{
+		float p[3][3];
+		MakePatch(center, n, p);
+		return TessellationReference::PatchCulled(c, p[0], p[1], p[2]);
+	}
+
+	void TestDistanceFactors()
+	{
+		Constants c = MakeConstants();
+		c.MaxTessFactor = 5.0f;
+
+		const float eye[3] = { 0.0f, 0.0f, 0.0f };
+		const float at0[3]  = { 0.0f, 0.0f, 0.0f };
+		const float at1[3]  = { 0.0f, 1.0f, 0.0f };
+		const float at13[3] = { 0.0f, 0.0f, 13.0f };
+		const float at25[3] = { 25.0f, 0.0f, 0.0f };
+		const float at90[3] = { 0.0f, -90.0f, 0.0f };
+
+		// MaxTessFactor at MaxTessDistance and nearer, MinTessFactor at
+		// MinTessDistance and farther, linear between.
+		CHECK(Near(TessellationReference::VertexFactor(c, eye, at0), 5.0f));
+		CHECK(Near(TessellationReference::VertexFactor(c, eye, at1), 5.0f));
+		CHECK(Near(TessellationReference::VertexFactor(c, eye, at13), 3.0f));
+		CHECK(Near(TessellationReference::VertexFactor(c, eye, at25), 1.0f));
+		CHECK(Near(TessellationReference::VertexFactor(c, eye, at90), 1.0f));
+
+		// An edge takes the mean of its ends, the same from either end.
+		CHECK(Near(TessellationReference::EdgeFactor(c, eye, at1, at13), 4.0f));
+		CHECK(TessellationReference::EdgeFactor(c, eye, at1, at13) ==
+			TessellationReference::EdgeFactor(c, eye, at13, at1));
+
+		// Edge i is opposite vertex i, and inside is their mean.
+		float edge[3], inside;
+		CHECK(TessellationReference::PatchFactors(c, eye, at1, at13, at25, edge, inside));
+		CHECK(Near(edge[0], 2.0f));
+		CHECK(Near(edge[1], 3.0f));
+		CHECK(Near(edge[2], 4.0f));
+		CHECK(Near(inside, 3.0f));
+	}
+
+	void TestScreenSpaceFactors()
+	{
+		Constants c = MakeConstants();
+		c.EdgeLength = 8.0f;
+
+		const float eye[3] = { 0.0f, 0.0f, 0.0f };
+
+		// A unit edge at distance 10: 1*500/10 = 50 pixels, 6.25 edges of 8.
+		const float a[3] = { -0.5f, 0.0f, 10.0f };
+		const float b[3] = {  0.5f, 0.0f, 10.0f };
+		CHECK(Near(TessellationReference::EdgeFactor(c, eye, a, b), 6.25f));
+
+		// Twice as far, half the factor; the distances play no part.
+		const float a2[3] = { -0.5f, 0.0f, 20.0f };
+		const float b2[3] = {  0.5f, 0.0f, 20.0f };
+		CHECK(Near(TessellationReference::EdgeFactor(c, eye, a2, b2), 3.125f));
+
+		// Seen end on it does not shrink, since the projected size is that of
+		// the edge's bounding sphere.
+		const float a3[3] = { 0.0f, 0.0f, 9.5f };
+		const float b3[3] = { 0.0f, 0.0f, 10.5f };
+		CHECK(Near(TessellationReference::EdgeFactor(c, eye, a3, b3), 6.25f));
+
+		// Clamped to [1, 64]: a large edge next to the eye, and a small one far off.
+		const float near0[3] = { -5.0f, 0.0f, 1.0f };
+		const float near1[3] = {  5.0f, 0.0f, 1.0f };
+		CHECK(TessellationReference::EdgeFactor(c, eye, near0, near1) == 64.0f);
+
+		const float far0[3] = { 0.0f, 0.0f, 1000.0f };
+		const float far1[3] = { 0.1f, 0.0f, 1000.0f };
+		CHECK(TessellationReference::EdgeFactor(c, eye, far0, far1) == 1.0f);
+
+		// The midpoint on the eye does not divide by zero.
+		const float mid[3] = { 0.0f, 0.0f, 10.0f };
+		CHECK(TessellationReference::EdgeFactor(c, mid, a, b) == 64.0f);
+
+		// A narrower range clamps the same way.
+		c.MinTessFactor = 2.0f;
+		c.MaxTessFactor = 4.0f;
+		CHECK(TessellationReference::EdgeFactor(c, eye, a, b) == 4.0f);
+		CHECK(TessellationReference::EdgeFactor(c, eye, far0, far1) == 2.0f);
+	}
+
+	void TestPlaneCulling()
+	{
+		Constants c = ShadowConstants();
+
+		// Facing the light, so only the planes decide.
+		const float facing[3] = { 0.0f, 0.0f, -1.0f };
+
+		const float inside[3] = { 0.0f, 0.0f, 25.0f };
+		CHECK(!Culled(c, inside, facing));
+
+		// Straddling the left plane.
+		const float straddle[3] = { -9.5f, 0.0f, 25.0f };
+		CHECK(!Culled(c, straddle, facing));
+
+		// Wholly outside the left plane: within HeightScale, displacement could
+		// still bring it in; past it, not.
+		const float justOut[3][3] = { { -10.05f, 0.0f, 25.0f }, { -11.0f, 0.0f, 25.0f }, { -10.05f, 1.0f, 25.0f } };
+		CHECK(!TessellationReference::PatchCulled(c, justOut[0], justOut[1], justOut[2]));
+
+		const float wellOut[3][3] = { { -10.2f, 0.0f, 25.0f }, { -11.0f, 0.0f, 25.0f }, { -10.2f, 1.0f, 25.0f } };
+		CHECK(TessellationReference::PatchCulled(c, wellOut[0], wellOut[1], wellOut[2]));
+
+		// Without the slack, the first one goes too.
+		Constants flat = c;
+		flat.HeightScale = 0.0f;
+		CHECK(TessellationReference::PatchCulled(flat, justOut[0], justOut[1], justOut[2]));
+
+		// Past the far plane.
+		const float beyond[3] = { 0.0f, 0.0f, 60.0f };
+		CHECK(Culled(c, beyond, facing));
+
+		// Between the light and its volume: it still casts a shadow into the
+		// volume, so the shadow pass, with no near plane, keeps it.
+		const float before[3] = { 0.0f, 0.0f, -5.0f };
+		CHECK(!Culled(c, before, facing));
+		CHECK(Culled(ShadowConstants(true), before, facing));
+		CHECK(c.CullPlanes[4][0] == 0.0f && c.CullPlanes[4][1] == 0.0f &&
+			c.CullPlanes[4][2] == 0.0f && c.CullPlanes[4][3] > 0.0f);
+
+		// A culled patch gets factors of zero.
+		const float eye[3] = { 0.0f, 0.0f, 0.0f };
+		float edge[3] = { 1.0f, 1.0f, 1.0f };
+		float insideFactor = 1.0f;
+		float q[3][3];
+		MakePatch(beyond, facing, q);
+		CHECK(!TessellationReference::PatchFactors(c, eye, q[0], q[1], q[2], edge, insideFactor));
+		CHECK(edge[0] == 0.0f && edge[1] == 0.0f && edge[2] == 0.0f && insideFactor == 0.0f);
+	}
+
+	// Normals at an angle from the view direction, as cos(angle).
+	void Normal(float cosAngle, float n[3])
+	{
+		n[0] = std::sqrt(1.0f - cosAngle*cosAngle);
+		n[1] = 0.0f;
+		n[2] = cosAngle;
+	}
+
+	void CheckBackfaces(const Constants& c, const float center[3])
+	{
+		float n[3];
+
+		// Facing the view (the normal against the view direction) is kept,
+		// facing away culled.
+		Normal(-1.0f, n);
+		CHECK(!Culled(c, center, n));
+		Normal(1.0f, n);
+		CHECK(Culled(c, center, n));
+
+		// Edge on, and facing away by less than the slack, is kept;
+		// displacement can still turn part of it toward the view.
+		Normal(0.0f, n);
+		CHECK(!Culled(c, center, n));
+		Normal(0.2f, n);
+		CHECK(!Culled(c, center, n));
+		Normal(0.3f, n);
+		CHECK(Culled(c, center, n));
+
+		// A w below zero culls no back faces.
+		Constants off = c;
+		off.CullView[3] = -1.0f;
+		Normal(1.0f, n);
+		CHECK(!Culled(off, center, n));
+
+		// Nor does a degenerate patch.
+		float p[3] = { center[0], center[1], center[2] };
+		CHECK(!TessellationReference::PatchCulled(c, p, p, p));
+	}
+
+	void TestBackfaceCulling()
+	{
+		// Perspective: w = 1, the eye at the origin, and the patch straight
+		// ahead so the view direction is +z.
+		Constants perspective = MakeConstants();
+		SetPlane(perspective.CullView, 0.0f, 0.0f, 0.0f, 1.0f);
+
+		const float ahead[3] = { 0.0f, 0.0f, 20.0f };
+		CheckBackfaces(perspective, ahead);
+
+		// Moving the eye moves the direction a patch is seen from: the same
+		// patch seen from behind is culled.
+		float n[3] = { 0.0f, 0.0f, -1.0f };
+		SetPlane(perspective.CullView, 0.0f, 0.0f, 40.0f, 1.0f);
+		CHECK(Culled(perspective, ahead, n));
+
+		// Orthographic, as a shadow pass: w = 0 and the view is the light's
+		// direction, the same for every patch wherever it is.
+		Constants shadow = ShadowConstants();
+		CheckBackfaces(shadow, ahead);
+
+		const float offCenter[3] = { 8.0f, -7.0f, 3.0f };
+		CheckBackfaces(shadow, offCenter);
+	}
+}
+
+int main()
+{
+	TestDistanceFactors();
+	TestScreenSpaceFactors();
+	TestPlaneCulling();
+	TestBackfaceCulling();
+
+	return CheckResult("TessellationReferenceTest");
+}